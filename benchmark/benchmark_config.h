@@ -14,9 +14,14 @@ typedef struct
 /// @brief Indexes of the benchmarks included in the benchmarking suite
 typedef enum
 {
+    BENCHMARK_ARITHMETIC,
+    BENCHMARK_CALLBACK,
+    BENCHMARK_CLOSURE,
     BENCHMARK_EQUALITY,
     BENCHMARK_FIBONACCI,
     BENCHMARK_INSTANTIATION,
+    BENCHMARK_LIVE_HEAP,
+    BENCHMARK_LOCAL_FUNCTION,
     BENCHMARK_METHOD_CALL,
     BENCHMARK_NEGATE,
     BENCHMARK_PROPERTIES,
@@ -17,15 +17,36 @@
 #ifdef OS_UNIX_LIKE
     #include <dirent.h> 
     #include <sys/stat.h>
+    #include <unistd.h>
 #endif
 
 #include "../src/initializer.h"
+#include "../src/backend/virtual_machine.h"
+#include "../src/frontend/compiler.h"
 
 #include "common.h"
 
 /// @brief Benchmarks that are included in the benchmarking suiteby default
 static benchmark_config_t benchmarks[] = 
 {
+    [BENCHMARK_ARITHMETIC] =
+    {
+        .benchmarkName = "Arithmetic",
+        .benchmarkFilePath = "Arithmetic.clx",
+        .executionCount = 3
+    },
+    [BENCHMARK_CALLBACK] =
+    {
+        .benchmarkName = "Callback",
+        .benchmarkFilePath = "Callback.clx",
+        .executionCount = 3
+    },
+    [BENCHMARK_CLOSURE] =
+    {
+        .benchmarkName = "Closure",
+        .benchmarkFilePath = "Closure.clx",
+        .executionCount = 3
+    },
     [BENCHMARK_EQUALITY] =
     {
         .benchmarkName = "Equality",
@@ -44,6 +65,18 @@ static benchmark_config_t benchmarks[] =
         .benchmarkFilePath = "Instantiation.clx",
         .executionCount = 3
     },
+    [BENCHMARK_LIVE_HEAP] =
+    {
+        .benchmarkName = "Live Heap",
+        .benchmarkFilePath = "LiveHeap.clx",
+        .executionCount = 3
+    },
+    [BENCHMARK_LOCAL_FUNCTION] =
+    {
+        .benchmarkName = "Local Function",
+        .benchmarkFilePath = "LocalFunction.clx",
+        .executionCount = 3
+    },
     [BENCHMARK_METHOD_CALL] =
     {
         .benchmarkName = "Method Call",
@@ -76,15 +109,33 @@ static benchmark_config_t benchmarks[] =
     }
 };
 
+/// @brief Names of the dispatch techniques of the virtual machine that are compared by the benchmark runner
+static char const * dispatchTechniqueNames[] = 
+{
+    [DISPATCH_TECHNIQUE_SWITCH] = "switch",
+    [DISPATCH_TECHNIQUE_COMPUTED_GOTO] = "computed goto",
+    [DISPATCH_TECHNIQUE_TAIL_CALL] = "tail call",
+    [DISPATCH_TECHNIQUE_DIRECT_THREADED] = "direct threaded",
+    [DISPATCH_TECHNIQUE_JIT] = "jit"
+};
+
+/// @brief Names of the instruction sets emitted by the compiler that are compared by the benchmark runner
+static char const * instructionSetNames[] = 
+{
+    [INSTRUCTION_SET_REGISTER] = "register",
+    [INSTRUCTION_SET_STACK] = "stack"
+};
+
 static FILE * benchmark_runner_create_results_file_pointer();
 static void benchamrk_runner_ensure_results_directory_exists();
 static void benchmark_runner_execute_benchmark(benchmark_config_t, bool, FILE *);
+static void benchmark_runner_execute_benchmark_using(benchmark_config_t, char const *, dispatch_technique, instruction_set, FILE *);
+static void benchmark_runner_print_header(FILE *);
 
 void benchmark_runner_execute_all_predefiened()
 {
     FILE * filePointer = benchmark_runner_create_results_file_pointer();
-    printf("%10s | %10s | %10s | %8s\n",  "average", "min", "max", "name");
-    fprintf(filePointer, "%10s | %10s | %10s | %8s\n",  "average", "min", "max", "name");
+    benchmark_runner_print_header(filePointer);
     size_t benchmarkCount = sizeof(benchmarks) / sizeof(*benchmarks);
     for (size_t i = 0; i < benchmarkCount; i++)
         benchmark_runner_execute_benchmark(*(benchmarks + i), false, filePointer);
@@ -94,8 +145,7 @@ void benchmark_runner_execute_all_predefiened()
 void benchmark_runner_execute_predefiened(benchmark benchmark)
 {
     FILE * filePointer = benchmark_runner_create_results_file_pointer();
-    printf("%10s | %10s | %10s | %8s\n",  "average", "min", "max", "name");
-    fprintf(filePointer, "%10s | %10s | %10s | %8s\n",  "average", "min", "max", "name");
+    benchmark_runner_print_header(filePointer);
     benchmark_runner_execute_benchmark(*(benchmarks + benchmark), false, filePointer);
     fclose(filePointer);
 }
@@ -103,8 +153,7 @@ void benchmark_runner_execute_predefiened(benchmark benchmark)
 void benchmark_runner_execute_custom_benchmarks(dynamic_benchmark_config_array_t * config_array)
 {
     FILE * filePointer = benchmark_runner_create_results_file_pointer();
-    printf("%10s | %10s | %10s | %8s\n-----------|------------|------------|-----------\n",  "average", "min", "max", "name");
-    fprintf(filePointer, "%10s | %10s | %10s | %8s\n-----------|------------|------------|-----------\n",  "average", "min", "max", "name");
+    benchmark_runner_print_header(filePointer);
     for (size_t i = 0; i < config_array->count; i++)
         benchmark_runner_execute_benchmark(config_array->configs[i], true, filePointer);
     fclose(filePointer);
@@ -114,13 +163,21 @@ static FILE * benchmark_runner_create_results_file_pointer()
 {
     FILE * filePointer;
     time_t current_time = time(NULL);
-    char * fileName = ctime(&current_time);
-    if (!fileName)
+    char const * currentTimeString = ctime(&current_time);
+    if (!currentTimeString)
     {
         printf("Unable to convert time to a character sequence.\n");
         exit(EXIT_CODE_SYSTEM_ERROR);
     }
-    size_t fileNameSize = strlen(fileName);
+    size_t fileNameSize = strlen(currentTimeString);
+    // The string returned by ctime is statically allocated, so we need to copy it before it can be resized
+    char * fileName = (char *)malloc(fileNameSize + 1);
+    if (!fileName)
+    {
+        fprintf(stderr, "Unable to allocate memory for the filename.\n");
+        exit(EXIT_CODE_SYSTEM_ERROR);
+    }
+    strcpy(fileName, currentTimeString);
     for (size_t i = 0; i < fileNameSize; i++)
     {
         if (fileName[i] == ' ')
@@ -213,9 +270,6 @@ static void benchamrk_runner_ensure_results_directory_exists()
 
 static void benchmark_runner_execute_benchmark(benchmark_config_t benchmark, bool custom, FILE * filePointer)
 {
-    double combined_execution_duration = 0.0;
-    double min_execution_duration = DBL_MAX;
-    double max_execution_duration = DBL_MIN;
     char * filePath = NULL;
     if(!custom)
     {
@@ -223,16 +277,41 @@ static void benchmark_runner_execute_benchmark(benchmark_config_t benchmark, boo
         *filePath = '\0';
         strcat(filePath, BENCHMARK_BASE_PATH);
         strcat(filePath, benchmark.benchmarkFilePath);
-        filePath[strlen(BENCHMARK_BASE_PATH) + strlen(filePath)] = '\0';
     }
     else
         filePath = (char *)benchmark.benchmarkFilePath;  
+    // Every dispatch technique that was compiled into the virtual machine is benchmarked with the register based and 
+    // the stack based bytecode, so they can be compared
+    size_t techniqueCount = sizeof(dispatchTechniqueNames) / sizeof(*dispatchTechniqueNames);
+    size_t instructionSetCount = sizeof(instructionSetNames) / sizeof(*instructionSetNames);
+    for (size_t i = 0; i < techniqueCount; i++)
+    {
+        if(!virtual_machine_supports_dispatch_technique((dispatch_technique)i))
+            continue;
+        for (size_t j = 0; j < instructionSetCount; j++)
+            benchmark_runner_execute_benchmark_using(benchmark, filePath, (dispatch_technique)i, (instruction_set)j, filePointer);
+    }
+    if(!custom)
+        free(filePath);
+}
+
+static void benchmark_runner_execute_benchmark_using(benchmark_config_t benchmark, char const * filePath, dispatch_technique technique, instruction_set instructionSet, FILE * filePointer)
+{
+    double combined_execution_duration = 0.0;
+    double min_execution_duration = DBL_MAX;
+    double max_execution_duration = DBL_MIN;
+    virtual_machine_set_dispatch_technique(technique);
+    compiler_set_instruction_set(instructionSet);
 
-    char * measured_time = (char *)calloc(1024, sizeof(char));
+    // setbuf requires a buffer with a size of at least BUFSIZ
+    char * measured_time = (char *)calloc(BUFSIZ, sizeof(char));
     #ifdef OS_WINDOWS
     freopen("NUL", "a", stdout);
     #elif OS_UNIX_LIKE
-    freopen("/dev/nul", "a", stdout);
+    // The original standard output is duplicated, so it can be restored afterwards
+    fflush(stdout);
+    int stdoutDescriptor = dup(fileno(stdout));
+    freopen("/dev/null", "a", stdout);
     #endif
     
     double benchmark_execution_time;
@@ -256,18 +335,33 @@ static void benchmark_runner_execute_benchmark(benchmark_config_t benchmark, boo
             *buffer = '\0';
     }
     // Reset stdout redirection
+    #ifdef OS_WINDOWS
     freopen("CON", "w", stdout);
-    printf("%9gs | %9gs | %9gs | %s\n", 
+    #elif OS_UNIX_LIKE
+    fflush(stdout);
+    dup2(stdoutDescriptor, fileno(stdout));
+    close(stdoutDescriptor);
+    setvbuf(stdout, NULL, _IOLBF, BUFSIZ);
+    #endif
+    printf("%9gs | %9gs | %9gs | %15s | %8s | %s\n", 
             combined_execution_duration / benchmark.executionCount,
             min_execution_duration,
             max_execution_duration,
+            dispatchTechniqueNames[technique],
+            instructionSetNames[instructionSet],
             benchmark.benchmarkName);
-    fprintf(filePointer, "%9gs | %9gs | %9gs | %s\n", 
+    fprintf(filePointer, "%9gs | %9gs | %9gs | %15s | %8s | %s\n", 
             combined_execution_duration / benchmark.executionCount,
             min_execution_duration,
             max_execution_duration,
+            dispatchTechniqueNames[technique],
+            instructionSetNames[instructionSet],
             benchmark.benchmarkName);
-    if(!custom)
-        free(filePath);
     free(measured_time);
+}
+
+static void benchmark_runner_print_header(FILE * filePointer)
+{
+    printf("%10s | %10s | %10s | %15s | %8s | %8s\n",  "average", "min", "max", "dispatch", "bytecode", "name");
+    fprintf(filePointer, "%10s | %10s | %10s | %15s | %8s | %8s\n",  "average", "min", "max", "dispatch", "bytecode", "name");
 }
\ No newline at end of file
@@ -0,0 +1,210 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file concurrent_marker.c
+ * @brief File containing the implementation of the concurrent marker.
+ */
+
+#include "concurrent_marker.h"
+
+#ifdef CONCURRENT_MARKER_AVAILABLE
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "garbage_collector.h"
+#include "virtual_machine.h"
+
+/// The amount of gray objects the background thread blackens, before it checks whether the heap lock is needed by the
+/// thread of the virtual machine
+#define CONCURRENT_MARKER_BATCH_SIZE (256u)
+
+/// The amount of references the log can hold, before it is passed on to the background thread
+#define CONCURRENT_MARKER_LOG_SIZE (256u)
+
+bool concurrentMarkerActive = false;
+
+/// The function that marks the references of a gray object
+static void (*blackenObject)(object_t *) = NULL;
+/// The amount of heap changes that have begun, but haven't ended yet
+static uint32_t heapChanges = 0u;
+/// Determines whether the heap lock is held until the outermost heap change has ended
+static bool heapChangeLocked = false;
+/// Guards the gray objects, the mark bits and the layout of the objects while the background thread is marking - it is
+/// recursive, because a heap change can trigger a step of the garbage collector
+static pthread_mutex_t heapMutex;
+/// The references that were stored since the log was passed on to the background thread the last time
+static object_t * loggedReferences[CONCURRENT_MARKER_LOG_SIZE];
+/// The amount of references in the log
+static uint32_t logCount = 0u;
+/// Determines whether the background thread shall be terminated
+static bool terminating = false;
+/// The background thread
+static pthread_t thread;
+/// Determines whether the background thread has been started
+static bool threadStarted = false;
+/// The amount of threads that wait for the heap lock - the background thread lets them go first between two batches
+static uint32_t waitingThreads = 0u;
+/// Signals that gray objects are available or that the background thread shall be terminated
+static pthread_cond_t workCondition = PTHREAD_COND_INITIALIZER;
+
+static void concurrent_marker_flush_log();
+static void concurrent_marker_lock_heap();
+static void * concurrent_marker_run_thread(void *);
+static bool concurrent_marker_start_thread();
+
+void concurrent_marker_begin_heap_change() {
+    if (!heapChanges++ && concurrentMarkerActive) {
+        concurrent_marker_lock_heap();
+        heapChangeLocked = true;
+    }
+}
+
+void concurrent_marker_end_heap_change() {
+    if (!--heapChanges && heapChangeLocked) {
+        heapChangeLocked = false;
+        pthread_mutex_unlock(&heapMutex);
+    }
+}
+
+void concurrent_marker_free() {
+    if (!threadStarted) {
+        return;
+    }
+    pthread_mutex_lock(&heapMutex);
+    concurrentMarkerActive = false;
+    logCount = 0u;
+    terminating = true;
+    pthread_cond_signal(&workCondition);
+    pthread_mutex_unlock(&heapMutex);
+    pthread_join(thread, NULL);
+    pthread_mutex_destroy(&heapMutex);
+    threadStarted = terminating = false;
+}
+
+void concurrent_marker_log(object_t * reference) {
+    loggedReferences[logCount++] = reference;
+    if (logCount == CONCURRENT_MARKER_LOG_SIZE) {
+        concurrent_marker_lock_heap();
+        concurrent_marker_flush_log();
+        pthread_mutex_unlock(&heapMutex);
+    }
+}
+
+void concurrent_marker_rescan(object_t * object) {
+    concurrent_marker_lock_heap();
+    // The mark bit doesn't change while the lock is held, an unmarked object is blackened after the changes anyway
+    if (object->isMarked) {
+        blackenObject(object);
+        pthread_cond_signal(&workCondition);
+    }
+    pthread_mutex_unlock(&heapMutex);
+}
+
+bool concurrent_marker_start(void (*blacken)(object_t *)) {
+    // The layout of the object that is changed at the moment isn't consistent yet
+    if (heapChanges || (!threadStarted && !concurrent_marker_start_thread())) {
+        return false;
+    }
+    pthread_mutex_lock(&heapMutex);
+    blackenObject = blacken;
+    concurrentMarkerActive = true;
+    pthread_cond_signal(&workCondition);
+    pthread_mutex_unlock(&heapMutex);
+    return true;
+}
+
+bool concurrent_marker_step() {
+    concurrent_marker_lock_heap();
+    concurrent_marker_flush_log();
+    bool finished = !virtualMachine.grayCount;
+    pthread_mutex_unlock(&heapMutex);
+    return finished;
+}
+
+void concurrent_marker_stop() {
+    if (!concurrentMarkerActive) {
+        return;
+    }
+    concurrent_marker_lock_heap();
+    concurrent_marker_flush_log();
+    concurrentMarkerActive = false;
+    pthread_mutex_unlock(&heapMutex);
+}
+
+/// @brief Marks the logged references, so they are traced by the background thread
+/// @details The heap lock has to be held by the caller
+static void concurrent_marker_flush_log() {
+    for (uint32_t i = 0u; i < logCount; i++) {
+        garbage_collector_mark_object(loggedReferences[i]);
+    }
+    logCount = 0u;
+    if (virtualMachine.grayCount) {
+        pthread_cond_signal(&workCondition);
+    }
+}
+
+/// @brief Acquires the heap lock on the thread of the virtual machine
+static void concurrent_marker_lock_heap() {
+    __atomic_add_fetch(&waitingThreads, 1u, __ATOMIC_ACQ_REL);
+    pthread_mutex_lock(&heapMutex);
+    __atomic_sub_fetch(&waitingThreads, 1u, __ATOMIC_ACQ_REL);
+}
+
+/// @brief Blackens the gray objects in batches, while the marking is active
+/// @param argument Unused argument of the thread
+/// @return Always NULL
+static void * concurrent_marker_run_thread(void * argument) {
+    (void)argument;
+    pthread_mutex_lock(&heapMutex);
+    while (!terminating) {
+        if (!concurrentMarkerActive || !virtualMachine.grayCount) {
+            pthread_cond_wait(&workCondition, &heapMutex);
+            continue;
+        }
+        for (uint32_t i = 0u; i < CONCURRENT_MARKER_BATCH_SIZE && virtualMachine.grayCount; i++) {
+            blackenObject(virtualMachine.grayStack[--virtualMachine.grayCount]);
+        }
+        // The lock isn't fair, so the background thread waits until the thread of the virtual machine got it
+        if (__atomic_load_n(&waitingThreads, __ATOMIC_ACQUIRE)) {
+            pthread_mutex_unlock(&heapMutex);
+            while (__atomic_load_n(&waitingThreads, __ATOMIC_ACQUIRE)) {
+                sched_yield();
+            }
+            pthread_mutex_lock(&heapMutex);
+        }
+    }
+    pthread_mutex_unlock(&heapMutex);
+    return NULL;
+}
+
+/// @brief Creates the heap lock and starts the background thread
+/// @return true if the background thread was started, false if not
+static bool concurrent_marker_start_thread() {
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&heapMutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    if (pthread_create(&thread, NULL, concurrent_marker_run_thread, NULL)) {
+        pthread_mutex_destroy(&heapMutex);
+        return false;
+    }
+    threadStarted = true;
+    return true;
+}
+
+#endif
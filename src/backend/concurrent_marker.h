@@ -0,0 +1,82 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file concurrent_marker.h
+ * @brief Header file containing the declarations of the concurrent marker.
+ * @details The concurrent marker traces the references of the gray objects of a major garbage collection on a
+ * background thread, while the program continues. The thread blackens the objects in small batches while it holds the
+ * heap lock. The program takes the lock only when it changes the layout of an object that can be read by the thread
+ * (e.g. when an array grows) - ordinary stores are recorded by the write barrier in a log instead, and the logged
+ * references are passed on to the thread at every step of the garbage collector.
+ */
+
+#ifndef CELLOX_CONCURRENT_MARKER_H_
+#define CELLOX_CONCURRENT_MARKER_H_
+
+#include "../common.h"
+#include "../language-models/object.h"
+
+// The background thread relies on POSIX threads and the atomic builtins of GCC and Clang, a value has to be a single
+// word, so it isn't torn when it is read while it is stored
+#if defined(GC_CONCURRENT_MARKING) && defined(NAN_BOXING) && defined(OS_UNIX_LIKE) &&                                 \
+    defined(POSIX_THREADS_AVAILABLE) && (defined(COMPILER_GCC) || defined(COMPILER_CLANG))
+#define CONCURRENT_MARKER_AVAILABLE
+#endif
+
+#ifdef CONCURRENT_MARKER_AVAILABLE
+
+/// Determines whether the background thread is marking - only changed by the thread of the virtual machine
+extern bool concurrentMarkerActive;
+
+/// @brief Begins a change of the layout of an object that can be read by the background thread
+/// @details The heap lock is held until the outermost change has ended. The background thread isn't started during a
+/// change, because the change can trigger a garbage collection step before the layout is consistent again
+void concurrent_marker_begin_heap_change();
+
+/// @brief Ends a change of the layout of an object
+void concurrent_marker_end_heap_change();
+
+/// @brief Terminates the background thread
+void concurrent_marker_free();
+
+/// @brief Records a reference that was stored while the background thread is marking
+/// @param reference The object that is referenced
+/// @details The log is passed on to the background thread once it is full or at the next step of the garbage collector
+void concurrent_marker_log(object_t * reference);
+
+/// @brief Marks the references of a marked object again, because many of them have changed
+/// @param object The object that is rescanned
+/// @details Unmarked objects are ignored, they are traced by the background thread anyway
+void concurrent_marker_rescan(object_t * object);
+
+/// @brief Starts the marking of the gray objects on the background thread
+/// @param blacken The function that marks the references of a gray object
+/// @return true if the background thread is marking, false if the marking has to continue on the thread of the
+/// virtual machine for now
+bool concurrent_marker_start(void (*blacken)(object_t *));
+
+/// @brief Passes the logged references on to the background thread
+/// @return true if no gray objects are left, false if the background thread is still marking
+bool concurrent_marker_step();
+
+/// @brief Stops the marking on the background thread
+/// @details The logged references are marked, the gray objects that are left have to be traced by the thread of the
+/// virtual machine
+void concurrent_marker_stop();
+
+#endif
+
+#endif
@@ -22,49 +22,136 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#ifdef PROFILE_GARBAGE_COLLECTOR
+#include <inttypes.h>
+#include <time.h>
+#endif
 
 #include "../frontend/compiler.h"
 #ifdef DEBUG_LOG_GC
 #include "chunk_disassembler.h"
 #endif
 #include "../language-models/object.h"
+#include "concurrent_marker.h"
 #include "memory_mutator.h"
+#include "parallel_marker.h"
 #include "virtual_machine.h"
 
 #define GC_HEAP_GROWTH_FACTOR (2)
 
+#ifdef PROFILE_GARBAGE_COLLECTOR
+/// The pause times of the garbage collector in seconds
+static double * pauses = NULL;
+/// The amount of pause times that are stored
+static uint32_t pauseCount = 0u;
+/// The amount of pause times that can be stored before the array has to grow
+static uint32_t pauseCapacity = 0u;
+#endif
+
+static void garbage_collector_begin_major_collection();
+static void garbage_collector_begin_marking();
 static void garbage_collector_blacken_object(object_t *);
+static void garbage_collector_clear_remembered_set();
+static void garbage_collector_collect_young_generation();
+#ifdef PROFILE_GARBAGE_COLLECTOR
+static int garbage_collector_compare_pauses(void const *, void const *);
+#endif
+static void garbage_collector_end_major_collection();
+static void garbage_collector_end_marking();
 static void garbage_collector_mark_array(dynamic_value_array_t *);
+static void garbage_collector_mark_remembered_set();
 static void garbage_collector_mark_roots();
-static void garbage_collector_sweep();
-static void garbage_collector_trace_references();
+static void garbage_collector_mark_shape(object_shape_t *);
+#ifdef PROFILE_GARBAGE_COLLECTOR
+static void garbage_collector_record_pause(clock_t);
+#endif
+static bool garbage_collector_sweep_old_generation(uint32_t);
+static void garbage_collector_sweep_young_generation();
+static bool garbage_collector_trace_references(uint32_t);
+static bool garbage_collector_unmark_old_generation(uint32_t);
 
 void garbage_collector_collect_garbage() {
-#ifdef DEBUG_LOG_GC
-    printf("garbage collection process has begun\n");
-    size_t before = virtualMachine.bytesAllocated;
+#ifdef PROFILE_GARBAGE_COLLECTOR
+    clock_t start = clock();
 #endif
-    garbage_collector_mark_roots();
-    garbage_collector_trace_references();
-    // We have to remove the strings with a another method, because they have their own hashtable
-    value_hash_table_remove_white(&virtualMachine.strings);
-    // reclaim the garbage
-    garbage_collector_sweep();
-    // Adjusts the threshold when the next garbage collection will occur
-    virtualMachine.nextGC = virtualMachine.bytesAllocated * GC_HEAP_GROWTH_FACTOR;
-#ifdef DEBUG_LOG_GC
-    printf("garbage collection process has ended\n");
-    printf("   collected %zu bytes (from %zu to %zu) next at %zu\n", before - virtualMachine.bytesAllocated, before,
-           virtualMachine.bytesAllocated, virtualMachine.nextGC);
+    // Without a budget a major collection is completed in a single step
+    uint32_t budget = GC_MARK_BUDGET ? GC_MARK_BUDGET : UINT32_MAX;
+    switch (virtualMachine.gcPhase) {
+    case GARBAGE_COLLECTOR_PHASE_IDLE:
+        if (virtualMachine.oldGenerationSize <= virtualMachine.nextGC) {
+            garbage_collector_collect_young_generation();
+            break;
+        }
+        garbage_collector_begin_major_collection();
+        // fall through
+    case GARBAGE_COLLECTOR_PHASE_UNMARKING:
+        if (!garbage_collector_unmark_old_generation(budget)) {
+            break;
+        }
+        garbage_collector_begin_marking();
+        // fall through
+    case GARBAGE_COLLECTOR_PHASE_MARKING:
+        if (!garbage_collector_trace_references(budget)) {
+            break;
+        }
+        garbage_collector_end_marking();
+        // fall through
+    case GARBAGE_COLLECTOR_PHASE_SWEEPING:
+        if (garbage_collector_sweep_old_generation(budget)) {
+            garbage_collector_end_major_collection();
+        }
+        break;
+    }
+    // The steps of a major collection are closer together than the minor collections, so the marking keeps up with the
+    // allocations
+    bool idle = virtualMachine.gcPhase == GARBAGE_COLLECTOR_PHASE_IDLE;
+    virtualMachine.nextMinorGC = virtualMachine.bytesAllocated + (idle ? GC_NURSERY_SIZE : GC_STEP_SIZE);
+#ifdef PROFILE_GARBAGE_COLLECTOR
+    garbage_collector_record_pause(start);
 #endif
 }
 
+#ifdef PROFILE_GARBAGE_COLLECTOR
+void garbage_collector_free_profile() {
+    free(pauses);
+    pauses = NULL;
+    pauseCount = pauseCapacity = 0u;
+}
+
+void garbage_collector_print_profile(FILE * file) {
+    fprintf(file, "== garbage collector profile ==\n%" PRIu32 " pauses\n", pauseCount);
+    if (!pauseCount) {
+        return;
+    }
+    double total = 0.0;
+    for (uint32_t i = 0u; i < pauseCount; i++) {
+        total += pauses[i];
+    }
+    qsort(pauses, pauseCount, sizeof(double), garbage_collector_compare_pauses);
+    fprintf(file, "total %.3f ms\n", total * 1000.0);
+    static uint32_t const percentiles[] = {50u, 90u, 99u};
+    for (size_t i = 0u; i < sizeof(percentiles) / sizeof(uint32_t); i++) {
+        // Nearest rank method
+        uint32_t rank = (percentiles[i] * pauseCount + 99u) / 100u;
+        fprintf(file, "p%" PRIu32 " %.3f ms\n", percentiles[i], pauses[rank - 1u] * 1000.0);
+    }
+    fprintf(file, "max %.3f ms\n", pauses[pauseCount - 1u] * 1000.0);
+}
+#endif
+
 void garbage_collector_mark_object(object_t * object) {
     if (!object) {
         return;
     }
+#ifdef PARALLEL_MARKER_AVAILABLE
+    // The references are traced by the workers of the parallel marker
+    if (parallelMarkerWorker) {
+        parallel_marker_mark_object(object);
+        return;
+    }
+#endif
     // Object is already marked, so we don't need to mark it again
-    if (object->isMarked) {
+    if (GC_IS_MARKED(object)) {
         return;
     }
 #ifdef DEBUG_LOG_GC
@@ -72,7 +159,7 @@ void garbage_collector_mark_object(object_t * object) {
     value_print(OBJECT_VAL(object));
     printf("\n");
 #endif
-    object->isMarked = true;
+    GC_SET_MARKED(object);
     if (virtualMachine.grayCapacity < virtualMachine.grayCount + 1) {
         virtualMachine.grayCapacity = GROW_CAPACITY(virtualMachine.grayCapacity);
         virtualMachine.grayStack =
@@ -90,6 +177,66 @@ void garbage_collector_mark_value(value_t value) {
     }
 }
 
+void garbage_collector_record_reference(object_t * object, object_t * reference) {
+#ifdef CONCURRENT_MARKER_AVAILABLE
+    // The gray objects belong to the background thread
+    if (concurrentMarkerActive) {
+        concurrent_marker_log(reference);
+        return;
+    }
+#endif
+    if (virtualMachine.gcPhase == GARBAGE_COLLECTOR_PHASE_MARKING) {
+        garbage_collector_mark_object(reference);
+    } else {
+        garbage_collector_remember(object);
+    }
+}
+
+void garbage_collector_remember(object_t * object) {
+#ifdef CONCURRENT_MARKER_AVAILABLE
+    if (concurrentMarkerActive) {
+        concurrent_marker_rescan(object);
+        return;
+    }
+#endif
+    if (!object->isMarked || object->isRemembered) {
+        return;
+    }
+    if (virtualMachine.gcPhase == GARBAGE_COLLECTOR_PHASE_MARKING) {
+        garbage_collector_blacken_object(object);
+        return;
+    }
+    object->isRemembered = true;
+    if (virtualMachine.rememberedCapacity < virtualMachine.rememberedCount + 1) {
+        virtualMachine.rememberedCapacity = GROW_CAPACITY(virtualMachine.rememberedCapacity);
+        virtualMachine.rememberedSet =
+            (object_t **)realloc(virtualMachine.rememberedSet, sizeof(object_t *) * virtualMachine.rememberedCapacity);
+    }
+    if (!virtualMachine.rememberedSet) {
+        exit(EXIT_CODE_SYSTEM_ERROR);
+    }
+    virtualMachine.rememberedSet[virtualMachine.rememberedCount++] = object;
+}
+
+/// @brief Begins a major garbage collection
+/// @details The young generation is collected beforehand, so all the objects belong to the old generation
+static void garbage_collector_begin_major_collection() {
+    garbage_collector_collect_young_generation();
+#ifdef DEBUG_LOG_GC
+    printf("major garbage collection process has begun\n");
+#endif
+    virtualMachine.sweepCursor = &virtualMachine.objects;
+    virtualMachine.gcPhase = GARBAGE_COLLECTOR_PHASE_UNMARKING;
+}
+
+/// @brief Begins the incremental marking after the old generation has been unmarked
+static void garbage_collector_begin_marking() {
+    // The objects that are remembered will be marked anyway
+    garbage_collector_clear_remembered_set();
+    garbage_collector_mark_roots();
+    virtualMachine.gcPhase = GARBAGE_COLLECTOR_PHASE_MARKING;
+}
+
 /// @brief Blackens an object
 /// @param object The object that is blackened
 /// @details This means all the references of this object have been marked
@@ -122,6 +269,8 @@ static void garbage_collector_blacken_object(object_t * object) {
             garbage_collector_mark_object((object_t *)celloxClass->name);
             // If a class is reachable, all the methods are reachable, too.
             value_hash_table_mark(&celloxClass->methods);
+            // The names of the fields in the shapes of the class are reachable as well
+            garbage_collector_mark_shape(celloxClass->rootShape);
             break;
         }
     case OBJECT_CLOSURE:
@@ -133,27 +282,44 @@ static void garbage_collector_blacken_object(object_t * object) {
             for (uint32_t i = 0; i < closure->upvalueCount; i++) {
                 garbage_collector_mark_object((object_t *)closure->upvalues[i]);
             }
+            // The same applies to the values that are captured by the closure
+            for (uint32_t i = 0; i < closure->capturedValueCount; i++) {
+                garbage_collector_mark_value(CLOSURE_CAPTURED_VALUES(closure)[i]);
+            }
             break;
         }
     case OBJECT_FUNCTION:
         {
             object_function_t * function = (object_function_t *)object;
             garbage_collector_mark_object((object_t *)function->name);
+            garbage_collector_mark_object((object_t *)GC_LOAD_SLOT(function->closure));
             // If a function is reachable all of the constants stored in the chunk are reachable, too.
             garbage_collector_mark_array(&function->chunk.constants);
+            // The classes stored in the inline caches are reachable, so they can't be replaced by another class that is
+            // allocated at the same address
+            for (uint32_t i = 0; i < function->chunk.inlineCacheCount; i++) {
+                inline_cache_mark(function->chunk.inlineCaches + i);
+            }
+            // The same applies to the callees that are stored in the call caches
+            for (uint32_t i = 0; i < function->chunk.callCacheCount; i++) {
+                call_cache_mark(function->chunk.callCaches + i);
+            }
             break;
         }
     case OBJECT_INSTANCE:
         {
             object_instance_t * instance = (object_instance_t *)object;
             garbage_collector_mark_object((object_t *)instance->celloxClass);
+            garbage_collector_mark_object((object_t *)GC_LOAD_SLOT(instance->boundMethod));
             // If the instace is reachable all of it's fields are reachable, too.
-            value_hash_table_mark(&instance->fields);
+            for (uint32_t i = 0; i < instance->shape->fieldCount; i++) {
+                garbage_collector_mark_value(GC_LOAD_SLOT(*object_instance_field(instance, i)));
+            }
             break;
         }
     case OBJECT_UPVALUE:
         // If a upvalue is reachable the captured value is reachable, too.
-        garbage_collector_mark_value(((object_upvalue_t *)object)->closed);
+        garbage_collector_mark_value(GC_LOAD_SLOT(((object_upvalue_t *)object)->closed));
         break;
     case OBJECT_NATIVE:
     case OBJECT_STRING:
@@ -161,11 +327,89 @@ static void garbage_collector_blacken_object(object_t * object) {
     }
 }
 
+/// @brief Removes all the objects from the remembered set
+static void garbage_collector_clear_remembered_set() {
+    for (uint32_t i = 0u; i < virtualMachine.rememberedCount; i++) {
+        virtualMachine.rememberedSet[i]->isRemembered = false;
+    }
+    virtualMachine.rememberedCount = 0u;
+}
+
+/// @brief Collects the objects that have been allocated since the last garbage collection (minor garbage collection)
+static void garbage_collector_collect_young_generation() {
+#ifdef DEBUG_LOG_GC
+    printf("minor garbage collection process has begun\n");
+    size_t before = virtualMachine.bytesAllocated;
+#endif
+    garbage_collector_mark_roots();
+    // The marking stops at the old objects, so the young objects only they refer to are marked from here
+    garbage_collector_mark_remembered_set();
+    garbage_collector_trace_references(UINT32_MAX);
+    // The young strings that are reclaimed are removed from the hashtable during the sweep
+    garbage_collector_sweep_young_generation();
+    garbage_collector_clear_remembered_set();
+    // The surviving objects are old now
+    virtualMachine.oldGenerationSize = virtualMachine.bytesAllocated;
+#ifdef DEBUG_LOG_GC
+    printf("garbage collection process has ended\n");
+    printf("   collected %zu bytes (from %zu to %zu)\n", before - virtualMachine.bytesAllocated, before,
+           virtualMachine.bytesAllocated);
+#endif
+}
+
+#ifdef PROFILE_GARBAGE_COLLECTOR
+/// @brief Compares two pause times
+/// @param a The first pause time
+/// @param b The second pause time
+/// @return A negative value if the first pause was shorter, a positive value if it was longer and zero otherwise
+static int garbage_collector_compare_pauses(void const * a, void const * b) {
+    double first = *(double const *)a;
+    double second = *(double const *)b;
+    return (first > second) - (first < second);
+}
+#endif
+
+/// @brief Ends a major garbage collection after the old generation has been swept
+static void garbage_collector_end_major_collection() {
+    virtualMachine.gcPhase = GARBAGE_COLLECTOR_PHASE_IDLE;
+    // Adjusts the threshold when the next major garbage collection will occur
+    virtualMachine.oldGenerationSize = virtualMachine.bytesAllocated;
+    virtualMachine.nextGC = virtualMachine.bytesAllocated * GC_HEAP_GROWTH_FACTOR;
+#ifdef DEBUG_LOG_GC
+    printf("garbage collection process has ended\n   %zu bytes allocated - next at %zu\n",
+           virtualMachine.bytesAllocated, virtualMachine.nextGC);
+#endif
+}
+
+/// @brief Ends the marking of a major garbage collection
+/// @details The roots are marked again, because they aren't guarded by the write barrier. The objects that have been
+/// allocated during the marking stay in the young generation and are swept by the next minor garbage collection.
+static void garbage_collector_end_marking() {
+#ifdef CONCURRENT_MARKER_AVAILABLE
+    // The gray objects the background thread hasn't blackened yet are traced during the pause
+    concurrent_marker_stop();
+#endif
+    garbage_collector_mark_roots();
+    garbage_collector_trace_references(UINT32_MAX);
+    // We have to remove the strings with a another method, because they have their own hashtable
+    value_hash_table_remove_white(&virtualMachine.strings);
+    virtualMachine.sweepCursor = &virtualMachine.objects;
+    virtualMachine.gcPhase = GARBAGE_COLLECTOR_PHASE_SWEEPING;
+}
+
 /// @brief  Marks all the values in an array
 /// @param array The array where all the values are marked
 static void garbage_collector_mark_array(dynamic_value_array_t * array) {
     for (int32_t i = 0; i < array->count; i++) {
-        garbage_collector_mark_value(array->values[i]);
+        garbage_collector_mark_value(GC_LOAD_SLOT(array->values[i]));
+    }
+}
+
+/// @brief Marks the young objects the objects in the remembered set refer to
+/// @details The remembered objects are old and therefore already marked, so they are blackened directly
+static void garbage_collector_mark_remembered_set() {
+    for (uint32_t i = 0u; i < virtualMachine.rememberedCount; i++) {
+        garbage_collector_blacken_object(virtualMachine.rememberedSet[i]);
     }
 }
 
@@ -181,48 +425,129 @@ static void garbage_collector_mark_roots() {
         garbage_collector_mark_object((object_t *)virtualMachine.callStack[i].closure);
     }
     // all the upvalues
-    for (object_upvalue_t * upvalue = virtualMachine.openUpvalues; upvalue; upvalue = upvalue->next) {
-        garbage_collector_mark_object((object_t *)upvalue);
+    for (uint32_t i = 0u; i < virtualMachine.openUpvalueTop; i++) {
+        garbage_collector_mark_object((object_t *)virtualMachine.openUpvalues[i]);
     }
-    // all the global variables
+    // all the values of the global variables
+    garbage_collector_mark_array(&virtualMachine.globalValues);
+    // and their names, the slots in the hashtable are only numbers
     value_hash_table_mark(&virtualMachine.globals);
     // and all the compiler roots allocated on the heap
     compiler_mark_roots();
     garbage_collector_mark_object((object_t *)virtualMachine.initString);
 }
 
-/** @brief Walks through the linked list of objects on the heap and checks their mark bits.
- * @details If an object is unmarked, it is unlinked from the list
- * and the memory used by the object is reclaimed
+/// @brief Marks the names of the fields in a shape and in all the shapes that were created by adding fields to it
+/// @param shape The shape that is marked
+static void garbage_collector_mark_shape(object_shape_t * shape) {
+    garbage_collector_mark_object((object_t *)shape->name);
+    for (uint32_t i = 0; i < shape->transitionCount; i++) {
+        garbage_collector_mark_shape(shape->transitions[i]);
+    }
+}
+
+#ifdef PROFILE_GARBAGE_COLLECTOR
+/// @brief Records the pause time of a garbage collection step
+/// @param start The processor time when the step has begun
+static void garbage_collector_record_pause(clock_t start) {
+    if (pauseCapacity < pauseCount + 1) {
+        pauseCapacity = GROW_CAPACITY(pauseCapacity);
+        pauses = (double *)realloc(pauses, sizeof(double) * pauseCapacity);
+    }
+    if (!pauses) {
+        exit(EXIT_CODE_SYSTEM_ERROR);
+    }
+    pauses[pauseCount++] = (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+#endif
+
+/** @brief Walks through the objects of the old generation and checks their mark bits.
+ * @param budget The maximum amount of objects that are swept
+ * @return true if the whole old generation has been swept, false if not
+ * @details The sweeping continues where the previous step has stopped. If an object is unmarked, it is unlinked from
+ * the list and the memory used by the object is reclaimed.
+ */
+static bool garbage_collector_sweep_old_generation(uint32_t budget) {
+    object_t ** link = virtualMachine.sweepCursor;
+    for (object_t * object = *link; object && budget; object = *link, budget--) {
+        if (object->isMarked) {
+            link = &object->next;
+        } else {
+            // Unreachable value -> free memory used by the object
+            *link = object->next;
+            memory_mutator_free_object(object);
+        }
+    }
+    virtualMachine.sweepCursor = link;
+    return !*link;
+}
+
+/** @brief Walks through the objects of the young generation and checks their mark bits.
+ * @details If an object is unmarked, the memory used by the object is reclaimed and unreachable strings are removed
+ * from the hashtable of the strings (if the last major collection hasn't removed them already). The marked objects stay
+ * marked, they are promoted by moving them to the list of the old objects.
  */
-static void garbage_collector_sweep() {
-    object_t * previous = NULL;
-    object_t * object = virtualMachine.objects;
+static void garbage_collector_sweep_young_generation() {
+    object_t * object = virtualMachine.youngObjects;
     while (object) {
+        object_t * next = object->next;
         if (object->isMarked) {
-            // We need to unmark the object so it is picked up during the next grabage collection process
-            object->isMarked = false;
-            previous = object;
-            object = object->next;
+            object->next = virtualMachine.objects;
+            virtualMachine.objects = object;
         } else {
             // Unreachable value -> free memory used by the object
-            object_t * unreached = object;
-            object = object->next;
-            if (previous) {
-                previous->next = object;
-            } else {
-                virtualMachine.objects = object;
+            if (object->type == OBJECT_STRING) {
+                value_hash_table_delete(&virtualMachine.strings, (object_string_t *)object);
             }
-            memory_mutator_free_object(unreached);
+            memory_mutator_free_object(object);
         }
+        object = next;
     }
+    // The young generation is empty after all the objects have been promoted or reclaimed
+    virtualMachine.youngObjects = NULL;
 }
 
-/// @brief Traces all the references to the objects of the virtual machine that are reachable
-/// All the objects that are reachable are marked as gray after the compiler roots are marked.
-static void garbage_collector_trace_references() {
-    while (virtualMachine.grayCount) {
+/// @brief Traces the references of the gray objects
+/// @param budget The maximum amount of objects that are blackened
+/// @return true if there are no gray objects left, false if not
+/// @details All the objects that are reachable are marked as gray after the roots have been marked.
+static bool garbage_collector_trace_references(uint32_t budget) {
+#ifdef CONCURRENT_MARKER_AVAILABLE
+    // The incremental marking of a major collection is handed over to the background thread. The marking ends, once no
+    // gray objects are left or the heap has doubled in the meantime, because no minor collections take place
+    if (budget != UINT32_MAX && virtualMachine.gcPhase == GARBAGE_COLLECTOR_PHASE_MARKING &&
+        (concurrentMarkerActive || concurrent_marker_start(garbage_collector_blacken_object))) {
+        return concurrent_marker_step() ||
+               virtualMachine.bytesAllocated > virtualMachine.oldGenerationSize * GC_HEAP_GROWTH_FACTOR;
+    }
+#endif
+#ifdef PARALLEL_MARKER_AVAILABLE
+    // Only the marking of a major collection, that isn't limited by a budget, is distributed across the workers
+    if (budget == UINT32_MAX && virtualMachine.grayCount && virtualMachine.gcPhase == GARBAGE_COLLECTOR_PHASE_MARKING &&
+        virtualMachine.bytesAllocated >= GC_PARALLEL_MARKING_THRESHOLD &&
+        parallel_marker_trace(virtualMachine.grayStack, virtualMachine.grayCount, garbage_collector_blacken_object,
+                              GC_MARK_THREADS)) {
+        virtualMachine.grayCount = 0u;
+        return true;
+    }
+#endif
+    for (; virtualMachine.grayCount && budget; budget--) {
         object_t * object = virtualMachine.grayStack[--virtualMachine.grayCount];
         garbage_collector_blacken_object(object);
     }
-}
\ No newline at end of file
+    return !virtualMachine.grayCount;
+}
+
+/// @brief Unmarks the objects of the old generation
+/// @param budget The maximum amount of objects that are unmarked
+/// @return true if the whole old generation has been unmarked, false if not
+/// @details The unmarking continues where the previous step has stopped
+static bool garbage_collector_unmark_old_generation(uint32_t budget) {
+    object_t ** link = virtualMachine.sweepCursor;
+    for (object_t * object = *link; object && budget; object = *link, budget--) {
+        object->isMarked = false;
+        link = &object->next;
+    }
+    virtualMachine.sweepCursor = link;
+    return !*link;
+}
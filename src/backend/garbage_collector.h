@@ -21,7 +21,75 @@
 #ifndef CELLOX_GARBAGE_COLLECTOR_H_
 #define CELLOX_GARBAGE_COLLECTOR_H_
 
+#include <stdio.h>
+
 #include "../language-models/object.h"
+#include "concurrent_marker.h"
+
+#ifndef GC_NURSERY_SIZE
+/// @brief Amount of bytes that can be allocated after a garbage collection, before a minor garbage collection is
+/// triggered
+#define GC_NURSERY_SIZE (1u << 20)
+#endif
+
+#ifndef GC_MARK_BUDGET
+/// @brief Maximum amount of objects that are unmarked, marked or swept during a single step of a major garbage
+/// collection
+/// @details Can be configured using CLX_GC_MARK_BUDGET - a budget of zero disables the incremental garbage collection,
+/// every major garbage collection stops the world until it has ended
+#define GC_MARK_BUDGET (4096u)
+#endif
+
+#ifndef GC_MARK_THREADS
+/// @brief Amount of threads that mark the objects of a major garbage collection in parallel
+/// @details Can be configured using CLX_GC_MARK_THREADS - zero uses a thread per processor, one disables the parallel
+/// marking
+#define GC_MARK_THREADS (0u)
+#endif
+
+#ifndef GC_PARALLEL_MARKING_THRESHOLD
+/// @brief Amount of bytes that have to be allocated, before the objects are marked in parallel - starting the threads
+/// doesn't pay off for smaller heaps
+#define GC_PARALLEL_MARKING_THRESHOLD (1u << 23)
+#endif
+
+#ifdef CONCURRENT_MARKER_AVAILABLE
+/// @brief Determines whether the references that are stored in unmarked objects are recorded by the write barrier
+/// @details The background thread can mark an object and read its references, right before the program stores a
+/// reference in it - the program might still see the stale mark bit
+#define GC_RECORD_ALL_REFERENCES (concurrentMarkerActive)
+/// @brief Reads the mark bit of an object, that can be set by the background thread at the same time
+#define GC_IS_MARKED(object) (__atomic_load_n(&(object)->isMarked, __ATOMIC_RELAXED))
+/// @brief Sets the mark bit of an object, that can be read by the write barrier at the same time
+#define GC_SET_MARKED(object) (__atomic_store_n(&(object)->isMarked, true, __ATOMIC_RELAXED))
+/// @brief Reads a slot of an object on the background thread, that is stored without holding the heap lock
+/// @details Acquires the contents of the object that is referenced, which were initialized before the slot was stored
+#define GC_LOAD_SLOT(slot) (__atomic_load_n(&(slot), __ATOMIC_ACQUIRE))
+/// @brief Stores a slot of an object without holding the heap lock, while the background thread can read it
+/// @details Releases the contents of the object that is referenced, so the background thread sees them initialized
+#define GC_STORE_SLOT(slot, value) (__atomic_store_n(&(slot), (value), __ATOMIC_RELEASE))
+#else
+#define GC_RECORD_ALL_REFERENCES (false)
+#define GC_IS_MARKED(object) ((object)->isMarked)
+#define GC_SET_MARKED(object) ((object)->isMarked = true)
+#define GC_LOAD_SLOT(slot) (slot)
+#define GC_STORE_SLOT(slot, value) ((slot) = (value))
+#endif
+
+/// @brief Amount of bytes that can be allocated between two steps of an incremental major garbage collection
+#define GC_STEP_SIZE (GC_NURSERY_SIZE / 8u)
+
+/// @brief Phase of the garbage collector
+typedef enum {
+    /// No major garbage collection is in progress - the young generation is collected by minor garbage collections
+    GARBAGE_COLLECTOR_PHASE_IDLE,
+    /// The old generation is unmarked incrementally, so the objects that are no longer reachable can be reclaimed
+    GARBAGE_COLLECTOR_PHASE_UNMARKING,
+    /// The heap is marked incrementally - the objects that are stored in marked objects are marked by the write barrier
+    GARBAGE_COLLECTOR_PHASE_MARKING,
+    /// The old generation is swept incrementally
+    GARBAGE_COLLECTOR_PHASE_SWEEPING,
+} garbage_collector_phase;
 
 /** @brief Starts the garbage collection process.
  * @details The garbage collector of cellox is a precise GC.
@@ -33,10 +101,41 @@
  * 2. Sweep phase <br>
  * In the marking phase we start at the roots and traverse through all the objects the roots refer to.
  * In the sweeping phase all the reachable objects have been marked, and therefore we can reclaim the memory that is
- * used by the unmarked objects.
+ * used by the unmarked objects. <br>
+ * The garbage collector is generational. Most of the objects die young, so a minor collection only marks and sweeps
+ * the objects that have been allocated since the last collection (young generation). The objects that survive a
+ * collection are promoted to the old generation in place - they stay marked, so the marking stops at them. Old objects
+ * that refer to young objects are recorded in the remembered set by the write barrier and traced like roots. A major
+ * collection marks and sweeps the whole heap, once the heap has grown beyond the treshhold of the last major
+ * collection. <br>
+ * A major collection is incremental. Every step unmarks, marks or sweeps at most GC_MARK_BUDGET objects, and the
+ * program continues in between. The write barrier marks the objects that are stored in marked objects (Dijkstra), so no
+ * reachable object stays unmarked. The roots aren't guarded by the write barrier, therefore they are marked again
+ * before the marking ends. <br>
+ * The marking of a major collection that isn't limited by a budget (the final step or a collection without a budget)
+ * is distributed across multiple threads on large heaps, while the program is stopped. <br>
+ * If the concurrent marking is enabled (CLX_GC_CONCURRENT_MARKING) and the budget isn't zero, the marking runs on a
+ * background thread instead. The write barrier logs the stored references, the steps only pass the log on to the
+ * background thread. Once no gray objects are left (or the heap has doubled), the marking ends with a pause that marks
+ * the roots and the logged references again.
  */
 void garbage_collector_collect_garbage();
 
+/// @brief Begins a change of the layout of an object, that can be read while the objects are marked concurrently
+/// @details E.g. the growth of the array where the values of an object are stored - ordinary stores don't need this
+static inline void garbage_collector_begin_heap_change() {
+#ifdef CONCURRENT_MARKER_AVAILABLE
+    concurrent_marker_begin_heap_change();
+#endif
+}
+
+/// @brief Ends a change of the layout of an object
+static inline void garbage_collector_end_heap_change() {
+#ifdef CONCURRENT_MARKER_AVAILABLE
+    concurrent_marker_end_heap_change();
+#endif
+}
+
 /// @brief Marks a cellox object
 /// @param object The object that is marked
 void garbage_collector_mark_object(object_t * object);
@@ -45,4 +144,45 @@ void garbage_collector_mark_object(object_t * object);
 /// @param value The value that is marked
 void garbage_collector_mark_value(value_t value);
 
+#ifdef PROFILE_GARBAGE_COLLECTOR
+/// @brief Deallocates the memory used by the pause time profile and resets it
+void garbage_collector_free_profile();
+
+/// @brief Prints the amount, the percentiles and the maximum of the pause times of the garbage collector
+/// @param file The file where the profile is printed
+void garbage_collector_print_profile(FILE * file);
+#endif
+
+/// @brief Records that a marked object refers to an unmarked object
+/// @param object The marked object
+/// @param reference The object that is referenced
+/// @details Between major collections the marked object belongs to the old generation and is remembered, during the
+/// incremental marking the referenced object is marked and during the concurrent marking the reference is logged
+void garbage_collector_record_reference(object_t * object, object_t * reference);
+
+/// @brief Adds an object of the old generation to the remembered set
+/// @param object The object that is remembered
+/// @details Objects of the young generation and objects that are already remembered are ignored. During the incremental
+/// marking the references of a marked object are marked instead
+void garbage_collector_remember(object_t * object);
+
+/// @brief Write barrier that has to be executed after a value has been stored in an object
+/// @param object The object where the value was stored
+/// @param value The value that was stored
+/// @details Records the reference, if a marked object refers to an unmarked object
+static inline void garbage_collector_write_barrier(object_t * object, value_t value) {
+    if ((GC_IS_MARKED(object) || GC_RECORD_ALL_REFERENCES) && IS_OBJECT(value) && !GC_IS_MARKED(AS_OBJECT(value))) {
+        garbage_collector_record_reference(object, AS_OBJECT(value));
+    }
+}
+
+/// @brief Write barrier that has to be executed after a reference to an object has been stored in an object
+/// @param object The object where the reference was stored
+/// @param reference The object that is referenced - may be NULL
+static inline void garbage_collector_write_barrier_object(object_t * object, object_t * reference) {
+    if ((GC_IS_MARKED(object) || GC_RECORD_ALL_REFERENCES) && reference && !GC_IS_MARKED(reference)) {
+        garbage_collector_record_reference(object, reference);
+    }
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,915 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file jit_compiler.c
+ * @brief File containing the implementation of the baseline just in time compiler.
+ * @details Register usage of the machine code:
+ * rbx - the call frame that is executed (reloaded after calls, because the callstack can grow)
+ * r14 - the address of the top of the stack of the virtual machine
+ * r15 - the amount of call frames when the machine code was entered
+ * Every other register is only used as a scratch register inside of a single template.
+ * If a call pushes a call frame, the machine code calls back into the virtual machine, that executes the callee until
+ * it has returned. The machine code is left when the call frame returns or an error occurs.
+ */
+
+#include "jit_compiler.h"
+
+#ifdef JIT_COMPILER_AVAILABLE
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#endif
+
+#include "memory_mutator.h"
+#include "virtual_machine.h"
+
+#ifdef JIT_COMPILER_AVAILABLE
+
+/// Marks the bytecode that is not the opcode of an instruction
+#define JIT_COMPILER_NO_ENTRY        (UINT32_MAX)
+
+/// The maximum amount of guards of a template, that jump to the slow path of the template
+#define JIT_COMPILER_MAX_GUARD_COUNT (2u)
+
+/// The minimum size of a region of executable memory (1 MB)
+#define JIT_COMPILER_REGION_SIZE     (1u << 20u)
+
+/// The alignment of the machine code of a chunk in a region of executable memory
+#define JIT_COMPILER_CODE_ALIGNMENT  (16u)
+
+/// @brief The general purpose registers of x86-64 (numbered like in the encoding of the instructions)
+typedef enum {
+    REGISTER_RAX,
+    REGISTER_RCX,
+    REGISTER_RDX,
+    REGISTER_RBX,
+    REGISTER_RSP,
+    REGISTER_RBP,
+    REGISTER_RSI,
+    REGISTER_RDI,
+    REGISTER_R8,
+    REGISTER_R9,
+    REGISTER_R10,
+    REGISTER_R11,
+    REGISTER_R12,
+    REGISTER_R13,
+    REGISTER_R14,
+    REGISTER_R15
+} jit_register;
+
+/// @brief The condition codes of the conditional jumps and the set instructions
+typedef enum {
+    CONDITION_BELOW_OR_EQUAL = 0x6,
+    CONDITION_ABOVE = 0x7,
+    CONDITION_EQUAL = 0x4,
+    CONDITION_NOT_EQUAL = 0x5,
+} jit_condition;
+
+/// @brief A jump to a bytecode instruction, whose distance is patched after all the instructions were translated
+typedef struct {
+    /// The position of the 32-bit displacement of the jump in the machine code
+    uint32_t position;
+    /// The index of the bytecode instruction that is the target of the jump
+    uint32_t target;
+} jit_compiler_patch_t;
+
+/// @brief Buffer where the machine code is assembled, before it is copied into executable memory
+typedef struct {
+    /// The machine code
+    uint8_t * bytes;
+    /// The amount of bytes of machine code
+    uint32_t count;
+    /// The capacity of the buffer
+    uint32_t capacity;
+    /// The jumps to bytecode instructions
+    jit_compiler_patch_t * patches;
+    /// The amount of jumps to bytecode instructions
+    uint32_t patchCount;
+    /// The capacity of the dynamic array with the jumps
+    uint32_t patchCapacity;
+    /// The chunk that is translated
+    chunk_t * chunk;
+    /// The functions that execute the instructions in the virtual machine
+    void * const * handlers;
+    /// The function that executes a callee until it has returned
+    void * executeCallee;
+    /// Offset of the stub that returns JIT_COMPILER_CONTINUE
+    uint32_t exitContinue;
+    /// Offset of the stub that leaves the machine code with the result in eax
+    uint32_t exit;
+    /// Offset of the stub that continues at the instruction the instruction pointer of the call frame points to
+    uint32_t resume;
+} jit_compiler_buffer_t;
+
+/// @brief A region of executable memory, where the machine code of the chunks is stored one after another
+/// @details The machine code of the chunks is not stored in separate pages, otherwise the hot paths of all the chunks
+/// would be mapped to the same sets of the instruction cache
+typedef struct jit_compiler_region_t {
+    /// The region that was allocated before
+    struct jit_compiler_region_t * previous;
+    /// The executable memory
+    uint8_t * memory;
+    /// The size of the executable memory in bytes
+    size_t size;
+    /// The amount of bytes that are already used
+    size_t used;
+} jit_compiler_region_t;
+
+/// The region of executable memory where the machine code is stored next
+static jit_compiler_region_t * currentRegion = NULL;
+
+static uint8_t * jit_compiler_allocate_executable_memory(uint8_t const *, size_t);
+static void jit_compiler_emit_byte(jit_compiler_buffer_t *, uint8_t);
+static void jit_compiler_emit_bytes(jit_compiler_buffer_t *, uint32_t, ...);
+static void jit_compiler_emit_compare_numbers(jit_compiler_buffer_t *, bool);
+static void jit_compiler_emit_handler_call(jit_compiler_buffer_t *, uint32_t, uint8_t, uint32_t);
+static void jit_compiler_emit_jump(jit_compiler_buffer_t *, uint32_t);
+static void jit_compiler_emit_jump_if(jit_compiler_buffer_t *, jit_condition, uint32_t);
+static uint32_t jit_compiler_emit_jump_forward(jit_compiler_buffer_t *, bool, jit_condition);
+static void jit_compiler_emit_jump_to_stub(jit_compiler_buffer_t *, bool, jit_condition, uint32_t);
+static void jit_compiler_emit_load(jit_compiler_buffer_t *, jit_register, jit_register, int32_t);
+static void jit_compiler_emit_load_immediate(jit_compiler_buffer_t *, jit_register, uint64_t);
+static void jit_compiler_emit_load_register_operand(jit_compiler_buffer_t *, jit_register, uint8_t);
+static void jit_compiler_emit_memory_operand(jit_compiler_buffer_t *, uint8_t, uint8_t, jit_register, int32_t);
+static void jit_compiler_emit_number_guard(jit_compiler_buffer_t *, jit_register, uint32_t *, uint32_t *);
+static void jit_compiler_emit_number_operation(jit_compiler_buffer_t *, uint8_t);
+static void jit_compiler_emit_push(jit_compiler_buffer_t *, jit_register);
+static void jit_compiler_emit_register_operation(jit_compiler_buffer_t *, uint8_t, jit_register, jit_register);
+static void jit_compiler_emit_slow_path(jit_compiler_buffer_t *, uint32_t *, uint32_t, uint32_t, uint8_t, uint32_t);
+static void jit_compiler_emit_stack_pointer_adjustment(jit_compiler_buffer_t *, bool, uint8_t);
+static void jit_compiler_emit_store(jit_compiler_buffer_t *, jit_register, jit_register, int32_t);
+static void jit_compiler_emit_store_register_destination(jit_compiler_buffer_t *, uint8_t, jit_register);
+static void jit_compiler_emit_u32(jit_compiler_buffer_t *, uint32_t);
+static void jit_compiler_emit_u64(jit_compiler_buffer_t *, uint64_t);
+static void jit_compiler_patch_jump_forward(jit_compiler_buffer_t *, uint32_t);
+static uint16_t jit_compiler_read_short(chunk_t *, uint32_t);
+static void jit_compiler_translate_instruction(jit_compiler_buffer_t *, uint32_t);
+#endif
+
+bool jit_compiler_compile(jit_code_t * jitCode, chunk_t * chunk, void * const * handlers, void * executeCallee) {
+#ifdef JIT_COMPILER_AVAILABLE
+    jit_compiler_buffer_t buffer = {.bytes = NULL,
+                                    .count = 0u,
+                                    .capacity = 0u,
+                                    .patches = NULL,
+                                    .patchCount = 0u,
+                                    .patchCapacity = 0u,
+                                    .chunk = chunk,
+                                    .handlers = handlers,
+                                    .executeCallee = executeCallee};
+    // The entries are allocated first, because their address is embedded into the machine code
+    void ** entries = ALLOCATE(void *, chunk->byteCodeCount);
+    uint32_t * offsets = ALLOCATE(uint32_t, chunk->byteCodeCount);
+    for (uint32_t i = 0u; i < chunk->byteCodeCount; i++) {
+        offsets[i] = JIT_COMPILER_NO_ENTRY;
+    }
+
+    // Prologue - push rbx, r14 and r15 (keeps the native stack aligned to 16 bytes for the calls of the handlers)
+    jit_compiler_emit_bytes(&buffer, 5u, 0x53, 0x41, 0x56, 0x41, 0x57);
+    // mov rbx, rdi
+    jit_compiler_emit_register_operation(&buffer, 0x89, REGISTER_RDI, REGISTER_RBX);
+    jit_compiler_emit_load_immediate(&buffer, REGISTER_R14, (uint64_t)(uintptr_t)&virtualMachine.stackTop);
+    jit_compiler_emit_load_immediate(&buffer, REGISTER_RAX, (uint64_t)(uintptr_t)&virtualMachine.frameCount);
+    // mov r15d, [rax] and jmp rsi
+    jit_compiler_emit_bytes(&buffer, 5u, 0x44, 0x8B, 0x38, 0xFF, 0xE6);
+
+    // mov eax, JIT_COMPILER_CONTINUE
+    buffer.exitContinue = buffer.count;
+    jit_compiler_emit_byte(&buffer, 0xB8);
+    jit_compiler_emit_u32(&buffer, JIT_COMPILER_CONTINUE);
+    // pop r15, pop r14, pop rbx and ret
+    buffer.exit = buffer.count;
+    jit_compiler_emit_bytes(&buffer, 6u, 0x41, 0x5F, 0x41, 0x5E, 0x5B, 0xC3);
+
+    // Looks up the machine code of the instruction the instruction pointer of the call frame points to
+    buffer.resume = buffer.count;
+    jit_compiler_emit_load(&buffer, REGISTER_RAX, REGISTER_RBX, (int32_t)offsetof(call_frame_t, ip));
+    jit_compiler_emit_load_immediate(&buffer, REGISTER_RCX, (uint64_t)(uintptr_t)chunk->code);
+    jit_compiler_emit_register_operation(&buffer, 0x29, REGISTER_RCX, REGISTER_RAX);
+    jit_compiler_emit_load_immediate(&buffer, REGISTER_RCX, (uint64_t)(uintptr_t)entries);
+    // mov rax, [rcx + rax * 8] and test rax, rax
+    jit_compiler_emit_bytes(&buffer, 7u, 0x48, 0x8B, 0x04, 0xC1, 0x48, 0x85, 0xC0);
+    jit_compiler_emit_jump_to_stub(&buffer, true, CONDITION_EQUAL, buffer.exitContinue);
+    // jmp rax
+    jit_compiler_emit_bytes(&buffer, 2u, 0xFF, 0xE0);
+
+    for (uint32_t i = 0u; i < chunk->byteCodeCount; i += chunk_instruction_length(chunk, i)) {
+        offsets[i] = buffer.count;
+        jit_compiler_translate_instruction(&buffer, i);
+    }
+
+    bool compiled = true;
+    for (uint32_t i = 0u; i < buffer.patchCount; i++) {
+        jit_compiler_patch_t * patch = &buffer.patches[i];
+        if (patch->target >= chunk->byteCodeCount || offsets[patch->target] == JIT_COMPILER_NO_ENTRY) {
+            compiled = false;
+            break;
+        }
+        int32_t distance = (int32_t)offsets[patch->target] - (int32_t)(patch->position + 4u);
+        memcpy(buffer.bytes + patch->position, &distance, sizeof(int32_t));
+    }
+
+    uint8_t * code = compiled ? jit_compiler_allocate_executable_memory(buffer.bytes, buffer.count) : NULL;
+    if (code) {
+        for (uint32_t i = 0u; i < chunk->byteCodeCount; i++) {
+            entries[i] = offsets[i] == JIT_COMPILER_NO_ENTRY ? NULL : code + offsets[i];
+        }
+        jitCode->code = code;
+        jitCode->entries = entries;
+        jitCode->entryCount = chunk->byteCodeCount;
+    } else {
+        FREE_ARRAY(void *, entries, chunk->byteCodeCount);
+    }
+    FREE_ARRAY(uint32_t, offsets, chunk->byteCodeCount);
+    FREE_ARRAY(uint8_t, buffer.bytes, buffer.capacity);
+    FREE_ARRAY(jit_compiler_patch_t, buffer.patches, buffer.patchCapacity);
+    return code != NULL;
+#else
+    (void)jitCode;
+    (void)chunk;
+    (void)handlers;
+    (void)executeCallee;
+    return false;
+#endif
+}
+
+uint32_t jit_compiler_execute(jit_code_t const * jitCode, void * frame, void const * entry) {
+#ifdef JIT_COMPILER_AVAILABLE
+    // The machine code starts with the prologue that jumps to the entry after the registers were set up
+    uint32_t (*machineCode)(void *, void const *) = (uint32_t(*)(void *, void const *))jitCode->code;
+    return machineCode(frame, entry);
+#else
+    (void)jitCode;
+    (void)frame;
+    (void)entry;
+    return JIT_COMPILER_CONTINUE;
+#endif
+}
+
+void jit_compiler_free(jit_code_t * jitCode) {
+    FREE_ARRAY(void *, jitCode->entries, jitCode->entryCount);
+    jit_compiler_init(jitCode);
+}
+
+void jit_compiler_free_executable_memory() {
+#ifdef JIT_COMPILER_AVAILABLE
+    while (currentRegion) {
+        jit_compiler_region_t * previous = currentRegion->previous;
+        munmap(currentRegion->memory, currentRegion->size);
+        free(currentRegion);
+        currentRegion = previous;
+    }
+#endif
+}
+
+void jit_compiler_init(jit_code_t * jitCode) {
+    jitCode->code = NULL;
+    jitCode->entries = NULL;
+    jitCode->entryCount = 0u;
+}
+
+#ifdef JIT_COMPILER_AVAILABLE
+/// @brief Copies machine code into the executable memory
+/// @param code The machine code that is copied
+/// @param size The size of the machine code in bytes
+/// @return The address of the machine code in the executable memory or NULL if no memory could be allocated
+static uint8_t * jit_compiler_allocate_executable_memory(uint8_t const * code, size_t size) {
+    size_t offset = currentRegion ? (currentRegion->used + JIT_COMPILER_CODE_ALIGNMENT - 1u) &
+                                        ~(size_t)(JIT_COMPILER_CODE_ALIGNMENT - 1u)
+                                  : 0u;
+    if (!currentRegion || offset + size > currentRegion->size) {
+        jit_compiler_region_t * region = malloc(sizeof(jit_compiler_region_t));
+        if (!region) {
+            return NULL;
+        }
+        region->size = size > JIT_COMPILER_REGION_SIZE ? size : JIT_COMPILER_REGION_SIZE;
+        region->memory = mmap(NULL, region->size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region->memory == MAP_FAILED) {
+            free(region);
+            return NULL;
+        }
+        region->used = 0u;
+        region->previous = currentRegion;
+        currentRegion = region;
+        offset = 0u;
+    }
+    // The memory is never writable and executable at the same time
+    if (mprotect(currentRegion->memory, currentRegion->size, PROT_READ | PROT_WRITE)) {
+        return NULL;
+    }
+    memcpy(currentRegion->memory + offset, code, size);
+    if (mprotect(currentRegion->memory, currentRegion->size, PROT_READ | PROT_EXEC)) {
+        return NULL;
+    }
+    currentRegion->used = offset + size;
+    return currentRegion->memory + offset;
+}
+
+/// @brief Appends a single byte of machine code to the buffer
+/// @param buffer The buffer where the machine code is stored
+/// @param byte The byte that is appended
+static void jit_compiler_emit_byte(jit_compiler_buffer_t * buffer, uint8_t byte) {
+    if (buffer->count == buffer->capacity) {
+        uint32_t oldCapacity = buffer->capacity;
+        buffer->capacity = GROW_CAPACITY(oldCapacity);
+        buffer->bytes = GROW_ARRAY(uint8_t, buffer->bytes, oldCapacity, buffer->capacity);
+    }
+    buffer->bytes[buffer->count++] = byte;
+}
+
+/// @brief Appends multiple bytes of machine code to the buffer
+/// @param buffer The buffer where the machine code is stored
+/// @param count The amount of bytes that are appended
+/// @param ... The bytes that are appended
+static void jit_compiler_emit_bytes(jit_compiler_buffer_t * buffer, uint32_t count, ...) {
+    va_list bytes;
+    va_start(bytes, count);
+    for (uint32_t i = 0u; i < count; i++) {
+        jit_compiler_emit_byte(buffer, (uint8_t)va_arg(bytes, int));
+    }
+    va_end(bytes);
+}
+
+/// @brief Compares the numbers in rax and rcx and stores the resulting boolean value in rax
+/// @param buffer The buffer where the machine code is stored
+/// @param less Determines whether rax < rcx or rax > rcx is evaluated
+static void jit_compiler_emit_compare_numbers(jit_compiler_buffer_t * buffer, bool less) {
+    // movq xmm0, rax and movq xmm1, rcx
+    jit_compiler_emit_bytes(buffer, 10u, 0x66, 0x48, 0x0F, 0x6E, 0xC0, 0x66, 0x48, 0x0F, 0x6E, 0xC9);
+    // ucomisd xmm1, xmm0 (less) or ucomisd xmm0, xmm1 (greater) - unordered operands are never above
+    jit_compiler_emit_bytes(buffer, 4u, 0x66, 0x0F, 0x2E, less ? 0xC8 : 0xC1);
+    // seta al and movzx eax, al
+    jit_compiler_emit_bytes(buffer, 6u, 0x0F, 0x90 | CONDITION_ABOVE, 0xC0, 0x0F, 0xB6, 0xC0);
+    // The tag of true only differs from the tag of false in the lowest bit
+    jit_compiler_emit_load_immediate(buffer, REGISTER_RCX, FALSE_VAL);
+    jit_compiler_emit_register_operation(buffer, 0x09, REGISTER_RCX, REGISTER_RAX);
+}
+
+/// @brief Calls the handler that executes an instruction in the virtual machine
+/// @param buffer The buffer where the machine code is stored
+/// @param opCodeIndex The index of the instruction in the chunk
+/// @param opCode The opcode of the handler that is called
+/// @param nextOpCodeIndex The index of the instruction that is executed next, if the handler doesn't jump
+static void jit_compiler_emit_handler_call(jit_compiler_buffer_t * buffer, uint32_t opCodeIndex, uint8_t opCode,
+                                           uint32_t nextOpCodeIndex) {
+    // The handler reads the operands using the instruction pointer of the call frame
+    jit_compiler_emit_load_immediate(buffer, REGISTER_RAX,
+                                     (uint64_t)(uintptr_t)(buffer->chunk->code + opCodeIndex + 1u));
+    jit_compiler_emit_store(buffer, REGISTER_RBX, REGISTER_RAX, (int32_t)offsetof(call_frame_t, ip));
+    // mov rdi, rbx
+    jit_compiler_emit_register_operation(buffer, 0x89, REGISTER_RBX, REGISTER_RDI);
+    jit_compiler_emit_load_immediate(buffer, REGISTER_RAX, (uint64_t)(uintptr_t)buffer->handlers[opCode]);
+    if (opCode == OP_WIDE) {
+        // The handler of OP_WIDE executes the wide instruction - calls and tail calls are handled like narrow ones
+        opCode = buffer->chunk->code[opCodeIndex + 1u];
+    }
+    // call rax
+    jit_compiler_emit_bytes(buffer, 2u, 0xFF, 0xD0);
+    if (opCode == OP_RETURN) {
+        // The call frame was popped - the result is JIT_COMPILER_CONTINUE or the result of the program
+        jit_compiler_emit_jump_to_stub(buffer, false, CONDITION_EQUAL, buffer->exit);
+        return;
+    }
+    // cmp eax, JIT_COMPILER_CONTINUE
+    jit_compiler_emit_bytes(buffer, 3u, 0x83, 0xF8, 0xFF);
+    jit_compiler_emit_jump_to_stub(buffer, true, CONDITION_NOT_EQUAL, buffer->exit);
+    if (opCode == OP_TAIL_CALL || opCode == OP_TAIL_INVOKE) {
+        // The call frame may execute another function now, that is executed by the virtual machine
+        jit_compiler_emit_jump_to_stub(buffer, false, CONDITION_EQUAL, buffer->exitContinue);
+        return;
+    }
+    if (opCode == OP_CALL || opCode == OP_CALL_INTRINSIC || opCode == OP_INVOKE || opCode == OP_SUPER_INVOKE) {
+        // A new call frame was pushed, unless a native function was called or a class without an initializer
+        jit_compiler_emit_load_immediate(buffer, REGISTER_RCX, (uint64_t)(uintptr_t)&virtualMachine.frameCount);
+        // cmp [rcx], r15d
+        jit_compiler_emit_bytes(buffer, 3u, 0x44, 0x39, 0x39);
+        uint32_t noCallFrame = jit_compiler_emit_jump_forward(buffer, true, CONDITION_EQUAL);
+        // mov edi, [rcx]
+        jit_compiler_emit_bytes(buffer, 2u, 0x8B, 0x39);
+        jit_compiler_emit_load_immediate(buffer, REGISTER_RAX, (uint64_t)(uintptr_t)buffer->executeCallee);
+        // call rax and cmp eax, JIT_COMPILER_CONTINUE
+        jit_compiler_emit_bytes(buffer, 5u, 0xFF, 0xD0, 0x83, 0xF8, 0xFF);
+        jit_compiler_emit_jump_to_stub(buffer, true, CONDITION_NOT_EQUAL, buffer->exit);
+        jit_compiler_patch_jump_forward(buffer, noCallFrame);
+        // The callstack may have grown during the call, so the address of the call frame is reloaded
+        jit_compiler_emit_load_immediate(buffer, REGISTER_RAX, (uint64_t)(uintptr_t)&virtualMachine.callStack);
+        jit_compiler_emit_load(buffer, REGISTER_RBX, REGISTER_RAX, 0);
+        // imul rax, r15, sizeof(call_frame_t) and add rbx, rax
+        jit_compiler_emit_bytes(buffer, 3u, 0x49, 0x69, 0xC7);
+        jit_compiler_emit_u32(buffer, (uint32_t)sizeof(call_frame_t));
+        jit_compiler_emit_register_operation(buffer, 0x01, REGISTER_RAX, REGISTER_RBX);
+        // sub rbx, sizeof(call_frame_t)
+        jit_compiler_emit_bytes(buffer, 3u, 0x48, 0x81, 0xEB);
+        jit_compiler_emit_u32(buffer, (uint32_t)sizeof(call_frame_t));
+    }
+    // The handler may have jumped or skipped the opcodes of a superinstruction
+    jit_compiler_emit_load(buffer, REGISTER_RAX, REGISTER_RBX, (int32_t)offsetof(call_frame_t, ip));
+    jit_compiler_emit_load_immediate(buffer, REGISTER_RCX,
+                                     (uint64_t)(uintptr_t)(buffer->chunk->code + nextOpCodeIndex));
+    jit_compiler_emit_register_operation(buffer, 0x39, REGISTER_RCX, REGISTER_RAX);
+    jit_compiler_emit_jump_to_stub(buffer, true, CONDITION_NOT_EQUAL, buffer->resume);
+    if (nextOpCodeIndex != opCodeIndex + chunk_instruction_length(buffer->chunk, opCodeIndex)) {
+        jit_compiler_emit_jump(buffer, nextOpCodeIndex);
+    }
+}
+
+/// @brief Emits a jump to the machine code of a bytecode instruction
+/// @param buffer The buffer where the machine code is stored
+/// @param target The index of the bytecode instruction
+static void jit_compiler_emit_jump(jit_compiler_buffer_t * buffer, uint32_t target) {
+    jit_compiler_emit_byte(buffer, 0xE9);
+    if (buffer->patchCount == buffer->patchCapacity) {
+        uint32_t oldCapacity = buffer->patchCapacity;
+        buffer->patchCapacity = GROW_CAPACITY(oldCapacity);
+        buffer->patches = GROW_ARRAY(jit_compiler_patch_t, buffer->patches, oldCapacity, buffer->patchCapacity);
+    }
+    buffer->patches[buffer->patchCount++] = (jit_compiler_patch_t){.position = buffer->count, .target = target};
+    jit_compiler_emit_u32(buffer, 0u);
+}
+
+/// @brief Emits a conditional jump to the machine code of a bytecode instruction
+/// @param buffer The buffer where the machine code is stored
+/// @param condition The condition of the jump
+/// @param target The index of the bytecode instruction
+static void jit_compiler_emit_jump_if(jit_compiler_buffer_t * buffer, jit_condition condition, uint32_t target) {
+    jit_compiler_emit_byte(buffer, 0x0F);
+    // The opcode of the conditional jump replaces the opcode of the unconditional jump
+    jit_compiler_emit_jump(buffer, target);
+    buffer->bytes[buffer->count - 5u] = 0x80 | condition;
+}
+
+/// @brief Emits a jump to machine code of the current template, that is emitted later on
+/// @param buffer The buffer where the machine code is stored
+/// @param conditional Determines whether the jump is conditional
+/// @param condition The condition of a conditional jump
+/// @return The position of the distance of the jump, that is patched using jit_compiler_patch_jump_forward()
+static uint32_t jit_compiler_emit_jump_forward(jit_compiler_buffer_t * buffer, bool conditional,
+                                               jit_condition condition) {
+    if (conditional) {
+        jit_compiler_emit_bytes(buffer, 2u, 0x0F, 0x80 | condition);
+    } else {
+        jit_compiler_emit_byte(buffer, 0xE9);
+    }
+    jit_compiler_emit_u32(buffer, 0u);
+    return buffer->count - 4u;
+}
+
+/// @brief Emits a jump to one of the stubs at the start of the machine code
+/// @param buffer The buffer where the machine code is stored
+/// @param conditional Determines whether the jump is conditional
+/// @param condition The condition of a conditional jump
+/// @param stub The offset of the stub
+static void jit_compiler_emit_jump_to_stub(jit_compiler_buffer_t * buffer, bool conditional, jit_condition condition,
+                                           uint32_t stub) {
+    uint32_t position = jit_compiler_emit_jump_forward(buffer, conditional, condition);
+    int32_t distance = (int32_t)stub - (int32_t)buffer->count;
+    memcpy(buffer->bytes + position, &distance, sizeof(int32_t));
+}
+
+/// @brief Loads a 64-bit value from memory (mov destination, [base + displacement])
+/// @param buffer The buffer where the machine code is stored
+/// @param destination The register where the value is loaded into
+/// @param base The register that contains the base address
+/// @param displacement The displacement that is added to the base address
+static void jit_compiler_emit_load(jit_compiler_buffer_t * buffer, jit_register destination, jit_register base,
+                                   int32_t displacement) {
+    jit_compiler_emit_memory_operand(buffer, 0x8B, destination, base, displacement);
+}
+
+/// @brief Loads a 64-bit immediate value into a register (movabs destination, value)
+/// @param buffer The buffer where the machine code is stored
+/// @param destination The register where the value is loaded into
+/// @param value The value that is loaded
+static void jit_compiler_emit_load_immediate(jit_compiler_buffer_t * buffer, jit_register destination,
+                                             uint64_t value) {
+    jit_compiler_emit_bytes(buffer, 2u, 0x48 | (destination >> 3), 0xB8 | (destination & 7));
+    jit_compiler_emit_u64(buffer, value);
+}
+
+/// @brief Loads the value of an operand of a register instruction (rdx has to contain the slots of the call frame)
+/// @param buffer The buffer where the machine code is stored
+/// @param destination The register where the value is loaded into
+/// @param operand The operand of the register instruction
+static void jit_compiler_emit_load_register_operand(jit_compiler_buffer_t * buffer, jit_register destination,
+                                                    uint8_t operand) {
+    if (operand & REGISTER_OPERAND_CONSTANT) {
+        // The constants of a chunk never change, so they are embedded into the machine code
+        jit_compiler_emit_load_immediate(buffer, destination,
+                                         buffer->chunk->constants.values[operand & ~REGISTER_OPERAND_CONSTANT]);
+    } else {
+        jit_compiler_emit_load(buffer, destination, REGISTER_RDX, (int32_t)(operand * sizeof(value_t)));
+    }
+}
+
+/// @brief Emits an instruction with a memory operand ([base + displacement])
+/// @param buffer The buffer where the machine code is stored
+/// @param opCode The opcode of the instruction
+/// @param reg The register operand or the opcode extension of the instruction
+/// @param base The register that contains the base address
+/// @param displacement The displacement that is added to the base address
+static void jit_compiler_emit_memory_operand(jit_compiler_buffer_t * buffer, uint8_t opCode, uint8_t reg,
+                                             jit_register base, int32_t displacement) {
+    jit_compiler_emit_bytes(buffer, 2u, 0x48 | ((reg >> 3) << 2) | (base >> 3), opCode);
+    // rbp and r13 can't be used as a base without a displacement
+    uint8_t mod = (!displacement && (base & 7) != REGISTER_RBP) ? 0x00
+                  : (displacement >= INT8_MIN && displacement <= INT8_MAX) ? 0x40
+                                                                           : 0x80;
+    jit_compiler_emit_byte(buffer, mod | ((reg & 7) << 3) | (base & 7));
+    // rsp and r12 can only be used as a base with a scale index byte
+    if ((base & 7) == REGISTER_RSP) {
+        jit_compiler_emit_byte(buffer, 0x24);
+    }
+    if (mod == 0x40) {
+        jit_compiler_emit_byte(buffer, (uint8_t)(int8_t)displacement);
+    } else if (mod == 0x80) {
+        jit_compiler_emit_u32(buffer, (uint32_t)displacement);
+    }
+}
+
+/// @brief Emits a guard that jumps to the slow path of the template, if the register doesn't contain a number
+/// @param buffer The buffer where the machine code is stored
+/// @param value The register that contains the value
+/// @param guards The positions of the guards of the template
+/// @param guardCount The amount of guards of the template
+/// @note r8 has to contain the bits of a quiet not a number
+static void jit_compiler_emit_number_guard(jit_compiler_buffer_t * buffer, jit_register value, uint32_t * guards,
+                                           uint32_t * guardCount) {
+    jit_compiler_emit_register_operation(buffer, 0x89, value, REGISTER_R10);
+    jit_compiler_emit_register_operation(buffer, 0x21, REGISTER_R8, REGISTER_R10);
+    jit_compiler_emit_register_operation(buffer, 0x39, REGISTER_R8, REGISTER_R10);
+    guards[(*guardCount)++] = jit_compiler_emit_jump_forward(buffer, true, CONDITION_EQUAL);
+}
+
+/// @brief Executes an arithmetic operation with the numbers in rax and rcx and stores the result in rax
+/// @param buffer The buffer where the machine code is stored
+/// @param operation The opcode of the scalar double precision operation (e.g. 0x58 for addsd)
+static void jit_compiler_emit_number_operation(jit_compiler_buffer_t * buffer, uint8_t operation) {
+    // movq xmm0, rax and movq xmm1, rcx
+    jit_compiler_emit_bytes(buffer, 10u, 0x66, 0x48, 0x0F, 0x6E, 0xC0, 0x66, 0x48, 0x0F, 0x6E, 0xC9);
+    // op xmm0, xmm1 and movq rax, xmm0
+    jit_compiler_emit_bytes(buffer, 9u, 0xF2, 0x0F, operation, 0xC1, 0x66, 0x48, 0x0F, 0x7E, 0xC0);
+}
+
+/// @brief Pushes the value of a register on the stack of the virtual machine
+/// @param buffer The buffer where the machine code is stored
+/// @param value The register that contains the value (rax, rcx or rdx)
+static void jit_compiler_emit_push(jit_compiler_buffer_t * buffer, jit_register value) {
+    jit_compiler_emit_load(buffer, REGISTER_R9, REGISTER_R14, 0);
+    jit_compiler_emit_store(buffer, REGISTER_R9, value, 0);
+    jit_compiler_emit_stack_pointer_adjustment(buffer, true, 1u);
+}
+
+/// @brief Emits an instruction with two register operands
+/// @param buffer The buffer where the machine code is stored
+/// @param opCode The opcode of the instruction (e.g. 0x89 for mov)
+/// @param source The register in the reg field of the instruction
+/// @param destination The register in the r/m field of the instruction
+static void jit_compiler_emit_register_operation(jit_compiler_buffer_t * buffer, uint8_t opCode, jit_register source,
+                                                 jit_register destination) {
+    jit_compiler_emit_bytes(buffer, 3u, 0x48 | ((source >> 3) << 2) | (destination >> 3), opCode,
+                            0xC0 | ((source & 7) << 3) | (destination & 7));
+}
+
+/// @brief Emits the slow path of a template, that executes the instruction using the handler of the virtual machine
+/// @param buffer The buffer where the machine code is stored
+/// @param guards The positions of the guards that jump to the slow path
+/// @param guardCount The amount of guards
+/// @param opCodeIndex The index of the instruction in the chunk
+/// @param opCode The opcode of the handler that is called
+/// @param nextOpCodeIndex The index of the instruction that is executed next, if the handler doesn't jump
+static void jit_compiler_emit_slow_path(jit_compiler_buffer_t * buffer, uint32_t * guards, uint32_t guardCount,
+                                        uint32_t opCodeIndex, uint8_t opCode, uint32_t nextOpCodeIndex) {
+    uint32_t fastPathEnd = jit_compiler_emit_jump_forward(buffer, false, CONDITION_EQUAL);
+    for (uint32_t i = 0u; i < guardCount; i++) {
+        jit_compiler_patch_jump_forward(buffer, guards[i]);
+    }
+    jit_compiler_emit_handler_call(buffer, opCodeIndex, opCode, nextOpCodeIndex);
+    jit_compiler_patch_jump_forward(buffer, fastPathEnd);
+}
+
+/// @brief Increments or decrements the top of the stack of the virtual machine
+/// @param buffer The buffer where the machine code is stored
+/// @param increment Determines whether the top of the stack is incremented or decremented
+/// @param count The amount of values the top of the stack is moved
+static void jit_compiler_emit_stack_pointer_adjustment(jit_compiler_buffer_t * buffer, bool increment, uint8_t count) {
+    // add / sub qword [r14], count * 8
+    jit_compiler_emit_memory_operand(buffer, 0x83, increment ? 0u : 5u, REGISTER_R14, 0);
+    jit_compiler_emit_byte(buffer, (uint8_t)(count * sizeof(value_t)));
+}
+
+/// @brief Stores a 64-bit value in memory (mov [base + displacement], source)
+/// @param buffer The buffer where the machine code is stored
+/// @param base The register that contains the base address
+/// @param source The register that contains the value
+/// @param displacement The displacement that is added to the base address
+static void jit_compiler_emit_store(jit_compiler_buffer_t * buffer, jit_register base, jit_register source,
+                                    int32_t displacement) {
+    jit_compiler_emit_memory_operand(buffer, 0x89, source, base, displacement);
+}
+
+/// @brief Stores the result of a register instruction (rdx has to contain the slots of the call frame)
+/// @param buffer The buffer where the machine code is stored
+/// @param destination The destination operand of the register instruction
+/// @param value The register that contains the result
+static void jit_compiler_emit_store_register_destination(jit_compiler_buffer_t * buffer, uint8_t destination,
+                                                         jit_register value) {
+    if (destination == REGISTER_DESTINATION_STACK) {
+        jit_compiler_emit_push(buffer, value);
+    } else {
+        jit_compiler_emit_store(buffer, REGISTER_RDX, value, (int32_t)(destination * sizeof(value_t)));
+    }
+}
+
+/// @brief Appends a 32-bit value to the machine code (little endian)
+/// @param buffer The buffer where the machine code is stored
+/// @param value The value that is appended
+static void jit_compiler_emit_u32(jit_compiler_buffer_t * buffer, uint32_t value) {
+    for (uint32_t i = 0u; i < 4u; i++) {
+        jit_compiler_emit_byte(buffer, (uint8_t)(value >> (8u * i)));
+    }
+}
+
+/// @brief Appends a 64-bit value to the machine code (little endian)
+/// @param buffer The buffer where the machine code is stored
+/// @param value The value that is appended
+static void jit_compiler_emit_u64(jit_compiler_buffer_t * buffer, uint64_t value) {
+    jit_compiler_emit_u32(buffer, (uint32_t)value);
+    jit_compiler_emit_u32(buffer, (uint32_t)(value >> 32u));
+}
+
+/// @brief Lets a jump that was emitted using jit_compiler_emit_jump_forward() jump to the end of the machine code
+/// @param buffer The buffer where the machine code is stored
+/// @param position The position of the distance of the jump
+static void jit_compiler_patch_jump_forward(jit_compiler_buffer_t * buffer, uint32_t position) {
+    int32_t distance = (int32_t)(buffer->count - (position + 4u));
+    memcpy(buffer->bytes + position, &distance, sizeof(int32_t));
+}
+
+/// @brief Reads a short operand of an instruction
+/// @param chunk The chunk of the instruction
+/// @param index The index of the first byte of the operand
+/// @return The value of the operand
+static uint16_t jit_compiler_read_short(chunk_t * chunk, uint32_t index) {
+    return (uint16_t)((chunk->code[index] << 8) | chunk->code[index + 1u]);
+}
+
+/// @brief Translates a single bytecode instruction into machine code
+/// @param buffer The buffer where the machine code is stored
+/// @param opCodeIndex The index of the instruction in the chunk
+static void jit_compiler_translate_instruction(jit_compiler_buffer_t * buffer, uint32_t opCodeIndex) {
+    uint8_t const * instruction = buffer->chunk->code + opCodeIndex;
+    uint32_t nextOpCodeIndex = opCodeIndex + chunk_instruction_length(buffer->chunk, opCodeIndex);
+    uint32_t guards[JIT_COMPILER_MAX_GUARD_COUNT];
+    uint32_t guardCount = 0u;
+    uint8_t opCode = *instruction;
+    if (opCode == OP_WIDE &&
+        (instruction[1] == OP_JUMP || instruction[1] == OP_JUMP_IF_FALSE || instruction[1] == OP_LOOP)) {
+        // The wide jumps share the templates of the narrow jumps
+        opCode = instruction[1];
+    }
+    switch (opCode) {
+    case OP_CONSTANT:
+        jit_compiler_emit_load_immediate(buffer, REGISTER_RAX, buffer->chunk->constants.values[instruction[1]]);
+        jit_compiler_emit_push(buffer, REGISTER_RAX);
+        break;
+    case OP_FALSE:
+        jit_compiler_emit_load_immediate(buffer, REGISTER_RAX, FALSE_VAL);
+        jit_compiler_emit_push(buffer, REGISTER_RAX);
+        break;
+    case OP_NULL:
+        jit_compiler_emit_load_immediate(buffer, REGISTER_RAX, NULL_VAL);
+        jit_compiler_emit_push(buffer, REGISTER_RAX);
+        break;
+    case OP_TRUE:
+        jit_compiler_emit_load_immediate(buffer, REGISTER_RAX, TRUE_VAL);
+        jit_compiler_emit_push(buffer, REGISTER_RAX);
+        break;
+    case OP_POP:
+        jit_compiler_emit_stack_pointer_adjustment(buffer, false, 1u);
+        break;
+    case OP_GET_LOCAL:
+        jit_compiler_emit_load(buffer, REGISTER_RDX, REGISTER_RBX, (int32_t)offsetof(call_frame_t, slots));
+        jit_compiler_emit_load(buffer, REGISTER_RAX, REGISTER_RDX, (int32_t)(instruction[1] * sizeof(value_t)));
+        jit_compiler_emit_push(buffer, REGISTER_RAX);
+        break;
+    case OP_SET_LOCAL:
+        jit_compiler_emit_load(buffer, REGISTER_R9, REGISTER_R14, 0);
+        jit_compiler_emit_load(buffer, REGISTER_RAX, REGISTER_R9, -(int32_t)sizeof(value_t));
+        jit_compiler_emit_load(buffer, REGISTER_RDX, REGISTER_RBX, (int32_t)offsetof(call_frame_t, slots));
+        jit_compiler_emit_store(buffer, REGISTER_RDX, REGISTER_RAX, (int32_t)(instruction[1] * sizeof(value_t)));
+        break;
+    case OP_GET_GLOBAL:
+        // The values of the globals are reloaded every time, because the array grows if new globals are declared
+        jit_compiler_emit_load_immediate(buffer, REGISTER_RDX,
+                                         (uint64_t)(uintptr_t)&virtualMachine.globalValues.values);
+        jit_compiler_emit_load(buffer, REGISTER_RDX, REGISTER_RDX, 0);
+        jit_compiler_emit_load(buffer, REGISTER_RAX, REGISTER_RDX,
+                               (int32_t)(jit_compiler_read_short(buffer->chunk, opCodeIndex + 2u) * sizeof(value_t)));
+        jit_compiler_emit_load_immediate(buffer, REGISTER_RCX, UNDEFINED_VAL);
+        jit_compiler_emit_register_operation(buffer, 0x39, REGISTER_RCX, REGISTER_RAX);
+        guards[guardCount++] = jit_compiler_emit_jump_forward(buffer, true, CONDITION_EQUAL);
+        jit_compiler_emit_push(buffer, REGISTER_RAX);
+        // Undefined globals are reported by the handler
+        jit_compiler_emit_slow_path(buffer, guards, guardCount, opCodeIndex, *instruction, nextOpCodeIndex);
+        break;
+    case OP_SET_GLOBAL:
+    case OP_SET_GLOBAL_POP:
+        {
+            int32_t displacement =
+                (int32_t)(jit_compiler_read_short(buffer->chunk, opCodeIndex + 2u) * sizeof(value_t));
+            jit_compiler_emit_load(buffer, REGISTER_R9, REGISTER_R14, 0);
+            jit_compiler_emit_load(buffer, REGISTER_RAX, REGISTER_R9, -(int32_t)sizeof(value_t));
+            jit_compiler_emit_load_immediate(buffer, REGISTER_RDX,
+                                             (uint64_t)(uintptr_t)&virtualMachine.globalValues.values);
+            jit_compiler_emit_load(buffer, REGISTER_RDX, REGISTER_RDX, 0);
+            jit_compiler_emit_load(buffer, REGISTER_RCX, REGISTER_RDX, displacement);
+            jit_compiler_emit_load_immediate(buffer, REGISTER_R8, UNDEFINED_VAL);
+            jit_compiler_emit_register_operation(buffer, 0x39, REGISTER_R8, REGISTER_RCX);
+            guards[guardCount++] = jit_compiler_emit_jump_forward(buffer, true, CONDITION_EQUAL);
+            jit_compiler_emit_store(buffer, REGISTER_RDX, REGISTER_RAX, displacement);
+            if (*instruction == OP_SET_GLOBAL_POP) {
+                // The OP_POP after the instruction is executed as well
+                jit_compiler_emit_stack_pointer_adjustment(buffer, false, 1u);
+                nextOpCodeIndex++;
+                jit_compiler_emit_jump(buffer, nextOpCodeIndex);
+            }
+            jit_compiler_emit_slow_path(buffer, guards, guardCount, opCodeIndex, *instruction, nextOpCodeIndex);
+            break;
+        }
+    case OP_JUMP:
+    case OP_LOOP:
+        jit_compiler_emit_jump(buffer, chunk_jump_target(buffer->chunk, opCodeIndex));
+        break;
+    case OP_JUMP_IF_FALSE:
+        {
+            uint32_t target = chunk_jump_target(buffer->chunk, opCodeIndex);
+            jit_compiler_emit_load(buffer, REGISTER_R9, REGISTER_R14, 0);
+            jit_compiler_emit_load(buffer, REGISTER_RAX, REGISTER_R9, -(int32_t)sizeof(value_t));
+            jit_compiler_emit_load_immediate(buffer, REGISTER_RCX, NULL_VAL);
+            jit_compiler_emit_register_operation(buffer, 0x39, REGISTER_RCX, REGISTER_RAX);
+            jit_compiler_emit_jump_if(buffer, CONDITION_EQUAL, target);
+            jit_compiler_emit_load_immediate(buffer, REGISTER_RCX, FALSE_VAL);
+            jit_compiler_emit_register_operation(buffer, 0x39, REGISTER_RCX, REGISTER_RAX);
+            jit_compiler_emit_jump_if(buffer, CONDITION_EQUAL, target);
+            break;
+        }
+    case OP_ADD:
+    case OP_ADD_NUMBER:
+    case OP_DIVIDE:
+    case OP_DIVIDE_NUMBER:
+    case OP_GREATER:
+    case OP_GREATER_NUMBER:
+    case OP_LESS:
+    case OP_LESS_NUMBER:
+    case OP_LESS_JUMP_IF_FALSE:
+    case OP_MULTIPLY:
+    case OP_MULTIPLY_NUMBER:
+    case OP_SUBTRACT:
+    case OP_SUBTRACT_NUMBER:
+        {
+            // The quickened and the generic instructions share a template - the slow path always calls the handler of
+            // the generic instruction, so a failing guard doesn't deoptimize the bytecode again and again
+            uint8_t genericOpCode = *instruction;
+            jit_compiler_emit_load(buffer, REGISTER_R9, REGISTER_R14, 0);
+            jit_compiler_emit_load(buffer, REGISTER_RAX, REGISTER_R9, -2 * (int32_t)sizeof(value_t));
+            jit_compiler_emit_load(buffer, REGISTER_RCX, REGISTER_R9, -(int32_t)sizeof(value_t));
+            jit_compiler_emit_load_immediate(buffer, REGISTER_R8, QNAN);
+            jit_compiler_emit_number_guard(buffer, REGISTER_RAX, guards, &guardCount);
+            jit_compiler_emit_number_guard(buffer, REGISTER_RCX, guards, &guardCount);
+            switch (*instruction) {
+            case OP_ADD:
+            case OP_ADD_NUMBER:
+                genericOpCode = OP_ADD;
+                jit_compiler_emit_number_operation(buffer, 0x58);
+                break;
+            case OP_DIVIDE:
+            case OP_DIVIDE_NUMBER:
+                genericOpCode = OP_DIVIDE;
+                jit_compiler_emit_number_operation(buffer, 0x5E);
+                break;
+            case OP_MULTIPLY:
+            case OP_MULTIPLY_NUMBER:
+                genericOpCode = OP_MULTIPLY;
+                jit_compiler_emit_number_operation(buffer, 0x59);
+                break;
+            case OP_SUBTRACT:
+            case OP_SUBTRACT_NUMBER:
+                genericOpCode = OP_SUBTRACT;
+                jit_compiler_emit_number_operation(buffer, 0x5C);
+                break;
+            case OP_GREATER:
+            case OP_GREATER_NUMBER:
+                genericOpCode = OP_GREATER;
+                jit_compiler_emit_compare_numbers(buffer, false);
+                break;
+            case OP_LESS:
+            case OP_LESS_NUMBER:
+                genericOpCode = OP_LESS;
+                jit_compiler_emit_compare_numbers(buffer, true);
+                break;
+            default:
+                break;
+            }
+            if (*instruction == OP_LESS_JUMP_IF_FALSE) {
+                // Executes OP_LESS, OP_JUMP_IF_FALSE and the OP_POP after the jump or at the jump target
+                // The operands are popped before the comparison, because the subtraction overwrites the flags
+                jit_compiler_emit_stack_pointer_adjustment(buffer, false, 2u);
+                jit_compiler_emit_bytes(buffer, 10u, 0x66, 0x48, 0x0F, 0x6E, 0xC0, 0x66, 0x48, 0x0F, 0x6E, 0xC9);
+                jit_compiler_emit_bytes(buffer, 4u, 0x66, 0x0F, 0x2E, 0xC8);
+                nextOpCodeIndex += 4u;
+                jit_compiler_emit_jump_if(buffer, CONDITION_BELOW_OR_EQUAL,
+                                          nextOpCodeIndex + jit_compiler_read_short(buffer->chunk, opCodeIndex + 2u));
+                jit_compiler_emit_jump(buffer, nextOpCodeIndex);
+            } else {
+                jit_compiler_emit_store(buffer, REGISTER_R9, REGISTER_RAX, -2 * (int32_t)sizeof(value_t));
+                jit_compiler_emit_stack_pointer_adjustment(buffer, false, 1u);
+            }
+            jit_compiler_emit_slow_path(buffer, guards, guardCount, opCodeIndex, genericOpCode, nextOpCodeIndex);
+            break;
+        }
+    case OP_REGISTER_ADD:
+    case OP_REGISTER_DIVIDE:
+    case OP_REGISTER_GREATER:
+    case OP_REGISTER_LESS:
+    case OP_REGISTER_LESS_JUMP_IF_FALSE:
+    case OP_REGISTER_MULTIPLY:
+    case OP_REGISTER_SUBTRACT:
+        {
+            jit_compiler_emit_load(buffer, REGISTER_RDX, REGISTER_RBX, (int32_t)offsetof(call_frame_t, slots));
+            jit_compiler_emit_load_register_operand(buffer, REGISTER_RAX, instruction[2]);
+            jit_compiler_emit_load_register_operand(buffer, REGISTER_RCX, instruction[3]);
+            jit_compiler_emit_load_immediate(buffer, REGISTER_R8, QNAN);
+            // The type of constant operands is already known
+            for (uint32_t i = 2u; i < 4u; i++) {
+                if (!(instruction[i] & REGISTER_OPERAND_CONSTANT) ||
+                    !IS_NUMBER(buffer->chunk->constants.values[instruction[i] & ~REGISTER_OPERAND_CONSTANT])) {
+                    jit_compiler_emit_number_guard(buffer, i == 2u ? REGISTER_RAX : REGISTER_RCX, guards,
+                                                   &guardCount);
+                }
+            }
+            switch (*instruction) {
+            case OP_REGISTER_ADD:
+                jit_compiler_emit_number_operation(buffer, 0x58);
+                break;
+            case OP_REGISTER_DIVIDE:
+                jit_compiler_emit_number_operation(buffer, 0x5E);
+                break;
+            case OP_REGISTER_MULTIPLY:
+                jit_compiler_emit_number_operation(buffer, 0x59);
+                break;
+            case OP_REGISTER_SUBTRACT:
+                jit_compiler_emit_number_operation(buffer, 0x5C);
+                break;
+            case OP_REGISTER_GREATER:
+                jit_compiler_emit_compare_numbers(buffer, false);
+                break;
+            case OP_REGISTER_LESS:
+                jit_compiler_emit_compare_numbers(buffer, true);
+                break;
+            default:
+                break;
+            }
+            if (*instruction == OP_REGISTER_LESS_JUMP_IF_FALSE) {
+                // Executes the comparison, the OP_JUMP_IF_FALSE and the OP_POP after the jump or at the jump target
+                jit_compiler_emit_bytes(buffer, 10u, 0x66, 0x48, 0x0F, 0x6E, 0xC0, 0x66, 0x48, 0x0F, 0x6E, 0xC9);
+                jit_compiler_emit_bytes(buffer, 4u, 0x66, 0x0F, 0x2E, 0xC8);
+                nextOpCodeIndex += 4u;
+                jit_compiler_emit_jump_if(buffer, CONDITION_BELOW_OR_EQUAL,
+                                          nextOpCodeIndex + jit_compiler_read_short(buffer->chunk, opCodeIndex + 5u));
+                jit_compiler_emit_jump(buffer, nextOpCodeIndex);
+            } else {
+                jit_compiler_emit_store_register_destination(buffer, instruction[1], REGISTER_RAX);
+            }
+            jit_compiler_emit_slow_path(buffer, guards, guardCount, opCodeIndex, *instruction, nextOpCodeIndex);
+            break;
+        }
+    case OP_REGISTER_MOVE:
+        jit_compiler_emit_load(buffer, REGISTER_RDX, REGISTER_RBX, (int32_t)offsetof(call_frame_t, slots));
+        jit_compiler_emit_load_register_operand(buffer, REGISTER_RAX, instruction[2]);
+        jit_compiler_emit_store_register_destination(buffer, instruction[1], REGISTER_RAX);
+        break;
+    case OP_GET_LOCAL_GET_PROPERTY:
+        // The opcode of the OP_GET_PROPERTY is skipped by the handler
+        jit_compiler_emit_handler_call(buffer, opCodeIndex, *instruction,
+                                       nextOpCodeIndex + chunk_instruction_length(buffer->chunk, nextOpCodeIndex));
+        break;
+    default:
+        jit_compiler_emit_handler_call(buffer, opCodeIndex, *instruction, nextOpCodeIndex);
+        break;
+    }
+}
+#endif
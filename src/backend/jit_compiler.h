@@ -0,0 +1,78 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file jit_compiler.h
+ * @brief Header file containing the declarations of the baseline just in time compiler.
+ * @details The just in time compiler translates the chunks of hot functions into x86-64 machine code, that is stitched
+ * together from a template for every bytecode instruction. Simple instructions are executed inline by the machine
+ * code, every other instruction (and the slow paths of the inlined instructions) call the handlers of the virtual
+ * machine. The interpreter remains the fallback for every function that hasn't been compiled (yet).
+ */
+
+#ifndef CELLOX_JIT_COMPILER_H_
+#define CELLOX_JIT_COMPILER_H_
+
+#include "../byte-code/chunk.h"
+#include "../common.h"
+
+// The machine code relies on the calling convention of the System V ABI and on not a number boxing
+#if defined(OS_LINUX) && defined(__x86_64__) && defined(NAN_BOXING)
+#define JIT_COMPILER_AVAILABLE
+#endif
+
+/// Result of the machine code and the handlers, if the virtual machine shall continue with the execution
+#define JIT_COMPILER_CONTINUE (UINT32_MAX)
+
+/// @brief Machine code of a chunk that was created by the just in time compiler
+typedef struct {
+    /// The machine code of the chunk in the executable memory (NULL if the chunk hasn't been compiled)
+    uint8_t * code;
+    /// The address of the machine code of every bytecode instruction - NULL for the operands of an instruction
+    void ** entries;
+    /// The amount of entries (equal to the amount of bytecode of the chunk)
+    uint32_t entryCount;
+} jit_code_t;
+
+/// @brief Translates a chunk into machine code
+/// @param jitCode The jit code where the machine code is stored
+/// @param chunk The chunk that is compiled
+/// @param handlers The functions that execute the instructions in the virtual machine - indexed by the opcode
+/// @param executeCallee The function that executes a call frame that was pushed by a call until it has returned - it
+/// receives the amount of call frames after the call frame was pushed
+/// @return true if the chunk was compiled, false if not (e.g. no executable memory could be allocated)
+bool jit_compiler_compile(jit_code_t * jitCode, chunk_t * chunk, void * const * handlers, void * executeCallee);
+
+/// @brief Executes the machine code of a chunk
+/// @param jitCode The jit code that is executed
+/// @param frame The call frame of the function (call_frame_t)
+/// @param entry The address of the machine code of the bytecode instruction where the execution starts
+/// @return JIT_COMPILER_CONTINUE if the virtual machine shall continue (e.g. after a call), otherwise the interpret
+/// result of the program
+uint32_t jit_compiler_execute(jit_code_t const * jitCode, void * frame, void const * entry);
+
+/// @brief Deallocates the memory used by the jit code
+/// @param jitCode The jit code that is freed
+/// @note The machine code itself stays in the executable memory, until jit_compiler_free_executable_memory() is called
+void jit_compiler_free(jit_code_t * jitCode);
+
+/// @brief Deallocates the executable memory that contains the machine code of all the compiled chunks
+void jit_compiler_free_executable_memory();
+
+/// @brief Initializes jit code
+/// @param jitCode The jit code that is initialized
+void jit_compiler_init(jit_code_t * jitCode);
+
+#endif
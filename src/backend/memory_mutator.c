@@ -23,31 +23,58 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "concurrent_marker.h"
 #include "garbage_collector.h"
+#include "object_allocator.h"
+#include "parallel_marker.h"
 #include "virtual_machine.h"
 
-void memory_mutator_free_objects() {
-    object_t * object = virtualMachine.objects;
-    while (object) {
-        object_t * next = object->next;
-        memory_mutator_free_object(object);
-        object = next;
+static inline void memory_mutator_collect_garbage_if_needed();
+static void memory_mutator_free_list(object_t *);
+
+void * memory_mutator_allocate_object(size_t size) {
+    if (size > OBJECT_ALLOCATOR_MAX_SIZE) {
+        return memory_mutator_reallocate(NULL, 0u, size);
     }
+    // The whole slot is accounted, the rest of it can't be used by other objects
+    virtualMachine.bytesAllocated += object_allocator_slot_size(size);
+    memory_mutator_collect_garbage_if_needed();
+    return object_allocator_allocate(size);
+}
+
+void memory_mutator_deallocate_object(void * pointer, size_t size) {
+    if (size > OBJECT_ALLOCATOR_MAX_SIZE) {
+        memory_mutator_reallocate(pointer, size, 0u);
+        return;
+    }
+    virtualMachine.bytesAllocated -= object_allocator_slot_size(size);
+    object_allocator_free(pointer, size);
+}
+
+void memory_mutator_free_objects() {
+#ifdef CONCURRENT_MARKER_AVAILABLE
+    // The background thread can't read the objects any longer
+    concurrent_marker_free();
+#endif
+    memory_mutator_free_list(virtualMachine.objects);
+    memory_mutator_free_list(virtualMachine.youngObjects);
+    object_allocator_free_pages();
     if (virtualMachine.grayStack) {
         free(virtualMachine.grayStack);
     }
-    virtualMachine.objects = NULL;
+    if (virtualMachine.rememberedSet) {
+        free(virtualMachine.rememberedSet);
+    }
+#ifdef PARALLEL_MARKER_AVAILABLE
+    parallel_marker_free();
+#endif
+    virtualMachine.objects = virtualMachine.youngObjects = NULL;
 }
 
 void * memory_mutator_reallocate(void * pointer, size_t oldSize, size_t newSize) {
     virtualMachine.bytesAllocated += newSize - oldSize;
     if (newSize > oldSize) {
-#ifdef DEBUG_STRESS_GC
-        memory_collect_garbage();
-#endif
-        if (virtualMachine.bytesAllocated > virtualMachine.nextGC) {
-            garbage_collector_collect_garbage();
-        }
+        memory_mutator_collect_garbage_if_needed();
     }
     if (!newSize) {
         free(pointer);
@@ -73,27 +100,28 @@ void memory_mutator_free_object(object_t * object) {
         {
             object_dynamic_value_array_t * array = (object_dynamic_value_array_t *)object;
             dynamic_value_array_free(&array->array);
-            FREE(object_dynamic_value_array_t, object);
+            FREE_OBJECT(object_dynamic_value_array_t, object);
             break;
         }
     case OBJECT_BOUND_METHOD:
-        FREE(object_bound_method_t, object);
+        FREE_OBJECT(object_bound_method_t, object);
         break;
     case OBJECT_CLASS:
         {
             object_class_t * celloxClass = (object_class_t *)object;
             // If a class is unreachable, all the methods are unreachable, too.
             value_hash_table_free(&celloxClass->methods);
-            FREE(object_class_t, object);
+            object_shape_free(celloxClass->rootShape);
+            FREE_OBJECT(object_class_t, object);
             break;
         }
     case OBJECT_CLOSURE:
         {
             object_closure_t * closure = (object_closure_t *)object;
-            // If a closure is unreachable we also need to free all the memory used by the upvalues that are captured by
-            // the closure
-            FREE_ARRAY(object_upvalue_t *, closure->upvalues, closure->upvalueCount);
-            FREE(object_closure_t, object);
+            // The references to the upvalues and the values that are captured by the closure are stored inline
+            memory_mutator_deallocate_object(object, sizeof(object_closure_t) +
+                                                         sizeof(object_upvalue_t *) * closure->upvalueCount +
+                                                         sizeof(value_t) * closure->capturedValueCount);
             break;
         }
     case OBJECT_FUNCTION:
@@ -101,30 +129,53 @@ void memory_mutator_free_object(object_t * object) {
             object_function_t * function = (object_function_t *)object;
             // If a function is unreachable we also need to free all the memory used by the chunk
             chunk_free(&function->chunk);
-            FREE(object_function_t, object);
+            threaded_code_free(&function->threadedCode);
+            jit_compiler_free(&function->jitCode);
+            FREE_OBJECT(object_function_t, object);
             break;
         }
     case OBJECT_INSTANCE:
         {
             object_instance_t * instance = (object_instance_t *)object;
             // If a instance is unreachable we also need to free all the memory used by the fields
-            value_hash_table_free(&instance->fields);
-            FREE(object_instance_t, object);
+            FREE_ARRAY(value_t, instance->outOfLineFields, instance->outOfLineFieldCapacity);
+            memory_mutator_deallocate_object(object,
+                                             sizeof(object_instance_t) + sizeof(value_t) * instance->inlineFieldCount);
             break;
         }
     case OBJECT_NATIVE:
-        FREE(object_native_t, object);
+        FREE_OBJECT(object_native_t, object);
         break;
     case OBJECT_STRING:
         {
             object_string_t * string = (object_string_t *)object;
             // If a string is unreachable we need to free the memory the underlying character sequence occupies
             FREE_ARRAY(char, string->chars, string->length + 1);
-            FREE(object_string_t, object);
+            FREE_OBJECT(object_string_t, object);
             break;
         }
     case OBJECT_UPVALUE:
-        FREE(object_upvalue_t, object);
+        FREE_OBJECT(object_upvalue_t, object);
         break;
     }
 }
+
+/// @brief Dealocates the memory used by all the objects in a linked list of objects
+/// @param object The first object of the list
+static void memory_mutator_free_list(object_t * object) {
+    while (object) {
+        object_t * next = object->next;
+        memory_mutator_free_object(object);
+        object = next;
+    }
+}
+
+/// @brief Triggers a garbage collection, if enough memory was allocated since the last one
+static inline void memory_mutator_collect_garbage_if_needed() {
+#ifdef DEBUG_STRESS_GC
+    memory_collect_garbage();
+#endif
+    if (virtualMachine.bytesAllocated > virtualMachine.nextMinorGC) {
+        garbage_collector_collect_garbage();
+    }
+}
@@ -36,6 +36,9 @@
 /// Makro that frees the memory used by a given type at the position specified by the pointer
 #define FREE(type, pointer)                 (memory_mutator_reallocate(pointer, sizeof(type), 0))
 
+/// Makro that frees the memory used by an object of a given type, that was allocated by memory_mutator_allocate_object
+#define FREE_OBJECT(type, pointer)          (memory_mutator_deallocate_object(pointer, sizeof(type)))
+
 /// Makro that dealocates an existing dynamic array
 #define FREE_ARRAY(type, pointer, oldCount) (memory_mutator_reallocate(pointer, sizeof(type) * (oldCount), 0))
 
@@ -49,6 +52,17 @@
 /// Determines the new size if a hashtable is grown
 #define GROW_HASHTABLE_CAPACITY(capacity) ((capacity) < 8u ? 8u : (capacity)*HASH_TABLE_GROWTH_FACTOR)
 
+/// @brief Allocates the memory used by an object
+/// @param size The size of the object
+/// @return The allocated memory block
+/// @details Small objects are allocated by the object allocator
+void * memory_mutator_allocate_object(size_t size);
+
+/// @brief Dealocates the memory used by an object, that was allocated by memory_mutator_allocate_object
+/// @param pointer Pointer to the memory block of the object
+/// @param size The size of the object
+void memory_mutator_deallocate_object(void * pointer, size_t size);
+
 /// @brief Dealocates the memory used by the objects of the virtualMachine
 void memory_mutator_free_objects();
 
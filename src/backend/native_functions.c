@@ -23,6 +23,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #ifdef OS_WINDOWS
@@ -105,12 +106,13 @@ native_function_config_t native_function_configs[] = {
                                         .arrity = 2},
     [NATIVE_FUNCTION_ARRAY_LENGTH] = {.functionName = "array_length",
                                       .function = native_functions_array_length,
-                                      .arrity = 1},
+                                      .arrity = 1,
+                                      .intrinsic = true},
     [NATIVE_FUNCTION_ASCI_TO_NUMERICAL] = {.functionName = "asci_to_num",
                                            .function = native_functions_asci_to_numerical,
                                            .arrity = 1},
     [NATIVE_FUNCTION_CLASS_OF] = {.functionName = "class_of", .function = native_functions_classof, .arrity = 1},
-    [NATIVE_FUNCTION_CLOCK] = {.functionName = "clock", .function = native_functions_clock},
+    [NATIVE_FUNCTION_CLOCK] = {.functionName = "clock", .function = native_functions_clock, .intrinsic = true},
     [NATIVE_FUNCTION_COSINE] = {.functionName = "cosine", .function = native_functions_cosine, .arrity = 1},
     [NATIVE_FUNCTION_EXIT] = {.functionName = "exit", .function = native_functions_exit, .arrity = 1},
     [NATIVE_FUNCTION_EXPONENTIAL] = {.functionName = "exponential",
@@ -133,12 +135,18 @@ native_function_config_t native_function_configs[] = {
     [NATIVE_FUNCTION_READ_FILE] = {.functionName = "read_file", .function = native_functions_read_file, .arrity = 1},
     [NATIVE_FUNCTION_READ_KEY] = {.functionName = "read_key", .function = native_functions_read_key},
     [NATIVE_FUNCTION_READ_LINE] = {.functionName = "read_line", .function = native_functions_read_line},
-    [NATIVE_FUNCTION_SINE] = {.functionName = "sine", .function = native_functions_sine, .arrity = 1},
+    [NATIVE_FUNCTION_SINE] = {.functionName = "sine",
+                              .function = native_functions_sine,
+                              .arrity = 1,
+                              .intrinsic = true},
     [NATIVE_FUNCTION_SIZEOF] = {.functionName = "size_of", .function = native_functions_size_of, .arrity = 1},
     [NATIVE_FUNCTION_STRING_HASH] = {.functionName = "string_hash",
                                      .function = native_functions_string_hash,
                                      .arrity = 1},
-    [NATIVE_FUNCTION_STRLEN] = {.functionName = "strlen", .function = native_functions_string_length, .arrity = 1},
+    [NATIVE_FUNCTION_STRLEN] = {.functionName = "strlen",
+                                .function = native_functions_string_length,
+                                .arrity = 1,
+                                .intrinsic = true},
     [NATIVE_FUNCTION_STRING_REPLACE_AT] = {.functionName = "string_replace_at",
                                            .function = native_functions_string_replace_at,
                                            .arrity = 3},
@@ -154,6 +162,35 @@ static void native_functions_arguments_error(char const * format, ...);
 static void native_functions_assert_arrity(uint8_t, uint32_t);
 static size_t native_functions_value_size(value_t value);
 
+bool native_functions_call_intrinsic(uint32_t native, value_t const * args, value_t * result) {
+    // Only the arguments that are accepted by the native function are handled, the native function reports the errors
+    switch (native) {
+    case NATIVE_FUNCTION_ARRAY_LENGTH:
+        if (!IS_ARRAY(*args)) {
+            return false;
+        }
+        *result = NUMBER_VAL(AS_ARRAY(*args)->array.count);
+        return true;
+    case NATIVE_FUNCTION_CLOCK:
+        *result = NUMBER_VAL((double)clock() / CLOCKS_PER_SEC);
+        return true;
+    case NATIVE_FUNCTION_SINE:
+        if (!IS_NUMBER(*args)) {
+            return false;
+        }
+        *result = NUMBER_VAL(sin(AS_NUMBER(*args)));
+        return true;
+    case NATIVE_FUNCTION_STRLEN:
+        if (!IS_STRING(*args)) {
+            return false;
+        }
+        *result = NUMBER_VAL(strlen(AS_CSTRING(*args)));
+        return true;
+    default:
+        return false;
+    }
+}
+
 native_function_config_t * native_functions_get_function_configs() {
     return native_function_configs;
 }
@@ -162,6 +199,16 @@ size_t native_functions_get_function_count() {
     return sizeof(native_function_configs) / sizeof(*native_function_configs);
 }
 
+int32_t native_functions_get_intrinsic(char const * name, uint32_t length) {
+    for (size_t i = 0; i < native_functions_get_function_count(); i++) {
+        if (native_function_configs[i].intrinsic && strlen(native_function_configs[i].functionName) == length &&
+            !memcmp(native_function_configs[i].functionName, name, length)) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
 value_t native_functions_append_to_file(uint32_t argCount, value_t const * args) {
     native_functions_assert_arrity(NATIVE_FUNCTION_APPEND_TO_FILE, argCount);
     if (!IS_STRING(*args) || !IS_STRING(*(args + 1))) {
@@ -569,19 +616,19 @@ static size_t native_functions_value_size(value_t value) {
             return classSize + sizeof(object_class_t);
         }
     case OBJECT_CLOSURE:
-        return AS_CLOSURE(value)->function->chunk.byteCodeCount + sizeof(object_closure_t);
+        return AS_CLOSURE(value)->function->chunk.byteCodeCount + sizeof(object_closure_t) +
+               sizeof(object_upvalue_t *) * AS_CLOSURE(value)->upvalueCount +
+               sizeof(value_t) * AS_CLOSURE(value)->capturedValueCount;
     case OBJECT_FUNCTION:
         return AS_FUNCTION(value)->chunk.byteCodeCount + sizeof(object_function_t);
     case OBJECT_INSTANCE:
         {
             object_instance_t * instance = AS_INSTANCE(value);
-            size_t size = sizeof(object_instance_t);
-            for (size_t i = 0; i < instance->fields.capacity; i++) {
-                // Not every entry in the table is filled
-                if (instance->fields.entries[i].key) {
-                    size += native_functions_value_size(instance->fields.entries[i].value);
-                }
+            size_t size = sizeof(object_instance_t) + sizeof(value_t) * instance->inlineFieldCount;
+            for (uint32_t i = 0; i < instance->shape->fieldCount; i++) {
+                size += native_functions_value_size(*object_instance_field(instance, i));
             }
+            return size;
         }
     case OBJECT_NATIVE:
         return sizeof(native_function_t);
@@ -35,8 +35,18 @@ typedef struct {
     native_function_t function;
     /// The amount of arguments the native function expects
     size_t arrity;
+    /// Determines whether calls of the native function are compiled to an intrinsic instruction
+    bool intrinsic;
 } native_function_config_t;
 
+/// @brief Executes a native function that is called by an intrinsic instruction without calling the native function
+/// @param native The index of the native function in the configurations
+/// @param args The arguments that the native function was called with - the amount of arguments matches the arrity
+/// @param result Pointer to the value where the result is stored
+/// @return true if the result was determined, false if the native function has to be called (e.g. to report an error
+/// regarding the arguments)
+bool native_functions_call_intrinsic(uint32_t native, value_t const * args, value_t * result);
+
 /// @brief Gets the configuration of the native functions
 /// @return an array that contains the native function configurations
 native_function_config_t * native_functions_get_function_configs();
@@ -45,6 +55,13 @@ native_function_config_t * native_functions_get_function_configs();
 /// @return The amount of native functions that are defiened
 size_t native_functions_get_function_count();
 
+/// @brief Determines whether calls of a native function are compiled to an intrinsic instruction
+/// @param name The name of the called global variable
+/// @param length The length of the name
+/// @return The index of the native function in the configurations or -1 if calls of the global variable are not
+/// compiled to an intrinsic instruction
+int32_t native_functions_get_intrinsic(char const * name, uint32_t length);
+
 /// @brief Determines the length of an array
 /// @param argCount The amount of arguments that were used when array_length was called
 /// @param args The arguments that array_length was called with
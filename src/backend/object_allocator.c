@@ -0,0 +1,172 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file object_allocator.c
+ * @brief File containing the implementation of the object allocator.
+ */
+
+#include "object_allocator.h"
+
+#include <stdlib.h>
+
+// The free slots are poisoned, so the address sanitizer still detects the objects that are used after they were freed
+#if defined(__SANITIZE_ADDRESS__)
+#define OBJECT_ALLOCATOR_POISONING
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define OBJECT_ALLOCATOR_POISONING
+#endif
+#endif
+
+#ifdef OBJECT_ALLOCATOR_POISONING
+#include <sanitizer/asan_interface.h>
+#define OBJECT_ALLOCATOR_POISON(address, size)   ASAN_POISON_MEMORY_REGION(address, size)
+#define OBJECT_ALLOCATOR_UNPOISON(address, size) ASAN_UNPOISON_MEMORY_REGION(address, size)
+#else
+#define OBJECT_ALLOCATOR_POISON(address, size)   ((void)(address), (void)(size))
+#define OBJECT_ALLOCATOR_UNPOISON(address, size) ((void)(address), (void)(size))
+#endif
+
+/// The amount of size classes
+#define OBJECT_ALLOCATOR_SIZE_CLASS_COUNT (OBJECT_ALLOCATOR_MAX_SIZE / OBJECT_ALLOCATOR_GRANULARITY)
+
+/// @brief A page that contains the slots of a size class
+typedef struct object_allocator_page_t {
+    /// The page that was allocated before this page
+    struct object_allocator_page_t * next;
+    /// Unused - the slots are aligned to the granularity
+    size_t padding;
+    /// The slots of the page
+    unsigned char slots[];
+} object_allocator_page_t;
+
+/// @brief A size class of the object allocator
+typedef struct {
+    /// The first free slot - every free slot refers to the next one
+    void * freeList;
+    /// The first slot of the newest page that hasn't been used yet
+    unsigned char * unusedSlots;
+    /// The end of the slots of the newest page
+    unsigned char * end;
+    /// The pages of the size class
+    object_allocator_page_t * pages;
+    /// The amount of pages of the size class
+    size_t pageCount;
+    /// The amount of slots that are used by objects
+    size_t usedSlotCount;
+    /// The amount of bytes that are used by the objects - the rest of the used slots is wasted
+    size_t objectBytes;
+} object_allocator_size_class_t;
+
+/// The size classes of the object allocator - the slots of the i-th class are (i + 1) * granularity bytes large
+static object_allocator_size_class_t sizeClasses[OBJECT_ALLOCATOR_SIZE_CLASS_COUNT];
+
+static void object_allocator_add_page(object_allocator_size_class_t *, size_t);
+static inline object_allocator_size_class_t * object_allocator_size_class(size_t);
+
+void * object_allocator_allocate(size_t size) {
+    object_allocator_size_class_t * sizeClass = object_allocator_size_class(size);
+    size_t slotSize = object_allocator_slot_size(size);
+    void * slot = sizeClass->freeList;
+    if (slot) {
+        OBJECT_ALLOCATOR_UNPOISON(slot, slotSize);
+        sizeClass->freeList = *(void **)slot;
+    } else {
+        if (sizeClass->unusedSlots == sizeClass->end) {
+            object_allocator_add_page(sizeClass, slotSize);
+        }
+        slot = sizeClass->unusedSlots;
+        sizeClass->unusedSlots += slotSize;
+        OBJECT_ALLOCATOR_UNPOISON(slot, slotSize);
+    }
+    sizeClass->usedSlotCount++;
+    sizeClass->objectBytes += size;
+    return slot;
+}
+
+void object_allocator_free(void * slot, size_t size) {
+    object_allocator_size_class_t * sizeClass = object_allocator_size_class(size);
+    *(void **)slot = sizeClass->freeList;
+    sizeClass->freeList = slot;
+    OBJECT_ALLOCATOR_POISON(slot, object_allocator_slot_size(size));
+    sizeClass->usedSlotCount--;
+    sizeClass->objectBytes -= size;
+}
+
+void object_allocator_free_pages() {
+    for (uint32_t i = 0u; i < OBJECT_ALLOCATOR_SIZE_CLASS_COUNT; i++) {
+        object_allocator_page_t * page = sizeClasses[i].pages;
+        while (page) {
+            object_allocator_page_t * next = page->next;
+            OBJECT_ALLOCATOR_UNPOISON(page, OBJECT_ALLOCATOR_PAGE_SIZE);
+            free(page);
+            page = next;
+        }
+        sizeClasses[i] = (object_allocator_size_class_t){0};
+    }
+}
+
+#ifdef PROFILE_GARBAGE_COLLECTOR
+void object_allocator_print_statistics(FILE * file) {
+    fprintf(file, "== object allocator ==\n");
+    size_t pageBytes = 0u, slotBytes = 0u, objectBytes = 0u;
+    for (uint32_t i = 0u; i < OBJECT_ALLOCATOR_SIZE_CLASS_COUNT; i++) {
+        object_allocator_size_class_t * sizeClass = sizeClasses + i;
+        if (!sizeClass->pageCount) {
+            continue;
+        }
+        size_t slotSize = (i + 1u) * OBJECT_ALLOCATOR_GRANULARITY;
+        fprintf(file, "%3zu bytes: %zu pages, %zu objects\n", slotSize, sizeClass->pageCount, sizeClass->usedSlotCount);
+        pageBytes += sizeClass->pageCount * OBJECT_ALLOCATOR_PAGE_SIZE;
+        slotBytes += sizeClass->usedSlotCount * slotSize;
+        objectBytes += sizeClass->objectBytes;
+    }
+    if (!pageBytes) {
+        return;
+    }
+    // The free slots are wasted until they are reused (external fragmentation), the end of the slots is wasted as long
+    // as the objects live (internal fragmentation)
+    fprintf(file, "%zu kB in pages, %zu kB used by objects\n", pageBytes / 1024u, objectBytes / 1024u);
+    fprintf(file, "external fragmentation %.1f %%\ninternal fragmentation %.1f %%\n",
+            100.0 * (double)(pageBytes - slotBytes) / (double)pageBytes,
+            100.0 * (double)(slotBytes - objectBytes) / (double)pageBytes);
+}
+#endif
+
+/// @brief Adds a new page to a size class
+/// @param sizeClass The size class where the page is added
+/// @param slotSize The size of the slots of the size class
+static void object_allocator_add_page(object_allocator_size_class_t * sizeClass, size_t slotSize) {
+    object_allocator_page_t * page = (object_allocator_page_t *)malloc(OBJECT_ALLOCATOR_PAGE_SIZE);
+    if (!page) {
+        fprintf(stderr, "Failed too allocate memory");
+        exit(EXIT_CODE_SYSTEM_ERROR);
+    }
+    page->next = sizeClass->pages;
+    sizeClass->pages = page;
+    sizeClass->pageCount++;
+    size_t slotCount = (OBJECT_ALLOCATOR_PAGE_SIZE - sizeof(object_allocator_page_t)) / slotSize;
+    sizeClass->unusedSlots = page->slots;
+    sizeClass->end = page->slots + slotCount * slotSize;
+    OBJECT_ALLOCATOR_POISON(page->slots, OBJECT_ALLOCATOR_PAGE_SIZE - sizeof(object_allocator_page_t));
+}
+
+/// @brief Determines the size class of an object
+/// @param size The size of the object
+/// @return The size class of the object
+static inline object_allocator_size_class_t * object_allocator_size_class(size_t size) {
+    return sizeClasses + (size - 1u) / OBJECT_ALLOCATOR_GRANULARITY;
+}
@@ -0,0 +1,68 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file object_allocator.h
+ * @brief Header file containing the declarations of the object allocator.
+ * @details The object allocator is a segregated allocator for small objects. The objects are grouped into size classes
+ * (multiples of OBJECT_ALLOCATOR_GRANULARITY bytes), every size class carves its slots out of its own pages. The slots
+ * of the objects that are reclaimed are linked into the free list of the size class and reused by the next objects of
+ * the class. The pages are returned, once all the objects of the virtual machine are freed.
+ */
+
+#ifndef CELLOX_OBJECT_ALLOCATOR_H_
+#define CELLOX_OBJECT_ALLOCATOR_H_
+
+#include <stdio.h>
+
+#include "../common.h"
+
+/// The size of the slots of the size classes is a multiple of the granularity
+#define OBJECT_ALLOCATOR_GRANULARITY (8u)
+
+/// The size of the largest objects that are allocated by the object allocator - larger objects are allocated by libc
+#define OBJECT_ALLOCATOR_MAX_SIZE    (256u)
+
+/// The size of a page that contains the slots of a size class
+#define OBJECT_ALLOCATOR_PAGE_SIZE   (1u << 15)
+
+/// @brief Allocates the slot of an object
+/// @param size The size of the object - at most OBJECT_ALLOCATOR_MAX_SIZE bytes
+/// @return The slot where the object is stored
+void * object_allocator_allocate(size_t size);
+
+/// @brief Frees the slot of an object
+/// @param slot The slot of the object that is freed
+/// @param size The size of the object
+void object_allocator_free(void * slot, size_t size);
+
+/// @brief Frees all the pages of the size classes
+/// @details All the objects have to be freed beforehand
+void object_allocator_free_pages();
+
+#ifdef PROFILE_GARBAGE_COLLECTOR
+/// @brief Prints the amount of pages and the fragmentation of the size classes
+/// @param file The file where the statistics are printed
+void object_allocator_print_statistics(FILE * file);
+#endif
+
+/// @brief Determines the size of the slot of an object
+/// @param size The size of the object
+/// @return The size of the slot that is used for the object
+static inline size_t object_allocator_slot_size(size_t size) {
+    return (size + OBJECT_ALLOCATOR_GRANULARITY - 1u) & ~(size_t)(OBJECT_ALLOCATOR_GRANULARITY - 1u);
+}
+
+#endif
@@ -0,0 +1,183 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file opcode_profiler.c
+ * @brief File containing the implementation of the opcode profiler.
+ */
+
+#include "opcode_profiler.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// @brief An entry in the hashtable of the profiler that contains the counter of a single n-gram
+typedef struct {
+    /// The length of the n-gram (upper 32 bits) and the opcodes of the n-gram (lower 32 bits) - zero if unused
+    uint64_t key;
+    /// How often the n-gram was executed
+    uint64_t count;
+} opcode_profiler_entry_t;
+
+/// Hashtable that contains the counters of the n-grams (open addressing with linear probing)
+static opcode_profiler_entry_t * entries = NULL;
+/// The capacity of the hashtable (always a power of two)
+static uint32_t entryCapacity = 0u;
+/// The amount of n-grams that are stored in the hashtable
+static uint32_t entryCount = 0u;
+/// The opcodes of the instructions that were executed last and that are stored next to each other in a chunk
+static uint8_t history[OPCODE_PROFILER_MAX_LENGTH];
+/// The amount of opcodes that are stored in the history
+static uint32_t historyLength = 0u;
+/// The amount of instructions that were executed
+static uint64_t instructionCount = 0u;
+/// The index of the instruction after the instruction that was executed last
+static uint32_t nextOpCodeIndex = 0u;
+/// The chunk of the instruction that was executed last
+static chunk_t const * previousChunk = NULL;
+
+static int opcode_profiler_compare_entries(void const *, void const *);
+static void opcode_profiler_count(uint8_t const *, uint32_t);
+static opcode_profiler_entry_t * opcode_profiler_find_entry(opcode_profiler_entry_t *, uint32_t, uint64_t);
+static void opcode_profiler_grow();
+
+void opcode_profiler_free() {
+    free(entries);
+    entries = NULL;
+    entryCapacity = entryCount = historyLength = nextOpCodeIndex = 0u;
+    instructionCount = 0u;
+    previousChunk = NULL;
+}
+
+void opcode_profiler_print(FILE * file) {
+
+/// Makro that retrieves the name of the specified opcode
+#define OPCODE_NAME(opcode) [opcode] = #opcode,
+
+    static char const * const opCodeNames[] = {CHUNK_OPCODES(OPCODE_NAME)};
+
+#undef OPCODE_NAME
+
+    fprintf(file, "== opcode profile ==\n%" PRIu64 " instructions executed\n", instructionCount);
+    if (!entryCount) {
+        return;
+    }
+    opcode_profiler_entry_t * sortedEntries = malloc(sizeof(opcode_profiler_entry_t) * entryCount);
+    if (!sortedEntries) {
+        return;
+    }
+    for (uint32_t length = 1u; length <= OPCODE_PROFILER_MAX_LENGTH; length++) {
+        uint32_t sortedCount = 0u;
+        for (uint32_t i = 0u; i < entryCapacity; i++) {
+            if ((uint32_t)(entries[i].key >> 32u) == length) {
+                sortedEntries[sortedCount++] = entries[i];
+            }
+        }
+        qsort(sortedEntries, sortedCount, sizeof(opcode_profiler_entry_t), opcode_profiler_compare_entries);
+        fprintf(file, "-- %" PRIu32 "-grams --\n", length);
+        for (uint32_t i = 0u; i < sortedCount && i < OPCODE_PROFILER_PRINT_COUNT; i++) {
+            fprintf(file, "%14" PRIu64 " %6.2f%% ", sortedEntries[i].count,
+                    100.0 * (double)sortedEntries[i].count / (double)instructionCount);
+            for (uint32_t j = 0u; j < length; j++) {
+                fprintf(file, " %s", opCodeNames[(uint8_t)(sortedEntries[i].key >> (8u * j))]);
+            }
+            fputc('\n', file);
+        }
+    }
+    free(sortedEntries);
+}
+
+void opcode_profiler_record(chunk_t const * chunk, uint32_t opCodeIndex) {
+    // A jump, call or return interrupts the sequence - those instructions are not stored next to each other
+    if (chunk != previousChunk || opCodeIndex != nextOpCodeIndex) {
+        historyLength = 0u;
+    }
+    previousChunk = chunk;
+    nextOpCodeIndex = opCodeIndex + chunk_instruction_length(chunk, opCodeIndex);
+    if (historyLength == OPCODE_PROFILER_MAX_LENGTH) {
+        memmove(history, history + 1, OPCODE_PROFILER_MAX_LENGTH - 1u);
+        historyLength--;
+    }
+    history[historyLength++] = chunk->code[opCodeIndex];
+    instructionCount++;
+    // Every n-gram that ends with the instruction is counted
+    for (uint32_t length = 1u; length <= historyLength; length++) {
+        opcode_profiler_count(history + historyLength - length, length);
+    }
+}
+
+/// @brief Compares two entries of the profiler by their count, so they are sorted in descending order
+/// @param first The first entry that is compared
+/// @param second The second entry that is compared
+/// @return A negative value if the first entry was executed more often than the second one
+static int opcode_profiler_compare_entries(void const * first, void const * second) {
+    uint64_t firstCount = ((opcode_profiler_entry_t const *)first)->count;
+    uint64_t secondCount = ((opcode_profiler_entry_t const *)second)->count;
+    return (firstCount < secondCount) - (firstCount > secondCount);
+}
+
+/// @brief Increments the counter of a n-gram
+/// @param opCodes The opcodes of the n-gram
+/// @param length The length of the n-gram
+static void opcode_profiler_count(uint8_t const * opCodes, uint32_t length) {
+    uint64_t key = (uint64_t)length << 32u;
+    for (uint32_t i = 0u; i < length; i++) {
+        key |= (uint64_t)opCodes[i] << (8u * i);
+    }
+    if ((entryCount + 1u) * 4u > entryCapacity * 3u) {
+        opcode_profiler_grow();
+    }
+    opcode_profiler_entry_t * entry = opcode_profiler_find_entry(entries, entryCapacity, key);
+    if (!entry->key) {
+        entry->key = key;
+        entryCount++;
+    }
+    entry->count++;
+}
+
+/// @brief Finds the entry of a n-gram in the hashtable or the unused entry where it can be stored
+/// @param table The hashtable that is searched
+/// @param capacity The capacity of the hashtable
+/// @param key The key of the n-gram
+/// @return The entry of the n-gram
+static opcode_profiler_entry_t * opcode_profiler_find_entry(opcode_profiler_entry_t * table, uint32_t capacity,
+                                                            uint64_t key) {
+    // Fibonacci hashing spreads the packed opcodes over the whole table
+    uint32_t index = (uint32_t)((key * UINT64_C(11400714819323198485)) >> 32u) & (capacity - 1u);
+    while (table[index].key && table[index].key != key) {
+        index = (index + 1u) & (capacity - 1u);
+    }
+    return &table[index];
+}
+
+/// @brief Doubles the capacity of the hashtable
+/// @details The memory isn't allocated by the memory mutator, so the profiler can't trigger a garbage collection
+static void opcode_profiler_grow() {
+    uint32_t capacity = entryCapacity ? entryCapacity * 2u : 256u;
+    opcode_profiler_entry_t * table = calloc(capacity, sizeof(opcode_profiler_entry_t));
+    if (!table) {
+        fprintf(stderr, "Failed too allocate memory");
+        exit(EXIT_CODE_SYSTEM_ERROR);
+    }
+    for (uint32_t i = 0u; i < entryCapacity; i++) {
+        if (entries[i].key) {
+            *opcode_profiler_find_entry(table, capacity, entries[i].key) = entries[i];
+        }
+    }
+    free(entries);
+    entries = table;
+    entryCapacity = capacity;
+}
@@ -0,0 +1,51 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file opcode_profiler.h
+ * @brief Header file containing the declarations of the opcode profiler.
+ * @details The profiler counts the n-grams of the opcodes that are executed by the virtual machine. Only sequences of
+ * instructions that are stored next to each other in a chunk are counted, because only those can be fused into a
+ * superinstruction. The profiler is only compiled into the virtual machine if PROFILE_OPCODES is defined, which is also
+ * supported by release builds.
+ */
+
+#ifndef CELLOX_OPCODE_PROFILER_H_
+#define CELLOX_OPCODE_PROFILER_H_
+
+#include <stdio.h>
+
+#include "../byte-code/chunk.h"
+#include "../common.h"
+
+/// The maximum length of the n-grams that are counted by the opcode profiler
+#define OPCODE_PROFILER_MAX_LENGTH  (4u)
+
+/// The amount of n-grams that are printed for every length
+#define OPCODE_PROFILER_PRINT_COUNT (16u)
+
+/// @brief Deallocates the memory used by the opcode profiler and resets all the counters
+void opcode_profiler_free();
+
+/// @brief Prints the most frequently executed n-grams
+/// @param file The file where the profile is printed
+void opcode_profiler_print(FILE * file);
+
+/// @brief Records the execution of a bytecode instruction
+/// @param chunk The chunk the instruction belongs to
+/// @param opCodeIndex The index of the instruction in the chunk
+void opcode_profiler_record(chunk_t const * chunk, uint32_t opCodeIndex);
+
+#endif
@@ -0,0 +1,330 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file parallel_marker.c
+ * @brief File containing the implementation of the parallel marker.
+ */
+
+#include "parallel_marker.h"
+
+#ifdef PARALLEL_MARKER_AVAILABLE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/// The amount of objects the deque of a worker can hold before it has to grow for the first time
+#define PARALLEL_MARKER_DEQUE_INITIAL (256)
+
+/// @brief Circular buffer that contains the objects of a deque
+typedef struct parallel_marker_buffer_t {
+    /// The amount of objects the buffer can hold (always a power of two)
+    int64_t capacity;
+    /// The buffer that was replaced by this buffer - it is freed after the tracing, because it can still be read by a
+    /// worker that steals an object
+    struct parallel_marker_buffer_t * previous;
+    /// The objects in the buffer
+    object_t * objects[];
+} parallel_marker_buffer_t;
+
+/// @brief A worker of the parallel marker
+/// @details The worker is aligned to a cache line, so the workers don't slow each other down by accessing the same line
+struct parallel_marker_worker_t {
+    /// The index of the next object that is stolen from the deque
+    int64_t top;
+    /// The index after the last object in the deque - only changed by the worker that owns the deque
+    int64_t bottom;
+    /// The buffer that contains the objects of the deque
+    parallel_marker_buffer_t * buffer;
+    /// The thread of the worker (unused by the thread of the virtual machine)
+    pthread_t thread;
+} __attribute__((aligned(64)));
+
+__thread parallel_marker_worker_t * parallelMarkerWorker = NULL;
+
+/// The workers of the parallel marker - the first worker is the thread of the virtual machine
+static parallel_marker_worker_t workers[PARALLEL_MARKER_MAX_WORKERS];
+/// The amount of workers (including the thread of the virtual machine)
+static uint32_t workerCount = 0u;
+/// The amount of threads that have been started
+static uint32_t startedThreads = 0u;
+/// The amount of workers that haven't found any gray objects
+static uint32_t idleWorkers = 0u;
+/// The amount of worker threads that have finished tracing the references
+static uint32_t finishedWorkers = 0u;
+/// Incremented whenever the worker threads shall start tracing the references
+static uint64_t traceGeneration = 0u;
+/// Determines whether the worker threads shall be terminated
+static bool terminating = false;
+/// The function that marks the references of a gray object
+static void (*blackenObject)(object_t *) = NULL;
+/// Guards the generation, the amount of finished workers and the termination of the worker threads
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+/// Signals that the worker threads shall start tracing the references or terminate
+static pthread_cond_t startCondition = PTHREAD_COND_INITIALIZER;
+/// Signals that all the worker threads have finished tracing the references
+static pthread_cond_t finishedCondition = PTHREAD_COND_INITIALIZER;
+
+static bool parallel_marker_has_work();
+static void parallel_marker_free_retired_buffers();
+static parallel_marker_buffer_t * parallel_marker_grow(parallel_marker_worker_t *, parallel_marker_buffer_t *,
+                                                       int64_t, int64_t);
+static parallel_marker_buffer_t * parallel_marker_new_buffer(int64_t);
+static object_t * parallel_marker_pop(parallel_marker_worker_t *);
+static void * parallel_marker_run_thread(void *);
+static bool parallel_marker_start_threads(uint32_t);
+static object_t * parallel_marker_steal(parallel_marker_worker_t *);
+static void parallel_marker_trace_worker(parallel_marker_worker_t *);
+
+void parallel_marker_free() {
+    pthread_mutex_lock(&mutex);
+    terminating = true;
+    pthread_cond_broadcast(&startCondition);
+    pthread_mutex_unlock(&mutex);
+    for (uint32_t i = 1u; i < startedThreads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    parallel_marker_free_retired_buffers();
+    for (uint32_t i = 0u; i < workerCount; i++) {
+        free(workers[i].buffer);
+        workers[i].buffer = NULL;
+        workers[i].top = workers[i].bottom = 0;
+    }
+    workerCount = startedThreads = 0u;
+    terminating = false;
+}
+
+void parallel_marker_push(object_t * object) {
+    parallel_marker_worker_t * worker = parallelMarkerWorker;
+    int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+    parallel_marker_buffer_t * buffer = __atomic_load_n(&worker->buffer, __ATOMIC_RELAXED);
+    if (bottom - top > buffer->capacity - 1) {
+        buffer = parallel_marker_grow(worker, buffer, top, bottom);
+    }
+    __atomic_store_n(&buffer->objects[bottom & (buffer->capacity - 1)], object, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+}
+
+bool parallel_marker_trace(object_t * const * grayObjects, uint32_t grayCount, void (*blacken)(object_t *),
+                           uint32_t threadCount) {
+    if (!workerCount && !parallel_marker_start_threads(threadCount)) {
+        return false;
+    }
+    blackenObject = blacken;
+    // The gray objects are distributed evenly, the worker threads are waiting, so the deques can be filled directly
+    for (uint32_t i = 0u; i < grayCount; i++) {
+        parallelMarkerWorker = workers + i % workerCount;
+        parallel_marker_push(grayObjects[i]);
+    }
+    pthread_mutex_lock(&mutex);
+    idleWorkers = finishedWorkers = 0u;
+    traceGeneration++;
+    pthread_cond_broadcast(&startCondition);
+    pthread_mutex_unlock(&mutex);
+    parallel_marker_trace_worker(workers);
+    pthread_mutex_lock(&mutex);
+    while (finishedWorkers < workerCount - 1u) {
+        pthread_cond_wait(&finishedCondition, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+    parallel_marker_free_retired_buffers();
+    return true;
+}
+
+/// @brief Determines whether any worker has objects in its deque
+/// @return true if a deque contains objects, false if not
+static bool parallel_marker_has_work() {
+    for (uint32_t i = 0u; i < workerCount; i++) {
+        int64_t top = __atomic_load_n(&workers[i].top, __ATOMIC_ACQUIRE);
+        if (top < __atomic_load_n(&workers[i].bottom, __ATOMIC_ACQUIRE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief Deallocates the buffers that have been replaced by bigger buffers
+static void parallel_marker_free_retired_buffers() {
+    for (uint32_t i = 0u; i < workerCount; i++) {
+        parallel_marker_buffer_t * retired = workers[i].buffer->previous;
+        workers[i].buffer->previous = NULL;
+        while (retired) {
+            parallel_marker_buffer_t * previous = retired->previous;
+            free(retired);
+            retired = previous;
+        }
+    }
+}
+
+/// @brief Doubles the capacity of the deque of a worker
+/// @param worker The worker that owns the deque
+/// @param buffer The current buffer of the deque
+/// @param top The index of the first object in the deque
+/// @param bottom The index after the last object in the deque
+/// @return The new buffer of the deque
+static parallel_marker_buffer_t * parallel_marker_grow(parallel_marker_worker_t * worker,
+                                                       parallel_marker_buffer_t * buffer, int64_t top, int64_t bottom) {
+    parallel_marker_buffer_t * grownBuffer = parallel_marker_new_buffer(buffer->capacity * 2);
+    for (int64_t i = top; i < bottom; i++) {
+        grownBuffer->objects[i & (grownBuffer->capacity - 1)] = buffer->objects[i & (buffer->capacity - 1)];
+    }
+    grownBuffer->previous = buffer;
+    __atomic_store_n(&worker->buffer, grownBuffer, __ATOMIC_RELEASE);
+    return grownBuffer;
+}
+
+/// @brief Allocates a new buffer for a deque
+/// @param capacity The amount of objects the buffer can hold (a power of two)
+/// @return The buffer that was allocated
+static parallel_marker_buffer_t * parallel_marker_new_buffer(int64_t capacity) {
+    parallel_marker_buffer_t * buffer = malloc(sizeof(parallel_marker_buffer_t) + sizeof(object_t *) * capacity);
+    if (!buffer) {
+        exit(EXIT_CODE_SYSTEM_ERROR);
+    }
+    buffer->capacity = capacity;
+    buffer->previous = NULL;
+    return buffer;
+}
+
+/// @brief Pops the last object from the deque of a worker
+/// @param worker The worker that owns the deque
+/// @return The object that was popped or NULL if the deque is empty
+static object_t * parallel_marker_pop(parallel_marker_worker_t * worker) {
+    int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED) - 1;
+    parallel_marker_buffer_t * buffer = __atomic_load_n(&worker->buffer, __ATOMIC_RELAXED);
+    __atomic_store_n(&worker->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&worker->top, __ATOMIC_RELAXED);
+    if (top > bottom) {
+        // The deque is empty
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    object_t * object = __atomic_load_n(&buffer->objects[bottom & (buffer->capacity - 1)], __ATOMIC_RELAXED);
+    if (top == bottom) {
+        // The last object in the deque - another worker might try to steal it at the same time
+        if (!__atomic_compare_exchange_n(&worker->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            object = NULL;
+        }
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return object;
+}
+
+/// @brief Waits until the worker thread shall trace the references and traces them
+/// @param argument The worker of the thread
+/// @return Always NULL
+static void * parallel_marker_run_thread(void * argument) {
+    parallel_marker_worker_t * worker = (parallel_marker_worker_t *)argument;
+    uint64_t generation = 0u;
+    for (;;) {
+        pthread_mutex_lock(&mutex);
+        while (traceGeneration == generation && !terminating) {
+            pthread_cond_wait(&startCondition, &mutex);
+        }
+        if (terminating) {
+            pthread_mutex_unlock(&mutex);
+            return NULL;
+        }
+        generation = traceGeneration;
+        pthread_mutex_unlock(&mutex);
+        parallel_marker_trace_worker(worker);
+        pthread_mutex_lock(&mutex);
+        if (++finishedWorkers == workerCount - 1u) {
+            pthread_cond_signal(&finishedCondition);
+        }
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+/// @brief Creates the deques of the workers and starts the worker threads
+/// @param threadCount The amount of threads that trace the references (zero for the amount of processors)
+/// @return true if more than a single worker is available, false if not
+static bool parallel_marker_start_threads(uint32_t threadCount) {
+    if (!threadCount) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = processors > 0 ? (uint32_t)processors : 1u;
+    }
+    threadCount = threadCount > PARALLEL_MARKER_MAX_WORKERS ? PARALLEL_MARKER_MAX_WORKERS : threadCount;
+    if (threadCount < 2u) {
+        return false;
+    }
+    for (uint32_t i = 0u; i < threadCount; i++) {
+        workers[i].buffer = parallel_marker_new_buffer(PARALLEL_MARKER_DEQUE_INITIAL);
+        workers[i].top = workers[i].bottom = 0;
+    }
+    workerCount = threadCount;
+    // The thread of the virtual machine is the first worker
+    for (startedThreads = 1u; startedThreads < threadCount; startedThreads++) {
+        if (pthread_create(&workers[startedThreads].thread, NULL, parallel_marker_run_thread,
+                           workers + startedThreads)) {
+            break;
+        }
+    }
+    // The workers whose threads couldn't be started are not used
+    workerCount = startedThreads;
+    return workerCount > 1u;
+}
+
+/// @brief Steals the first object from the deque of another worker
+/// @param thief The worker that steals the object
+/// @return The object that was stolen or NULL if no object could be stolen
+static object_t * parallel_marker_steal(parallel_marker_worker_t * thief) {
+    uint32_t start = (uint32_t)(thief - workers);
+    for (uint32_t i = 1u; i < workerCount; i++) {
+        parallel_marker_worker_t * victim = workers + (start + i) % workerCount;
+        int64_t top = __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        int64_t bottom = __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE);
+        if (top >= bottom) {
+            continue;
+        }
+        parallel_marker_buffer_t * buffer = __atomic_load_n(&victim->buffer, __ATOMIC_ACQUIRE);
+        object_t * object = __atomic_load_n(&buffer->objects[top & (buffer->capacity - 1)], __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&victim->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            return object;
+        }
+    }
+    return NULL;
+}
+
+/// @brief Traces the references on a worker until no gray objects are left on any worker
+/// @param worker The worker of the current thread
+static void parallel_marker_trace_worker(parallel_marker_worker_t * worker) {
+    parallelMarkerWorker = worker;
+    for (;;) {
+        object_t * object;
+        while ((object = parallel_marker_pop(worker)) || (object = parallel_marker_steal(worker))) {
+            blackenObject(object);
+        }
+        // The tracing has ended, once all the workers are idle at the same time - only busy workers create gray
+        // objects
+        __atomic_add_fetch(&idleWorkers, 1u, __ATOMIC_SEQ_CST);
+        while (!parallel_marker_has_work()) {
+            if (__atomic_load_n(&idleWorkers, __ATOMIC_SEQ_CST) == workerCount) {
+                parallelMarkerWorker = NULL;
+                return;
+            }
+            sched_yield();
+        }
+        __atomic_sub_fetch(&idleWorkers, 1u, __ATOMIC_SEQ_CST);
+    }
+}
+
+#endif
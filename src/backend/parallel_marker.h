@@ -0,0 +1,74 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file parallel_marker.h
+ * @brief Header file containing the declarations of the parallel marker.
+ * @details The parallel marker traces the references of the gray objects on a pool of worker threads, while the
+ * program is stopped. Every worker owns a deque of gray objects (Chase-Lev) - it pushes and pops the objects it marks
+ * at the bottom, while the other workers steal objects from the top once their own deque is empty. The mark bits are
+ * set atomically, so every object is blackened exactly once.
+ */
+
+#ifndef CELLOX_PARALLEL_MARKER_H_
+#define CELLOX_PARALLEL_MARKER_H_
+
+#include "../common.h"
+#include "../language-models/object.h"
+
+// The worker threads rely on POSIX threads, thread local storage and the atomic builtins of GCC and Clang
+#if defined(OS_UNIX_LIKE) && defined(POSIX_THREADS_AVAILABLE) && (defined(COMPILER_GCC) || defined(COMPILER_CLANG))
+#define PARALLEL_MARKER_AVAILABLE
+#endif
+
+#ifdef PARALLEL_MARKER_AVAILABLE
+
+/// The maximum amount of threads that trace references in parallel (including the thread of the virtual machine)
+#define PARALLEL_MARKER_MAX_WORKERS (16u)
+
+/// @brief A worker of the parallel marker
+typedef struct parallel_marker_worker_t parallel_marker_worker_t;
+
+/// The worker of the current thread - NULL if the thread doesn't trace references in parallel at the moment
+extern __thread parallel_marker_worker_t * parallelMarkerWorker;
+
+/// @brief Deallocates the deques of the workers and terminates the worker threads
+void parallel_marker_free();
+
+/// @brief Pushes an object on the deque of the worker of the current thread
+/// @param object The object that is pushed
+void parallel_marker_push(object_t * object);
+
+/// @brief Traces the references of the gray objects in parallel until no gray objects are left
+/// @param grayObjects The gray objects where the tracing begins
+/// @param grayCount The amount of gray objects
+/// @param blacken The function that marks the references of a gray object
+/// @param threadCount The amount of threads that trace the references (zero for the amount of processors)
+/// @return true if the references were traced, false if only a single thread is available
+bool parallel_marker_trace(object_t * const * grayObjects, uint32_t grayCount, void (*blacken)(object_t *),
+                           uint32_t threadCount);
+
+/// @brief Marks an object on a worker thread
+/// @param object The object that is marked
+/// @details The mark bit is set atomically, because the object can be marked by another worker at the same time
+static inline void parallel_marker_mark_object(object_t * object) {
+    if (!__atomic_exchange_n(&object->isMarked, true, __ATOMIC_RELAXED)) {
+        parallel_marker_push(object);
+    }
+}
+
+#endif
+
+#endif
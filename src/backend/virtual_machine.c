@@ -30,20 +30,104 @@
 
 #include "../common.h"
 #include "../frontend/compiler.h"
+#include "garbage_collector.h"
+#include "jit_compiler.h"
 #include "memory_mutator.h"
 #include "native_functions.h"
 #if defined(DEBUG_TRACE_EXECUTION)
 #include "../byte-code/chunk_disassembler.h"
 #endif
+#if defined(PROFILE_GARBAGE_COLLECTOR)
+#include "object_allocator.h"
+#endif
+#if defined(PROFILE_OPCODES)
+#include "opcode_profiler.h"
+#endif
 #include "../language-models/value.h"
 
+// The switch based dispatch is always compiled into the virtual machine as a fallback. The other dispatch techniques
+// are only compiled in if they have been selected at configuration time and are supported by the compiler.
+#if (defined(DISPATCH_COMPUTED_GOTO) || defined(DISPATCH_ALL_TECHNIQUES)) &&                                          \
+    (defined(COMPILER_GCC) || defined(COMPILER_CLANG))
+#define VIRTUAL_MACHINE_COMPUTED_GOTO_AVAILABLE
+#endif
+#if (defined(DISPATCH_TAIL_CALL) || defined(DISPATCH_ALL_TECHNIQUES)) && defined(MUSTTAIL_SUPPORTED)
+#define VIRTUAL_MACHINE_TAIL_CALL_AVAILABLE
+#endif
+#if (defined(DISPATCH_DIRECT_THREADED) || defined(DISPATCH_ALL_TECHNIQUES)) &&                                        \
+    (defined(COMPILER_GCC) || defined(COMPILER_CLANG))
+#define VIRTUAL_MACHINE_DIRECT_THREADED_AVAILABLE
+#endif
+// The just in time compiler is opt-in at runtime, so it is compiled in whenever the platform is supported
+#ifdef JIT_COMPILER_AVAILABLE
+#define VIRTUAL_MACHINE_JIT_AVAILABLE
+#endif
+
+#if defined(COMPILER_GCC) || defined(COMPILER_CLANG)
+/// Makro that marks a function that is rarely executed (e.g. reports a runtime error) - the function is never inlined
+/// and placed apart from the hot code, the branches that lead to it are treated as unlikely
+#define COLD __attribute__((cold, noinline))
+#elif defined(COMPILER_MSVC)
+#define COLD __declspec(noinline)
+#else
+#define COLD
+#endif
+
 /// Global VirtualMachine variable
 virtual_machine_t virtualMachine;
 
+/// The technique that is currently used to dispatch the bytecode instructions
+/// @details Not stored in the virtual machine, because the virtual machine is reinitialized for every program
+#if defined(DISPATCH_JIT) && defined(VIRTUAL_MACHINE_JIT_AVAILABLE)
+static dispatch_technique dispatchTechnique = DISPATCH_TECHNIQUE_JIT;
+#elif defined(DISPATCH_TAIL_CALL) && defined(VIRTUAL_MACHINE_TAIL_CALL_AVAILABLE)
+static dispatch_technique dispatchTechnique = DISPATCH_TECHNIQUE_TAIL_CALL;
+#elif defined(DISPATCH_DIRECT_THREADED) && defined(VIRTUAL_MACHINE_DIRECT_THREADED_AVAILABLE)
+static dispatch_technique dispatchTechnique = DISPATCH_TECHNIQUE_DIRECT_THREADED;
+#elif defined(VIRTUAL_MACHINE_COMPUTED_GOTO_AVAILABLE)
+static dispatch_technique dispatchTechnique = DISPATCH_TECHNIQUE_COMPUTED_GOTO;
+#else
+static dispatch_technique dispatchTechnique = DISPATCH_TECHNIQUE_SWITCH;
+#endif
+
+/// @brief Amount of values that are reserved on the stack for every call frame on top of the maximum stack depth of
+/// the function
+/// @details Covers the values the virtual machine pushes while it executes a single instruction (e.g. the operands of
+/// a register instruction that is executed by the generic instruction or a string that is interned)
+#define VIRTUAL_MACHINE_TEMPORARY_STACK_SIZE (8u)
+
+#ifdef VIRTUAL_MACHINE_TAIL_CALL_AVAILABLE
+/// Function that executes a single bytecode instruction and dispatches the next one
+typedef interpret_result (*virtual_machine_instruction_handler_t)(call_frame_t *);
+#endif
+
+#ifdef VIRTUAL_MACHINE_DIRECT_THREADED_AVAILABLE
+/// The addresses of the labels that are used to translate chunks into threaded code - set by the direct threaded run
+/// loop, because the labels are only accessible in there
+static void * const * directThreadedHandlers = NULL;
+#endif
+
+#ifdef VIRTUAL_MACHINE_JIT_AVAILABLE
+/// Amount of calls and loop iterations after which a function is compiled into machine code
+#ifdef DEBUG_STRESS_JIT
+#define VIRTUAL_MACHINE_JIT_THRESHOLD (0u)
+#else
+#define VIRTUAL_MACHINE_JIT_THRESHOLD (1000u)
+#endif
+
+/// Function that executes a single bytecode instruction for the just in time compiler
+typedef uint32_t (*virtual_machine_jit_handler_t)(call_frame_t *);
+#endif
+
+static inline bool virtual_machine_add();
 static void virtual_machine_array_literal(int32_t);
+static inline object_bound_method_t * virtual_machine_bind(object_instance_t *, object_closure_t *);
 static bool virtual_machine_bind_method(object_class_t *, object_string_t *);
+static inline void virtual_machine_cache_write_barrier(object_t *);
 static bool virtual_machine_call(object_closure_t *, int32_t);
-static bool virtual_machine_call_value(value_t, int32_t);
+static bool virtual_machine_call_intrinsic(uint8_t, int32_t);
+static inline bool virtual_machine_call_native(native_function_t, int32_t);
+static bool virtual_machine_call_value(value_t, int32_t, call_cache_t *, bool);
 static object_upvalue_t * virtual_machine_capture_upvalue(value_t *);
 static void virtual_machine_close_upvalues(value_t *);
 static void virtual_machine_concatenate_arrays();
@@ -51,39 +135,114 @@ static void virtual_machine_concatenate_strings();
 static void virtual_machine_define_method(object_string_t *);
 static void virtual_machine_define_native(char const *, native_function_t);
 static void virtual_machine_define_natives();
+static bool virtual_machine_ensure_stack_capacity(value_t *, object_function_t *);
+#ifdef VIRTUAL_MACHINE_DIRECT_THREADED_AVAILABLE
+static void virtual_machine_enter_threaded_code(call_frame_t *);
+#endif
+static bool virtual_machine_execute_wide(call_frame_t *);
 static bool virtual_machine_get_index_of();
+static inline bool virtual_machine_get_property(object_string_t *, inline_cache_t *);
 static bool virtual_machine_get_sclice_of();
-static bool virtual_machine_invoke(object_string_t *, int32_t);
+static void virtual_machine_grow_call_stack();
+static void virtual_machine_grow_stack(uint32_t);
+static inline inline_cache_entry_t * virtual_machine_inline_cache_lookup(inline_cache_t *, object_instance_t *);
+static inline bool virtual_machine_instantiate(object_class_t *, object_closure_t *, int32_t);
+static inline uint32_t virtual_machine_instruction_index(call_frame_t *);
+static bool virtual_machine_invoke(object_string_t *, int32_t, inline_cache_t *, bool);
 static bool virtual_machine_invoke_from_class(object_class_t *, object_string_t *, int32_t);
 static inline bool virtual_machine_is_falsey(value_t);
+#ifdef VIRTUAL_MACHINE_JIT_AVAILABLE
+static uint32_t virtual_machine_jit_execute(uint32_t);
+#endif
 static bool virtual_machine_modulo();
+static COLD void virtual_machine_operand_error(char const *, value_t);
+static COLD void virtual_machine_operand_types_error(char const *, value_t, value_t);
+static COLD void virtual_machine_operands_error(char const *, value_t, value_t);
 static inline value_t virtual_machine_peek(int32_t);
+static inline value_t virtual_machine_register_operand(call_frame_t *, uint8_t);
+static inline void virtual_machine_register_store(call_frame_t *, uint8_t, value_t);
 static inline void virtual_machine_reset_stack();
+static inline bool virtual_machine_resolve_property(object_instance_t *, object_string_t *, inline_cache_t *, value_t *,
+                                                    bool *);
 static interpret_result virtual_machine_run();
-static void virtual_machine_runtime_error(char const *, ...);
+#ifdef VIRTUAL_MACHINE_COMPUTED_GOTO_AVAILABLE
+static interpret_result virtual_machine_run_computed_goto();
+#endif
+#ifdef VIRTUAL_MACHINE_DIRECT_THREADED_AVAILABLE
+static interpret_result virtual_machine_run_direct_threaded();
+#endif
+#ifdef VIRTUAL_MACHINE_JIT_AVAILABLE
+static interpret_result virtual_machine_run_jit();
+#endif
+static interpret_result virtual_machine_run_switch();
+#ifdef VIRTUAL_MACHINE_TAIL_CALL_AVAILABLE
+static interpret_result virtual_machine_run_tail_call();
+#endif
+static COLD void virtual_machine_runtime_error(char const *, ...);
 static bool virtual_machine_set_index_of();
+static inline bool virtual_machine_set_property(object_string_t *, inline_cache_t *);
+static bool virtual_machine_tail_call(object_closure_t *, int32_t);
+#if defined(DEBUG_TRACE_EXECUTION) || defined(PROFILE_OPCODES)
+static void virtual_machine_trace_instruction(call_frame_t *, uint32_t);
+#endif
 
 void virtual_machine_free() {
     value_hash_table_free(&virtualMachine.globals);
+    dynamic_value_array_free(&virtualMachine.globalValues);
     value_hash_table_free(&virtualMachine.strings);
     virtualMachine.initString = NULL;
     if (virtualMachine.program) {
         free(virtualMachine.program);
     }
+#ifdef PROFILE_GARBAGE_COLLECTOR
+    // The fragmentation is reported before the pages are freed
+    object_allocator_print_statistics(stderr);
+#endif
     memory_mutator_free_objects();
+    jit_compiler_free_executable_memory();
+    free(virtualMachine.callStack);
+    free(virtualMachine.stack);
+    free(virtualMachine.openUpvalues);
+    virtualMachine.callStack = NULL;
+    virtualMachine.stack = virtualMachine.stackTop = NULL;
+    virtualMachine.openUpvalues = NULL;
+    virtualMachine.openUpvalueTop = 0u;
+    virtualMachine.frameCapacity = virtualMachine.stackCapacity = 0u;
+#ifdef PROFILE_OPCODES
+    opcode_profiler_print(stderr);
+    opcode_profiler_free();
+#endif
+#ifdef PROFILE_GARBAGE_COLLECTOR
+    garbage_collector_print_profile(stderr);
+    garbage_collector_free_profile();
+#endif
 }
 
 void virtual_machine_init() {
+    // The stacks start small and grow on demand
+    virtualMachine.callStack = NULL;
+    virtualMachine.stack = NULL;
+    virtualMachine.openUpvalues = NULL;
+    virtualMachine.openUpvalueTop = 0u;
+    virtualMachine.frameCapacity = virtualMachine.stackCapacity = 0u;
+    virtual_machine_grow_call_stack();
+    virtual_machine_grow_stack(STACK_INITIAL);
     virtual_machine_reset_stack();
     virtualMachine.program = NULL;
-    virtualMachine.objects = NULL;
-    virtualMachine.bytesAllocated = 0;
-    // Garbage Collection is triggered after 1 MB of data has been allocated
+    virtualMachine.objects = virtualMachine.youngObjects = NULL;
+    virtualMachine.bytesAllocated = virtualMachine.oldGenerationSize = 0;
+    // A major Garbage Collection is triggered after the old generation has grown to 1 MB
     virtualMachine.nextGC = (1 << 20);
+    virtualMachine.nextMinorGC = GC_NURSERY_SIZE;
     virtualMachine.grayCount = virtualMachine.grayCapacity = 0u;
     virtualMachine.grayStack = NULL;
-    // Initializes the hashtable that contains the global variables
+    virtualMachine.gcPhase = GARBAGE_COLLECTOR_PHASE_IDLE;
+    virtualMachine.sweepCursor = NULL;
+    virtualMachine.rememberedCount = virtualMachine.rememberedCapacity = 0u;
+    virtualMachine.rememberedSet = NULL;
+    // Initializes the hashtable that contains the slots of the global variables and the values of the globals
     value_hash_table_init(&virtualMachine.globals);
+    dynamic_value_array_init(&virtualMachine.globalValues);
     // Initializes the hashtable that contains the strings
     value_hash_table_init(&virtualMachine.strings);
     // virtualMachine.stackTop = virtualMachine.stack;
@@ -128,11 +287,22 @@ interpret_result virtual_machine_run_chunk(chunk_t chunk) {
     return virtual_machine_run();
 }
 
-void virtual_machine_push(value_t value) {
-    // There are 16384 values on the stack 🤯
-    if ((virtualMachine.stackTop - virtualMachine.stack) == STACK_MAX) {
-        virtual_machine_runtime_error("Stack overflow!!!");
+uint32_t virtual_machine_global_slot(object_string_t * name) {
+    value_t slot;
+    if (value_hash_table_get(&virtualMachine.globals, name, &slot)) {
+        return (uint32_t)AS_NUMBER(slot);
     }
+    uint32_t index = virtualMachine.globalValues.count;
+    // The name is kept on the stack, because growing the hashtable can trigger a garbage collection
+    virtual_machine_push(OBJECT_VAL(name));
+    value_hash_table_set(&virtualMachine.globals, name, NUMBER_VAL(index));
+    dynamic_value_array_write(&virtualMachine.globalValues, UNDEFINED_VAL);
+    virtual_machine_pop();
+    return index;
+}
+
+void virtual_machine_push(value_t value) {
+    // The values of a call frame are reserved when the function is called, so the stack can't overflow here
     // We add the value to the stack
     *virtualMachine.stackTop = value;
     // The stacktop points at the next empty slot
@@ -146,23 +316,95 @@ value_t virtual_machine_pop() {
     return *virtualMachine.stackTop;
 }
 
+bool virtual_machine_set_dispatch_technique(dispatch_technique technique) {
+    if (!virtual_machine_supports_dispatch_technique(technique)) {
+        return false;
+    }
+    dispatchTechnique = technique;
+    return true;
+}
+
+bool virtual_machine_supports_dispatch_technique(dispatch_technique technique) {
+    switch (technique) {
+    case DISPATCH_TECHNIQUE_SWITCH:
+        return true;
+#ifdef VIRTUAL_MACHINE_COMPUTED_GOTO_AVAILABLE
+    case DISPATCH_TECHNIQUE_COMPUTED_GOTO:
+        return true;
+#endif
+#ifdef VIRTUAL_MACHINE_TAIL_CALL_AVAILABLE
+    case DISPATCH_TECHNIQUE_TAIL_CALL:
+        return true;
+#endif
+#ifdef VIRTUAL_MACHINE_DIRECT_THREADED_AVAILABLE
+    case DISPATCH_TECHNIQUE_DIRECT_THREADED:
+        return true;
+#endif
+#ifdef VIRTUAL_MACHINE_JIT_AVAILABLE
+    case DISPATCH_TECHNIQUE_JIT:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+/// @brief Adds the two upper values on the stack
+/// @details Numbers are added, strings are concatenated and values are appended to arrays
+/// @return A boolean value that indicates whether the execution has led to a runtime error
+static inline bool virtual_machine_add() {
+    if (IS_STRING(virtual_machine_peek(0)) && IS_STRING(virtual_machine_peek(1))) {
+        virtual_machine_concatenate_strings();
+    } else if (IS_NUMBER(virtual_machine_peek(0)) && IS_NUMBER(virtual_machine_peek(1))) {
+        double b = AS_NUMBER(virtual_machine_pop());
+        double a = AS_NUMBER(virtual_machine_pop());
+        virtual_machine_push(NUMBER_VAL(a + b));
+    } else if (IS_ARRAY(virtual_machine_peek(1))) {
+        virtual_machine_concatenate_arrays();
+    } else {
+        virtual_machine_operand_types_error("Operands must be two numbers, two strings, an array and a value or an "
+                                            "array and an array, but they are a %s value and a %s value",
+                                            virtual_machine_peek(0), virtual_machine_peek(1));
+        return false;
+    }
+    return true;
+}
+
 /// @brief Creates an array based on an array literal expression
 /// @param argCount The size of the array
 static void virtual_machine_array_literal(int32_t argCount) {
     object_dynamic_value_array_t * dynamicArray = object_new_dynamic_value_array();
-    value_t val;
+    // The array is kept on the stack, so it is reachable if a garbage collection is triggered while it grows
+    virtual_machine_push(OBJECT_VAL(dynamicArray));
     // The elements are reversed on the stack so we iterate backwards 🔙
-    for (int32_t i = argCount - 1; i >= 0; i--) {
+    for (int32_t i = argCount; i > 0; i--) {
         dynamic_value_array_write(&dynamicArray->array, virtual_machine_peek(i));
+        garbage_collector_write_barrier(&dynamicArray->obj, virtual_machine_peek(i));
     }
-    for (int32_t j = 0; j < argCount; j++) {
+    for (int32_t j = 0; j <= argCount; j++) {
         virtual_machine_pop();
     }
     virtual_machine_push(OBJECT_VAL(dynamicArray));
 }
 
-/// @brief Binds a method to a cellox class
-/// @param celloxClass The class the method is bound to
+/// @brief Binds a method to an instance
+/// @param instance The instance the method is bound to
+/// @param method The closure of the method
+/// @return The bound method
+/// @details The method that was bound to the instance last is reused, so reading the same method of an instance
+/// repeatedly (e.g. to pass it as a callback) allocates a single bound method
+static inline object_bound_method_t * virtual_machine_bind(object_instance_t * instance, object_closure_t * method) {
+    if (instance->boundMethod && instance->boundMethod->method == method) {
+        return instance->boundMethod;
+    }
+    object_bound_method_t * boundMethod = object_new_bound_method(OBJECT_VAL(instance), method);
+    GC_STORE_SLOT(instance->boundMethod, boundMethod);
+    garbage_collector_write_barrier_object(&instance->obj, &boundMethod->obj);
+    return boundMethod;
+}
+
+/// @brief Binds a method of a cellox class to the instance on top of the stack
+/// @param celloxClass The class that contains the method
 /// @param name The name of the method
 /// @return true if the method was defiened, false if not
 static bool virtual_machine_bind_method(object_class_t * celloxClass, object_string_t * name) {
@@ -171,12 +413,20 @@ static bool virtual_machine_bind_method(object_class_t * celloxClass, object_str
         virtual_machine_runtime_error("Undefined property '%s'.", name->chars);
         return false;
     }
-    object_bound_method_t * bound = object_new_bound_method(virtual_machine_peek(0), AS_CLOSURE(method));
-    virtual_machine_pop();
-    virtual_machine_push(OBJECT_VAL(bound));
+    // The receiver of a super expression is always the instance this refers to
+    object_bound_method_t * bound = virtual_machine_bind(AS_INSTANCE(virtual_machine_peek(0)), AS_CLOSURE(method));
+    virtualMachine.stackTop[-1] = OBJECT_VAL(bound);
     return true;
 }
 
+/// @brief Write barrier for the inline caches and the call caches of the function that is currently executed
+/// @param object The object that is referenced by the entry of the cache that was updated
+/// @details The caches are stored in the chunk of the function, so the function refers to the object
+static inline void virtual_machine_cache_write_barrier(object_t * object) {
+    object_function_t * function = virtualMachine.callStack[virtualMachine.frameCount - 1u].closure->function;
+    garbage_collector_write_barrier_object(&function->obj, object);
+}
+
 /// @brief Calls a function that is bound to a closure
 /// @param closure The closure the function belongs to
 /// @param argCount The amount of arguments that are used when the function is envoked
@@ -190,7 +440,14 @@ static bool virtual_machine_call(object_closure_t * closure, int32_t argCount) {
     }
 
     if (virtualMachine.frameCount == FRAMES_MAX) {
-        // The callstack is 64 calls deep 🤯
+        // The callstack is FRAMES_MAX calls deep 🤯
+        virtual_machine_runtime_error("Stack overflow.");
+        return false;
+    }
+    if (virtualMachine.frameCount == virtualMachine.frameCapacity) {
+        virtual_machine_grow_call_stack();
+    }
+    if (!virtual_machine_ensure_stack_capacity(virtualMachine.stackTop - argCount - 1, closure->function)) {
         virtual_machine_runtime_error("Stack overflow.");
         return false;
     }
@@ -199,115 +456,190 @@ static bool virtual_machine_call(object_closure_t * closure, int32_t argCount) {
     frame->closure = closure;
     frame->ip = closure->function->chunk.code;
     frame->slots = virtualMachine.stackTop - argCount - 1;
+#ifdef VIRTUAL_MACHINE_DIRECT_THREADED_AVAILABLE
+    if (dispatchTechnique == DISPATCH_TECHNIQUE_DIRECT_THREADED) {
+        virtual_machine_enter_threaded_code(frame);
+    }
+#endif
+#ifdef VIRTUAL_MACHINE_JIT_AVAILABLE
+    if (dispatchTechnique == DISPATCH_TECHNIQUE_JIT) {
+        closure->function->hotness++;
+    }
+#endif
+    return true;
+}
+
+/// @brief Calls a well-known native function by an intrinsic instruction
+/// @param native The index of the native function
+/// @param argCount The amount of arguments for the native function call
+/// @return true if everything went well, false if not
+/// @details The native functions are defined before any other global variable, so the index of a native function is
+/// also the slot of its global variable. If the global variable doesn't hold the native function anymore, the value of
+/// the global variable is called instead
+static bool virtual_machine_call_intrinsic(uint8_t native, int32_t argCount) {
+    value_t callee = virtualMachine.globalValues.values[native];
+    native_function_config_t * config = native_functions_get_function_configs() + native;
+    value_t result;
+    if (IS_NATIVE(callee) && AS_NATIVE(callee) == config->function && (size_t)argCount == config->arrity &&
+        native_functions_call_intrinsic(native, virtualMachine.stackTop - argCount, &result)) {
+        virtualMachine.stackTop -= argCount;
+        virtual_machine_push(result);
+        return true;
+    }
+    // The callee is inserted below the arguments, like it would have been by OP_GET_GLOBAL
+    value_t * arguments = virtualMachine.stackTop - argCount;
+    memmove(arguments + 1, arguments, sizeof(value_t) * (size_t)argCount);
+    *arguments = callee;
+    virtualMachine.stackTop++;
+    return virtual_machine_call_value(callee, argCount, NULL, false);
+}
+
+/// @brief Calls a native function
+/// @param native The native function that is called
+/// @param argCount The amount of arguments for the native function call
+/// @return true - calling a native function can't fail
+static inline bool virtual_machine_call_native(native_function_t native, int32_t argCount) {
+    value_t result = native(argCount, virtualMachine.stackTop - argCount);
+    virtualMachine.stackTop -= argCount + 1;
+    virtual_machine_push(result);
     return true;
 }
 
 /// @brief Handles calls for anything that is not a function / closure
 /// @param callee The value that is called
 /// @param argCount The amount of arguments for the value call
+/// @param cache The call cache of the call site or NULL if the call site has no call cache
+/// @param tailCall Boolean value that determines whether a called closure reuses the call frame of the current function
 /// @return true if everything went well, false if not
-static bool virtual_machine_call_value(value_t callee, int32_t argCount) {
+/// @details Natives and initializers never reuse the call frame, their result is returned by the following OP_RETURN
+static bool virtual_machine_call_value(value_t callee, int32_t argCount, call_cache_t * cache, bool tailCall) {
     if (IS_OBJECT(callee)) {
+        // A call site that calls the same callee as the last time skips the type switch and the lookup of the
+        // initializer
+        if (cache && cache->callee == AS_OBJECT(callee)) {
+            switch (cache->kind) {
+            case CALL_CACHE_CLASS:
+                if (cache->classVersion == AS_CLASS(callee)->version) {
+                    return virtual_machine_instantiate(AS_CLASS(callee), (object_closure_t *)cache->initializer,
+                                                       argCount);
+                }
+                break;
+            case CALL_CACHE_CLOSURE:
+                return tailCall ? virtual_machine_tail_call(AS_CLOSURE(callee), argCount)
+                                : virtual_machine_call(AS_CLOSURE(callee), argCount);
+            case CALL_CACHE_NATIVE:
+                return virtual_machine_call_native(AS_NATIVE(callee), argCount);
+            default:
+                break;
+            }
+        }
         switch (OBJECT_TYPE(callee)) {
         case OBJECT_BOUND_METHOD:
             {
+                // Bound methods are not cached, because they are only reused as long as the method is bound to the same
+                // instance
                 object_bound_method_t * bound = AS_BOUND_METHOD(callee);
                 virtualMachine.stackTop[-argCount - 1] = bound->receiver;
-                return virtual_machine_call(bound->method, argCount);
+                return tailCall ? virtual_machine_tail_call(bound->method, argCount)
+                                : virtual_machine_call(bound->method, argCount);
             }
         case OBJECT_CLASS:
             {
                 object_class_t * celloxClass = AS_CLASS(callee);
-                virtualMachine.stackTop[-argCount - 1] = OBJECT_VAL(object_new_instance(celloxClass));
                 value_t initializer;
+                object_closure_t * initializerClosure = NULL;
                 if (value_hash_table_get(&celloxClass->methods, virtualMachine.initString, &initializer)) {
-                    return virtual_machine_call(AS_CLOSURE(initializer), argCount);
-                } else if (argCount != 0) {
-                    virtual_machine_runtime_error("Expected 0 arguments but got %d.", argCount);
-                    return false;
+                    initializerClosure = AS_CLOSURE(initializer);
                 }
-                return true;
+                if (cache) {
+                    call_cache_update(cache, AS_OBJECT(callee), CALL_CACHE_CLASS, (object_t *)initializerClosure);
+                    virtual_machine_cache_write_barrier(AS_OBJECT(callee));
+                }
+                return virtual_machine_instantiate(celloxClass, initializerClosure, argCount);
             }
         case OBJECT_CLOSURE:
-            return virtual_machine_call(AS_CLOSURE(callee), argCount);
+            if (cache) {
+                call_cache_update(cache, AS_OBJECT(callee), CALL_CACHE_CLOSURE, NULL);
+                virtual_machine_cache_write_barrier(AS_OBJECT(callee));
+            }
+            return tailCall ? virtual_machine_tail_call(AS_CLOSURE(callee), argCount)
+                            : virtual_machine_call(AS_CLOSURE(callee), argCount);
         case OBJECT_NATIVE:
-            {
-                native_function_t native = AS_NATIVE(callee);
-                value_t result = native(argCount, virtualMachine.stackTop - argCount);
-                virtualMachine.stackTop -= argCount + 1;
-                virtual_machine_push(result);
-                return true;
+            if (cache) {
+                call_cache_update(cache, AS_OBJECT(callee), CALL_CACHE_NATIVE, NULL);
+                virtual_machine_cache_write_barrier(AS_OBJECT(callee));
             }
+            return virtual_machine_call_native(AS_NATIVE(callee), argCount);
         default:
-            virtual_machine_runtime_error(
-                "Can only call functions and classes, but call expression was performed with a %s object",
-                value_stringify_type(callee));
-            return false;
+            break;
         }
     }
     // Non-callable object type.
-    virtual_machine_runtime_error(
-        "Can only call functions and classes, but call expression was performed with a %s value",
-        value_stringify_type(callee));
+    virtual_machine_operand_error("Can only call functions and classes, but call expression was performed with a %s %s",
+                                  callee);
     return false;
 }
 
 /// @brief Captures an upvalue of the enclosing environment
 /// @param local The slot of the local variable that is captured
 /// @return The created upvalue
+/// @details The open upvalues are indexed by their slot, so an upvalue that captures the slot already is found at once
 static object_upvalue_t * virtual_machine_capture_upvalue(value_t * local) {
-    object_upvalue_t * prevUpvalue = NULL;
-    object_upvalue_t * upvalue = virtualMachine.openUpvalues;
-    while (upvalue && upvalue->location > local) {
-        prevUpvalue = upvalue;
-        upvalue = upvalue->next;
-    }
-
-    if (upvalue && upvalue->location == local) {
-        return upvalue;
+    uint32_t slot = (uint32_t)(local - virtualMachine.stack);
+    if (virtualMachine.openUpvalues[slot]) {
+        return virtualMachine.openUpvalues[slot];
     }
     object_upvalue_t * createdUpvalue = object_new_upvalue(local);
-    createdUpvalue->next = upvalue;
-    if (!prevUpvalue) {
-        virtualMachine.openUpvalues = createdUpvalue;
-    } else {
-        prevUpvalue->next = createdUpvalue;
+    virtualMachine.openUpvalues[slot] = createdUpvalue;
+    if (slot >= virtualMachine.openUpvalueTop) {
+        virtualMachine.openUpvalueTop = slot + 1u;
     }
     return createdUpvalue;
 }
 
 /** @brief Function takes a slot of the stack as a parameter.
  * @details Then it closes all upvalues it can find in that slot and the slots above that slot in the stack.
- * A upvalue is closed by copying the objects value into the closed field in te ObjectValue.
+ * A upvalue is closed by copying the objects value into the closed field in te ObjectValue. Only the slots below the
+ * top of the open upvalues are visited, so nothing is visited if no upvalue is open above the slot.
  */
 static void virtual_machine_close_upvalues(value_t * last) {
-    while (virtualMachine.openUpvalues && virtualMachine.openUpvalues->location >= last) {
-        object_upvalue_t * upvalue = virtualMachine.openUpvalues;
-        upvalue->closed = *upvalue->location;
-        upvalue->location = &upvalue->closed;
-        virtualMachine.openUpvalues = upvalue->next;
+    uint32_t lastSlot = (uint32_t)(last - virtualMachine.stack);
+    while (virtualMachine.openUpvalueTop > lastSlot) {
+        object_upvalue_t ** slot = &virtualMachine.openUpvalues[--virtualMachine.openUpvalueTop];
+        if (*slot) {
+            GC_STORE_SLOT((*slot)->closed, *(*slot)->location);
+            (*slot)->location = &(*slot)->closed;
+            garbage_collector_write_barrier(&(*slot)->obj, (*slot)->closed);
+            *slot = NULL;
+        }
     }
 }
 
 /// @brief Concatenates the two upper values (cellox arrays) on the stack
 static void virtual_machine_concatenate_arrays() {
     object_dynamic_value_array_t * newArray = object_new_dynamic_value_array();
-    for (uint32_t i = 0; i < AS_ARRAY(virtual_machine_peek(1))->array.count; i++) {
-        dynamic_value_array_write(&newArray->array, AS_ARRAY(virtual_machine_peek(1))->array.values[i]);
+    // The new array is kept on the stack above the operands, so it is reachable while it grows
+    virtual_machine_push(OBJECT_VAL(newArray));
+    for (uint32_t i = 0; i < AS_ARRAY(virtual_machine_peek(2))->array.count; i++) {
+        dynamic_value_array_write(&newArray->array, AS_ARRAY(virtual_machine_peek(2))->array.values[i]);
+        garbage_collector_write_barrier(&newArray->obj, AS_ARRAY(virtual_machine_peek(2))->array.values[i]);
     }
 
-    if (IS_ARRAY(virtual_machine_peek(0))) {
-        object_dynamic_value_array_t * array = AS_ARRAY(virtual_machine_peek(0));
+    if (IS_ARRAY(virtual_machine_peek(1))) {
+        object_dynamic_value_array_t * array = AS_ARRAY(virtual_machine_peek(1));
         // Adding the same array twice results in an infinite loop
         uint32_t upperBound = array->array.count;
         for (uint32_t i = 0; i < upperBound; i++) {
             dynamic_value_array_write(&newArray->array, array->array.values[i]);
+            garbage_collector_write_barrier(&newArray->obj, array->array.values[i]);
         }
     } else {
-        dynamic_value_array_write(&newArray->array, virtual_machine_peek(0));
+        dynamic_value_array_write(&newArray->array, virtual_machine_peek(1));
+        garbage_collector_write_barrier(&newArray->obj, virtual_machine_peek(1));
     }
     virtual_machine_pop();
     virtual_machine_pop();
+    virtual_machine_pop();
     virtual_machine_push(OBJECT_VAL(newArray));
 }
 
@@ -332,6 +664,9 @@ static void virtual_machine_define_method(object_string_t * name) {
     value_t method = virtual_machine_peek(0);
     object_class_t * celloxClass = AS_CLASS(virtual_machine_peek(1));
     value_hash_table_set(&celloxClass->methods, name, method);
+    garbage_collector_write_barrier(&celloxClass->obj, method);
+    // The inline caches that store the class are invalidated
+    celloxClass->version++;
     virtual_machine_pop();
 }
 
@@ -341,13 +676,15 @@ static void virtual_machine_define_method(object_string_t * name) {
 static void virtual_machine_define_native(char const * name, native_function_t function) {
     virtual_machine_push(OBJECT_VAL(object_copy_string(name, (int32_t)strlen(name), false)));
     virtual_machine_push(OBJECT_VAL(object_new_native(function)));
-    value_hash_table_set(&virtualMachine.globals, AS_STRING(virtualMachine.stack[0]), virtualMachine.stack[1]);
+    uint32_t slot = virtual_machine_global_slot(AS_STRING(virtualMachine.stack[0]));
+    virtualMachine.globalValues.values[slot] = virtualMachine.stack[1];
     virtual_machine_pop();
     virtual_machine_pop();
 }
 
 /// @brief Defines the native functions of the virtual machine
-/// @details These are functions that are implemented in C
+/// @details These are functions that are implemented in C. The natives are defined before any other global variable,
+/// so the slot of a native function is its index in the configurations - OP_CALL_INTRINSIC relies on that
 static void virtual_machine_define_natives() {
     // Pointer to the first configuration
     native_function_config_t * configs = native_functions_get_function_configs();
@@ -359,6 +696,44 @@ static void virtual_machine_define_natives() {
     }
 }
 
+/// @brief Makes sure that the stack can hold the values of a call frame
+/// @param slots The first slot of the call frame
+/// @param function The function that is executed in the call frame
+/// @return true if the stack can hold the values, false if the stack would exceed STACK_MAX values
+/// @details The stack grows if the values that are reserved for the call frame exceed its capacity. The callee, the
+/// arguments and the maximum stack depth of the function are reserved, so the values can be pushed without a check
+static bool virtual_machine_ensure_stack_capacity(value_t * slots, object_function_t * function) {
+    uint32_t required = (uint32_t)(slots - virtualMachine.stack) + 1u + (uint32_t)function->arity +
+                        function->chunk.maxStackDepth + VIRTUAL_MACHINE_TEMPORARY_STACK_SIZE;
+    if (required <= virtualMachine.stackCapacity) {
+        return true;
+    }
+    if (required > STACK_MAX) {
+        return false;
+    }
+    uint32_t capacity = GROW_CAPACITY(virtualMachine.stackCapacity);
+    virtual_machine_grow_stack(capacity < required ? required : capacity > STACK_MAX ? STACK_MAX : capacity);
+    return true;
+}
+
+#ifdef VIRTUAL_MACHINE_DIRECT_THREADED_AVAILABLE
+/// @brief Lets a call frame execute the threaded code of its function
+/// @param frame The call frame that is entered
+/// @details The chunk of the function is translated into threaded code the first time the function is called, so only
+/// chunks that are actually executed are translated
+static void virtual_machine_enter_threaded_code(call_frame_t * frame) {
+    // The handlers are not known until the direct threaded run loop is entered for the first time
+    if (!directThreadedHandlers) {
+        return;
+    }
+    object_function_t * function = frame->closure->function;
+    if (!function->threadedCode.cells) {
+        threaded_code_translate(&function->threadedCode, &function->chunk, directThreadedHandlers);
+    }
+    frame->threadedIp = function->threadedCode.cells;
+}
+#endif
+
 /// @brief Gets an item in an array or a string specified by a numerical index
 /// @return A boolean value that indicates whether the execution has led to a runtime error
 static bool virtual_machine_get_index_of() {
@@ -383,10 +758,9 @@ static bool virtual_machine_get_index_of() {
         }
         virtual_machine_push(array->array.values[num]);
     } else {
-        virtual_machine_runtime_error(
-            "Operands must a numerical value and a string object but are a %s %s and a %s %s",
-            value_stringify_type(virtual_machine_peek(0)), IS_OBJECT(virtual_machine_peek(0)) ? "object" : "value",
-            value_stringify_type(virtual_machine_peek(1)), IS_OBJECT(virtual_machine_peek(1)) ? "object" : "value");
+        virtual_machine_operands_error(
+            "Operands must a numerical value and a string object but are a %s %s and a %s %s", virtual_machine_peek(0),
+            virtual_machine_peek(1));
         return false;
     }
     return true;
@@ -403,15 +777,14 @@ static bool virtual_machine_get_slice_of() {
         return false;
     }
     if (!IS_NUMBER(virtual_machine_peek(1))) {
-        virtual_machine_runtime_error(
+        virtual_machine_operand_error(
             "A range can only be created with a number as second argument but was created with a %s %s",
-            value_stringify_type(virtual_machine_peek(1)), IS_OBJECT(virtual_machine_peek(1)) ? "object" : "value");
+            virtual_machine_peek(1));
         return false;
     }
     if (!IS_ARRAY(virtual_machine_peek(2)) && !IS_STRING(virtual_machine_peek(2))) {
-        virtual_machine_runtime_error("A slice can only be created from an array but was tried to create with a %s %s",
-                                      value_stringify_type(virtual_machine_peek(2)),
-                                      IS_OBJECT(virtual_machine_peek(2)) ? "object" : "value");
+        virtual_machine_operand_error("A slice can only be created from an array but was tried to create with a %s %s",
+                                      virtual_machine_peek(2));
         return false;
     }
 
@@ -427,7 +800,8 @@ static bool virtual_machine_get_slice_of() {
         return false;
     }
     if (IS_ARRAY(virtual_machine_peek(0))) {
-        object_dynamic_value_array_t * sourceArray = AS_ARRAY(virtual_machine_pop());
+        // The source stays on the stack until the slice has been created, so it can't be reclaimed in the meantime
+        object_dynamic_value_array_t * sourceArray = AS_ARRAY(virtual_machine_peek(0));
         if (upperBound >= sourceArray->array.count) {
             virtual_machine_runtime_error(
                 "Upperbound can not be higher or equal to the size of the array, but upperbound is %d and size %d",
@@ -435,12 +809,16 @@ static bool virtual_machine_get_slice_of() {
             return false;
         }
         object_dynamic_value_array_t * resultArray = object_new_dynamic_value_array();
+        virtual_machine_push(OBJECT_VAL(resultArray));
         for (; i < upperBound; i++) {
             dynamic_value_array_write(&resultArray->array, sourceArray->array.values[i]);
+            garbage_collector_write_barrier(&resultArray->obj, sourceArray->array.values[i]);
         }
+        virtual_machine_pop();
+        virtual_machine_pop();
         virtual_machine_push(OBJECT_VAL(resultArray));
     } else {
-        object_string_t * sourceString = AS_STRING(virtual_machine_pop());
+        object_string_t * sourceString = AS_STRING(virtual_machine_peek(0));
         if (upperBound >= sourceString->length) {
             virtual_machine_runtime_error(
                 "Upperbound can not be higher or equal to the length of the string but upperbound is %d and size %d",
@@ -453,30 +831,157 @@ static bool virtual_machine_get_slice_of() {
         }
         chars[i] = '\0';
         object_string_t * resultSting = object_take_string(chars, upperBound - i + 1);
+        virtual_machine_pop();
         virtual_machine_push(OBJECT_VAL(resultSting));
     }
     return true;
 }
 
+/// @brief Grows the callstack of the virtual machine
+/// @details The callstack doubles its capacity until it can hold FRAMES_MAX frames. The call frames are copied, so
+/// pointers to the call frames have to be reloaded afterwards
+static void virtual_machine_grow_call_stack() {
+    uint32_t capacity = virtualMachine.frameCapacity ? virtualMachine.frameCapacity * 2u : FRAMES_INITIAL;
+    capacity = capacity > FRAMES_MAX ? FRAMES_MAX : capacity;
+    call_frame_t * callStack = (call_frame_t *)realloc(virtualMachine.callStack, sizeof(call_frame_t) * capacity);
+    if (!callStack) {
+        exit(EXIT_CODE_SYSTEM_ERROR);
+    }
+    virtualMachine.callStack = callStack;
+    virtualMachine.frameCapacity = capacity;
+}
+
+/// @brief Grows the stack of the virtual machine
+/// @param capacity The amount of values the stack can hold afterwards
+/// @details The values are moved to a new memory block, so the slots of the call frames, the top of the stack and the
+/// locations of the open upvalues are moved as well. The open upvalues grow together with the stack
+static void virtual_machine_grow_stack(uint32_t capacity) {
+    value_t * oldStack = virtualMachine.stack;
+    value_t * stack = (value_t *)malloc(sizeof(value_t) * capacity);
+    object_upvalue_t ** openUpvalues =
+        (object_upvalue_t **)realloc(virtualMachine.openUpvalues, sizeof(object_upvalue_t *) * capacity);
+    if (!stack || !openUpvalues) {
+        exit(EXIT_CODE_SYSTEM_ERROR);
+    }
+    memset(openUpvalues + virtualMachine.stackCapacity, 0,
+           sizeof(object_upvalue_t *) * (capacity - virtualMachine.stackCapacity));
+    virtualMachine.openUpvalues = openUpvalues;
+    if (oldStack) {
+        memcpy(stack, oldStack, sizeof(value_t) * (size_t)(virtualMachine.stackTop - oldStack));
+        for (uint32_t i = 0u; i < virtualMachine.frameCount; i++) {
+            call_frame_t * frame = &virtualMachine.callStack[i];
+            frame->slots = stack + (frame->slots - oldStack);
+        }
+        for (uint32_t i = 0u; i < virtualMachine.openUpvalueTop; i++) {
+            if (openUpvalues[i]) {
+                openUpvalues[i]->location = stack + i;
+            }
+        }
+        virtualMachine.stackTop = stack + (virtualMachine.stackTop - oldStack);
+        free(oldStack);
+    }
+    virtualMachine.stack = stack;
+    virtualMachine.stackCapacity = capacity;
+}
+
+/// @brief Gets a property of the instance on top of the stack
+/// @param name The name of the property
+/// @param cache The inline cache of the call site
+/// @return A boolean value that indicates whether the execution has led to a runtime error
+/// @details The property replaces the instance on top of the stack. If the instance has no field with the name, a
+/// method of its class is bound to the instance
+static inline bool virtual_machine_get_property(object_string_t * name, inline_cache_t * cache) {
+    if (!IS_INSTANCE(virtual_machine_peek(0))) {
+        virtual_machine_operand_error("Only instances have properties but get expression but a %s %s was used",
+                                      virtual_machine_peek(0));
+        return false;
+    }
+    value_t property;
+    bool isField;
+    if (!virtual_machine_resolve_property(AS_INSTANCE(virtual_machine_peek(0)), name, cache, &property, &isField)) {
+        virtual_machine_runtime_error("Undefined property '%s'.", name->chars);
+        return false;
+    }
+    if (isField) {
+        // The field replaces the instance on top of the stack
+        virtualMachine.stackTop[-1] = property;
+        return true;
+    }
+    object_bound_method_t * bound = virtual_machine_bind(AS_INSTANCE(virtual_machine_peek(0)), AS_CLOSURE(property));
+    virtualMachine.stackTop[-1] = OBJECT_VAL(bound);
+    return true;
+}
+
+/// @brief Looks up the entry of the shape of a receiver in an inline cache
+/// @param cache The inline cache that is searched
+/// @param instance The receiver
+/// @return The entry of the shape or NULL if the shape isn't stored in the cache or the entry is outdated
+static inline inline_cache_entry_t * virtual_machine_inline_cache_lookup(inline_cache_t * cache,
+                                                                        object_instance_t * instance) {
+    for (uint32_t i = 0u; i < INLINE_CACHE_ENTRY_COUNT; i++) {
+        inline_cache_entry_t * entry = cache->entries + i;
+        if (entry->shape == instance->shape && entry->classVersion == instance->celloxClass->version) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/// @brief Creates a new instance of a class and calls the initializer of the class
+/// @param celloxClass The class that is instantiated
+/// @param initializer The initializer of the class or NULL if the class has no initializer
+/// @param argCount The amount of arguments for the initializer call
+/// @return true if everything went well, false if not
+static inline bool virtual_machine_instantiate(object_class_t * celloxClass, object_closure_t * initializer,
+                                               int32_t argCount) {
+    virtualMachine.stackTop[-argCount - 1] = OBJECT_VAL(object_new_instance(celloxClass));
+    if (initializer) {
+        return virtual_machine_call(initializer, argCount);
+    } else if (argCount != 0) {
+        virtual_machine_runtime_error("Expected 0 arguments but got %d.", argCount);
+        return false;
+    }
+    return true;
+}
+
+/// @brief Determines the index of the bytecode instruction that is currently executed in a call frame
+/// @param frame The call frame of the instruction
+/// @return The index of the last byte of the bytecode instruction that was read
+static inline uint32_t virtual_machine_instruction_index(call_frame_t * frame) {
+#ifdef VIRTUAL_MACHINE_DIRECT_THREADED_AVAILABLE
+    if (dispatchTechnique == DISPATCH_TECHNIQUE_DIRECT_THREADED) {
+        threaded_code_t * threadedCode = &frame->closure->function->threadedCode;
+        return threadedCode->opCodeIndexes[frame->threadedIp - threadedCode->cells - 1];
+    }
+#endif
+    return (uint32_t)(frame->ip - frame->closure->function->chunk.code - 1);
+}
+
 /// @brief Invokes a method bound to a cellox class instance
 /// @param name The name of the method that is envoked
 /// @param argCount The amount of arguments that are used when calling the method
+/// @param cache The inline cache of the call site
+/// @param tailCall Boolean value that determines whether the method reuses the call frame of the current function
 /// @return true if everything went well, false if something went wrong (not a cellox instance / undefiened method /
 /// stack overflow / wrong argument count)
-static bool virtual_machine_invoke(object_string_t * name, int32_t argCount) {
+static bool virtual_machine_invoke(object_string_t * name, int32_t argCount, inline_cache_t * cache, bool tailCall) {
     value_t receiver = virtual_machine_peek(argCount);
     if (!IS_INSTANCE(receiver)) {
-        virtual_machine_runtime_error("Only instances have methods but a %s %s was invoked",
-                                      value_stringify_type(receiver), IS_OBJECT(receiver) ? "object" : "value");
+        virtual_machine_operand_error("Only instances have methods but a %s %s was invoked", receiver);
+        return false;
+    }
+    value_t property;
+    bool isField;
+    if (!virtual_machine_resolve_property(AS_INSTANCE(receiver), name, cache, &property, &isField)) {
+        virtual_machine_runtime_error("Undefined property '%s'.", name->chars);
         return false;
     }
-    object_instance_t * instance = AS_INSTANCE(receiver);
-    value_t value;
-    if (value_hash_table_get(&instance->fields, name, &value)) {
-        virtualMachine.stackTop[-argCount - 1] = value;
-        return virtual_machine_call_value(value, argCount);
+    if (isField) {
+        virtualMachine.stackTop[-argCount - 1] = property;
+        return virtual_machine_call_value(property, argCount, NULL, tailCall);
     }
-    return virtual_machine_invoke_from_class(instance->celloxClass, name, argCount);
+    return tailCall ? virtual_machine_tail_call(AS_CLOSURE(property), argCount)
+                    : virtual_machine_call(AS_CLOSURE(property), argCount);
 }
 
 /// @brief Invokes a method from a celloxclass
@@ -509,15 +1014,38 @@ static bool virtual_machine_modulo() {
         int a = AS_NUMBER(virtual_machine_pop());
         virtual_machine_push(NUMBER_VAL(a % b));
     } else {
-        virtual_machine_runtime_error(
-            "Operands must be two numbers but they are a %s %s and a %s %s",
-            value_stringify_type(virtual_machine_peek(0)), IS_OBJECT(virtual_machine_peek(0)) ? "object" : "value",
-            value_stringify_type(virtual_machine_peek(1)), IS_OBJECT(virtual_machine_peek(1)) ? "object" : "value");
+        virtual_machine_operands_error("Operands must be two numbers but they are a %s %s and a %s %s",
+                                       virtual_machine_peek(0), virtual_machine_peek(1));
         return false;
     }
     return true;
 }
 
+/// @brief Reports a runtime error that was caused by the type of an operand
+/// @param format The format of the error message - followed by the type of the operand and whether it is an object
+/// @param operand The operand that caused the error
+/// @details Kept out of line, so the formatting of the error message doesn't bloat the hot paths of the handlers
+static void virtual_machine_operand_error(char const * format, value_t operand) {
+    virtual_machine_runtime_error(format, value_stringify_type(operand), IS_OBJECT(operand) ? "object" : "value");
+}
+
+/// @brief Reports a runtime error that was caused by the types of two operands - only the types are reported
+/// @param format The format of the error message - followed by the types of the two operands
+/// @param first The first operand that is reported
+/// @param second The second operand that is reported
+static void virtual_machine_operand_types_error(char const * format, value_t first, value_t second) {
+    virtual_machine_runtime_error(format, value_stringify_type(first), value_stringify_type(second));
+}
+
+/// @brief Reports a runtime error that was caused by the types of two operands
+/// @param format The format of the error message - followed by the type of every operand and whether it is an object
+/// @param first The first operand that is reported
+/// @param second The second operand that is reported
+static void virtual_machine_operands_error(char const * format, value_t first, value_t second) {
+    virtual_machine_runtime_error(format, value_stringify_type(first), IS_OBJECT(first) ? "object" : "value",
+                                  value_stringify_type(second), IS_OBJECT(second) ? "object" : "value");
+}
+
 /// @brief Gets the value at the specified distance on the stack
 /// @param distance The distance to the value
 /// @return The value at the specified distance
@@ -525,19 +1053,74 @@ static inline value_t virtual_machine_peek(int32_t distance) {
     return virtualMachine.stackTop[-1 - distance];
 }
 
+/// @brief Gets the value of an operand of a register instruction
+/// @param frame The call frame the register instruction is executed in
+/// @param operand The operand - either a slot of the call frame or a constant of the chunk
+/// @return The value of the operand
+static inline value_t virtual_machine_register_operand(call_frame_t * frame, uint8_t operand) {
+    return operand & REGISTER_OPERAND_CONSTANT
+               ? frame->closure->function->chunk.constants.values[operand & ~REGISTER_OPERAND_CONSTANT]
+               : frame->slots[operand];
+}
+
+/// @brief Stores the result of a register instruction
+/// @param frame The call frame the register instruction is executed in
+/// @param destination The slot of the call frame where the result is stored or REGISTER_DESTINATION_STACK
+/// @param value The result that is stored
+static inline void virtual_machine_register_store(call_frame_t * frame, uint8_t destination, value_t value) {
+    if (destination == REGISTER_DESTINATION_STACK) {
+        virtual_machine_push(value);
+    } else {
+        frame->slots[destination] = value;
+    }
+}
+
 /// @brief Resets the stack of the vm
 /// @details This means that all values will be removed
 /// The upvalues and framecount is also reset.
 static inline void virtual_machine_reset_stack() {
     virtualMachine.stackTop = virtualMachine.stack;
     virtualMachine.frameCount = 0u;
-    virtualMachine.openUpvalues = NULL;
+    // The upvalues of an aborted program are not closed anymore
+    if (virtualMachine.openUpvalueTop) {
+        memset(virtualMachine.openUpvalues, 0, sizeof(object_upvalue_t *) * virtualMachine.openUpvalueTop);
+    }
+    virtualMachine.openUpvalueTop = 0u;
 }
 
-static interpret_result virtual_machine_run() {
-#ifdef DEBUG_TRACE_EXECUTION
-    printf("== execution ==\n");
-#endif
+/// @brief Resolves a property of an instance - either a field of the instance or a method of its class
+/// @param instance The instance where the property is resolved
+/// @param name The name of the property
+/// @param cache The inline cache of the call site
+/// @param property Stores the value of the field or the method that was resolved
+/// @param isField Stores whether the property is a field of the instance
+/// @return true if the property has been found, false if not
+/// @details The shape of the instance and the methods of the class are only searched if the inline cache misses. A
+/// method is cached for a shape, that doesn't contain a field with the same name, so the method can't be shadowed
+static inline bool virtual_machine_resolve_property(object_instance_t * instance, object_string_t * name,
+                                                    inline_cache_t * cache, value_t * property, bool * isField) {
+    inline_cache_entry_t * entry = virtual_machine_inline_cache_lookup(cache, instance);
+    if (entry) {
+        *isField = entry->fieldIndex != INLINE_CACHE_NO_FIELD;
+        *property = *isField ? *object_instance_field(instance, entry->fieldIndex) : entry->method;
+        return true;
+    }
+    uint32_t slot = object_shape_find_field(instance->shape, name);
+    if (slot != OBJECT_SHAPE_NO_FIELD) {
+        inline_cache_update(cache, instance->shape, slot, NULL_VAL, NULL);
+        virtual_machine_cache_write_barrier(&instance->celloxClass->obj);
+        *property = *object_instance_field(instance, slot);
+        *isField = true;
+        return true;
+    }
+    if (!value_hash_table_get(&instance->celloxClass->methods, name, property)) {
+        return false;
+    }
+    inline_cache_update(cache, instance->shape, INLINE_CACHE_NO_FIELD, *property, NULL);
+    virtual_machine_cache_write_barrier(&instance->celloxClass->obj);
+    *isField = false;
+    return true;
+}
 
 /// Reads the next instruction from the current frame on top of the callstack
 #define READ_BYTE()     (*frame->ip++)
@@ -551,6 +1134,43 @@ static interpret_result virtual_machine_run() {
 /// Makro reads string in the chunk
 #define READ_STRING()   AS_STRING(READ_CONSTANT())
 
+/// Makro that reads the index of an inline cache and determines the address of the cache
+#define READ_INLINE_CACHE() (&frame->closure->function->chunk.inlineCaches[READ_SHORT()])
+
+/// Makro that reads the index of a call cache and determines the address of the cache
+#define READ_CALL_CACHE()   (&frame->closure->function->chunk.callCaches[READ_SHORT()])
+
+/// Makro that rewrites a generic binary instruction into its quickened form, if both operands are numbers
+#ifdef PROFILE_OPCODES
+// The opcode profiler has to count the original sequences of instructions
+#define QUICKEN_BINARY_OP(quickenedOpCode)
+#else
+#define QUICKEN_BINARY_OP(quickenedOpCode)                                                                             \
+    do {                                                                                                               \
+        if (IS_NUMBER(virtual_machine_peek(0)) && IS_NUMBER(virtual_machine_peek(1))) {                                \
+            REWRITE_INSTRUCTION(quickenedOpCode);                                                                      \
+        }                                                                                                              \
+    } while (false)
+#endif
+
+/// Makro that reads an operand of a register instruction and retrieves its value
+#define READ_REGISTER() virtual_machine_register_operand(frame, READ_BYTE())
+
+/// Makro that skips the opcode of an instruction that is executed as a part of a superinstruction
+#define SKIP_OPCODE()         (frame->ip++)
+
+/// Makro that jumps forward in the chunk of the current frame
+#define JUMP_FORWARD(offset)  (frame->ip += (offset))
+
+/// Makro that jumps backward in the chunk of the current frame
+#define JUMP_BACKWARD(offset) (frame->ip -= (offset))
+
+/// Makro that rewrites the opcode of the instruction that is executed (only used by instructions without operands)
+#define REWRITE_INSTRUCTION(opcode) (frame->ip[-1] = (opcode))
+
+/// Makro that makes sure the instruction that is executed is dispatched again (after it has been rewritten)
+#define REEXECUTE_INSTRUCTION()     (frame->ip--)
+
 /**
  * Macro for creating a binary operator, based on a operator in C
  * We have to embed the marco into a do while, which isn't followed by a semicolon,
@@ -559,11 +1179,8 @@ static interpret_result virtual_machine_run() {
 #define BINARY_OP(valueType, op)                                                                       \
     do {                                                                                               \
         if (!IS_NUMBER(virtual_machine_peek(0)) || !IS_NUMBER(virtual_machine_peek(1))) {              \
-            virtual_machine_runtime_error("Operands must be numbers but they are a %s %s and a %s %s", \
-                                          value_stringify_type(virtual_machine_peek(0)),               \
-                                          IS_OBJECT(virtual_machine_peek(0)) ? "object" : "value",     \
-                                          value_stringify_type(virtual_machine_peek(1)),               \
-                                          IS_OBJECT(virtual_machine_peek(1)) ? "object" : "value");    \
+            virtual_machine_operands_error("Operands must be numbers but they are a %s %s and a %s %s", \
+                                           virtual_machine_peek(0), virtual_machine_peek(1));          \
             return INTERPRET_RUNTIME_ERROR;                                                            \
         }                                                                                              \
         double b = AS_NUMBER(virtual_machine_pop());                                                   \
@@ -571,76 +1188,86 @@ static interpret_result virtual_machine_run() {
         virtual_machine_push(valueType(a op b));                                                       \
     } while (false)
 
-    call_frame_t * frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
-
-// For GCC and Clang we use computed goto's for non-debug builds, to create a efficient dispatch table, in order to
-// speed up the execution.🚀 This is for example also done by ruby or dalvik (android java VM). Lua on the other hand
-// uses a regular switch statement like we do, if there is the compiler is not gcc or clang.
-#if !defined(BUILD_DEBUG) && (defined(COMPILER_GCC) || defined(COMPILER_Clang))
-
-    // Dispatch table with the labels we jump to instead of function pointers
-    void * dispatch_table[] = {
-        &&label_add,           &&label_array_literal, &&label_call,          &&label_class,         &&label_closure,
-        &&label_close_upvalue, &&label_constant,      &&label_define_global, &&label_divide,        &&label_equal,
-        &&label_exponent,      &&label_false,         &&label_get_global,    &&label_get_index_of,  &&label_get_local,
-        &&label_get_property,  &&label_get_slice_of,  &&label_get_super,     &&label_get_upvalue,   &&label_greater,
-        &&label_inherit,       &&label_invoke,        &&label_jump,          &&label_jump_if_false, &&label_less,
-        &&label_loop,          &&label_method,        &&label_modulo,        &&label_multiply,      &&label_negate,
-        &&label_not,           &&label_null,          &&label_pop,           &&label_return,        &&label_set_global,
-        &&label_set_index_of,  &&label_set_local,     &&label_set_property,  &&label_set_upvalue,   &&label_subtract,
-        &&label_super_invoke,  &&label_true};
+/**
+ * Macro for creating a binary operator of the register instruction set, based on a operator in C
+ * If the operands are not numbers, they are pushed onto the stack and the error is reported by the stack based
+ * implementation of the operator
+ */
+#define REGISTER_BINARY_OP(valueType, op)                                                               \
+    do {                                                                                                \
+        uint8_t destination = READ_BYTE();                                                              \
+        value_t a = READ_REGISTER();                                                                    \
+        value_t b = READ_REGISTER();                                                                    \
+        if (!IS_NUMBER(a) || !IS_NUMBER(b)) {                                                           \
+            virtual_machine_push(a);                                                                    \
+            virtual_machine_push(b);                                                                    \
+            BINARY_OP(valueType, op);                                                                   \
+        }                                                                                               \
+        virtual_machine_register_store(frame, destination, valueType(AS_NUMBER(a) op AS_NUMBER(b)));    \
+    } while (false)
 
-/// Makro that dipatches the next bytecode instuction
-#define DISPATCH() goto * dispatch_table[READ_BYTE()]
+/// Makro that determines the index of the next bytecode instruction in the chunk of the current frame
+#define NEXT_INSTRUCTION_INDEX() ((uint32_t)(frame->ip - frame->closure->function->chunk.code))
 
-    DISPATCH();
-#endif // Not debug and clang or gcc
+/**
+ * Macro for creating a binary operator of a quickened instruction, that only has a single guard for both operands
+ * If one of the operands isn't a number, the instruction is rewritten into the generic instruction that is executed
+ * instead (deoptimization)
+ */
+#define NUMBER_BINARY_OP(valueType, op, genericOpCode)                                                                 \
+    do {                                                                                                               \
+        value_t b = virtual_machine_peek(0);                                                                           \
+        value_t a = virtual_machine_peek(1);                                                                           \
+        if (IS_NUMBER(a) && IS_NUMBER(b)) {                                                                            \
+            virtualMachine.stackTop--;                                                                                 \
+            virtualMachine.stackTop[-1] = valueType(AS_NUMBER(a) op AS_NUMBER(b));                                     \
+        } else {                                                                                                       \
+            REWRITE_INSTRUCTION(genericOpCode);                                                                        \
+            REEXECUTE_INSTRUCTION();                                                                                   \
+        }                                                                                                              \
+    } while (false)
 
-    for (;;) {
-#ifdef DEBUG_TRACE_EXECUTION
-        // Prints all the values located on the stack
-        printf("          ");
-        for (value_t * slot = virtualMachine.stack; slot < virtualMachine.stackTop; slot++) {
-            printf("[ ");
-            value_print(*slot);
-            printf(" ]");
-        }
-        printf("\n");
-        chunk_disassembler_disassemble_instruction(&frame->closure->function->chunk,
-                                                   (int32_t)(frame->ip - frame->closure->function->chunk.code));
+/// Makro that traces and / or profiles the execution of the next bytecode instruction
+#if defined(DEBUG_TRACE_EXECUTION) || defined(PROFILE_OPCODES)
+#define TRACE_INSTRUCTION() virtual_machine_trace_instruction(frame, NEXT_INSTRUCTION_INDEX())
+#else
+#define TRACE_INSTRUCTION()
 #endif
 
-#if !defined(BUILD_DEBUG) && (defined(COMPILER_GCC) || defined(COMPILER_Clang))
-    label_add:
-        if (IS_STRING(virtual_machine_peek(0)) && IS_STRING(virtual_machine_peek(1))) {
-            virtual_machine_concatenate_strings();
-        } else if (IS_NUMBER(virtual_machine_peek(0)) && IS_NUMBER(virtual_machine_peek(1))) {
-            BINARY_OP(NUMBER_VAL, +);
-        } else if (IS_ARRAY(virtual_machine_peek(1))) {
-            virtual_machine_concatenate_arrays();
-        } else {
-            virtual_machine_runtime_error("Operands must be two numbers, two strings, an array and a value or an array "
-                                          "and an array, but they are a %s value and a %s value",
-                                          value_stringify_type(virtual_machine_peek(0)),
-                                          value_stringify_type(virtual_machine_peek(1)));
-            return INTERPRET_RUNTIME_ERROR;
+/// @brief Executes an instruction with a wide first operand, that is prefixed by OP_WIDE
+/// @param frame The call frame that executes the instruction - the instruction pointer points behind OP_WIDE
+/// @return A boolean value that indicates whether the execution has led to a runtime error
+/// @details The wide instructions are rare (e.g. the constants after the first 256 constants of a chunk), so they are
+/// decoded by this function instead of a handler for every wide instruction. The threaded code contains the narrow
+/// handlers with the decoded wide operands instead. Invocations push a new call frame, so the caller has to reload
+/// the call frame afterwards
+static bool virtual_machine_execute_wide(call_frame_t * frame) {
+    uint8_t instruction = READ_BYTE();
+    if (instruction == OP_JUMP || instruction == OP_JUMP_IF_FALSE || instruction == OP_LOOP) {
+        uint32_t offset = ((uint32_t)READ_SHORT() << 16);
+        offset |= READ_SHORT();
+        if (instruction == OP_LOOP) {
+            JUMP_BACKWARD(offset);
+        } else if (instruction == OP_JUMP || virtual_machine_is_falsey(virtual_machine_peek(0))) {
+            JUMP_FORWARD(offset);
         }
-        DISPATCH();
-    label_array_literal:
-        virtual_machine_array_literal(READ_BYTE());
-        DISPATCH();
-    label_call:
+        return true;
+    }
+    uint32_t constantIndex = (uint32_t)READ_BYTE() << 16;
+    constantIndex |= READ_SHORT();
+    value_t constant = frame->closure->function->chunk.constants.values[constantIndex];
+    // The operands after the index of the constant are the same as the ones of the narrow instruction
+    switch (instruction) {
+    case OP_CLASS:
+        virtual_machine_push(OBJECT_VAL(object_new_class(AS_STRING(constant))));
+        return true;
+    case OP_CLOSURE:
         {
-            int32_t argCount = READ_BYTE();
-            if (!virtual_machine_call_value(virtual_machine_peek(argCount), argCount)) {
-                return INTERPRET_RUNTIME_ERROR;
+            object_function_t * function = AS_FUNCTION(constant);
+            if (!function->upvalueCount && !function->capturedValueCount) {
+                virtual_machine_push(OBJECT_VAL(object_function_closure(function)));
+                return true;
             }
-            frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
-            DISPATCH();
-        }
-    label_closure:
-        {
-            object_function_t * function = AS_FUNCTION(READ_CONSTANT());
             object_closure_t * closure = object_new_closure(function);
             virtual_machine_push(OBJECT_VAL(closure));
             for (uint32_t i = 0; i < closure->upvalueCount; i++) {
@@ -648,590 +1275,145 @@ static interpret_result virtual_machine_run() {
                 uint8_t index = READ_BYTE();
                 closure->upvalues[i] =
                     isLocal ? virtual_machine_capture_upvalue(frame->slots + index) : frame->closure->upvalues[index];
+                // Capturing an upvalue can trigger a garbage collection that promotes the closure
+                garbage_collector_write_barrier_object(&closure->obj, &closure->upvalues[i]->obj);
             }
-            DISPATCH();
-        }
-    label_class:
-        virtual_machine_push(OBJECT_VAL(object_new_class(READ_STRING())));
-        DISPATCH();
-    label_close_upvalue:
-        virtual_machine_close_upvalues(virtualMachine.stackTop - 1);
-        virtual_machine_pop();
-        DISPATCH();
-    label_constant:
-        {
-            value_t constant = READ_CONSTANT();
-            virtual_machine_push(constant);
-            DISPATCH();
-        }
-    label_define_global:
-        {
-            object_string_t * name = READ_STRING();
-            value_hash_table_set(&virtualMachine.globals, name, virtual_machine_peek(0));
-            virtual_machine_pop();
-            DISPATCH();
-        }
-    label_divide:
-        BINARY_OP(NUMBER_VAL, /);
-        DISPATCH();
-    label_equal:
-        {
-            value_t a = virtual_machine_pop();
-            value_t b = virtual_machine_pop();
-            virtual_machine_push(BOOL_VAL(value_values_equal(a, b)));
-            DISPATCH();
-        }
-    label_exponent:
-        if (IS_NUMBER(virtual_machine_peek(0)) && IS_NUMBER(virtual_machine_peek(1))) {
-            double b = AS_NUMBER(virtual_machine_pop());
-            double a = AS_NUMBER(virtual_machine_pop());
-            virtual_machine_push(NUMBER_VAL(pow(a, b)));
-        } else {
-            virtual_machine_runtime_error("Operands must be two numbers but they are a %s value and a %s value",
-                                          value_stringify_type(virtual_machine_peek(0)),
-                                          value_stringify_type(virtual_machine_peek(1)));
-            return INTERPRET_RUNTIME_ERROR;
-        }
-        DISPATCH();
-    label_false:
-        virtual_machine_push(BOOL_VAL(false));
-        DISPATCH();
-    label_get_global:
-        {
-            object_string_t * name = READ_STRING();
-            value_t value;
-            if (!value_hash_table_get(&virtualMachine.globals, name, &value)) {
-                virtual_machine_runtime_error("Undefined variable '%s'.", name->chars);
-                return INTERPRET_RUNTIME_ERROR;
-            }
-            virtual_machine_push(value);
-            DISPATCH();
-        }
-    label_get_index_of:
-        if (!virtual_machine_get_index_of()) {
-            return INTERPRET_RUNTIME_ERROR;
-        }
-        DISPATCH();
-    label_get_local:
-        virtual_machine_push(frame->slots[READ_BYTE()]);
-        DISPATCH();
-    label_get_property:
-        {
-            if (!IS_INSTANCE(virtual_machine_peek(0))) {
-                virtual_machine_runtime_error("Only instances have properties but get expression but a %s %s was used",
-                                              value_stringify_type(virtual_machine_peek(0)),
-                                              IS_OBJECT(virtual_machine_peek(0)) ? "object" : "value");
-                return INTERPRET_RUNTIME_ERROR;
-            }
-            object_instance_t * instance = AS_INSTANCE(virtual_machine_peek(0));
-            object_string_t * name = READ_STRING();
-            value_t value;
-            if (value_hash_table_get(&instance->fields, name, &value)) {
-                virtual_machine_pop(); // Instance.
-                virtual_machine_push(value);
-                DISPATCH();
-            }
-            if (!virtual_machine_bind_method(instance->celloxClass, name)) {
-                return INTERPRET_RUNTIME_ERROR;
-            }
-            DISPATCH();
-        }
-    label_get_slice_of:
-        if (!virtual_machine_get_slice_of()) {
-            return INTERPRET_RUNTIME_ERROR;
-        }
-        DISPATCH();
-    label_get_super:
-        {
-            object_string_t * name = READ_STRING();
-            object_class_t * superclass = AS_CLASS(virtual_machine_pop());
-
-            if (!virtual_machine_bind_method(superclass, name)) {
-                virtual_machine_runtime_error("Method %s not defined in parent class %s", name->chars,
-                                              superclass->name->chars);
-                return INTERPRET_RUNTIME_ERROR;
-            }
-            DISPATCH();
-        }
-    label_get_upvalue:
-        {
-            uint8_t slot = READ_BYTE();
-            virtual_machine_push(*frame->closure->upvalues[slot]->location);
-            DISPATCH();
-        }
-    label_greater:
-        BINARY_OP(BOOL_VAL, >);
-        DISPATCH();
-    label_inherit:
-        {
-            value_t superclassvalue = virtual_machine_peek(1);
-            if (!IS_CLASS(superclassvalue)) {
-                virtual_machine_runtime_error("Superclass must be a class but is a %s %s",
-                                              value_stringify_type(superclassvalue),
-                                              IS_OBJECT(superclassvalue) ? "object" : "value");
-
-                return INTERPRET_RUNTIME_ERROR;
-            }
-            object_class_t * subclass = AS_CLASS(virtual_machine_peek(0));
-            value_hash_table_add_all(&AS_CLASS(superclassvalue)->methods, &subclass->methods);
-            virtual_machine_pop(); // Subclass.
-            DISPATCH();
-        }
-    label_invoke:
-        {
-            object_string_t * method = READ_STRING();
-            if (!virtual_machine_invoke(method, READ_BYTE())) {
-                return INTERPRET_RUNTIME_ERROR;
-            }
-            frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
-            DISPATCH();
-        }
-    label_jump:
-        // We jump 🦘
-        frame->ip += READ_SHORT();
-        DISPATCH();
-    label_jump_if_false:
-        {
-            uint16_t offset = READ_SHORT();
-            if (virtual_machine_is_falsey(virtual_machine_peek(0))) {
-                // We jump 🦘
-                frame->ip += offset;
+            for (uint32_t i = 0; i < closure->capturedValueCount; i++) {
+                uint8_t isLocal = READ_BYTE();
+                uint8_t index = READ_BYTE();
+                CLOSURE_CAPTURED_VALUES(closure)[i] =
+                    isLocal ? frame->slots[index] : CLOSURE_CAPTURED_VALUES(frame->closure)[index];
+                garbage_collector_write_barrier(&closure->obj, CLOSURE_CAPTURED_VALUES(closure)[i]);
             }
-            DISPATCH();
-        }
-    label_less:
-        BINARY_OP(BOOL_VAL, <);
-        DISPATCH();
-    label_loop:
-        frame->ip -= READ_SHORT();
-        DISPATCH();
-    label_method:
-        virtual_machine_define_method(READ_STRING());
-        DISPATCH();
-    label_modulo:
-        if (!virtual_machine_modulo()) {
-            return INTERPRET_RUNTIME_ERROR;
+            return true;
         }
-        DISPATCH();
-    label_multiply:
-        BINARY_OP(NUMBER_VAL, *);
-        DISPATCH();
-    label_negate:
-        if (!IS_NUMBER(virtual_machine_peek(0))) {
-            virtual_machine_runtime_error("Operand must be a number but is a %s %s.",
-                                          value_stringify_type(virtual_machine_peek(0)),
-                                          IS_OBJECT(virtual_machine_peek(0)) ? "object" : "value");
-            return INTERPRET_RUNTIME_ERROR;
-        }
-        virtual_machine_push(NUMBER_VAL(-AS_NUMBER(virtual_machine_pop())));
-        DISPATCH();
-    label_not:
-        virtual_machine_push(BOOL_VAL(virtual_machine_is_falsey(virtual_machine_pop())));
-        DISPATCH();
-    label_null:
-        virtual_machine_push(NULL_VAL);
-        DISPATCH();
-    label_pop:
+    case OP_CONSTANT:
+        virtual_machine_push(constant);
+        return true;
+    case OP_DEFINE_GLOBAL:
+        virtualMachine.globalValues.values[READ_SHORT()] = virtual_machine_peek(0);
         virtual_machine_pop();
-        DISPATCH();
-    label_return:
+        return true;
+    case OP_GET_GLOBAL:
+    case OP_SET_GLOBAL:
         {
-            value_t result = virtual_machine_pop();
-            virtual_machine_close_upvalues(frame->slots);
-            virtualMachine.frameCount--;
-            if (!virtualMachine.frameCount) {
-                virtual_machine_pop();
-                return INTERPRET_OK;
+            value_t * global = &virtualMachine.globalValues.values[READ_SHORT()];
+            if (IS_UNDEFINED(*global)) {
+                virtual_machine_runtime_error("Undefined variable '%s'.", AS_CSTRING(constant));
+                return false;
             }
-            virtualMachine.stackTop = frame->slots;
-            virtual_machine_push(result);
-            frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
-            DISPATCH();
-        }
-    label_set_global:
-        {
-            object_string_t * name = READ_STRING();
-            if (value_hash_table_set(&virtualMachine.globals, name, virtual_machine_peek(0))) {
-                value_hash_table_delete(&virtualMachine.globals, name);
-                virtual_machine_runtime_error("Undefined variable '%s'.", name->chars);
-                return INTERPRET_RUNTIME_ERROR;
+            if (instruction == OP_GET_GLOBAL) {
+                virtual_machine_push(*global);
+            } else {
+                *global = virtual_machine_peek(0);
             }
-            DISPATCH();
+            return true;
         }
-    label_set_index_of:
-        if (!virtual_machine_set_index_of()) {
-            return INTERPRET_RUNTIME_ERROR;
-        }
-        DISPATCH();
-    label_set_local:
-        // We set the value at the specified slot to the value that is stored on the top of the stack of the virtual
-        // machine.
-        frame->slots[READ_BYTE()] = virtual_machine_peek(0);
-        DISPATCH();
-    label_set_property:
+    case OP_GET_PROPERTY:
+        return virtual_machine_get_property(AS_STRING(constant), READ_INLINE_CACHE());
+    case OP_GET_SUPER:
+        return virtual_machine_bind_method(AS_CLASS(virtual_machine_pop()), AS_STRING(constant));
+    case OP_INVOKE:
+    case OP_TAIL_INVOKE:
         {
-            if (!IS_INSTANCE(virtual_machine_peek(1))) {
-                virtual_machine_runtime_error("Only instances have fields but was called with a %s %s",
-                                              value_stringify_type(virtual_machine_peek(1)),
-                                              IS_OBJECT(virtual_machine_peek(1)) ? "object" : "value");
-                return INTERPRET_RUNTIME_ERROR;
-            }
-            // We look up the field in the 'fields' hashtable of the cellox object instance
-            value_hash_table_set(&AS_INSTANCE(virtual_machine_peek(1))->fields, READ_STRING(), virtual_machine_peek(0));
-            // The value that is assigned to the property
-            value_t value = virtual_machine_pop();
-            virtual_machine_pop();
-            virtual_machine_push(value);
-            DISPATCH();
+            int argCount = READ_BYTE();
+            return virtual_machine_invoke(AS_STRING(constant), argCount, READ_INLINE_CACHE(),
+                                          instruction == OP_TAIL_INVOKE);
         }
-    label_set_upvalue:
-        *frame->closure->upvalues[READ_BYTE()]->location = virtual_machine_peek(0);
-        DISPATCH();
-    label_subtract:
-        BINARY_OP(NUMBER_VAL, -);
-        DISPATCH();
-    label_super_invoke:
+    case OP_METHOD:
+        virtual_machine_define_method(AS_STRING(constant));
+        return true;
+    case OP_SET_PROPERTY:
+        return virtual_machine_set_property(AS_STRING(constant), READ_INLINE_CACHE());
+    case OP_SUPER_INVOKE:
         {
-            object_string_t * method = READ_STRING();
             int argCount = READ_BYTE();
-            object_class_t * superclass = AS_CLASS(virtual_machine_pop());
-            if (!virtual_machine_invoke_from_class(superclass, method, argCount)) {
-                return INTERPRET_RUNTIME_ERROR;
-            }
-            frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
-            DISPATCH();
+            return virtual_machine_invoke_from_class(AS_CLASS(virtual_machine_pop()), AS_STRING(constant), argCount);
         }
-    label_true:
-        virtual_machine_push(BOOL_VAL(true));
-        DISPATCH();
-// For MSVC and other C-compilers we use a switch statement instead
-#else
-        uint8_t instruction;
-        switch (instruction = READ_BYTE()) {
-        case OP_ADD:
-            {
-                if (IS_STRING(virtual_machine_peek(0)) && IS_STRING(virtual_machine_peek(1))) {
-                    virtual_machine_concatenate_strings();
-                } else if (IS_NUMBER(virtual_machine_peek(0)) && IS_NUMBER(virtual_machine_peek(1))) {
-                    BINARY_OP(NUMBER_VAL, +);
-                } else if (IS_ARRAY(virtual_machine_peek(1))) {
-                    virtual_machine_concatenate_arrays();
-                } else {
-                    virtual_machine_runtime_error("Operands must be two numbers, two strings, an array and a value or "
-                                                  "an array and an array, but they are a %s value and a %s value",
-                                                  value_stringify_type(virtual_machine_peek(0)),
-                                                  value_stringify_type(virtual_machine_peek(1)));
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                break;
-            }
-        case OP_ARRAY_LITERAL:
-            {
-                virtual_machine_array_literal(READ_BYTE());
-                break;
-            }
-        case OP_CALL:
-            {
-                int32_t argCount = READ_BYTE();
-                if (!virtual_machine_call_value(virtual_machine_peek(argCount), argCount)) {
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
-                break;
-            }
-        case OP_CLOSURE:
-            {
-                object_function_t * function = AS_FUNCTION(READ_CONSTANT());
-                object_closure_t * closure = object_new_closure(function);
-                virtual_machine_push(OBJECT_VAL(closure));
-                for (uint32_t i = 0; i < closure->upvalueCount; i++) {
-                    uint8_t isLocal = READ_BYTE();
-                    uint8_t index = READ_BYTE();
-                    closure->upvalues[i] = isLocal ? virtual_machine_capture_upvalue(frame->slots + index)
-                                                   : frame->closure->upvalues[index];
-                }
-                break;
-            }
-        case OP_CLASS:
-            virtual_machine_push(OBJECT_VAL(object_new_class(READ_STRING())));
-            break;
-        case OP_CLOSE_UPVALUE:
-            virtual_machine_close_upvalues(virtualMachine.stackTop - 1);
-            virtual_machine_pop();
-            break;
-        case OP_CONSTANT:
-            {
-                value_t constant = READ_CONSTANT();
-                virtual_machine_push(constant);
-                break;
-            }
-        case OP_DEFINE_GLOBAL:
-            {
-                object_string_t * name = READ_STRING();
-                value_hash_table_set(&virtualMachine.globals, name, virtual_machine_peek(0));
-                virtual_machine_pop();
-                break;
-            }
-        case OP_DIVIDE:
-            BINARY_OP(NUMBER_VAL, /);
-            break;
-        case OP_EQUAL:
-            {
-                value_t a = virtual_machine_pop();
-                value_t b = virtual_machine_pop();
-                virtual_machine_push(BOOL_VAL(value_values_equal(a, b)));
-                break;
-            }
-        case OP_EXPONENT:
-            {
-                if (IS_NUMBER(virtual_machine_peek(0)) && IS_NUMBER(virtual_machine_peek(1))) {
-                    double b = AS_NUMBER(virtual_machine_pop());
-                    double a = AS_NUMBER(virtual_machine_pop());
-                    virtual_machine_push(NUMBER_VAL(pow(a, b)));
-                } else {
-                    virtual_machine_runtime_error("Operands must be two numbers but they are a %s value and a %s value",
-                                                  value_stringify_type(virtual_machine_peek(0)),
-                                                  value_stringify_type(virtual_machine_peek(1)));
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                break;
-            }
-        case OP_FALSE:
-            virtual_machine_push(BOOL_VAL(false));
-            break;
-        case OP_GET_GLOBAL:
-            {
-                object_string_t * name = READ_STRING();
-                value_t value;
-                if (!value_hash_table_get(&virtualMachine.globals, name, &value)) {
-                    virtual_machine_runtime_error("Undefined variable '%s'.", name->chars);
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                virtual_machine_push(value);
-                break;
-            }
-        case OP_GET_INDEX_OF:
-            {
-                if (!virtual_machine_get_index_of()) {
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                break;
-            }
-        case OP_GET_LOCAL:
-            {
-                uint8_t slot = READ_BYTE();
-                virtual_machine_push(frame->slots[slot]);
-                break;
-            }
-        case OP_GET_PROPERTY:
-            {
-                if (!IS_INSTANCE(virtual_machine_peek(0))) {
-                    virtual_machine_runtime_error(
-                        "Only instances have properties but get expression but a %s %s was used",
-                        value_stringify_type(virtual_machine_peek(0)),
-                        IS_OBJECT(virtual_machine_peek(0)) ? "object" : "value");
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                object_instance_t * instance = AS_INSTANCE(virtual_machine_peek(0));
-                object_string_t * name = READ_STRING();
-
-                value_t value;
-                if (value_hash_table_get(&instance->fields, name, &value)) {
-                    virtual_machine_pop(); // Instance.
-                    virtual_machine_push(value);
-                    break;
-                }
-                if (!virtual_machine_bind_method(instance->celloxClass, name)) {
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                break;
-            }
-        case OP_GET_SLICE_OF:
-            {
-                if (!virtual_machine_get_slice_of()) {
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                break;
-            }
-        case OP_GET_SUPER:
-            {
-                object_string_t * name = READ_STRING();
-                object_class_t * superclass = AS_CLASS(virtual_machine_pop());
+    default:
+        // Only the instructions with a constant or a jump offset as their first operand have a wide form
+        return false;
+    }
+}
 
-                if (!virtual_machine_bind_method(superclass, name)) {
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                break;
-            }
-        case OP_GET_UPVALUE:
-            {
-                uint8_t slot = READ_BYTE();
-                virtual_machine_push(*frame->closure->upvalues[slot]->location);
-                break;
-            }
-        case OP_GREATER:
-            BINARY_OP(BOOL_VAL, >);
-            break;
-        case OP_INHERIT:
-            {
-                value_t superclass = virtual_machine_peek(1);
-                if (!IS_CLASS(superclass)) {
-                    virtual_machine_runtime_error("Superclass must be a class but is a %s %s",
-                                                  value_stringify_type(superclass),
-                                                  IS_OBJECT(superclass) ? "object" : "value");
+static interpret_result virtual_machine_run() {
+#ifdef DEBUG_TRACE_EXECUTION
+    printf("== execution ==\n");
+#endif
+    switch (dispatchTechnique) {
+#ifdef VIRTUAL_MACHINE_COMPUTED_GOTO_AVAILABLE
+    case DISPATCH_TECHNIQUE_COMPUTED_GOTO:
+        return virtual_machine_run_computed_goto();
+#endif
+#ifdef VIRTUAL_MACHINE_TAIL_CALL_AVAILABLE
+    case DISPATCH_TECHNIQUE_TAIL_CALL:
+        return virtual_machine_run_tail_call();
+#endif
+#ifdef VIRTUAL_MACHINE_DIRECT_THREADED_AVAILABLE
+    case DISPATCH_TECHNIQUE_DIRECT_THREADED:
+        return virtual_machine_run_direct_threaded();
+#endif
+#ifdef VIRTUAL_MACHINE_JIT_AVAILABLE
+    case DISPATCH_TECHNIQUE_JIT:
+        return virtual_machine_run_jit();
+#endif
+    default:
+        return virtual_machine_run_switch();
+    }
+}
+
+#ifdef VIRTUAL_MACHINE_COMPUTED_GOTO_AVAILABLE
+/// @brief Executes the bytecode using computed goto's
+/// @details Every instruction jumps directly to the label of the next instruction using a dispatch table, instead of
+/// going back to a single switch statement. This is for example also done by ruby or dalvik (android java VM).
+/// @return The result of the interpretation
+static interpret_result virtual_machine_run_computed_goto() {
+    call_frame_t * frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+
+/// Makro that retrieves the address of the label of the specified opcode
+#define LABEL_ADDRESS(opcode) [opcode] = &&label_##opcode,
+
+    // Dispatch table with the labels we jump to instead of function pointers
+    static void * const dispatchTable[] = {CHUNK_OPCODES(LABEL_ADDRESS)};
+
+/// Makro that starts the definition of a bytecode instruction
+#define VM_INSTRUCTION(opcode) label_##opcode:
+
+/// Makro that dipatches the next bytecode instuction
+#define VM_DISPATCH()                       \
+    do {                                    \
+        TRACE_INSTRUCTION();                \
+        goto * dispatchTable[READ_BYTE()];  \
+    } while (false)
+
+    VM_DISPATCH();
+#include "virtual_machine_instructions.h"
+
+#undef LABEL_ADDRESS
+#undef VM_INSTRUCTION
+#undef VM_DISPATCH
+}
+#endif
+
+/// @brief Executes the bytecode using a single switch statement that is executed in a loop
+/// @details This approach is supported by every C-compiler. It is used by Lua for example.
+/// @return The result of the interpretation
+static interpret_result virtual_machine_run_switch() {
+    call_frame_t * frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+
+/// Makro that starts the definition of a bytecode instruction
+#define VM_INSTRUCTION(opcode) case opcode:
+
+/// Makro that dipatches the next bytecode instuction
+#define VM_DISPATCH()          continue
+
+    for (;;) {
+        TRACE_INSTRUCTION();
+        switch (READ_BYTE()) {
+#include "virtual_machine_instructions.h"
 
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                object_class_t * subclass = AS_CLASS(virtual_machine_peek(0));
-                value_hash_table_add_all(&AS_CLASS(superclass)->methods, &subclass->methods);
-                virtual_machine_pop(); // Subclass.
-                break;
-            }
-        case OP_INVOKE:
-            {
-                object_string_t * method = READ_STRING();
-                int argCount = READ_BYTE();
-                if (!virtual_machine_invoke(method, argCount)) {
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
-                break;
-            }
-        case OP_JUMP:
-            {
-                uint16_t offset = READ_SHORT();
-                // We jump 🦘
-                frame->ip += offset;
-                break;
-            }
-        case OP_JUMP_IF_FALSE:
-            {
-                uint16_t offset = READ_SHORT();
-                if (virtual_machine_is_falsey(virtual_machine_peek(0))) {
-                    // We jump 🦘
-                    frame->ip += offset;
-                }
-                break;
-            }
-        case OP_LESS:
-            BINARY_OP(BOOL_VAL, <);
-            break;
-        case OP_LOOP:
-            {
-                uint16_t offset = READ_SHORT();
-                frame->ip -= offset;
-                break;
-            }
-        case OP_METHOD:
-            virtual_machine_define_method(READ_STRING());
-            break;
-        case OP_MODULO:
-            {
-                if (!virtual_machine_modulo()) {
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                break;
-            }
-        case OP_MULTIPLY:
-            BINARY_OP(NUMBER_VAL, *);
-            break;
-        case OP_NEGATE:
-            if (!IS_NUMBER(virtual_machine_peek(0))) {
-                virtual_machine_runtime_error("Operand must be a number but is a %s %s.",
-                                              value_stringify_type(virtual_machine_peek(0)),
-                                              IS_OBJECT(virtual_machine_peek(0)) ? "object" : "value");
-                return INTERPRET_RUNTIME_ERROR;
-            }
-            virtual_machine_push(NUMBER_VAL(-AS_NUMBER(virtual_machine_pop())));
-            break;
-        case OP_NOT:
-            virtual_machine_push(BOOL_VAL(virtual_machine_is_falsey(virtual_machine_pop())));
-            break;
-        case OP_NULL:
-            virtual_machine_push(NULL_VAL);
-            break;
-        case OP_POP:
-            virtual_machine_pop();
-            break;
-        case OP_RETURN:
-            {
-                value_t result = virtual_machine_pop();
-                virtual_machine_close_upvalues(frame->slots);
-                virtualMachine.frameCount--;
-                if (!virtualMachine.frameCount) {
-                    virtual_machine_pop();
-                    return INTERPRET_OK;
-                }
-                virtualMachine.stackTop = frame->slots;
-                virtual_machine_push(result);
-                frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
-                break;
-            }
-        case OP_SET_GLOBAL:
-            {
-                object_string_t * name = READ_STRING();
-                if (value_hash_table_set(&virtualMachine.globals, name, virtual_machine_peek(0))) {
-                    value_hash_table_delete(&virtualMachine.globals, name);
-                    virtual_machine_runtime_error("Undefined variable '%s'.", name->chars);
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                break;
-            }
-        case OP_SET_INDEX_OF:
-            {
-                if (!virtual_machine_set_index_of()) {
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                break;
-            }
-        case OP_SET_LOCAL:
-            {
-                // We set the value at the specified slot to the value that is stored on the top of the stack of the
-                // virtual machine.
-                uint8_t slot = READ_BYTE();
-                frame->slots[slot] = virtual_machine_peek(0);
-                break;
-            }
-        case OP_SET_PROPERTY:
-            {
-                if (!IS_INSTANCE(virtual_machine_peek(1))) {
-                    virtual_machine_runtime_error("Only instances have fields but was called with a %s %s",
-                                                  value_stringify_type(virtual_machine_peek(1)),
-                                                  IS_OBJECT(virtual_machine_peek(1)) ? "object" : "value");
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                object_instance_t * instance = AS_INSTANCE(virtual_machine_peek(1));
-                value_hash_table_set(&instance->fields, READ_STRING(), virtual_machine_peek(0));
-                value_t value = virtual_machine_pop();
-                virtual_machine_pop();
-                virtual_machine_push(value);
-                break;
-            }
-        case OP_SET_UPVALUE:
-            {
-                uint8_t slot = READ_BYTE();
-                *frame->closure->upvalues[slot]->location = virtual_machine_peek(0);
-                break;
-            }
-        case OP_SUBTRACT:
-            BINARY_OP(NUMBER_VAL, -);
-            break;
-        case OP_SUPER_INVOKE:
-            {
-                object_string_t * method = READ_STRING();
-                int argCount = READ_BYTE();
-                object_class_t * superclass = AS_CLASS(virtual_machine_pop());
-                if (!virtual_machine_invoke_from_class(superclass, method, argCount)) {
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
-                break;
-            }
-        case OP_TRUE:
-            virtual_machine_push(BOOL_VAL(true));
-            break;
         default:
-#if defined(COMPILER_MSVC) && !defined(BUILD_DEBUG)
+#if defined(COMPILER_MSVC) && !defined(BUILD_TYPE_DEBUG)
             // We assume this code to be unreachable.
             // This tells the optimizer that reaching default is undefiened behaviour 😨
             __assume(0);
@@ -1241,17 +1423,241 @@ static interpret_result virtual_machine_run() {
             exit(70);
 #endif
         }
+    }
+
+#undef VM_INSTRUCTION
+#undef VM_DISPATCH
+}
+
+#ifdef VIRTUAL_MACHINE_TAIL_CALL_AVAILABLE
+/// Makro that forces the compiler to emit a jump instead of a call - the handlers can't overflow the native stack
+#define MUSTTAIL __attribute__((musttail))
+
+/// Makro that defines the prototype of the function that executes a bytecode instruction
+#define HANDLER_PROTOTYPE(opcode) static interpret_result virtual_machine_execute_##opcode(call_frame_t *);
+
+CHUNK_OPCODES(HANDLER_PROTOTYPE)
+
+/// Makro that retrieves the function that executes the specified opcode
+#define HANDLER_ADDRESS(opcode) [opcode] = virtual_machine_execute_##opcode,
+
+/// Dispatch table with the functions that execute the bytecode instructions
+static virtual_machine_instruction_handler_t const dispatchHandlers[] = {CHUNK_OPCODES(HANDLER_ADDRESS)};
+
+/// Makro that starts the definition of a bytecode instruction
+#define VM_INSTRUCTION(opcode) static interpret_result virtual_machine_execute_##opcode(call_frame_t * frame)
+
+/// Makro that dipatches the next bytecode instuction
+#define VM_DISPATCH()                                           \
+    do {                                                        \
+        TRACE_INSTRUCTION();                                    \
+        MUSTTAIL return dispatchHandlers[READ_BYTE()](frame);   \
+    } while (false)
+
+#include "virtual_machine_instructions.h"
+
+/// @brief Executes the bytecode using tail calls
+/// @details Every bytecode instruction is executed by a separate function, that calls the function of the next
+/// instruction as a guaranteed tail call. The compiler optimizes every handler seperately and the call frame is kept
+/// in a register.
+/// @return The result of the interpretation
+static interpret_result virtual_machine_run_tail_call() {
+    call_frame_t * frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+    TRACE_INSTRUCTION();
+    return dispatchHandlers[READ_BYTE()](frame);
+}
+
+#undef MUSTTAIL
+#undef HANDLER_PROTOTYPE
+#undef HANDLER_ADDRESS
+#undef VM_INSTRUCTION
+#undef VM_DISPATCH
 #endif
+
+#ifdef VIRTUAL_MACHINE_JIT_AVAILABLE
+/// Makro that defines the prototype of the function that executes a bytecode instruction for the just in time compiler
+#define HANDLER_PROTOTYPE(opcode) static uint32_t virtual_machine_jit_##opcode(call_frame_t *);
+
+CHUNK_OPCODES(HANDLER_PROTOTYPE)
+
+/// Makro that retrieves the function that executes the specified opcode for the just in time compiler
+#define HANDLER_ADDRESS(opcode) [opcode] = virtual_machine_jit_##opcode,
+
+/// The functions that execute the bytecode instructions, that are called by the machine code of the just in time
+/// compiler and used to interpret functions that haven't been compiled yet
+static virtual_machine_jit_handler_t const jitHandlers[] = {CHUNK_OPCODES(HANDLER_ADDRESS)};
+
+#undef REEXECUTE_INSTRUCTION
+
+/// Makro that executes the rewritten instruction right away, because the caller continues after the instruction
+#define REEXECUTE_INSTRUCTION() return jitHandlers[frame->ip[-1]](frame)
+
+/// Makro that starts the definition of a bytecode instruction - most of the instructions without operands don't use
+/// the call frame
+#define VM_INSTRUCTION(opcode) static uint32_t virtual_machine_jit_##opcode(call_frame_t * frame __attribute__((unused)))
+
+/// Makro that returns to the machine code or the run loop, that dispatch the next bytecode instruction
+#define VM_DISPATCH()          return JIT_COMPILER_CONTINUE
+
+#include "virtual_machine_instructions.h"
+
+/// @brief Executes the call frames of the virtual machine until a call frame returns
+/// @param frameCount The amount of call frames, when the call frame that is executed was pushed
+/// @details Functions are interpreted until they have been called or have looped often enough, then their chunk is
+/// compiled into machine code. The machine code can be entered at every instruction, so a function is also compiled
+/// in the middle of a hot loop. The machine code of a caller calls this function again, to execute its callee.
+/// @return JIT_COMPILER_CONTINUE if the call frame has returned, otherwise the result of the interpretation
+static uint32_t virtual_machine_jit_execute(uint32_t frameCount) {
+    while (virtualMachine.frameCount >= frameCount) {
+        call_frame_t * frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+        object_function_t * function = frame->closure->function;
+        if (!function->jitCode.code && function->hotness >= VIRTUAL_MACHINE_JIT_THRESHOLD &&
+            !jit_compiler_compile(&function->jitCode, &function->chunk, (void * const *)jitHandlers,
+                                  (void *)virtual_machine_jit_execute)) {
+            // The function is interpreted until it has become hot again
+            function->hotness = 0u;
+        }
+        void * entry = function->jitCode.code ? function->jitCode.entries[frame->ip - function->chunk.code] : NULL;
+        uint32_t result;
+        if (entry) {
+            result = jit_compiler_execute(&function->jitCode, frame, entry);
+        } else {
+            TRACE_INSTRUCTION();
+            uint8_t instruction = READ_BYTE();
+            // Loop iterations are counted as well, otherwise a script with a hot loop would never be compiled
+            if (instruction == OP_LOOP || (instruction == OP_WIDE && *frame->ip == OP_LOOP)) {
+                function->hotness++;
+            }
+            result = jitHandlers[instruction](frame);
+        }
+        if (result != JIT_COMPILER_CONTINUE) {
+            return result;
+        }
     }
+    return JIT_COMPILER_CONTINUE;
+}
+
+/// @brief Executes the bytecode using the baseline just in time compiler
+/// @return The result of the interpretation
+static interpret_result virtual_machine_run_jit() {
+    return (interpret_result)virtual_machine_jit_execute(1u);
+}
+
+#undef HANDLER_PROTOTYPE
+#undef HANDLER_ADDRESS
+#undef VM_INSTRUCTION
+#undef VM_DISPATCH
+#endif
+
+#ifdef VIRTUAL_MACHINE_DIRECT_THREADED_AVAILABLE
 #undef READ_BYTE
 #undef READ_SHORT
 #undef READ_CONSTANT
 #undef READ_STRING
-#undef BINARY_OP
-#if !defined(BUILD_DEBUG) && (defined(COMPILER_GCC) || defined(COMPILER_Clang))
-#undef DISPATCH
-#endif
+#undef READ_INLINE_CACHE
+#undef READ_CALL_CACHE
+#undef SKIP_OPCODE
+#undef JUMP_FORWARD
+#undef JUMP_BACKWARD
+#undef REWRITE_INSTRUCTION
+#undef REEXECUTE_INSTRUCTION
+
+// The threaded code already contains the decoded operands, so every operand is read from a cell of its own
+
+/// Reads the next operand from the threaded code of the current frame
+#define READ_BYTE()           ((frame->threadedIp++)->operand)
+
+/// Reads the distance of a jump (in cells) from the threaded code of the current frame
+#define READ_SHORT()          ((frame->threadedIp++)->operand)
+
+/// Reads a constant from the threaded code of the current frame
+#define READ_CONSTANT()       (*(frame->threadedIp++)->constant)
+
+/// Reads a string constant from the threaded code of the current frame
+#define READ_STRING()         ((frame->threadedIp++)->string)
+
+/// Reads the address of an inline cache from the threaded code of the current frame
+#define READ_INLINE_CACHE()   ((frame->threadedIp++)->inlineCache)
+
+/// Reads the address of a call cache from the threaded code of the current frame
+#define READ_CALL_CACHE()     ((frame->threadedIp++)->callCache)
+
+/// Makro that skips the handler of an instruction that is executed as a part of a superinstruction
+#define SKIP_OPCODE()         (frame->threadedIp++)
+
+/// Makro that jumps forward in the threaded code of the current frame
+#define JUMP_FORWARD(offset)  (frame->threadedIp += (offset))
+
+/// Makro that jumps backward in the threaded code of the current frame
+#define JUMP_BACKWARD(offset) (frame->threadedIp -= (offset))
+
+/// Makro that rewrites the handler of the instruction that is executed in the threaded code of the current frame
+#define REWRITE_INSTRUCTION(opcode) (frame->threadedIp[-1].handler = directThreadedHandlers[(opcode)])
+
+/// Makro that makes sure the instruction that is executed is dispatched again (after it has been rewritten)
+#define REEXECUTE_INSTRUCTION()     (frame->threadedIp--)
+
+#undef NEXT_INSTRUCTION_INDEX
+
+/// Makro that determines the index of the next bytecode instruction in the chunk of the current frame
+#define NEXT_INSTRUCTION_INDEX()                                                                                      \
+    (frame->closure->function->threadedCode.opCodeIndexes[frame->threadedIp -                                        \
+                                                           frame->closure->function->threadedCode.cells])
+
+/// @brief Executes pre-decoded threaded code
+/// @details The chunks are translated into threaded code, that contains the addresses of the labels of the
+/// instructions and the decoded operands. Dispatching an instruction is a single indirect jump, without decoding the
+/// opcode or looking up the address in a dispatch table.
+/// @return The result of the interpretation
+static interpret_result virtual_machine_run_direct_threaded() {
+
+/// Makro that retrieves the address of the label of the specified opcode
+#define LABEL_ADDRESS(opcode) [opcode] = &&label_##opcode,
+
+    // The addresses of the labels that are stored in the threaded code
+    static void * const handlers[] = {CHUNK_OPCODES(LABEL_ADDRESS)};
+    directThreadedHandlers = handlers;
+    call_frame_t * frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+    // The frame of the script was created before the handlers were known
+    virtual_machine_enter_threaded_code(frame);
+
+/// Makro that starts the definition of a bytecode instruction
+#define VM_INSTRUCTION(opcode) label_##opcode:
+
+/// Makro that dipatches the next bytecode instuction
+#define VM_DISPATCH()                           \
+    do {                                        \
+        TRACE_INSTRUCTION();                    \
+        goto * (frame->threadedIp++)->handler;  \
+    } while (false)
+
+    VM_DISPATCH();
+#include "virtual_machine_instructions.h"
+
+#undef LABEL_ADDRESS
+#undef VM_INSTRUCTION
+#undef VM_DISPATCH
 }
+#endif
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef READ_CONSTANT
+#undef READ_STRING
+#undef READ_INLINE_CACHE
+#undef READ_CALL_CACHE
+#undef SKIP_OPCODE
+#undef JUMP_FORWARD
+#undef JUMP_BACKWARD
+#undef REWRITE_INSTRUCTION
+#undef REEXECUTE_INSTRUCTION
+#undef READ_REGISTER
+#undef QUICKEN_BINARY_OP
+#undef BINARY_OP
+#undef NUMBER_BINARY_OP
+#undef REGISTER_BINARY_OP
+#undef NEXT_INSTRUCTION_INDEX
+#undef TRACE_INSTRUCTION
 
 /// @brief Reports an error that has occured at runtime
 /// @param format The formater of the error message
@@ -1266,7 +1672,7 @@ static void virtual_machine_runtime_error(char const * format, ...) {
     for (int32_t i = virtualMachine.frameCount - 1; i >= 0; i--) {
         call_frame_t * frame = &virtualMachine.callStack[i];
         object_function_t * function = frame->closure->function;
-        size_t instruction = frame->ip - function->chunk.code - 1;
+        uint32_t instruction = virtual_machine_instruction_index(frame);
         fprintf(stderr, "[line %d] in ", chunk_determine_line_by_index(&function->chunk, instruction));
         if (!function->name) {
             fprintf(stderr, "script\n");
@@ -1288,14 +1694,96 @@ static bool virtual_machine_set_index_of() {
             virtual_machine_runtime_error("accessed array out of bounds at index %d", num);
             return false;
         }
-        array->array.values[num] = val;
+        GC_STORE_SLOT(array->array.values[num], val);
+        garbage_collector_write_barrier(&array->obj, val);
         virtual_machine_push(OBJECT_VAL(array));
     } else {
-        virtual_machine_runtime_error(
+        virtual_machine_operands_error(
             "Can only be called with an used with an arry and a number but was used with a %s %s and a %s %s",
-            value_stringify_type(virtual_machine_peek(0)), IS_OBJECT(virtual_machine_peek(0)) ? "object" : "value",
-            value_stringify_type(virtual_machine_peek(1)), IS_OBJECT(virtual_machine_peek(1)) ? "object" : "value");
+            virtual_machine_peek(0), virtual_machine_peek(1));
         return false;
     }
     return true;
 }
+
+/// @brief Sets a property of the instance below the value on top of the stack
+/// @param name The name of the property
+/// @param cache The inline cache of the call site
+/// @return A boolean value that indicates whether the execution has led to a runtime error
+/// @details The instance is removed from the stack, the assigned value stays on top of the stack. If the instance
+/// doesn't have a field with the name yet, the field is added and the instance transitions to another shape
+static inline bool virtual_machine_set_property(object_string_t * name, inline_cache_t * cache) {
+    if (!IS_INSTANCE(virtual_machine_peek(1))) {
+        virtual_machine_operand_error("Only instances have fields but was called with a %s %s",
+                                      virtual_machine_peek(1));
+        return false;
+    }
+    object_instance_t * instance = AS_INSTANCE(virtual_machine_peek(1));
+    inline_cache_entry_t * entry = virtual_machine_inline_cache_lookup(cache, instance);
+    if (!entry) {
+        uint32_t slot = object_shape_find_field(instance->shape, name);
+        object_shape_t * transition = NULL;
+        if (slot == OBJECT_SHAPE_NO_FIELD) {
+            transition = object_shape_transition(instance->shape, name);
+            slot = transition->fieldCount - 1u;
+        }
+        inline_cache_update(cache, instance->shape, slot, NULL_VAL, transition);
+        virtual_machine_cache_write_barrier(&instance->celloxClass->obj);
+        // The entry that has been created most recently is stored first
+        entry = cache->entries;
+    }
+    if (entry->transition) {
+        object_instance_add_field(instance, entry->transition, virtual_machine_peek(0));
+    } else {
+        GC_STORE_SLOT(*object_instance_field(instance, entry->fieldIndex), virtual_machine_peek(0));
+        garbage_collector_write_barrier(&instance->obj, virtual_machine_peek(0));
+    }
+    // The value that is assigned to the property
+    value_t value = virtual_machine_pop();
+    virtual_machine_pop();
+    virtual_machine_push(value);
+    return true;
+}
+
+/// @brief Calls a closure in tail position
+/// @param closure The closure that is called
+/// @param argCount The amount of arguments that are used for the call
+/// @return true if everything went well, false if the amount of arguments doesn't match the arity of the closure
+/// @details The call frame of the current function is reused - the upvalues of the current function are closed like it
+/// is done by OP_RETURN, the closure and the arguments are moved to the first slot of the frame and the frame is
+/// entered again. The depth of the callstack doesn't grow, so tail recursive functions can't overflow it
+static bool virtual_machine_tail_call(object_closure_t * closure, int32_t argCount) {
+    if (argCount != closure->function->arity) {
+        virtual_machine_runtime_error("Expected %d arguments but got %d.", closure->function->arity, argCount);
+        return false;
+    }
+    call_frame_t * frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+    virtual_machine_close_upvalues(frame->slots);
+    memmove(frame->slots, virtualMachine.stackTop - argCount - 1, (size_t)(argCount + 1) * sizeof(value_t));
+    virtualMachine.stackTop = frame->slots + argCount + 1;
+    virtualMachine.frameCount--;
+    return virtual_machine_call(closure, argCount);
+}
+
+#if defined(DEBUG_TRACE_EXECUTION) || defined(PROFILE_OPCODES)
+/// @brief Traces the execution of the next bytecode instruction
+/// @param frame The call frame the instruction belongs to
+/// @param opCodeIndex The index of the instruction in the chunk of the function
+/// @details Records the instruction in the opcode profiler and / or prints all the values located on the stack and
+/// disassembles the instruction
+static void virtual_machine_trace_instruction(call_frame_t * frame, uint32_t opCodeIndex) {
+#ifdef PROFILE_OPCODES
+    opcode_profiler_record(&frame->closure->function->chunk, opCodeIndex);
+#endif
+#ifdef DEBUG_TRACE_EXECUTION
+    printf("          ");
+    for (value_t * slot = virtualMachine.stack; slot < virtualMachine.stackTop; slot++) {
+        printf("[ ");
+        value_print(*slot);
+        printf(" ]");
+    }
+    printf("\n");
+    chunk_disassembler_disassemble_instruction(&frame->closure->function->chunk, (int32_t)opCodeIndex);
+#endif
+}
+#endif
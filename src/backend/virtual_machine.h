@@ -24,14 +24,22 @@
 
 #include "../language-models/data-structures/value_hash_table.h"
 #include "../language-models/object.h"
+#include "garbage_collector.h"
 
+#ifndef FRAMES_MAX
 /// @brief Maximum amount of frames the virtual machine can hold
-/// @details The maxiimum depth of the callstack
-#define FRAMES_MAX 64
+/// @details The maximum depth of the callstack - can be configured using CLX_MAX_CALL_DEPTH
+#define FRAMES_MAX (16384u)
+#endif
 
 /// @brief Maximum amount values that can be allocated on the stack of the VirtualMachine
-/// @details These are currently 16384 values
-#define STACK_MAX  (FRAMES_MAX * UINT8_COUNT)
+#define STACK_MAX      (FRAMES_MAX * UINT8_COUNT)
+
+/// @brief Amount of frames the callstack can hold, before it has to grow for the first time
+#define FRAMES_INITIAL (8u)
+
+/// @brief Amount of values the stack can hold, before it has to grow for the first time
+#define STACK_INITIAL  (2u * UINT8_COUNT)
 
 /// @brief A call frame structure
 /// @details This represents a single ongoing function call
@@ -40,6 +48,8 @@ typedef struct {
     object_closure_t * closure;
     /// The instruction pointer in the callframe
     uint8_t * ip;
+    /// The instruction pointer in the threaded code of the function - only used by the direct threaded dispatch
+    threaded_code_cell_t * threadedIp;
     /// Points to the first slot in the stack of the virtualMachine the function can use
     value_t * slots;
 } call_frame_t;
@@ -47,35 +57,65 @@ typedef struct {
 /// @brief A virtual machine
 /// @details The processbased virtual machine that is used by the cellox compiler is a stackbased virtual machine
 typedef struct {
-    /// Callstack of the virtual machine
-    call_frame_t callStack[FRAMES_MAX];
+    /// Callstack of the virtual machine - grows on demand until it holds FRAMES_MAX frames
+    call_frame_t * callStack;
     /// The amount of callframes the virtualMachine currently holds
     uint32_t frameCount;
+    /// The amount of callframes the callstack can hold before it has to grow
+    uint32_t frameCapacity;
     /// Amount of objects in the virtual machine that are marked as gray -> objects that are already discovered but
     /// haven't been processed yet
     uint32_t grayCount;
     /// The capacity of the dynamic array storing the objects that were marked as gray
     uint32_t grayCapacity;
-    /// Stack of the virtualMachine
-    value_t stack[STACK_MAX];
+    /// Stack of the virtualMachine - grows on demand until it holds STACK_MAX values
+    value_t * stack;
     /// Pointer to the top of the stack
     value_t * stackTop;
-    /// Hashtable that contains the global variables
+    /// The amount of values the stack can hold before it has to grow
+    uint32_t stackCapacity;
+    /// Hashtable that maps the names of the global variables to their slots in the global value array
     value_hash_table_t globals;
+    /// The values of the global variables - the slots are resolved by the compiler
+    dynamic_value_array_t globalValues;
     /// Hashtable that contains the strings
     value_hash_table_t strings;
     /// String "init" used to look up the initializer of a class - reused for every init call
     object_string_t * initString;
-    /// Upvalues of the closures of all the functions on the callstack
-    object_upvalue_t * openUpvalues;
+    /// Open upvalues of the closures of all the functions on the callstack - indexed by the slot of the captured local
+    /// variable (NULL if the slot isn't captured), grows together with the stack
+    object_upvalue_t ** openUpvalues;
+    /// Every open upvalue captures a slot below this slot
+    uint32_t openUpvalueTop;
     /// Number of bytes that have been allocated by the virtualMachine
     size_t bytesAllocated;
-    /// A treshhold when the next garbage Collection shall be triggered (e.g. a Megabyte)
+    /// Number of bytes that were allocated by the virtualMachine after the last garbage collection - all the objects
+    /// that survived it belong to the old generation
+    size_t oldGenerationSize;
+    /// A treshhold of the size of the old generation when the next garbage collection shall be a major one (e.g. a
+    /// Megabyte)
     size_t nextGC;
-    /// The objects that are allocated in the memory of the virtualMachine
+    /// A treshhold when the next garbage collection shall be triggered - the size of the nursery above the size of the
+    /// old generation
+    size_t nextMinorGC;
+    /// The objects of the old generation - they have survived at least one garbage collection
     object_t * objects;
+    /// The objects of the young generation (nursery) - they have been allocated since the last garbage collection
+    object_t * youngObjects;
     /// The stack that contains all the gray objects
     object_t ** grayStack;
+    /// The phase of the major garbage collection that is in progress
+    garbage_collector_phase gcPhase;
+    /// The link to the next object of the old generation that is unmarked or swept by the incremental major garbage
+    /// collection
+    object_t ** sweepCursor;
+    /// Objects of the old generation that refer to objects of the young generation - recorded by the write barrier and
+    /// traced by the next minor garbage collection
+    object_t ** rememberedSet;
+    /// Amount of objects in the remembered set
+    uint32_t rememberedCount;
+    /// The capacity of the dynamic array storing the remembered set
+    uint32_t rememberedCapacity;
     /// The source code of the program
     char * program;
 } virtual_machine_t;
@@ -90,6 +130,20 @@ typedef enum {
     INTERPRET_RUNTIME_ERROR,
 } interpret_result;
 
+/// @brief Technique that is used by the virtual machine to dispatch the bytecode instructions
+typedef enum {
+    /// A single switch statement that is executed in a loop
+    DISPATCH_TECHNIQUE_SWITCH,
+    /// A dispatch table with the addresses of labels (GCC and Clang only)
+    DISPATCH_TECHNIQUE_COMPUTED_GOTO,
+    /// A dispatch table with functions that call each other using guaranteed tail calls (requires musttail)
+    DISPATCH_TECHNIQUE_TAIL_CALL,
+    /// Pre-decoded threaded code that contains the addresses of labels and decoded operands (GCC and Clang only)
+    DISPATCH_TECHNIQUE_DIRECT_THREADED,
+    /// Machine code that is created by a baseline just in time compiler for hot functions (x86-64 Linux only)
+    DISPATCH_TECHNIQUE_JIT,
+} dispatch_technique;
+
 extern virtual_machine_t virtualMachine;
 
 /// Deallocates the memory used by the virtual machine
@@ -106,10 +160,29 @@ interpret_result virtual_machine_interpret(char * program, bool freeProgram);
 
 interpret_result virtual_machine_run_chunk(chunk_t chunk);
 
+/// @brief Gets the slot of a global variable in the global value array
+/// @param name The name of the global variable
+/// @return The index of the slot where the value of the global variable is stored
+/// @details If the global variable is not known yet, a new slot is allocated that is marked as undefined until the
+/// variable is defined
+uint32_t virtual_machine_global_slot(object_string_t * name);
+
 /// @brief Pushes a new Value on the stack
 /// @param value The value that is pushed on the stack
+/// @details The capacity of the stack isn't checked - the maximum stack depth of a function is reserved when it is
+/// called
 void virtual_machine_push(value_t value);
 
+/// @brief Sets the technique that is used to dispatch the bytecode instructions
+/// @param technique The dispatch technique that is used from now on
+/// @return true if the dispatch technique was compiled into the virtual machine, false if not
+bool virtual_machine_set_dispatch_technique(dispatch_technique technique);
+
+/// @brief Determines whether a dispatch technique was compiled into the virtual machine
+/// @param technique The dispatch technique that is checked
+/// @return true if the dispatch technique is supported, false if not
+bool virtual_machine_supports_dispatch_technique(dispatch_technique technique);
+
 /// @brief Pops a value from the stack
 /// @return The value that was popped from the stack
 value_t virtual_machine_pop();
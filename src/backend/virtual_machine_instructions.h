@@ -0,0 +1,577 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file virtual_machine_instructions.h
+ * @brief File containing the definitions of the bytecode instructions that are executed by the virtual machine.
+ * @details This file has no include guard on purpose. It is included once by virtual_machine.c for every dispatch
+ * technique that is compiled into the virtual machine. Before the inclusion the following macros have to be defined:
+ * VM_INSTRUCTION(opcode) - Starts the definition of the handler of the specified opcode (label, case or function)
+ * VM_DISPATCH() - Dispatches the next bytecode instruction
+ * The handlers can access the current call frame through the variable frame and leave the virtual machine with a
+ * return statement. The operands are read using the READ_ makros and jumps are performed using the JUMP_ makros, so
+ * the handlers can be used for the bytecode as well as for the pre-decoded threaded code.
+ * The OP_REGISTER_ instructions are three-address instructions, that operate directly on the slots of the call frame
+ * (the registers) and the constants of the chunk instead of the stack.
+ * The superinstructions execute a sequence of instructions at once. They read the operands of all the instructions of
+ * the sequence and skip the opcodes of the instructions after the first one using SKIP_OPCODE().
+ * The generic arithmetic and comparison instructions quicken themselves using REWRITE_INSTRUCTION(), if they are
+ * executed with two numbers. The quickened instructions deoptimize themselves, if their guard fails.
+ */
+
+VM_INSTRUCTION(OP_ADD) {
+    QUICKEN_BINARY_OP(OP_ADD_NUMBER);
+    if (!virtual_machine_add()) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_ADD_NUMBER) {
+    NUMBER_BINARY_OP(NUMBER_VAL, +, OP_ADD);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_ARRAY_LITERAL) {
+    virtual_machine_array_literal(READ_BYTE());
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_CALL) {
+    int32_t argCount = READ_BYTE();
+    call_cache_t * cache = READ_CALL_CACHE();
+    if (!virtual_machine_call_value(virtual_machine_peek(argCount), argCount, cache, false)) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_CALL_INTRINSIC) {
+    uint8_t native = READ_BYTE();
+    int32_t argCount = READ_BYTE();
+    if (!virtual_machine_call_intrinsic(native, argCount)) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    // A call frame was pushed, if the global variable of the native function holds a closure now
+    frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_CLASS) {
+    virtual_machine_push(OBJECT_VAL(object_new_class(READ_STRING())));
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_CLOSURE) {
+    object_function_t * function = AS_FUNCTION(READ_CONSTANT());
+    // Functions that don't capture any variables share a single closure, so the declaration doesn't allocate
+    if (!function->upvalueCount && !function->capturedValueCount) {
+        virtual_machine_push(OBJECT_VAL(object_function_closure(function)));
+        VM_DISPATCH();
+    }
+    object_closure_t * closure = object_new_closure(function);
+    virtual_machine_push(OBJECT_VAL(closure));
+    for (uint32_t i = 0; i < closure->upvalueCount; i++) {
+        uint8_t isLocal = READ_BYTE();
+        uint8_t index = READ_BYTE();
+        closure->upvalues[i] =
+            isLocal ? virtual_machine_capture_upvalue(frame->slots + index) : frame->closure->upvalues[index];
+        // Capturing an upvalue can trigger a garbage collection that promotes the closure
+        garbage_collector_write_barrier_object(&closure->obj, &closure->upvalues[i]->obj);
+    }
+    for (uint32_t i = 0; i < closure->capturedValueCount; i++) {
+        uint8_t isLocal = READ_BYTE();
+        uint8_t index = READ_BYTE();
+        CLOSURE_CAPTURED_VALUES(closure)[i] =
+            isLocal ? frame->slots[index] : CLOSURE_CAPTURED_VALUES(frame->closure)[index];
+        garbage_collector_write_barrier(&closure->obj, CLOSURE_CAPTURED_VALUES(closure)[i]);
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_CLOSE_UPVALUE) {
+    virtual_machine_close_upvalues(virtualMachine.stackTop - 1);
+    virtual_machine_pop();
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_CONSTANT) {
+    value_t constant = READ_CONSTANT();
+    virtual_machine_push(constant);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_DEFINE_GLOBAL) {
+    // The name of the global is skipped, the slot of the global was resolved by the compiler
+    (void)READ_STRING();
+    virtualMachine.globalValues.values[READ_SHORT()] = virtual_machine_peek(0);
+    virtual_machine_pop();
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_DIVIDE) {
+    QUICKEN_BINARY_OP(OP_DIVIDE_NUMBER);
+    BINARY_OP(NUMBER_VAL, /);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_DIVIDE_NUMBER) {
+    NUMBER_BINARY_OP(NUMBER_VAL, /, OP_DIVIDE);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_EQUAL) {
+    value_t a = virtual_machine_pop();
+    value_t b = virtual_machine_pop();
+    virtual_machine_push(BOOL_VAL(value_values_equal(a, b)));
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_EXPONENT) {
+    QUICKEN_BINARY_OP(OP_EXPONENT_NUMBER);
+    if (IS_NUMBER(virtual_machine_peek(0)) && IS_NUMBER(virtual_machine_peek(1))) {
+        double b = AS_NUMBER(virtual_machine_pop());
+        double a = AS_NUMBER(virtual_machine_pop());
+        virtual_machine_push(NUMBER_VAL(pow(a, b)));
+    } else {
+        virtual_machine_operand_types_error("Operands must be two numbers but they are a %s value and a %s value",
+                                            virtual_machine_peek(0), virtual_machine_peek(1));
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_EXPONENT_NUMBER) {
+    value_t b = virtual_machine_peek(0);
+    value_t a = virtual_machine_peek(1);
+    if (IS_NUMBER(a) && IS_NUMBER(b)) {
+        virtualMachine.stackTop--;
+        virtualMachine.stackTop[-1] = NUMBER_VAL(pow(AS_NUMBER(a), AS_NUMBER(b)));
+    } else {
+        REWRITE_INSTRUCTION(OP_EXPONENT);
+        REEXECUTE_INSTRUCTION();
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_FALSE) {
+    virtual_machine_push(BOOL_VAL(false));
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_GET_CAPTURED_VALUE) {
+    uint8_t index = READ_BYTE();
+    virtual_machine_push(CLOSURE_CAPTURED_VALUES(frame->closure)[index]);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_GET_GLOBAL) {
+    object_string_t * name = READ_STRING();
+    value_t value = virtualMachine.globalValues.values[READ_SHORT()];
+    if (IS_UNDEFINED(value)) {
+        virtual_machine_runtime_error("Undefined variable '%s'.", name->chars);
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    virtual_machine_push(value);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_GET_INDEX_OF) {
+    if (!virtual_machine_get_index_of()) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_GET_LOCAL) {
+    virtual_machine_push(frame->slots[READ_BYTE()]);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_GET_LOCAL_GET_PROPERTY) {
+    virtual_machine_push(frame->slots[READ_BYTE()]);
+    SKIP_OPCODE();
+    object_string_t * name = READ_STRING();
+    if (!virtual_machine_get_property(name, READ_INLINE_CACHE())) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_GET_PROPERTY) {
+    object_string_t * name = READ_STRING();
+    if (!virtual_machine_get_property(name, READ_INLINE_CACHE())) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_GET_SLICE_OF) {
+    if (!virtual_machine_get_slice_of()) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_GET_SUPER) {
+    object_string_t * name = READ_STRING();
+    object_class_t * superclass = AS_CLASS(virtual_machine_pop());
+    if (!virtual_machine_bind_method(superclass, name)) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_GET_UPVALUE) {
+    uint8_t slot = READ_BYTE();
+    virtual_machine_push(*frame->closure->upvalues[slot]->location);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_GREATER) {
+    QUICKEN_BINARY_OP(OP_GREATER_NUMBER);
+    BINARY_OP(BOOL_VAL, >);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_GREATER_NUMBER) {
+    NUMBER_BINARY_OP(BOOL_VAL, >, OP_GREATER);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_INHERIT) {
+    value_t superclass = virtual_machine_peek(1);
+    if (!IS_CLASS(superclass)) {
+        virtual_machine_operand_error("Superclass must be a class but is a %s %s", superclass);
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    object_class_t * subclass = AS_CLASS(virtual_machine_peek(0));
+    value_hash_table_add_all(&AS_CLASS(superclass)->methods, &subclass->methods);
+    // The inherited methods can be young
+    garbage_collector_remember(&subclass->obj);
+    subclass->version++;
+    virtual_machine_pop(); // Subclass.
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_INVOKE) {
+    object_string_t * method = READ_STRING();
+    int argCount = READ_BYTE();
+    if (!virtual_machine_invoke(method, argCount, READ_INLINE_CACHE(), false)) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_JUMP) {
+    // The offset of a wide jump can exceed 16 bits in the threaded code
+    uint32_t offset = READ_SHORT();
+    // We jump 🦘
+    JUMP_FORWARD(offset);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_JUMP_IF_FALSE) {
+    uint32_t offset = READ_SHORT();
+    if (virtual_machine_is_falsey(virtual_machine_peek(0))) {
+        // We jump 🦘
+        JUMP_FORWARD(offset);
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_LESS) {
+    QUICKEN_BINARY_OP(OP_LESS_NUMBER);
+    BINARY_OP(BOOL_VAL, <);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_LESS_JUMP_IF_FALSE) {
+    BINARY_OP(BOOL_VAL, <);
+    SKIP_OPCODE();
+    uint16_t offset = READ_SHORT();
+    SKIP_OPCODE();
+    // The condition is popped in both cases, so we jump over the OP_POP at the jump target
+    if (!AS_BOOL(virtual_machine_pop())) {
+        JUMP_FORWARD(offset);
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_LESS_NUMBER) {
+    NUMBER_BINARY_OP(BOOL_VAL, <, OP_LESS);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_LOOP) {
+    uint32_t offset = READ_SHORT();
+    JUMP_BACKWARD(offset);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_METHOD) {
+    virtual_machine_define_method(READ_STRING());
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_MODULO) {
+    if (!virtual_machine_modulo()) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_MULTIPLY) {
+    QUICKEN_BINARY_OP(OP_MULTIPLY_NUMBER);
+    BINARY_OP(NUMBER_VAL, *);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_MULTIPLY_NUMBER) {
+    NUMBER_BINARY_OP(NUMBER_VAL, *, OP_MULTIPLY);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_NEGATE) {
+    // Not quickened - numbers are the only operands, so this is already the single guard of a quickened instruction
+    if (!IS_NUMBER(virtual_machine_peek(0))) {
+        virtual_machine_operand_error("Operand must be a number but is a %s %s.", virtual_machine_peek(0));
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    virtual_machine_push(NUMBER_VAL(-AS_NUMBER(virtual_machine_pop())));
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_NOT) {
+    virtual_machine_push(BOOL_VAL(virtual_machine_is_falsey(virtual_machine_pop())));
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_NULL) {
+    virtual_machine_push(NULL_VAL);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_POP) {
+    virtual_machine_pop();
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_REGISTER_ADD) {
+    uint8_t destination = READ_BYTE();
+    value_t a = READ_REGISTER();
+    value_t b = READ_REGISTER();
+    if (IS_NUMBER(a) && IS_NUMBER(b)) {
+        virtual_machine_register_store(frame, destination, NUMBER_VAL(AS_NUMBER(a) + AS_NUMBER(b)));
+        VM_DISPATCH();
+    }
+    // Strings and arrays are added on the stack
+    virtual_machine_push(a);
+    virtual_machine_push(b);
+    if (!virtual_machine_add()) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    if (destination != REGISTER_DESTINATION_STACK) {
+        frame->slots[destination] = virtual_machine_pop();
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_REGISTER_DIVIDE) {
+    REGISTER_BINARY_OP(NUMBER_VAL, /);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_REGISTER_EQUAL) {
+    uint8_t destination = READ_BYTE();
+    value_t a = READ_REGISTER();
+    value_t b = READ_REGISTER();
+    virtual_machine_register_store(frame, destination, BOOL_VAL(value_values_equal(a, b)));
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_REGISTER_GREATER) {
+    REGISTER_BINARY_OP(BOOL_VAL, >);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_REGISTER_LESS) {
+    REGISTER_BINARY_OP(BOOL_VAL, <);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_REGISTER_LESS_JUMP_IF_FALSE) {
+    // The destination is always the stack, but the condition would be popped right away
+    (void)READ_BYTE();
+    value_t a = READ_REGISTER();
+    value_t b = READ_REGISTER();
+    if (!IS_NUMBER(a) || !IS_NUMBER(b)) {
+        virtual_machine_push(a);
+        virtual_machine_push(b);
+        BINARY_OP(BOOL_VAL, <);
+    }
+    SKIP_OPCODE();
+    uint16_t offset = READ_SHORT();
+    SKIP_OPCODE();
+    // We jump over the OP_POP at the jump target as well
+    if (!(AS_NUMBER(a) < AS_NUMBER(b))) {
+        JUMP_FORWARD(offset);
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_REGISTER_MOVE) {
+    uint8_t destination = READ_BYTE();
+    virtual_machine_register_store(frame, destination, READ_REGISTER());
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_REGISTER_MULTIPLY) {
+    REGISTER_BINARY_OP(NUMBER_VAL, *);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_REGISTER_SUBTRACT) {
+    REGISTER_BINARY_OP(NUMBER_VAL, -);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_RETURN) {
+    value_t result = virtual_machine_pop();
+    virtual_machine_close_upvalues(frame->slots);
+    virtualMachine.frameCount--;
+    if (!virtualMachine.frameCount) {
+        virtual_machine_pop();
+        return INTERPRET_OK;
+    }
+    virtualMachine.stackTop = frame->slots;
+    virtual_machine_push(result);
+    frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_SET_GLOBAL) {
+    object_string_t * name = READ_STRING();
+    value_t * global = &virtualMachine.globalValues.values[READ_SHORT()];
+    // A global can only be assigned after it has been defined
+    if (IS_UNDEFINED(*global)) {
+        virtual_machine_runtime_error("Undefined variable '%s'.", name->chars);
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    *global = virtual_machine_peek(0);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_SET_GLOBAL_POP) {
+    object_string_t * name = READ_STRING();
+    value_t * global = &virtualMachine.globalValues.values[READ_SHORT()];
+    if (IS_UNDEFINED(*global)) {
+        virtual_machine_runtime_error("Undefined variable '%s'.", name->chars);
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    *global = virtual_machine_peek(0);
+    SKIP_OPCODE();
+    virtual_machine_pop();
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_SET_INDEX_OF) {
+    if (!virtual_machine_set_index_of()) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_SET_LOCAL) {
+    // We set the value at the specified slot to the value that is stored on the top of the stack of the virtual
+    // machine.
+    frame->slots[READ_BYTE()] = virtual_machine_peek(0);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_SET_PROPERTY) {
+    object_string_t * name = READ_STRING();
+    if (!virtual_machine_set_property(name, READ_INLINE_CACHE())) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_SET_UPVALUE) {
+    object_upvalue_t * upvalue = frame->closure->upvalues[READ_BYTE()];
+    GC_STORE_SLOT(*upvalue->location, virtual_machine_peek(0));
+    garbage_collector_write_barrier(&upvalue->obj, virtual_machine_peek(0));
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_SUBTRACT) {
+    QUICKEN_BINARY_OP(OP_SUBTRACT_NUMBER);
+    BINARY_OP(NUMBER_VAL, -);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_SUBTRACT_NUMBER) {
+    NUMBER_BINARY_OP(NUMBER_VAL, -, OP_SUBTRACT);
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_SUPER_INVOKE) {
+    object_string_t * method = READ_STRING();
+    int argCount = READ_BYTE();
+    object_class_t * superclass = AS_CLASS(virtual_machine_pop());
+    if (!virtual_machine_invoke_from_class(superclass, method, argCount)) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_TAIL_CALL) {
+    int32_t argCount = READ_BYTE();
+    call_cache_t * cache = READ_CALL_CACHE();
+    if (!virtual_machine_call_value(virtual_machine_peek(argCount), argCount, cache, true)) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    // The current call frame is either reused or a native / initializer was called and OP_RETURN follows
+    frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_TAIL_INVOKE) {
+    object_string_t * method = READ_STRING();
+    int argCount = READ_BYTE();
+    if (!virtual_machine_invoke(method, argCount, READ_INLINE_CACHE(), true)) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_TRUE) {
+    virtual_machine_push(BOOL_VAL(true));
+    VM_DISPATCH();
+}
+
+VM_INSTRUCTION(OP_WIDE) {
+    // Only executed by the dispatch techniques that execute the bytecode - the threaded code contains the narrow
+    // instructions with the decoded wide operands
+    if (!virtual_machine_execute_wide(frame)) {
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    frame = &virtualMachine.callStack[virtualMachine.frameCount - 1];
+    VM_DISPATCH();
+}
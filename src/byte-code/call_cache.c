@@ -0,0 +1,42 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file call_cache.c
+ * @brief File containing the implementation of functionality regarding call caches.
+ */
+
+#include "call_cache.h"
+
+#include "../backend/garbage_collector.h"
+#include "../language-models/object.h"
+
+void call_cache_init(call_cache_t * cache) {
+    cache->callee = NULL;
+    cache->kind = CALL_CACHE_EMPTY;
+    cache->classVersion = 0u;
+    cache->initializer = NULL;
+}
+
+void call_cache_mark(call_cache_t * cache) {
+    garbage_collector_mark_object(GC_LOAD_SLOT(cache->callee));
+}
+
+void call_cache_update(call_cache_t * cache, object_t * callee, call_cache_kind kind, object_t * initializer) {
+    GC_STORE_SLOT(cache->callee, callee);
+    cache->kind = kind;
+    cache->classVersion = kind == CALL_CACHE_CLASS ? ((object_class_t *)callee)->version : 0u;
+    cache->initializer = initializer;
+}
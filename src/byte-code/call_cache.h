@@ -0,0 +1,71 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file call_cache.h
+ * @brief Header file containing the declarations of functionality regarding call caches.
+ * @details A call cache belongs to a single call site of a call expression in a chunk. It stores the callee that was
+ * called the last time and the kind of the callee, so the type of the callee doesn't have to be determined again if
+ * the same callee is called the next time. If the callee is a class, the initializer of the class is stored as well,
+ * so it doesn't have to be looked up every time an instance of the class is created.
+ */
+
+#ifndef CELLOX_CALL_CACHE_H_
+#define CELLOX_CALL_CACHE_H_
+
+#include "../common.h"
+#include "../language-models/value.h"
+
+/// @brief Kind of the callee that is stored in a call cache
+typedef enum {
+    /// The cache doesn't store a callee
+    CALL_CACHE_EMPTY,
+    /// The callee is a class - the cache stores the initializer of the class
+    CALL_CACHE_CLASS,
+    /// The callee is a closure
+    CALL_CACHE_CLOSURE,
+    /// The callee is a native function
+    CALL_CACHE_NATIVE,
+} call_cache_kind;
+
+/// @brief A call cache of a single call site
+typedef struct {
+    /// The callee that was called the last time or NULL if the cache is empty
+    object_t * callee;
+    /// The kind of the callee
+    call_cache_kind kind;
+    /// The version of the class when the cache was updated - the initializer is invalid if the version has changed
+    uint32_t classVersion;
+    /// The closure that initializes an instance of the class or NULL if the class has no initializer
+    object_t * initializer;
+} call_cache_t;
+
+/// @brief Initializes a call cache
+/// @param cache The call cache that is initialized
+void call_cache_init(call_cache_t * cache);
+
+/// @brief Marks the callee that is stored in the call cache
+/// @param cache The call cache where the callee is marked
+/// @details The initializer is marked by the class, a cache with an outdated class version is never used
+void call_cache_mark(call_cache_t * cache);
+
+/// @brief Stores a callee in a call cache
+/// @param cache The call cache where the callee is stored
+/// @param callee The callee that was called
+/// @param kind The kind of the callee
+/// @param initializer The initializer of the class or NULL - only used if the callee is a class
+void call_cache_update(call_cache_t * cache, object_t * callee, call_cache_kind kind, object_t * initializer);
+
+#endif
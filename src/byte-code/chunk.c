@@ -22,12 +22,34 @@
 
 #include <stdlib.h>
 
+#include "../backend/garbage_collector.h"
 #include "../backend/memory_mutator.h"
 #include "../backend/virtual_machine.h"
 
 static void chunk_adjust_line_info_by_index(chunk_t *, uint32_t, int32_t);
 static inline bool chunk_byte_code_is_full(chunk_t *);
+static uint32_t chunk_instruction_successors(chunk_t const *, uint32_t, uint32_t[2]);
+static inline bool chunk_is_valid_instruction(chunk_t const *, uint32_t);
 static inline bool chunk_line_info_is_full(chunk_t *);
+static inline uint16_t chunk_read_short(chunk_t const *, uint32_t);
+static inline uint32_t chunk_read_word(chunk_t const *, uint32_t);
+static int32_t chunk_stack_effect(chunk_t const *, uint32_t);
+
+uint32_t chunk_add_call_cache(chunk_t * chunk) {
+    garbage_collector_begin_heap_change();
+    if (chunk->callCacheCapacity < chunk->callCacheCount + 1) {
+        uint32_t oldCapacity = chunk->callCacheCapacity;
+        chunk->callCacheCapacity = GROW_CAPACITY(oldCapacity);
+        chunk->callCaches = GROW_ARRAY(call_cache_t, chunk->callCaches, oldCapacity, chunk->callCacheCapacity);
+        if (!chunk->callCaches) {
+            exit(EXIT_CODE_SYSTEM_ERROR);
+        }
+    }
+    call_cache_init(chunk->callCaches + chunk->callCacheCount);
+    uint32_t index = chunk->callCacheCount++;
+    garbage_collector_end_heap_change();
+    return index;
+}
 
 int32_t chunk_add_constant(chunk_t * chunk, value_t value) {
     virtual_machine_push(value);
@@ -36,6 +58,75 @@ int32_t chunk_add_constant(chunk_t * chunk, value_t value) {
     return chunk->constants.count - 1;
 }
 
+uint32_t chunk_add_inline_cache(chunk_t * chunk) {
+    garbage_collector_begin_heap_change();
+    if (chunk->inlineCacheCapacity < chunk->inlineCacheCount + 1) {
+        uint32_t oldCapacity = chunk->inlineCacheCapacity;
+        chunk->inlineCacheCapacity = GROW_CAPACITY(oldCapacity);
+        chunk->inlineCaches =
+            GROW_ARRAY(inline_cache_t, chunk->inlineCaches, oldCapacity, chunk->inlineCacheCapacity);
+        if (!chunk->inlineCaches) {
+            exit(EXIT_CODE_SYSTEM_ERROR);
+        }
+    }
+    inline_cache_init(chunk->inlineCaches + chunk->inlineCacheCount);
+    uint32_t index = chunk->inlineCacheCount++;
+    garbage_collector_end_heap_change();
+    return index;
+}
+
+bool chunk_determine_max_stack_depth(chunk_t const * chunk, uint32_t * maxStackDepth) {
+    *maxStackDepth = 0u;
+    if (!chunk->byteCodeCount) {
+        return true;
+    }
+    // The stack depth before every reachable instruction - -1 if the instruction wasn't reached yet
+    int32_t * depths = malloc(sizeof(int32_t) * chunk->byteCodeCount);
+    // The indexes of the instructions whose successors have to be visited
+    uint32_t * worklist = malloc(sizeof(uint32_t) * chunk->byteCodeCount);
+    if (!depths || !worklist) {
+        exit(EXIT_CODE_SYSTEM_ERROR);
+    }
+    for (uint32_t i = 0u; i < chunk->byteCodeCount; i++) {
+        depths[i] = -1;
+    }
+    uint32_t worklistCount = 0u;
+    depths[0] = 0;
+    worklist[worklistCount++] = 0u;
+    bool valid = true;
+    while (valid && worklistCount) {
+        uint32_t i = worklist[--worklistCount];
+        if (!chunk_is_valid_instruction(chunk, i) || chunk_instruction_length(chunk, i) > chunk->byteCodeCount - i) {
+            valid = false;
+            break;
+        }
+        int32_t depth = depths[i] + chunk_stack_effect(chunk, i);
+        if (depth < 0) {
+            valid = false;
+            break;
+        }
+        if ((uint32_t)depth > *maxStackDepth) {
+            *maxStackDepth = (uint32_t)depth;
+        }
+        uint32_t successors[2];
+        uint32_t successorCount = chunk_instruction_successors(chunk, i, successors);
+        for (uint32_t j = 0u; j < successorCount; j++) {
+            if (successors[j] >= chunk->byteCodeCount) {
+                valid = false;
+            } else if (depths[successors[j]] == -1) {
+                depths[successors[j]] = depth;
+                worklist[worklistCount++] = successors[j];
+            } else if (depths[successors[j]] != depth) {
+                // Every path to an instruction has to leave the same amount of values on the stack
+                valid = false;
+            }
+        }
+    }
+    free(depths);
+    free(worklist);
+    return valid;
+}
+
 uint32_t chunk_determine_line_by_index(chunk_t * chunk, uint32_t opCodeIndex) {
     line_info_t * upperBound = chunk->lineInfos + chunk->lineInfoCount;
     for (line_info_t * lip = chunk->lineInfos; lip < upperBound; lip++) {
@@ -49,17 +140,106 @@ uint32_t chunk_determine_line_by_index(chunk_t * chunk, uint32_t opCodeIndex) {
 void chunk_free(chunk_t * chunk) {
     FREE_ARRAY(uint8_t, chunk->code, chunk->byteCodeCapacity);
     FREE_ARRAY(line_info_t, chunk->lineInfos, chunk->lineInfoCapacity);
+    FREE_ARRAY(inline_cache_t, chunk->inlineCaches, chunk->inlineCacheCapacity);
+    FREE_ARRAY(call_cache_t, chunk->callCaches, chunk->callCacheCapacity);
     dynamic_value_array_free(&chunk->constants);
     chunk_init(chunk);
 }
 
 void chunk_init(chunk_t * chunk) {
     chunk->byteCodeCount = chunk->byteCodeCapacity = chunk->lineInfoCount = chunk->lineInfoCapacity = 0;
+    chunk->inlineCacheCount = chunk->inlineCacheCapacity = 0;
+    chunk->callCacheCount = chunk->callCacheCapacity = 0;
     chunk->code = NULL;
     chunk->lineInfos = NULL;
+    chunk->inlineCaches = NULL;
+    chunk->callCaches = NULL;
+    chunk->maxStackDepth = 0u;
     dynamic_value_array_init(&chunk->constants);
 }
 
+uint32_t chunk_instruction_length(chunk_t const * chunk, uint32_t opCodeIndex) {
+    switch (chunk->code[opCodeIndex]) {
+    case OP_ARRAY_LITERAL:
+    case OP_CLASS:
+    case OP_CONSTANT:
+    case OP_GET_CAPTURED_VALUE:
+    case OP_GET_LOCAL:
+    case OP_GET_LOCAL_GET_PROPERTY:
+    case OP_GET_SUPER:
+    case OP_GET_UPVALUE:
+    case OP_METHOD:
+    case OP_SET_LOCAL:
+    case OP_SET_UPVALUE:
+        return 2u;
+    case OP_CALL_INTRINSIC:
+    case OP_JUMP:
+    case OP_JUMP_IF_FALSE:
+    case OP_LOOP:
+    case OP_REGISTER_MOVE:
+    case OP_SUPER_INVOKE:
+        return 3u;
+    case OP_CALL:
+    case OP_DEFINE_GLOBAL:
+    case OP_GET_GLOBAL:
+    case OP_GET_PROPERTY:
+    case OP_REGISTER_ADD:
+    case OP_REGISTER_DIVIDE:
+    case OP_REGISTER_EQUAL:
+    case OP_REGISTER_GREATER:
+    case OP_REGISTER_LESS:
+    case OP_REGISTER_LESS_JUMP_IF_FALSE:
+    case OP_REGISTER_MULTIPLY:
+    case OP_REGISTER_SUBTRACT:
+    case OP_SET_GLOBAL:
+    case OP_SET_GLOBAL_POP:
+    case OP_SET_PROPERTY:
+    case OP_TAIL_CALL:
+        return 4u;
+    case OP_INVOKE:
+    case OP_TAIL_INVOKE:
+        return 5u;
+    case OP_CLOSURE:
+        {
+            // The function is followed by a pair of operands for every upvalue and every value that is captured by
+            // the closure
+            object_function_t * function =
+                AS_FUNCTION(chunk->constants.values[chunk_read_constant_index(chunk, opCodeIndex)]);
+            return 2u + 2u * (function->upvalueCount + function->capturedValueCount);
+        }
+    case OP_WIDE:
+        // OP_WIDE and the two additional bytes of the wide operand
+        if (chunk->code[opCodeIndex + 1u] == OP_CLOSURE) {
+            object_function_t * function =
+                AS_FUNCTION(chunk->constants.values[chunk_read_constant_index(chunk, opCodeIndex)]);
+            return 5u + 2u * (function->upvalueCount + function->capturedValueCount);
+        }
+        return 3u + chunk_instruction_length(chunk, opCodeIndex + 1u);
+    default:
+        return 1u;
+    }
+}
+
+uint32_t chunk_jump_target(chunk_t const * chunk, uint32_t opCodeIndex) {
+    bool wide = chunk->code[opCodeIndex] == OP_WIDE;
+    // The offset is relative to the end of the jump
+    uint32_t end = opCodeIndex + (wide ? 6u : 3u);
+    uint32_t offset = wide ? chunk_read_word(chunk, opCodeIndex + 2u) : chunk_read_short(chunk, opCodeIndex + 1u);
+    if (chunk->code[opCodeIndex + (wide ? 1u : 0u)] == OP_LOOP) {
+        // A loop can't jump in front of the beginning of the chunk - the index would wrap around
+        return offset > end ? UINT32_MAX : end - offset;
+    }
+    return offset > UINT32_MAX - end ? UINT32_MAX : end + offset;
+}
+
+uint32_t chunk_read_constant_index(chunk_t const * chunk, uint32_t opCodeIndex) {
+    if (chunk->code[opCodeIndex] != OP_WIDE) {
+        return chunk->code[opCodeIndex + 1u];
+    }
+    return ((uint32_t)chunk->code[opCodeIndex + 2u] << 16) | ((uint32_t)chunk->code[opCodeIndex + 3u] << 8) |
+           chunk->code[opCodeIndex + 4u];
+}
+
 void chunk_remove_bytecode(chunk_t * chunk, uint32_t startIndex, uint32_t amount) {
     if (startIndex + amount >= chunk->byteCodeCount) {
         return;
@@ -75,71 +255,35 @@ void chunk_remove_constant(chunk_t * chunk, uint32_t constantIndex) {
 }
 
 void chunk_decrement_constant_indezes(chunk_t * chunk, uint32_t startIndex) {
-    for (size_t i = 0; i < chunk->byteCodeCount; i++) {
-        switch (chunk->code[i]) {
-        case OP_CONSTANT:
-            if (chunk->code[i + 1] >= startIndex) {
-                chunk->code[i + 1]--;
-            }
-        case OP_ARRAY_LITERAL:
-        case OP_CLASS:
-        case OP_DEFINE_GLOBAL:
-        case OP_GET_GLOBAL:
-        case OP_GET_PROPERTY:
-        case OP_GET_SUPER:
-        case OP_METHOD:
-        case OP_SET_GLOBAL:
-        case OP_SET_PROPERTY:
-        case OP_CALL:
-        case OP_GET_LOCAL:
-        case OP_GET_UPVALUE:
-        case OP_SET_LOCAL:
-        case OP_SET_UPVALUE:
-            i++;
-            break;
-        case OP_INVOKE:
-        case OP_JUMP:
-            i += 2;
-            break;
-        default:
-            break;
+    for (uint32_t i = 0; i < chunk->byteCodeCount; i += chunk_instruction_length(chunk, i)) {
+        if (chunk->code[i] == OP_CONSTANT && chunk->code[i + 1] >= startIndex) {
+            chunk->code[i + 1]--;
         }
     }
 }
 
 void chunk_replace_constant_references(chunk_t * chunk, uint32_t oldIndex, uint32_t replacementIndex) {
-    for (size_t i = 0; i < chunk->byteCodeCount; i++) {
-        switch (chunk->code[i]) {
-        case OP_CONSTANT:
-            if (chunk->code[i + 1] == oldIndex) {
-                chunk->code[i + 1] = replacementIndex;
-            }
-        case OP_ARRAY_LITERAL:
-        case OP_CLASS:
-        case OP_DEFINE_GLOBAL:
-        case OP_GET_GLOBAL:
-        case OP_GET_PROPERTY:
-        case OP_GET_SUPER:
-        case OP_METHOD:
-        case OP_SET_GLOBAL:
-        case OP_SET_PROPERTY:
-        case OP_CALL:
-        case OP_GET_LOCAL:
-        case OP_GET_UPVALUE:
-        case OP_SET_LOCAL:
-        case OP_SET_UPVALUE:
-            i++;
-            break;
-        case OP_INVOKE:
-        case OP_JUMP:
-            i += 2;
-            break;
-        default:
-            break;
+    for (uint32_t i = 0; i < chunk->byteCodeCount; i += chunk_instruction_length(chunk, i)) {
+        if (chunk->code[i] == OP_CONSTANT && chunk->code[i + 1] == oldIndex) {
+            chunk->code[i + 1] = replacementIndex;
         }
     }
 }
 
+void chunk_truncate(chunk_t * chunk, uint32_t byteCodeCount) {
+    chunk->byteCodeCount = byteCodeCount;
+    // Line infos that only contain removed bytecode instructions are removed
+    while (chunk->lineInfoCount &&
+           (chunk->lineInfoCount == 1 ? !byteCodeCount
+                                      : chunk->lineInfos[chunk->lineInfoCount - 2].lastOpCodeIndexInLine + 1u >=
+                                            byteCodeCount)) {
+        chunk->lineInfoCount--;
+    }
+    if (chunk->lineInfoCount && chunk->lineInfos[chunk->lineInfoCount - 1].lastOpCodeIndexInLine >= byteCodeCount) {
+        chunk->lineInfos[chunk->lineInfoCount - 1].lastOpCodeIndexInLine = byteCodeCount - 1u;
+    }
+}
+
 void chunk_write(chunk_t * chunk, uint8_t byte, int32_t line) {
     if (chunk_byte_code_is_full(chunk)) {
         // Stores the oldcapacity of the chunk so we know how much memory we have to allocate
@@ -195,9 +339,196 @@ static inline bool chunk_byte_code_is_full(chunk_t * chunk) {
     return chunk->byteCodeCapacity < chunk->byteCodeCount + 1;
 }
 
+/// @brief Determines the instructions that can be executed after a bytecode instruction
+/// @param chunk The chunk where the bytecode instruction is stored
+/// @param opCodeIndex The index of the opcode of the instruction
+/// @param successors The indexes of the opcodes of the instructions that can be executed next
+/// @return The amount of successors of the instruction
+/// @details Superinstructions continue behind the last instruction of the sequence they execute. Jumps of the
+/// superinstructions that end with OP_JUMP_IF_FALSE and OP_POP skip the OP_POP at the jump target
+static uint32_t chunk_instruction_successors(chunk_t const * chunk, uint32_t opCodeIndex, uint32_t successors[2]) {
+    // A wide jump has the same successors as a narrow jump
+    uint8_t opCode = chunk->code[opCodeIndex] == OP_WIDE ? chunk->code[opCodeIndex + 1u] : chunk->code[opCodeIndex];
+    switch (opCode) {
+    case OP_GET_LOCAL_GET_PROPERTY:
+        successors[0] = opCodeIndex + 6u;
+        return 1u;
+    case OP_JUMP:
+    case OP_LOOP:
+        successors[0] = chunk_jump_target(chunk, opCodeIndex);
+        return 1u;
+    case OP_JUMP_IF_FALSE:
+        successors[0] = opCodeIndex + chunk_instruction_length(chunk, opCodeIndex);
+        successors[1] = chunk_jump_target(chunk, opCodeIndex);
+        return 2u;
+    case OP_LESS_JUMP_IF_FALSE:
+        successors[0] = opCodeIndex + 5u;
+        successors[1] = opCodeIndex + 5u + chunk_read_short(chunk, opCodeIndex + 2u);
+        return 2u;
+    case OP_REGISTER_LESS_JUMP_IF_FALSE:
+        successors[0] = opCodeIndex + 8u;
+        successors[1] = opCodeIndex + 8u + chunk_read_short(chunk, opCodeIndex + 5u);
+        return 2u;
+    case OP_RETURN:
+        return 0u;
+    case OP_SET_GLOBAL_POP:
+        successors[0] = opCodeIndex + 5u;
+        return 1u;
+    default:
+        successors[0] = opCodeIndex + chunk_instruction_length(chunk, opCodeIndex);
+        return 1u;
+    }
+}
+
+/// @brief Determines whether the opcode of an instruction exists and whether OP_WIDE prefixes an instruction with a
+/// wide form
+/// @param chunk The chunk where the bytecode instruction is stored
+/// @param opCodeIndex The index of the opcode of the instruction
+/// @return true if the instruction can be executed, false if not
+static inline bool chunk_is_valid_instruction(chunk_t const * chunk, uint32_t opCodeIndex) {
+    if (chunk->code[opCodeIndex] != OP_WIDE) {
+        return chunk->code[opCodeIndex] < OP_WIDE;
+    }
+    if (opCodeIndex + 1u >= chunk->byteCodeCount) {
+        return false;
+    }
+    switch (chunk->code[opCodeIndex + 1u]) {
+    case OP_CLASS:
+    case OP_CLOSURE:
+    case OP_CONSTANT:
+    case OP_DEFINE_GLOBAL:
+    case OP_GET_GLOBAL:
+    case OP_GET_PROPERTY:
+    case OP_GET_SUPER:
+    case OP_INVOKE:
+    case OP_JUMP:
+    case OP_JUMP_IF_FALSE:
+    case OP_LOOP:
+    case OP_METHOD:
+    case OP_SET_GLOBAL:
+    case OP_SET_PROPERTY:
+    case OP_SUPER_INVOKE:
+    case OP_TAIL_INVOKE:
+        return true;
+    default:
+        return false;
+    }
+}
+
 /// @brief Determines whether a chunk is completely filled with bytecode instructions
 /// @param chunk The chunk that is checked if it is already filled
 /// @return True if the chunk is full, false if not
 static inline bool chunk_line_info_is_full(chunk_t * chunk) {
     return chunk->lineInfoCapacity < chunk->lineInfoCount + 1;
 }
+
+/// @brief Reads an operand that is stored in two bytes of the chunk (e.g. a jump offset)
+/// @param chunk The chunk where the operand is stored
+/// @param index The index of the first byte of the operand
+/// @return The value of the operand
+static inline uint16_t chunk_read_short(chunk_t const * chunk, uint32_t index) {
+    return (uint16_t)((chunk->code[index] << 8) | chunk->code[index + 1u]);
+}
+
+/// @brief Reads an operand that is stored in four bytes of the chunk (e.g. a wide jump offset)
+/// @param chunk The chunk where the operand is stored
+/// @param index The index of the first byte of the operand
+/// @return The value of the operand
+static inline uint32_t chunk_read_word(chunk_t const * chunk, uint32_t index) {
+    return ((uint32_t)chunk->code[index] << 24) | ((uint32_t)chunk->code[index + 1u] << 16) |
+           ((uint32_t)chunk->code[index + 2u] << 8) | chunk->code[index + 3u];
+}
+
+/// @brief Determines how many values a bytecode instruction adds to the stack
+/// @param chunk The chunk where the bytecode instruction is stored
+/// @param opCodeIndex The index of the opcode of the instruction
+/// @return The amount of values that are pushed minus the amount of values that are popped by the instruction
+/// @details The effect of a superinstruction is the effect of the whole sequence it executes
+static int32_t chunk_stack_effect(chunk_t const * chunk, uint32_t opCodeIndex) {
+    switch (chunk->code[opCodeIndex]) {
+    case OP_ARRAY_LITERAL:
+        return 1 - (int32_t)chunk->code[opCodeIndex + 1u];
+    case OP_CALL:
+    case OP_TAIL_CALL:
+        // The callee and the arguments are replaced by the result
+        return -(int32_t)chunk->code[opCodeIndex + 1u];
+    case OP_CALL_INTRINSIC:
+        // The arguments are replaced by the result
+        return 1 - (int32_t)chunk->code[opCodeIndex + 2u];
+    case OP_INVOKE:
+    case OP_TAIL_INVOKE:
+        // The receiver and the arguments are replaced by the result - the name of the method is the first operand
+        return -(int32_t)chunk->code[opCodeIndex + 2u];
+    case OP_SUPER_INVOKE:
+        // The superclass is popped as well
+        return -(int32_t)chunk->code[opCodeIndex + 2u] - 1;
+    case OP_CLASS:
+    case OP_CLOSURE:
+    case OP_CONSTANT:
+    case OP_FALSE:
+    case OP_GET_CAPTURED_VALUE:
+    case OP_GET_GLOBAL:
+    case OP_GET_LOCAL:
+    case OP_GET_LOCAL_GET_PROPERTY:
+    case OP_GET_UPVALUE:
+    case OP_NULL:
+    case OP_TRUE:
+        return 1;
+    case OP_ADD:
+    case OP_ADD_NUMBER:
+    case OP_CLOSE_UPVALUE:
+    case OP_DEFINE_GLOBAL:
+    case OP_DIVIDE:
+    case OP_DIVIDE_NUMBER:
+    case OP_EQUAL:
+    case OP_EXPONENT:
+    case OP_EXPONENT_NUMBER:
+    case OP_GET_INDEX_OF:
+    case OP_GET_SUPER:
+    case OP_GREATER:
+    case OP_GREATER_NUMBER:
+    case OP_INHERIT:
+    case OP_LESS:
+    case OP_LESS_NUMBER:
+    case OP_METHOD:
+    case OP_MODULO:
+    case OP_MULTIPLY:
+    case OP_MULTIPLY_NUMBER:
+    case OP_POP:
+    case OP_RETURN:
+    case OP_SET_GLOBAL_POP:
+    case OP_SET_PROPERTY:
+    case OP_SUBTRACT:
+    case OP_SUBTRACT_NUMBER:
+        return -1;
+    case OP_GET_SLICE_OF:
+    case OP_LESS_JUMP_IF_FALSE:
+    case OP_SET_INDEX_OF:
+        return -2;
+    case OP_REGISTER_ADD:
+    case OP_REGISTER_DIVIDE:
+    case OP_REGISTER_EQUAL:
+    case OP_REGISTER_GREATER:
+    case OP_REGISTER_LESS:
+    case OP_REGISTER_MOVE:
+    case OP_REGISTER_MULTIPLY:
+    case OP_REGISTER_SUBTRACT:
+        // Register instructions only push their result if the destination is the stack
+        return chunk->code[opCodeIndex + 1u] == REGISTER_DESTINATION_STACK ? 1 : 0;
+    case OP_WIDE:
+        // The operands after the wide operand are three bytes further back than in the narrow instruction
+        switch (chunk->code[opCodeIndex + 1u]) {
+        case OP_INVOKE:
+        case OP_TAIL_INVOKE:
+            return -(int32_t)chunk->code[opCodeIndex + 5u];
+        case OP_SUPER_INVOKE:
+            return -(int32_t)chunk->code[opCodeIndex + 5u] - 1;
+        default:
+            return chunk_stack_effect(chunk, opCodeIndex + 1u);
+        }
+    default:
+        // OP_GET_PROPERTY, OP_JUMP, OP_JUMP_IF_FALSE, OP_LOOP, OP_NEGATE, OP_NOT, OP_REGISTER_LESS_JUMP_IF_FALSE,
+        // OP_SET_GLOBAL, OP_SET_LOCAL and OP_SET_UPVALUE replace the value on top of the stack or don't change it
+        return 0;
+    }
+}
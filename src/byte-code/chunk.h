@@ -24,15 +24,37 @@
 #include "../common.h"
 #include "../language-models/data-structures/dynamic_value_array.h"
 #include "../language-models/value.h"
+#include "call_cache.h"
+#include "inline_cache.h"
 
 /// @brief opcodes of the bytecode instruction set
+/// @details Superinstructions (e.g. OP_GET_LOCAL_GET_PROPERTY) are created by the chunk optimizer. They replace the
+/// opcode of the first instruction of a sequence, that is executed as a whole by the superinstruction. The operands of
+/// the first instruction and the following instructions are kept, so the length of the chunk and the jump offsets
+/// don't change and the instructions of the sequence can still be the target of a jump.
+/// Quickened instructions (e.g. OP_ADD_NUMBER) are specialized for numerical operands. The virtual machine rewrites a
+/// generic instruction into its quickened form, when it is executed with two numbers, and rewrites it back into the
+/// generic form if the guard of the quickened instruction fails (deoptimization).
+/// Property accesses and method invocations (OP_GET_PROPERTY, OP_SET_PROPERTY, OP_INVOKE and OP_TAIL_INVOKE) are followed
+/// by the index of the inline cache of the call site, that is stored in two bytes after the other operands.
+/// Calls in tail position (OP_TAIL_CALL and OP_TAIL_INVOKE) reuse the call frame of the current function. They are
+/// always followed by OP_RETURN, that returns the result if no closure was called (e.g. a native function).
+/// Instructions whose first operand is a constant index or a jump offset have a wide form, that is prefixed by OP_WIDE.
+/// The wide form stores the index of the constant in three bytes and the offset of the jump in four bytes, the other
+/// operands are the same. Superinstructions are only created from narrow instructions.
 enum opcode {
     /// Pops the two most upper values from the stack, adds them and pushes the result onto the stack
     OP_ADD,
+    /// Quickened OP_ADD for two numbers - rewritten into OP_ADD if one of the operands isn't a number
+    OP_ADD_NUMBER,
     /// Defines the arguments of the array literal declaration
     OP_ARRAY_LITERAL,
-    /// Defines the arguments for the next function invocation
+    /// Calls the callee below the arguments on the stack - followed by the amount of arguments and the index of the call
+    /// cache of the call site
     OP_CALL,
+    /// Calls a well-known native function without loading it from its global variable - followed by the index of the
+    /// native function and the amount of arguments
+    OP_CALL_INTRINSIC,
     /// Defines a new class
     OP_CLASS,
     /// Defines a new closure for a function that is about to be called
@@ -46,20 +68,29 @@ enum opcode {
     /// Pops the two most upper values from the stack, divides the first with the second value and pushes the result on
     /// the stack
     OP_DIVIDE,
+    /// Quickened OP_DIVIDE for two numbers - rewritten into OP_DIVIDE if one of the operands isn't a number
+    OP_DIVIDE_NUMBER,
     /// Determines whether two the values on top of the are equal and  pushes the result on the stack
     OP_EQUAL,
     /// Pops the two most upper values from the stack, raises the first with the second value and pushes the result on
     /// the stack
     OP_EXPONENT,
+    /// Quickened OP_EXPONENT for two numbers - rewritten into OP_EXPONENT if one of the operands isn't a number
+    OP_EXPONENT_NUMBER,
     /// Pushes the boolean value false on the stack
     OP_FALSE,
+    /// Gets a value that was captured by the closure by value and stores it on the stack - followed by the index of
+    /// the captured value
+    OP_GET_CAPTURED_VALUE,
     /// Gets the value of a global variable and stores it on the stack
     OP_GET_GLOBAL,
     /// Gets the value of a single character in a string at the specified index. Pushes the result on the stack
     OP_GET_INDEX_OF,
     /// Gets the value of a local variable and stores it on the stack
     OP_GET_LOCAL,
-    /// Gets the value of the property of a Cellox object and stores it on the stack
+    /// Superinstruction that gets a property of a local variable (e.g. this) - OP_GET_LOCAL followed by OP_GET_PROPERTY
+    OP_GET_LOCAL_GET_PROPERTY,
+    /// Gets the value of the property of a Cellox object and stores it on the stack - uses an inline cache
     OP_GET_PROPERTY,
     /// Gets the two most upper values from the stack and uses them to narrow down a certain range that is used to
     /// create a slice from an array or a string
@@ -71,9 +102,11 @@ enum opcode {
     /// Pops the two most upper values from the stack, and pushes the value true on the stack if the first number is
     /// greater than the second number
     OP_GREATER,
+    /// Quickened OP_GREATER for two numbers - rewritten into OP_GREATER if one of the operands isn't a number
+    OP_GREATER_NUMBER,
     /// Adds another class as the parent to a class declaration
     OP_INHERIT,
-    /// Invokes a function
+    /// Invokes a method of a Cellox object - uses an inline cache
     OP_INVOKE,
     /// Jumps from the current position to another position in the code, determined by a certain offset - used at the
     /// beginning of a loop, conditional statements
@@ -83,6 +116,11 @@ enum opcode {
     /// Pops the two most upper values from the stack, and pushes the value true on the stack if the first number is
     /// less than the second number
     OP_LESS,
+    /// Superinstruction that compares the two most upper values on the stack and jumps if the first number isn't less
+    /// than the second one - OP_LESS followed by OP_JUMP_IF_FALSE and OP_POP, where the jump target is OP_POP as well
+    OP_LESS_JUMP_IF_FALSE,
+    /// Quickened OP_LESS for two numbers - rewritten into OP_LESS if one of the operands isn't a number
+    OP_LESS_NUMBER,
     /// Jumps from the current position to another position in the code, determined by a certain offset - used at the
     /// end of a loop
     OP_LOOP,
@@ -93,6 +131,8 @@ enum opcode {
     OP_MODULO,
     /// Pops the two most upper values from the stack adds them and pushes the result onto the stack
     OP_MULTIPLY,
+    /// Quickened OP_MULTIPLY for two numbers - rewritten into OP_MULTIPLY if one of the operands isn't a number
+    OP_MULTIPLY_NUMBER,
     /// Negates the value on top of the stack
     OP_NEGATE,
     /// Converts the value on top of the stack from a truthy value to a falsy value and vice versa
@@ -101,28 +141,143 @@ enum opcode {
     OP_NULL,
     /// Pops a value from the stack
     OP_POP,
+    /// Adds two register operands and stores the result in the destination register
+    OP_REGISTER_ADD,
+    /// Divides the first register operand by the second register operand and stores the result in the destination
+    /// register
+    OP_REGISTER_DIVIDE,
+    /// Determines whether two register operands are equal and stores the result in the destination register
+    OP_REGISTER_EQUAL,
+    /// Stores true in the destination register if the first register operand is greater than the second one
+    OP_REGISTER_GREATER,
+    /// Stores true in the destination register if the first register operand is less than the second one
+    OP_REGISTER_LESS,
+    /// Superinstruction that jumps if the first register operand isn't less than the second one - OP_REGISTER_LESS
+    /// (with the stack as destination) followed by OP_JUMP_IF_FALSE and OP_POP, where the jump target is OP_POP as well
+    OP_REGISTER_LESS_JUMP_IF_FALSE,
+    /// Copies a register operand into the destination register
+    OP_REGISTER_MOVE,
+    /// Multiplies two register operands and stores the result in the destination register
+    OP_REGISTER_MULTIPLY,
+    /// Subtracts the second register operand from the first register operand and stores the result in the destination
+    /// register
+    OP_REGISTER_SUBTRACT,
     /// Returns the value that is stored on the top of the stack
     OP_RETURN,
     /// Sets the value of a global variable
     OP_SET_GLOBAL,
+    /// Superinstruction that pops the value on top of the stack and assigns it to a global variable - OP_SET_GLOBAL
+    /// followed by OP_POP
+    OP_SET_GLOBAL_POP,
     /// Copies the value of a string and alters a single character at the specified index. Pushes the result on the
     /// stack.
     OP_SET_INDEX_OF,
     /// Sets the value of a local variable
     OP_SET_LOCAL,
-    /// Sets the value of a property
+    /// Sets the value of a property - uses an inline cache
     OP_SET_PROPERTY,
     /// Sets an upvalue that is captured by the current closure
     OP_SET_UPVALUE,
     /// Pops the two most upper values from the stack, subtracts the second value from the first value and pushes the
     /// result onto the stack
     OP_SUBTRACT,
+    /// Quickened OP_SUBTRACT for two numbers - rewritten into OP_SUBTRACT if one of the operands isn't a number
+    OP_SUBTRACT_NUMBER,
     /// Invokes a method of the parent class
     OP_SUPER_INVOKE,
+    /// OP_CALL in tail position - a called closure reuses the call frame of the current function
+    OP_TAIL_CALL,
+    /// OP_INVOKE in tail position - the invoked method reuses the call frame of the current function
+    OP_TAIL_INVOKE,
     /// Pushes the boolean value true on the stack
     OP_TRUE,
+    /// Prefix of an instruction with a wide first operand (a constant index with three bytes or a jump offset with four
+    /// bytes)
+    OP_WIDE,
 };
 
+/// X-Makro that contains all the opcodes of the bytecode instruction set
+/// @details Used to create the dispatch tables of the virtual machine and the names of the opcodes - the order is
+/// irrelevant, because designated initializers are used
+#define CHUNK_OPCODES(X)                                                                                               \
+    X(OP_ADD)                                                                                                          \
+    X(OP_ADD_NUMBER)                                                                                                   \
+    X(OP_ARRAY_LITERAL)                                                                                                \
+    X(OP_CALL)                                                                                                         \
+    X(OP_CALL_INTRINSIC)                                                                                               \
+    X(OP_CLASS)                                                                                                        \
+    X(OP_CLOSURE)                                                                                                      \
+    X(OP_CLOSE_UPVALUE)                                                                                                \
+    X(OP_CONSTANT)                                                                                                     \
+    X(OP_DEFINE_GLOBAL)                                                                                                \
+    X(OP_DIVIDE)                                                                                                       \
+    X(OP_DIVIDE_NUMBER)                                                                                                \
+    X(OP_EQUAL)                                                                                                        \
+    X(OP_EXPONENT)                                                                                                     \
+    X(OP_EXPONENT_NUMBER)                                                                                              \
+    X(OP_FALSE)                                                                                                        \
+    X(OP_GET_CAPTURED_VALUE)                                                                                           \
+    X(OP_GET_GLOBAL)                                                                                                   \
+    X(OP_GET_INDEX_OF)                                                                                                 \
+    X(OP_GET_LOCAL)                                                                                                    \
+    X(OP_GET_LOCAL_GET_PROPERTY)                                                                                       \
+    X(OP_GET_PROPERTY)                                                                                                 \
+    X(OP_GET_SLICE_OF)                                                                                                 \
+    X(OP_GET_SUPER)                                                                                                    \
+    X(OP_GET_UPVALUE)                                                                                                  \
+    X(OP_GREATER)                                                                                                      \
+    X(OP_GREATER_NUMBER)                                                                                               \
+    X(OP_INHERIT)                                                                                                      \
+    X(OP_INVOKE)                                                                                                       \
+    X(OP_JUMP)                                                                                                         \
+    X(OP_JUMP_IF_FALSE)                                                                                                \
+    X(OP_LESS)                                                                                                         \
+    X(OP_LESS_JUMP_IF_FALSE)                                                                                           \
+    X(OP_LESS_NUMBER)                                                                                                  \
+    X(OP_LOOP)                                                                                                         \
+    X(OP_METHOD)                                                                                                       \
+    X(OP_MODULO)                                                                                                       \
+    X(OP_MULTIPLY)                                                                                                     \
+    X(OP_MULTIPLY_NUMBER)                                                                                              \
+    X(OP_NEGATE)                                                                                                       \
+    X(OP_NOT)                                                                                                          \
+    X(OP_NULL)                                                                                                         \
+    X(OP_POP)                                                                                                          \
+    X(OP_REGISTER_ADD)                                                                                                 \
+    X(OP_REGISTER_DIVIDE)                                                                                              \
+    X(OP_REGISTER_EQUAL)                                                                                               \
+    X(OP_REGISTER_GREATER)                                                                                             \
+    X(OP_REGISTER_LESS)                                                                                                \
+    X(OP_REGISTER_LESS_JUMP_IF_FALSE)                                                                                  \
+    X(OP_REGISTER_MOVE)                                                                                                \
+    X(OP_REGISTER_MULTIPLY)                                                                                            \
+    X(OP_REGISTER_SUBTRACT)                                                                                            \
+    X(OP_RETURN)                                                                                                       \
+    X(OP_SET_GLOBAL)                                                                                                   \
+    X(OP_SET_GLOBAL_POP)                                                                                               \
+    X(OP_SET_INDEX_OF)                                                                                                 \
+    X(OP_SET_LOCAL)                                                                                                    \
+    X(OP_SET_PROPERTY)                                                                                                 \
+    X(OP_SET_UPVALUE)                                                                                                  \
+    X(OP_SUBTRACT)                                                                                                     \
+    X(OP_SUBTRACT_NUMBER)                                                                                              \
+    X(OP_SUPER_INVOKE)                                                                                                 \
+    X(OP_TAIL_CALL)                                                                                                    \
+    X(OP_TAIL_INVOKE)                                                                                                  \
+    X(OP_TRUE)                                                                                                         \
+    X(OP_WIDE)
+
+/// @brief Flag of a register operand that refers to a constant of the chunk instead of a slot of the call frame
+/// @details The register instructions have the form OP_REGISTER_X destination operand operand. The lower seven bits
+/// of an operand contain either the index of the constant or the slot of the local variable
+#define REGISTER_OPERAND_CONSTANT  (0x80u)
+
+/// @brief Destination of a register instruction that pushes the result onto the stack instead of storing it in a slot
+#define REGISTER_DESTINATION_STACK (0xFFu)
+
+/// @brief Maximum amount of constants in a chunk - the wide instructions store the index of a constant in three bytes
+#define CHUNK_CONSTANTS_MAX        (0x1000000u)
+
 /// @brief Line info of a chunk
 /// @details Stores the index of the last instruction in a line and the line number
 typedef struct {
@@ -150,14 +305,47 @@ typedef struct {
     line_info_t * lineInfos;
     /// Constants stored in the chunk
     dynamic_value_array_t constants;
+    /// Amount of inline caches in the chunk
+    uint32_t inlineCacheCount;
+    /// Capacity for inline caches of the chunk
+    uint32_t inlineCacheCapacity;
+    /// The inline caches of the property accesses and method invocations in the chunk
+    inline_cache_t * inlineCaches;
+    /// Amount of call caches in the chunk
+    uint32_t callCacheCount;
+    /// Capacity for call caches of the chunk
+    uint32_t callCacheCapacity;
+    /// The call caches of the call expressions in the chunk
+    call_cache_t * callCaches;
+    /// The maximum amount of values the bytecode holds on the stack on top of the callee and the arguments
+    uint32_t maxStackDepth;
 } chunk_t;
 
+/// @brief Adds an empty call cache to the chunk
+/// @param chunk The chunk where the call cache is added
+/// @return The index of the added call cache
+uint32_t chunk_add_call_cache(chunk_t * chunk);
+
 /// @brief Adds a constant to the chunk
 /// @param chunk The chunk where the value is added
 /// @param value The value that is added
 /// @return The index of the added constant
 int32_t chunk_add_constant(chunk_t * chunk, value_t value);
 
+/// @brief Adds an empty inline cache to the chunk
+/// @param chunk The chunk where the inline cache is added
+/// @return The index of the added inline cache
+uint32_t chunk_add_inline_cache(chunk_t * chunk);
+
+/// @brief Determines the maximum amount of values the bytecode of a chunk holds on the stack
+/// @param chunk The chunk that is analyzed
+/// @param maxStackDepth The maximum amount of values on top of the callee and the arguments of the call frame
+/// @return true if the bytecode is valid, false if an instruction could pop more values than the stack holds, a path
+/// leads out of the chunk or two paths reach an instruction with a different amount of values on the stack
+/// @details Every reachable instruction is visited once with the stack depth it is executed with - the chunk needs to
+/// be fully initialized (e.g. the functions of the closures are stored in the constants)
+bool chunk_determine_max_stack_depth(chunk_t const * chunk, uint32_t * maxStackDepth);
+
 /// @brief Determines the corresponding line number for a bytecode instruction by the index of the instruction in the
 /// chunk
 /// @param chunk The chunk where the bytecode instruction is stored
@@ -173,6 +361,31 @@ void chunk_free(chunk_t * chunk);
 /// @param chunk The chunk that is initialized
 void chunk_init(chunk_t * chunk);
 
+/// @brief Determines the length of the bytecode instruction at the specified index, including all of its operands
+/// @param chunk The chunk where the bytecode instruction is stored
+/// @param opCodeIndex The index of the opcode of the instruction
+/// @return The amount of bytes the instruction occupies in the chunk
+/// @details The length of a superinstruction is the length of the first instruction of the sequence it executes
+uint32_t chunk_instruction_length(chunk_t const * chunk, uint32_t opCodeIndex);
+
+/// @brief Determines the index of the instruction a jump or a loop continues at, when it jumps
+/// @param chunk The chunk where the jump is stored
+/// @param opCodeIndex The index of the opcode of the jump (OP_JUMP, OP_JUMP_IF_FALSE or OP_LOOP) or of its OP_WIDE
+/// @return The index of the jump target or UINT32_MAX if the offset leads in front of the beginning of the chunk
+uint32_t chunk_jump_target(chunk_t const * chunk, uint32_t opCodeIndex);
+
+/// @brief Reads the index of the constant that is the first operand of an instruction
+/// @param chunk The chunk where the instruction is stored
+/// @param opCodeIndex The index of the opcode of the instruction or of its OP_WIDE
+/// @return The index of the constant in the constants of the chunk
+uint32_t chunk_read_constant_index(chunk_t const * chunk, uint32_t opCodeIndex);
+
+/// @brief Removes all the bytecode instructions behind the specified index from the chunk
+/// @param chunk The chunk that is truncated
+/// @param byteCodeCount The amount of bytecode instructions that are kept
+/// @details The line info of the removed bytecode instructions is removed as well
+void chunk_truncate(chunk_t * chunk, uint32_t byteCodeCount);
+
 /// @brief Removes a sequence of bytecode instructions from the chunk
 /// @param chunk The chunk where the bytecode is removed
 /// @param startIndex The index of the first instruction that is removed from the chunk
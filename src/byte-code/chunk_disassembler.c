@@ -23,15 +23,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "../backend/native_functions.h"
 #include "../common.h"
 #include "../language-models/object.h"
 #include "../language-models/value.h"
 
 static int32_t chunk_disassembler_byte_instruction(char const *, chunk_t *, int32_t);
+static int32_t chunk_disassembler_call_instruction(char const *, chunk_t *, int32_t);
 static int32_t chunk_disassembler_constant_instruction(char const *, chunk_t *, int32_t);
+static int32_t chunk_disassembler_global_instruction(char const *, chunk_t *, int32_t);
 static int chunk_disassembler_invoke_instruction(char const *, chunk_t *, int32_t);
-static int32_t chunk_disassembler_jump_instruction(char const *, int32_t, chunk_t *, int32_t);
+static int32_t chunk_disassembler_jump_instruction(char const *, chunk_t *, int32_t);
 static void chunk_disassembler_print_chunk_metadata(chunk_t *, char const *, uint32_t);
+static void chunk_disassembler_print_inline_cache(chunk_t *, int32_t);
+static void chunk_disassembler_print_register_operand(chunk_t *, uint8_t);
+static int32_t chunk_disassembler_property_instruction(char const *, chunk_t *, int32_t);
+static int32_t chunk_disassembler_register_instruction(char const *, uint32_t, chunk_t *, int32_t);
 static int32_t chunk_disassembler_simple_instruction(char const *, int32_t);
 
 void chunk_disassembler_disassemble_chunk(chunk_t * chunk, char const * name, uint32_t arity) {
@@ -52,19 +59,32 @@ int32_t chunk_disassembler_disassemble_instruction(chunk_t * chunk, int32_t offs
     // Instruction specific behaviour
     uint8_t instruction = chunk->code[offset];
     printf(" OP_%02X: ", instruction);
+    if (instruction == OP_WIDE) {
+        // The wide instruction is disassembled like the narrow one, only the first operand is read differently
+        instruction = chunk->code[offset + 1];
+        printf("WIDE ");
+    }
     switch (instruction) {
     case OP_ADD:
         return chunk_disassembler_simple_instruction("ADD", offset);
+    case OP_ADD_NUMBER:
+        return chunk_disassembler_simple_instruction("ADD_NUMBER", offset);
     case OP_ARRAY_LITERAL:
         return chunk_disassembler_byte_instruction("DYNAMIC_ARRAY_LITERAL", chunk, offset);
     case OP_CALL:
-        return chunk_disassembler_byte_instruction("CALL", chunk, offset);
+        return chunk_disassembler_call_instruction("CALL", chunk, offset);
+    case OP_CALL_INTRINSIC:
+        {
+            native_function_config_t * config = native_functions_get_function_configs() + chunk->code[offset + 1];
+            printf("%-16s %04X '%s'\n", "CALL_INTRINSIC", chunk->code[offset + 2], config->functionName);
+            return offset + 3;
+        }
     case OP_CLASS:
         return chunk_disassembler_constant_instruction("CLASS", chunk, offset);
     case OP_CLOSURE:
         {
-            offset++;
-            uint8_t constant = chunk->code[offset++];
+            uint32_t constant = chunk_read_constant_index(chunk, offset);
+            offset += chunk->code[offset] == OP_WIDE ? 5 : 2;
             printf("%-16s %04X ", "CLOSURE", constant);
             value_print(chunk->constants.values[constant]);
             printf("\n");
@@ -74,6 +94,13 @@ int32_t chunk_disassembler_disassemble_instruction(chunk_t * chunk, int32_t offs
                 int32_t index = chunk->code[offset++];
                 printf("%04X      |                     %s %d\n", offset - 2, isLocal ? "local" : "upvalue", index);
             }
+            // The values that are captured by value follow the upvalues
+            for (uint32_t j = 0; j < function->capturedValueCount; j++) {
+                int32_t isLocal = chunk->code[offset++];
+                int32_t index = chunk->code[offset++];
+                printf("%04X      |                     %s %d\n", offset - 2,
+                       isLocal ? "local value" : "captured value", index);
+            }
             return offset;
         }
     case OP_CLOSE_UPVALUE:
@@ -81,23 +108,31 @@ int32_t chunk_disassembler_disassemble_instruction(chunk_t * chunk, int32_t offs
     case OP_CONSTANT:
         return chunk_disassembler_constant_instruction("CONSTANT", chunk, offset);
     case OP_DEFINE_GLOBAL:
-        return chunk_disassembler_constant_instruction("DEFINE_GLOBAL", chunk, offset);
+        return chunk_disassembler_global_instruction("DEFINE_GLOBAL", chunk, offset);
     case OP_DIVIDE:
         return chunk_disassembler_simple_instruction("DIVIDE", offset);
+    case OP_DIVIDE_NUMBER:
+        return chunk_disassembler_simple_instruction("DIVIDE_NUMBER", offset);
     case OP_EQUAL:
         return chunk_disassembler_simple_instruction("EQUAL", offset);
     case OP_EXPONENT:
         return chunk_disassembler_simple_instruction("EXPONENT", offset);
+    case OP_EXPONENT_NUMBER:
+        return chunk_disassembler_simple_instruction("EXPONENT_NUMBER", offset);
     case OP_FALSE:
         return chunk_disassembler_simple_instruction("FALSE", offset);
+    case OP_GET_CAPTURED_VALUE:
+        return chunk_disassembler_byte_instruction("GET_CAPTURED_VALUE", chunk, offset);
     case OP_GET_GLOBAL:
-        return chunk_disassembler_constant_instruction("GET_GLOBAL", chunk, offset);
+        return chunk_disassembler_global_instruction("GET_GLOBAL", chunk, offset);
     case OP_GET_INDEX_OF:
         return chunk_disassembler_simple_instruction("GET_INDEX_OF", offset);
     case OP_GET_LOCAL:
         return chunk_disassembler_byte_instruction("GET_LOCAL", chunk, offset);
+    case OP_GET_LOCAL_GET_PROPERTY:
+        return chunk_disassembler_byte_instruction("GET_LOCAL_GET_PROPERTY", chunk, offset);
     case OP_GET_PROPERTY:
-        return chunk_disassembler_constant_instruction("GET_PROPERTY", chunk, offset);
+        return chunk_disassembler_property_instruction("GET_PROPERTY", chunk, offset);
     case OP_GET_SLICE_OF:
         return chunk_disassembler_simple_instruction("GET_RANGE_OF", offset);
     case OP_GET_SUPER:
@@ -106,24 +141,32 @@ int32_t chunk_disassembler_disassemble_instruction(chunk_t * chunk, int32_t offs
         return chunk_disassembler_byte_instruction("GET_UPVALUE", chunk, offset);
     case OP_GREATER:
         return chunk_disassembler_simple_instruction("GREATER", offset);
+    case OP_GREATER_NUMBER:
+        return chunk_disassembler_simple_instruction("GREATER_NUMBER", offset);
     case OP_INHERIT:
         return chunk_disassembler_simple_instruction("INHERIT", offset);
     case OP_INVOKE:
         return chunk_disassembler_invoke_instruction("INVOKE", chunk, offset);
     case OP_JUMP:
-        return chunk_disassembler_jump_instruction("JUMP", 1, chunk, offset);
+        return chunk_disassembler_jump_instruction("JUMP", chunk, offset);
     case OP_JUMP_IF_FALSE:
-        return chunk_disassembler_jump_instruction("JUMP_IF_FALSE", 1, chunk, offset);
+        return chunk_disassembler_jump_instruction("JUMP_IF_FALSE", chunk, offset);
     case OP_LESS:
         return chunk_disassembler_simple_instruction("LESS", offset);
+    case OP_LESS_JUMP_IF_FALSE:
+        return chunk_disassembler_simple_instruction("LESS_JUMP_IF_FALSE", offset);
+    case OP_LESS_NUMBER:
+        return chunk_disassembler_simple_instruction("LESS_NUMBER", offset);
     case OP_LOOP:
-        return chunk_disassembler_jump_instruction("LOOP", -1, chunk, offset);
+        return chunk_disassembler_jump_instruction("LOOP", chunk, offset);
     case OP_METHOD:
         return chunk_disassembler_constant_instruction("METHOD", chunk, offset);
     case OP_MODULO:
         return chunk_disassembler_simple_instruction("MODULO", offset);
     case OP_MULTIPLY:
         return chunk_disassembler_simple_instruction("MULTIPLY", offset);
+    case OP_MULTIPLY_NUMBER:
+        return chunk_disassembler_simple_instruction("MULTIPLY_NUMBER", offset);
     case OP_NEGATE:
         return chunk_disassembler_simple_instruction("NEGATE", offset);
     case OP_NOT:
@@ -132,10 +175,30 @@ int32_t chunk_disassembler_disassemble_instruction(chunk_t * chunk, int32_t offs
         return chunk_disassembler_simple_instruction("NULL", offset);
     case OP_POP:
         return chunk_disassembler_simple_instruction("POP", offset);
+    case OP_REGISTER_ADD:
+        return chunk_disassembler_register_instruction("REGISTER_ADD", 2, chunk, offset);
+    case OP_REGISTER_DIVIDE:
+        return chunk_disassembler_register_instruction("REGISTER_DIVIDE", 2, chunk, offset);
+    case OP_REGISTER_EQUAL:
+        return chunk_disassembler_register_instruction("REGISTER_EQUAL", 2, chunk, offset);
+    case OP_REGISTER_GREATER:
+        return chunk_disassembler_register_instruction("REGISTER_GREATER", 2, chunk, offset);
+    case OP_REGISTER_LESS:
+        return chunk_disassembler_register_instruction("REGISTER_LESS", 2, chunk, offset);
+    case OP_REGISTER_LESS_JUMP_IF_FALSE:
+        return chunk_disassembler_register_instruction("REGISTER_LESS_JUMP_IF_FALSE", 2, chunk, offset);
+    case OP_REGISTER_MOVE:
+        return chunk_disassembler_register_instruction("REGISTER_MOVE", 1, chunk, offset);
+    case OP_REGISTER_MULTIPLY:
+        return chunk_disassembler_register_instruction("REGISTER_MULTIPLY", 2, chunk, offset);
+    case OP_REGISTER_SUBTRACT:
+        return chunk_disassembler_register_instruction("REGISTER_SUBTRACT", 2, chunk, offset);
     case OP_RETURN:
         return chunk_disassembler_simple_instruction("RETURN", offset);
     case OP_SET_GLOBAL:
-        return chunk_disassembler_constant_instruction("SET_GLOBAL", chunk, offset);
+        return chunk_disassembler_global_instruction("SET_GLOBAL", chunk, offset);
+    case OP_SET_GLOBAL_POP:
+        return chunk_disassembler_global_instruction("SET_GLOBAL_POP", chunk, offset);
     case OP_SET_INDEX_OF:
         return chunk_disassembler_simple_instruction("SET INDEX OF", offset);
     case OP_SET_LOCAL:
@@ -143,11 +206,17 @@ int32_t chunk_disassembler_disassemble_instruction(chunk_t * chunk, int32_t offs
     case OP_SET_UPVALUE:
         return chunk_disassembler_byte_instruction("SET_UPVALUE", chunk, offset);
     case OP_SET_PROPERTY:
-        return chunk_disassembler_constant_instruction("SET_PROPERTY", chunk, offset);
+        return chunk_disassembler_property_instruction("SET_PROPERTY", chunk, offset);
     case OP_SUBTRACT:
         return chunk_disassembler_simple_instruction("SUBTRACT", offset);
+    case OP_SUBTRACT_NUMBER:
+        return chunk_disassembler_simple_instruction("SUBTRACT_NUMBER", offset);
     case OP_SUPER_INVOKE:
         return chunk_disassembler_invoke_instruction("SUPER_INVOKE", chunk, offset);
+    case OP_TAIL_CALL:
+        return chunk_disassembler_call_instruction("TAIL_CALL", chunk, offset);
+    case OP_TAIL_INVOKE:
+        return chunk_disassembler_invoke_instruction("TAIL_INVOKE", chunk, offset);
     case OP_TRUE:
         return chunk_disassembler_simple_instruction("TRUE", offset);
     default:
@@ -167,36 +236,71 @@ static int32_t chunk_disassembler_byte_instruction(char const * name, chunk_t *
     return offset + 2;
 }
 
+/// @brief Dissasembles a call instruction - OP_CALL and OP_TAIL_CALL
+/// @param name The name of the call instruction
+/// @param chunk The chunk where the call instruction is located
+/// @param offset The offset of the call instruction
+/// @return The offset of the next instruction
+static int32_t chunk_disassembler_call_instruction(char const * name, chunk_t * chunk, int32_t offset) {
+    uint8_t argCount = chunk->code[offset + 1];
+    printf("%-16s %04X", name, argCount);
+    // The index of the call cache is printed like the index of an inline cache
+    chunk_disassembler_print_inline_cache(chunk, offset + 2);
+    printf("\n");
+    return offset + 4;
+}
+
 /// @brief Dissasembles a constant instruction - OP_CONSTANT
 /// @param name The name of the constant
 /// @param chunk The chunk where the constant is located
 /// @param offset The offset of the constant
 /// @return The
 static int32_t chunk_disassembler_constant_instruction(char const * name, chunk_t * chunk, int32_t offset) {
-    uint8_t constant = chunk->code[offset + 1];
+    uint32_t constant = chunk_read_constant_index(chunk, offset);
     printf("%-16s %04X '", name, constant);
     value_print(chunk->constants.values[constant]);
     printf("'\n");
-    return offset + 2;
+    return offset + chunk_instruction_length(chunk, offset);
+}
+
+/// @brief Dissasembles an instruction that accesses a global variable
+/// @param name The name of the instruction
+/// @param chunk The chunk where the instruction is located
+/// @param offset The offset of the instruction
+/// @return The index of the next bytecode instruction in the chunk
+static int32_t chunk_disassembler_global_instruction(char const * name, chunk_t * chunk, int32_t offset) {
+    uint32_t constant = chunk_read_constant_index(chunk, offset);
+    // The slot is stored in the last two bytes of the instruction
+    int32_t next = offset + chunk_instruction_length(chunk, offset);
+    uint16_t slot = (uint16_t)((chunk->code[next - 2] << 8) | chunk->code[next - 1]);
+    printf("%-16s %04X '", name, constant);
+    value_print(chunk->constants.values[constant]);
+    printf("' (slot %d)\n", slot);
+    return next;
 }
 
 /// @brief Dissasembles a invoke instruction
 /// @details This can either be a INVOKE or a SUPER_INVOKE Instruction
 static int chunk_disassembler_invoke_instruction(char const * name, chunk_t * chunk, int32_t offset) {
-    uint8_t constant = *(chunk->code + offset + 1);
-    uint8_t argCount = *(chunk->code + offset + 2);
+    uint32_t constant = chunk_read_constant_index(chunk, offset);
+    bool wide = chunk->code[offset] == OP_WIDE;
+    // The argument count follows the index of the constant, that has three bytes in a wide instruction
+    int32_t argCountIndex = wide ? offset + 5 : offset + 2;
+    uint8_t argCount = chunk->code[argCountIndex];
     printf("%-16s (%d args) %04X '", name, argCount, constant);
     value_print(chunk->constants.values[constant]);
-    printf("'\n");
-    return offset + 3;
+    printf("'");
+    if (chunk->code[wide ? offset + 1 : offset] != OP_SUPER_INVOKE) {
+        chunk_disassembler_print_inline_cache(chunk, argCountIndex + 1);
+    }
+    printf("\n");
+    return offset + chunk_instruction_length(chunk, offset);
 }
 
-/// Dissasembles a jump instruction (with a 16-bit operand)
-static int32_t chunk_disassembler_jump_instruction(char const * name, int32_t sign, chunk_t * chunk, int32_t offset) {
-    uint16_t jump = (uint16_t)(*(chunk->code + offset + 1) << 8);
-    jump |= *(chunk->code + offset + 2);
-    printf("%-16s %04X -> %04X\n", name, offset, offset + 3 + sign * jump);
-    return offset + 3;
+/// Dissasembles a jump instruction (with a 16-bit operand or a 32-bit operand in the wide form)
+static int32_t chunk_disassembler_jump_instruction(char const * name, chunk_t * chunk, int32_t offset) {
+    printf("%-16s %04X -> %04X\n", name, offset, chunk_jump_target(chunk, offset));
+    return offset + chunk_instruction_length(chunk, offset);
 }
 
 /// @brief Provides additional metadata to a chunk and prints it to the stdandard output
@@ -220,43 +324,21 @@ static void chunk_disassembler_print_chunk_metadata(chunk_t * chunk, char const
             numberCount++;
         }
     }
-    for (uint32_t j = 0; j < chunk->byteCodeCount; j++) {
-        switch (chunk->code[j]) {
+    for (uint32_t j = 0; j < chunk->byteCodeCount; j += chunk_instruction_length(chunk, j)) {
+        if (j + 1 == chunk->byteCodeCount) {
+            break;
+        }
+        switch (chunk->code[j] == OP_WIDE ? chunk->code[j + 1] : chunk->code[j]) {
         case OP_CONSTANT:
-            if (j + 1 == chunk->byteCodeCount) {
-                break;
-            }
-            if (IS_STRING(chunk->constants.values[chunk->code[j + 1]])) {
+            if (IS_STRING(chunk->constants.values[chunk_read_constant_index(chunk, j)])) {
                 stringCount++;
             }
             break;
         case OP_CLASS:
-            if (j + 1 == chunk->byteCodeCount) {
-                break;
-            }
-            if (IS_STRING(chunk->constants.values[chunk->code[j + 1]])) {
+            if (IS_STRING(chunk->constants.values[chunk_read_constant_index(chunk, j)])) {
                 classCount++;
             }
-        case OP_ARRAY_LITERAL:
-        case OP_DEFINE_GLOBAL:
-        case OP_GET_GLOBAL:
-        case OP_GET_PROPERTY:
-        case OP_GET_SUPER:
-        case OP_METHOD:
-        case OP_SET_GLOBAL:
-        case OP_SET_PROPERTY:
-        case OP_CALL:
-        case OP_GET_LOCAL:
-        case OP_GET_UPVALUE:
-        case OP_SET_LOCAL:
-        case OP_SET_UPVALUE:
-            j++;
-            break;
-        case OP_INVOKE:
-        case OP_JUMP:
-            j += 2;
             break;
-
         default:
             break;
         }
@@ -268,6 +350,65 @@ static void chunk_disassembler_print_chunk_metadata(chunk_t * chunk, char const
            functionCount == 1 ? "function" : "functions", classCount, classCount == 1 ? "class" : "classes");
 }
 
+/// @brief Prints the index of the inline cache of a property access or a method invocation
+/// @param chunk The chunk where the instruction is stored
+/// @param offset The offset of the two bytes that contain the index of the inline cache
+static void chunk_disassembler_print_inline_cache(chunk_t * chunk, int32_t offset) {
+    uint16_t cache = (uint16_t)((chunk->code[offset] << 8) | chunk->code[offset + 1]);
+    printf(" cache %04X", cache);
+}
+
+/// @brief Prints a single operand of a register instruction
+/// @param chunk The chunk where the register instruction is stored
+/// @param operand The operand that is printed (either a slot of the call frame or a constant)
+static void chunk_disassembler_print_register_operand(chunk_t * chunk, uint8_t operand) {
+    if (operand & REGISTER_OPERAND_CONSTANT) {
+        printf(" K%d '", operand & ~REGISTER_OPERAND_CONSTANT);
+        value_print(chunk->constants.values[operand & ~REGISTER_OPERAND_CONSTANT]);
+        printf("'");
+    } else {
+        printf(" R%d", operand);
+    }
+}
+
+/// @brief Dissasembles a property instruction - OP_GET_PROPERTY or OP_SET_PROPERTY
+/// @param name The name of the instruction
+/// @param chunk The chunk where the instruction is located
+/// @param offset The offset of the instruction
+/// @return The index of the next bytecode instruction in the chunk
+static int32_t chunk_disassembler_property_instruction(char const * name, chunk_t * chunk, int32_t offset) {
+    uint32_t constant = chunk_read_constant_index(chunk, offset);
+    int32_t next = offset + chunk_instruction_length(chunk, offset);
+    printf("%-16s %04X '", name, constant);
+    value_print(chunk->constants.values[constant]);
+    printf("'");
+    // The index of the inline cache is stored in the last two bytes of the instruction
+    chunk_disassembler_print_inline_cache(chunk, next - 2);
+    printf("\n");
+    return next;
+}
+
+/// @brief Dissasembles a register instruction
+/// @param name The name of the register instruction
+/// @param operandCount The amount of operands of the instruction (without the destination)
+/// @param chunk The chunk where the register instruction is stored
+/// @param offset The offset of the register instruction
+/// @return The index of the next bytecode instruction in the chunk
+static int32_t chunk_disassembler_register_instruction(char const * name, uint32_t operandCount, chunk_t * chunk,
+                                                       int32_t offset) {
+    uint8_t destination = chunk->code[offset + 1];
+    if (destination == REGISTER_DESTINATION_STACK) {
+        printf("%-16s push <-", name);
+    } else {
+        printf("%-16s R%d <-", name, destination);
+    }
+    for (uint32_t i = 0; i < operandCount; i++) {
+        chunk_disassembler_print_register_operand(chunk, chunk->code[offset + 2 + i]);
+    }
+    printf("\n");
+    return offset + 2 + operandCount;
+}
+
 /// Dissasembles a simple instruction
 static int32_t chunk_disassembler_simple_instruction(char const * name, int32_t offset) {
     printf("%s\n", name);
@@ -26,6 +26,7 @@
 
 #include "cellox_config.h"
 
+#include "../backend/virtual_machine.h"
 #include "../language-models/object.h"
 
 /// @brief Chunk segment prefixes
@@ -50,7 +51,7 @@ enum constant_type_prefix {
 };
 
 static void chunk_file_append_chunk(chunk_t, chunk_file_compile_flag, FILE *);
-static void chunk_file_append_code_segment(uint8_t *, uint32_t, FILE *);
+static void chunk_file_append_code_segment(uint8_t *, uint32_t, uint32_t, FILE *);
 static void chunk_file_append_constant(value_t, dynamic_value_array_t *, chunk_file_compile_flag, FILE *);
 static void chunk_file_append_constant_segment(dynamic_value_array_t, dynamic_value_array_t *, chunk_file_compile_flag,
                                                FILE *);
@@ -61,6 +62,7 @@ static void chunk_file_append_line_info_segment(line_info_t *, uint32_t, FILE *)
 static void chunk_file_append_meta_data(chunk_file_compile_flag, FILE *);
 static void chunk_file_append_u32(uint32_t, FILE *);
 static void chunk_file_append_u64(uint64_t, FILE *);
+static void chunk_file_create_inline_caches(chunk_t *);
 static void chunk_file_parse_chunk(char const **, chunk_t *, size_t *, size_t);
 static void chunk_file_parse_code(char const **, chunk_t *, size_t *, size_t);
 static void chunk_file_parse_constant(char const **, chunk_t *, size_t *, size_t);
@@ -72,6 +74,7 @@ static void chunk_file_parse_metadata(char const **, chunk_t *, size_t *, size_t
 static uint32_t chunk_file_parse_u32(char const **, chunk_t *, size_t *, size_t);
 static uint64_t chunk_file_parse_u64(char const **, chunk_t *, size_t *, size_t);
 static char * chunk_file_read_file(char const *, size_t *);
+static void chunk_file_resolve_global_slots(chunk_t *);
 static void chunk_file_error(char const *, ...);
 
 int chunk_file_store(chunk_t chunk, char const * programmPath, chunk_file_compile_flag flag) {
@@ -109,6 +112,8 @@ chunk_t * chunk_file_load(char const * filePath) {
     if (!mainChunk) {
         return mainChunk;
     }
+    // The segments that are not stored in the file (e.g. the inline caches) must not contain garbage
+    chunk_init(mainChunk);
     size_t fileSize = 0;
     size_t bytesRead = 0;
     char * chunkFileContent = chunk_file_read_file(filePath, &fileSize);
@@ -137,16 +142,19 @@ static void chunk_file_append_chunk(chunk_t chunk, chunk_file_compile_flag flag,
     if (functions.count) {
         chunk_file_append_inner_segment(functions, flag, filePointer);
     }
-    chunk_file_append_code_segment(chunk.code, chunk.byteCodeCount, filePointer);
+    chunk_file_append_code_segment(chunk.code, chunk.byteCodeCount, chunk.maxStackDepth, filePointer);
 }
 
 /// @brief Appends the bytecode stored in a chunk to the file
 /// @param code Pointer to the bytecode of the chunk
 /// @param codeSize The amount of bytecode instructions stored in the chunk
+/// @param maxStackDepth The maximum amount of values the bytecode holds on the stack
 /// @param filePointer Pointer to the file
-static void chunk_file_append_code_segment(uint8_t * code, uint32_t codeSize, FILE * filePointer) {
+static void chunk_file_append_code_segment(uint8_t * code, uint32_t codeSize, uint32_t maxStackDepth,
+                                           FILE * filePointer) {
     fputc(CHUNK_SEGMENT_TYPE_BYTECODE, filePointer);
     chunk_file_append_u32(codeSize, filePointer);
+    chunk_file_append_u32(maxStackDepth, filePointer);
     for (uint32_t i = 0; i < codeSize; i++) {
         fputc(code[i], filePointer);
     }
@@ -206,7 +214,7 @@ static void chunk_file_append_constant_segment(dynamic_value_array_t constants,
     }
 }
 
-/// @brief Appends the meta data of a function to the file (arity and upvalue count)
+/// @brief Appends the meta data of a function to the file (arity, upvalue count and captured value count)
 /// @param function The function that has it's metadata appended to the file
 /// @param filePointer Pointer to the file
 static void chunk_file_append_function_meta_data(object_function_t function, FILE * filePointer) {
@@ -214,6 +222,7 @@ static void chunk_file_append_function_meta_data(object_function_t function, FIL
     fputc(0, filePointer);
     chunk_file_append_u32(function.arity, filePointer);
     chunk_file_append_u32(function.upvalueCount, filePointer);
+    chunk_file_append_u32(function.capturedValueCount, filePointer);
 }
 
 /// @brief Appends the inner segment of the chunk to tthe file
@@ -256,13 +265,15 @@ static void chunk_file_append_line_info_segment(line_info_t * lineInfos, uint32_
     }
 }
 
-/// @brief Appends the meta data of a cellox bytecode file (chunk file writer options and the cellox version)
+/// @brief Appends the meta data of a cellox bytecode file (chunk file writer options, the cellox version and the
+/// version of the chunk file format)
 /// @param flags Compile flags used to compile the sourcecode to a cellox chunk file
 /// @param filePointer Pointer to the file
 static void chunk_file_append_meta_data(chunk_file_compile_flag flag, FILE * filePointer) {
     fputc(flag, filePointer);
     fputc(PROJECT_VERSION_MAJOR, filePointer);
     fputc(PROJECT_VERSION_MINOR, filePointer);
+    fputc(CHUNK_FILE_FORMAT_VERSION, filePointer);
 }
 
 /// @brief Appends a 32bit unsigned integer value to a chunk file
@@ -293,6 +304,42 @@ static void chunk_file_append_u64(uint64_t number, FILE * filePointer) {
     fputc(number & 0x00000000000000ff, filePointer);
 }
 
+/// @brief Creates the inline caches of the property accesses and method invocations and the call caches of the call
+/// expressions in a chunk
+/// @param chunk The chunk where the caches are created
+/// @details The caches are not stored in a chunk file, only their indexes are stored in the bytecode
+static void chunk_file_create_inline_caches(chunk_t * chunk) {
+    for (uint32_t i = 0; i < chunk->byteCodeCount; i += chunk_instruction_length(chunk, i)) {
+        // The wide instructions end with the index of the inline cache as well
+        switch (chunk->code[i] == OP_WIDE ? chunk->code[i + 1u] : chunk->code[i]) {
+        case OP_GET_PROPERTY:
+        case OP_INVOKE:
+        case OP_SET_PROPERTY:
+        case OP_TAIL_INVOKE:
+            {
+                // The index of the inline cache is stored in the last two bytes of the instruction
+                uint32_t cacheIndex = i + chunk_instruction_length(chunk, i) - 2u;
+                uint32_t cache = (uint32_t)((chunk->code[cacheIndex] << 8) | chunk->code[cacheIndex + 1u]);
+                while (chunk->inlineCacheCount <= cache) {
+                    chunk_add_inline_cache(chunk);
+                }
+                break;
+            }
+        case OP_CALL:
+        case OP_TAIL_CALL:
+            {
+                uint32_t cache = (uint32_t)((chunk->code[i + 2u] << 8) | chunk->code[i + 3u]);
+                while (chunk->callCacheCount <= cache) {
+                    chunk_add_call_cache(chunk);
+                }
+                break;
+            }
+        default:
+            break;
+        }
+    }
+}
+
 /// @brief Parses a chunk in a chunk file
 /// @param fileContent  Pointer to the pointer where the contents of the file are stored
 /// @param result The resulting chunk of the parsing process
@@ -330,9 +377,12 @@ static void chunk_file_parse_chunk(char const ** fileContent, chunk_t * result,
 /// @param result The resulting chunk of the parsing process
 /// @param bytesReadPointer Pointer to the bytes read counter
 /// @param fileSize The size of the file in bytes
+/// @details The maximum stack depth that is stored in the file is verified, because the virtual machine doesn't check
+/// the capacity of the stack when a value is pushed
 static void chunk_file_parse_code(char const ** fileContent, chunk_t * result, size_t * bytesReadPointer,
                                   size_t fileSize) {
     uint32_t codeCount = chunk_file_parse_u32(fileContent, result, bytesReadPointer, fileSize);
+    uint32_t maxStackDepth = chunk_file_parse_u32(fileContent, result, bytesReadPointer, fileSize);
     if (!codeCount) {
         return;
     }
@@ -346,6 +396,11 @@ static void chunk_file_parse_code(char const ** fileContent, chunk_t * result, s
     for (uint32_t i = 0; i < codeAbsoluteSize; i++, (*bytesReadPointer)++) {
         result->code[i] = *(*fileContent)++;
     }
+    if (!chunk_determine_max_stack_depth(result, &result->maxStackDepth) || result->maxStackDepth != maxStackDepth) {
+        chunk_file_error("Chunk file contains bytecode with an invalid stack depth");
+    }
+    chunk_file_create_inline_caches(result);
+    chunk_file_resolve_global_slots(result);
 }
 
 /// @brief Parses a single constant in a constant segment
@@ -433,6 +488,7 @@ static void chunk_file_parse_inner(char const ** fileContent, chunk_t * result,
         *bytesReadPointer += functionNameLength + 2;
         function->arity = chunk_file_parse_u32(fileContent, result, bytesReadPointer, fileSize);
         function->upvalueCount = chunk_file_parse_u32(fileContent, result, bytesReadPointer, fileSize);
+        function->capturedValueCount = chunk_file_parse_u32(fileContent, result, bytesReadPointer, fileSize);
         chunk_file_parse_chunk(fileContent, &function->chunk, bytesReadPointer, fileSize);
         dynamic_value_array_write(&result->constants, OBJECT_VAL(function));
     }
@@ -469,11 +525,16 @@ static void chunk_file_parse_line_info(char const ** fileContent, chunk_t * resu
 /// @param fileSize The size of the file in bytes
 static void chunk_file_parse_metadata(char const ** fileContent, chunk_t * result, size_t * bytesReadPointer,
                                       size_t fileSize) {
-    for (; (*bytesReadPointer) < 3; (*bytesReadPointer)++, (*fileContent)++) {
+    for (; (*bytesReadPointer) < 4; (*bytesReadPointer)++, (*fileContent)++) {
         if ((*bytesReadPointer) >= fileSize) {
             chunk_file_error("Chunk file is incomplete");
         }
-        // We ignore the metadata right now
+        // We ignore the compile flags and the cellox version right now
+    }
+    uint8_t formatVersion = (uint8_t)(*fileContent)[-1];
+    if (formatVersion != CHUNK_FILE_FORMAT_VERSION) {
+        chunk_file_error("Chunk file format version %u is not supported (expected version %u)", formatVersion,
+                         CHUNK_FILE_FORMAT_VERSION);
     }
 }
 
@@ -488,11 +549,12 @@ static uint32_t chunk_file_parse_u32(char const ** fileContent, chunk_t * result
     if ((*bytesReadPointer) > (fileSize - 4)) {
         chunk_file_error("Chunk file is incomplete");
     }
+    // The bytes are read as unsigned values, otherwise bytes greater than 0x7f would be sign extended
     uint32_t number = 0;
-    number += (*(*fileContent)++) << 24;
-    number += (*(*fileContent)++) << 16;
-    number += (*(*fileContent)++) << 8;
-    number += (*(*fileContent)++);
+    number += (uint32_t)(uint8_t) * (*fileContent)++ << 24;
+    number += (uint32_t)(uint8_t) * (*fileContent)++ << 16;
+    number += (uint32_t)(uint8_t) * (*fileContent)++ << 8;
+    number += (uint32_t)(uint8_t) * (*fileContent)++;
     (*bytesReadPointer) += 4;
     return number;
 }
@@ -509,14 +571,14 @@ static uint64_t chunk_file_parse_u64(char const ** fileContent, chunk_t * result
         chunk_file_error("Chunk file is incomplete");
     }
     uint64_t number = 0;
-    number += ((uint64_t) * (*fileContent)++) << 56;
-    number += ((uint64_t) * (*fileContent)++) << 48;
-    number += ((uint64_t) * (*fileContent)++) << 40;
-    number += ((uint64_t) * (*fileContent)++) << 32;
-    number += ((uint64_t) * (*fileContent)++) << 24;
-    number += ((uint64_t) * (*fileContent)++) << 16;
-    number += ((uint64_t) * (*fileContent)++) << 8;
-    number += ((uint64_t) * (*fileContent)++);
+    number += ((uint64_t)(uint8_t) * (*fileContent)++) << 56;
+    number += ((uint64_t)(uint8_t) * (*fileContent)++) << 48;
+    number += ((uint64_t)(uint8_t) * (*fileContent)++) << 40;
+    number += ((uint64_t)(uint8_t) * (*fileContent)++) << 32;
+    number += ((uint64_t)(uint8_t) * (*fileContent)++) << 24;
+    number += ((uint64_t)(uint8_t) * (*fileContent)++) << 16;
+    number += ((uint64_t)(uint8_t) * (*fileContent)++) << 8;
+    number += ((uint64_t)(uint8_t) * (*fileContent)++);
     (*bytesReadPointer) += 8;
     return number;
 }
@@ -551,6 +613,35 @@ static char * chunk_file_read_file(char const * path, size_t * fileSizePointer)
     return buffer;
 }
 
+/// @brief Resolves the slots of the global variables that are accessed in a chunk
+/// @param chunk The chunk where the global variables are accessed
+/// @details The slots stored in a chunk file belong to the virtual machine that compiled the chunk, therefore they are
+/// resolved again using the names of the global variables
+static void chunk_file_resolve_global_slots(chunk_t * chunk) {
+    for (uint32_t i = 0; i < chunk->byteCodeCount; i += chunk_instruction_length(chunk, i)) {
+        switch (chunk->code[i] == OP_WIDE ? chunk->code[i + 1u] : chunk->code[i]) {
+        case OP_DEFINE_GLOBAL:
+        case OP_GET_GLOBAL:
+        case OP_SET_GLOBAL:
+        case OP_SET_GLOBAL_POP:
+            {
+                object_string_t * name = AS_STRING(chunk->constants.values[chunk_read_constant_index(chunk, i)]);
+                uint32_t slot = virtual_machine_global_slot(name);
+                if (slot > UINT16_MAX) {
+                    chunk_file_error("Too many global variables");
+                }
+                // The slot is stored in the last two bytes of the instruction
+                uint32_t slotIndex = i + chunk_instruction_length(chunk, i) - 2u;
+                chunk->code[slotIndex] = (slot >> 8) & 0xff;
+                chunk->code[slotIndex + 1u] = slot & 0xff;
+                break;
+            }
+        default:
+            break;
+        }
+    }
+}
+
 /// @brief Prints a error message for io errors and exits
 /// @param format The formater of the error message
 /// @param ... The arguments that are formated
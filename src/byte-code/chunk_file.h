@@ -25,6 +25,15 @@
 
 #include "chunk.h"
 
+/// @brief Version of the format of cellox chunk files
+/// @details Version 2 added the register based bytecode instructions, version 3 the superinstructions, version 4
+/// the quickened instructions, version 5 the indexes of the inline caches, version 6 the slots of the global
+/// variables, version 7 the tail calls and the maximum stack depth of a chunk, version 8 the wide instructions,
+/// version 9 the indexes of the call caches, version 10 the intrinsic calls and version 11 the variables that are
+/// captured by value. Chunk files with a different format version can not be executed, because the opcodes have been
+/// renumbered or their operands have changed
+#define CHUNK_FILE_FORMAT_VERSION (11u)
+
 /// @brief Compiler flags
 typedef enum {
     /// Compile flag that indicates that line information is included in the chunk file
@@ -45,7 +54,8 @@ typedef enum {
  * <li>----top level chunk----</li>
  * </ol>
  * The metadata of a file starts with the compileflags stored in a single byte. It is followed by a byte indicating the
-major and another byte indicating the minor version of cellox that was used to create the chunk.
+major and another byte indicating the minor version of cellox that was used to create the chunk. The last byte of the
+metadata contains the version of the chunk file format.
  * Each chunk is stored in three different segments:
  * <ol>
  * <li>----constants-----</li>
@@ -0,0 +1,63 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file inline_cache.c
+ * @brief File containing the implementation of functionality regarding inline caches.
+ */
+
+#include "inline_cache.h"
+
+#include "../backend/garbage_collector.h"
+#include "../language-models/object.h"
+
+void inline_cache_init(inline_cache_t * cache) {
+    for (uint32_t i = 0u; i < INLINE_CACHE_ENTRY_COUNT; i++) {
+        cache->entries[i].shape = NULL;
+        cache->entries[i].classVersion = 0u;
+        cache->entries[i].fieldIndex = INLINE_CACHE_NO_FIELD;
+        cache->entries[i].method = NULL_VAL;
+        cache->entries[i].transition = NULL;
+    }
+}
+
+void inline_cache_mark(inline_cache_t * cache) {
+    for (uint32_t i = 0u; i < INLINE_CACHE_ENTRY_COUNT && cache->entries[i].shape; i++) {
+        garbage_collector_mark_object((object_t *)cache->entries[i].shape->celloxClass);
+    }
+}
+
+void inline_cache_update(inline_cache_t * cache, object_shape_t * shape, uint32_t fieldIndex, value_t method,
+                         object_shape_t * transition) {
+    // The entries are moved while the background thread could read them
+    garbage_collector_begin_heap_change();
+    // Index of the entry that is replaced - the entries before it are moved back by one position
+    uint32_t replaced = INLINE_CACHE_ENTRY_COUNT - 1u;
+    for (uint32_t i = 0u; i < INLINE_CACHE_ENTRY_COUNT; i++) {
+        if (cache->entries[i].shape == shape || !cache->entries[i].shape) {
+            replaced = i;
+            break;
+        }
+    }
+    for (uint32_t i = replaced; i > 0u; i--) {
+        cache->entries[i] = cache->entries[i - 1u];
+    }
+    cache->entries[0].shape = shape;
+    cache->entries[0].classVersion = shape->celloxClass->version;
+    cache->entries[0].fieldIndex = fieldIndex;
+    cache->entries[0].method = method;
+    cache->entries[0].transition = transition;
+    garbage_collector_end_heap_change();
+}
@@ -0,0 +1,80 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file inline_cache.h
+ * @brief Header file containing the declarations of functionality regarding inline caches.
+ * @details An inline cache belongs to a single call site of a property access or a method invocation in a chunk. It
+ * stores the result of the last lookups for the shapes of the receivers that were used at the call site, so the shape
+ * of the instance and the methods of the class don't have to be searched again if the same shape is used the next
+ * time. A cache is monomorphic as long as a single shape is used and becomes polymorphic, if up to
+ * INLINE_CACHE_ENTRY_COUNT different shapes are used at the call site.
+ */
+
+#ifndef CELLOX_INLINE_CACHE_H_
+#define CELLOX_INLINE_CACHE_H_
+
+#include "../common.h"
+#include "../language-models/value.h"
+
+/// Amount of receiver shapes that can be stored in an inline cache
+#define INLINE_CACHE_ENTRY_COUNT (4u)
+
+/// Field index of an entry that stores a method
+#define INLINE_CACHE_NO_FIELD    (UINT32_MAX)
+
+/// @brief An entry of an inline cache
+typedef struct {
+    /// The shape of the receiver or NULL if the entry is empty
+    object_shape_t * shape;
+    /// The version of the class of the receiver when the entry was created - the entry is invalid if the version has
+    /// changed
+    uint32_t classVersion;
+    /// Slot of the field in the receiver or INLINE_CACHE_NO_FIELD if the property is a method
+    uint32_t fieldIndex;
+    /// The method that was resolved - only used if the property is a method
+    value_t method;
+    /// The shape of the receiver after the field has been added by an assignment - NULL if the field already exists
+    object_shape_t * transition;
+} inline_cache_entry_t;
+
+/// @brief An inline cache of a single call site
+typedef struct {
+    /// The entries of the cache - the entry that has been created most recently is stored first
+    inline_cache_entry_t entries[INLINE_CACHE_ENTRY_COUNT];
+} inline_cache_t;
+
+/// @brief Initializes an inline cache
+/// @param cache The inline cache that is initialized
+void inline_cache_init(inline_cache_t * cache);
+
+/// @brief Marks the classes of all the shapes that are stored in the inline cache
+/// @param cache The inline cache where all the classes are marked
+/// @details The shapes are owned by the classes and the methods are marked by the classes, entries with an outdated
+/// version are never used
+void inline_cache_mark(inline_cache_t * cache);
+
+/// @brief Stores the result of a lookup in an inline cache
+/// @param cache The inline cache where the result is stored
+/// @param shape The shape of the receiver
+/// @param fieldIndex The slot of the field in the receiver or INLINE_CACHE_NO_FIELD
+/// @param method The method that was resolved - only used if the field index is INLINE_CACHE_NO_FIELD
+/// @param transition The shape of the receiver after the field has been added or NULL if the field already exists
+/// @details The entry of the shape is replaced, if the shape is already stored in the cache. Otherwise the least
+/// recently created entry is evicted, if the cache is full
+void inline_cache_update(inline_cache_t * cache, object_shape_t * shape, uint32_t fieldIndex, value_t method,
+                         object_shape_t * transition);
+
+#endif
@@ -0,0 +1,190 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file threaded_code.c
+ * @brief File containing the implementation of functionality regarding pre-decoded threaded code.
+ */
+
+#include "threaded_code.h"
+
+#include "../backend/memory_mutator.h"
+#include "../language-models/object.h"
+
+static uint32_t threaded_code_cell_count(chunk_t *, uint32_t);
+
+void threaded_code_free(threaded_code_t * threadedCode) {
+    FREE_ARRAY(threaded_code_cell_t, threadedCode->cells, threadedCode->count);
+    FREE_ARRAY(uint32_t, threadedCode->opCodeIndexes, threadedCode->count);
+    threaded_code_init(threadedCode);
+}
+
+void threaded_code_init(threaded_code_t * threadedCode) {
+    threadedCode->count = 0u;
+    threadedCode->cells = NULL;
+    threadedCode->opCodeIndexes = NULL;
+}
+
+void threaded_code_translate(threaded_code_t * threadedCode, chunk_t * chunk, void * const * handlers) {
+    // Index of the first cell of every bytecode instruction, needed to translate the jump offsets
+    uint32_t * cellIndexes = ALLOCATE(uint32_t, chunk->byteCodeCount + 1u);
+    uint32_t cellCount = 0u;
+    for (uint32_t i = 0u; i < chunk->byteCodeCount; i += chunk_instruction_length(chunk, i)) {
+        for (uint32_t j = i; j < i + chunk_instruction_length(chunk, i); j++) {
+            cellIndexes[j] = cellCount;
+        }
+        cellCount += threaded_code_cell_count(chunk, i);
+    }
+    cellIndexes[chunk->byteCodeCount] = cellCount;
+
+    threaded_code_cell_t * cells = ALLOCATE(threaded_code_cell_t, cellCount);
+    uint32_t * opCodeIndexes = ALLOCATE(uint32_t, cellCount);
+    for (uint32_t i = 0u; i < chunk->byteCodeCount; i += chunk_instruction_length(chunk, i)) {
+        uint8_t const * instruction = chunk->code + i;
+        threaded_code_cell_t * cell = cells + cellIndexes[i];
+        for (uint32_t j = 0u; j < threaded_code_cell_count(chunk, i); j++) {
+            opCodeIndexes[cellIndexes[i] + j] = i;
+        }
+        // A wide instruction is translated into the cells of the narrow instruction, only its first operand is read
+        // differently - the operands after the index of a constant start three bytes later
+        bool wide = *instruction == OP_WIDE;
+        uint8_t opCode = wide ? instruction[1] : *instruction;
+        uint8_t const * operands = wide ? instruction + 3u : instruction;
+        uint32_t next = i + chunk_instruction_length(chunk, i);
+        (cell++)->handler = handlers[opCode];
+        switch (opCode) {
+        case OP_ARRAY_LITERAL:
+        case OP_GET_CAPTURED_VALUE:
+        case OP_GET_LOCAL:
+        case OP_GET_LOCAL_GET_PROPERTY:
+        case OP_GET_UPVALUE:
+        case OP_SET_LOCAL:
+        case OP_SET_UPVALUE:
+            cell->operand = instruction[1];
+            break;
+        case OP_CALL:
+        case OP_TAIL_CALL:
+            (cell++)->operand = instruction[1];
+            cell->callCache = &chunk->callCaches[(instruction[2] << 8) | instruction[3]];
+            break;
+        case OP_CALL_INTRINSIC:
+            (cell++)->operand = instruction[1];
+            cell->operand = instruction[2];
+            break;
+        case OP_CONSTANT:
+            cell->constant = &chunk->constants.values[chunk_read_constant_index(chunk, i)];
+            break;
+        case OP_CLASS:
+        case OP_GET_SUPER:
+        case OP_METHOD:
+            cell->string = AS_STRING(chunk->constants.values[chunk_read_constant_index(chunk, i)]);
+            break;
+        case OP_DEFINE_GLOBAL:
+        case OP_GET_GLOBAL:
+        case OP_SET_GLOBAL:
+        case OP_SET_GLOBAL_POP:
+            (cell++)->string = AS_STRING(chunk->constants.values[chunk_read_constant_index(chunk, i)]);
+            cell->operand = (uint32_t)((operands[2] << 8) | operands[3]);
+            break;
+        case OP_GET_PROPERTY:
+        case OP_SET_PROPERTY:
+            (cell++)->string = AS_STRING(chunk->constants.values[chunk_read_constant_index(chunk, i)]);
+            cell->inlineCache = &chunk->inlineCaches[(operands[2] << 8) | operands[3]];
+            break;
+        case OP_INVOKE:
+        case OP_TAIL_INVOKE:
+            (cell++)->string = AS_STRING(chunk->constants.values[chunk_read_constant_index(chunk, i)]);
+            (cell++)->operand = operands[2];
+            cell->inlineCache = &chunk->inlineCaches[(operands[3] << 8) | operands[4]];
+            break;
+        case OP_SUPER_INVOKE:
+            (cell++)->string = AS_STRING(chunk->constants.values[chunk_read_constant_index(chunk, i)]);
+            cell->operand = operands[2];
+            break;
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+            // The offsets are relative to the end of the instruction - in bytes and in cells
+            cell->operand = cellIndexes[chunk_jump_target(chunk, i)] - cellIndexes[next];
+            break;
+        case OP_LOOP:
+            cell->operand = cellIndexes[next] - cellIndexes[chunk_jump_target(chunk, i)];
+            break;
+        case OP_REGISTER_ADD:
+        case OP_REGISTER_DIVIDE:
+        case OP_REGISTER_EQUAL:
+        case OP_REGISTER_GREATER:
+        case OP_REGISTER_LESS:
+        case OP_REGISTER_LESS_JUMP_IF_FALSE:
+        case OP_REGISTER_MOVE:
+        case OP_REGISTER_MULTIPLY:
+        case OP_REGISTER_SUBTRACT:
+            // The register operands are decoded by the instructions, because the slots are relative to the call frame
+            for (uint32_t j = 1u; j < chunk_instruction_length(chunk, i); j++) {
+                (cell++)->operand = instruction[j];
+            }
+            break;
+        case OP_CLOSURE:
+            {
+                uint32_t constant = chunk_read_constant_index(chunk, i);
+                (cell++)->constant = &chunk->constants.values[constant];
+                object_function_t * function = AS_FUNCTION(chunk->constants.values[constant]);
+                // A pair of operands (isLocal and index) for every upvalue and value that is captured by the closure
+                for (uint32_t j = 0u; j < 2u * (function->upvalueCount + function->capturedValueCount); j++) {
+                    (cell++)->operand = operands[2u + j];
+                }
+                break;
+            }
+        default:
+            break;
+        }
+    }
+    FREE_ARRAY(uint32_t, cellIndexes, chunk->byteCodeCount + 1u);
+    threadedCode->cells = cells;
+    threadedCode->opCodeIndexes = opCodeIndexes;
+    threadedCode->count = cellCount;
+}
+
+/// @brief Determines the amount of cells that are needed to store the instruction at the specified index
+/// @param chunk The chunk where the instruction is stored
+/// @param opCodeIndex The index of the opcode of the instruction
+/// @return The amount of cells the instruction occupies in the threaded code
+static uint32_t threaded_code_cell_count(chunk_t * chunk, uint32_t opCodeIndex) {
+    // A wide instruction occupies as many cells as the narrow instruction, that is three bytes shorter
+    bool wide = chunk->code[opCodeIndex] == OP_WIDE;
+    uint32_t length = chunk_instruction_length(chunk, opCodeIndex) - (wide ? 3u : 0u);
+    switch (chunk->code[opCodeIndex + (wide ? 1u : 0u)]) {
+    // Jump offsets are stored in a single cell
+    case OP_JUMP:
+    case OP_JUMP_IF_FALSE:
+    case OP_LOOP:
+        return 2u;
+    // The slot of a global variable is stored in a single cell
+    case OP_DEFINE_GLOBAL:
+    case OP_GET_GLOBAL:
+    case OP_SET_GLOBAL:
+    case OP_SET_GLOBAL_POP:
+    // The index of an inline cache or a call cache is replaced by the address of the cache
+    case OP_CALL:
+    case OP_GET_PROPERTY:
+    case OP_INVOKE:
+    case OP_SET_PROPERTY:
+    case OP_TAIL_CALL:
+    case OP_TAIL_INVOKE:
+        return length - 1u;
+    // Every other operand is stored in a cell of its own
+    default:
+        return length;
+    }
+}
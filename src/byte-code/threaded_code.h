@@ -0,0 +1,71 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Frederik Tobner                                    *
+ *                                                                          *
+ * This file is part of Cellox.                                             *
+ *                                                                          *
+ * Permission to use, copy, modify, and distribute this software and its    *
+ * documentation under the terms of the GNU General Public License is       *
+ * hereby granted.                                                          *
+ * No representations are made about the suitability of this software for   *
+ * any purpose.                                                             *
+ * It is provided "as is" without express or implied warranty.              *
+ * See the <https://www.gnu.org/licenses/gpl-3.0.html/>GNU General Public   *
+ * License for more details.                                                *
+ ****************************************************************************/
+
+/**
+ * @file threaded_code.h
+ * @brief Header file containing the declarations of functionality regarding pre-decoded threaded code.
+ * @details Threaded code is a translation of a chunk, where every opcode is replaced by the address of the code that
+ * executes the instruction and every operand is already decoded. The chunk itself is kept, because it is still needed
+ * by the disassembler and to determine the line of an instruction.
+ */
+
+#ifndef CELLOX_THREADED_CODE_H_
+#define CELLOX_THREADED_CODE_H_
+
+#include "../common.h"
+#include "../language-models/value.h"
+#include "chunk.h"
+
+/// @brief A single cell of threaded code
+typedef union {
+    /// Address of the code that executes the instruction
+    void * handler;
+    /// A decoded operand (e.g. the slot of a local variable or the distance of a jump in cells)
+    uint32_t operand;
+    /// Pointer to a constant in the constant pool of the chunk
+    value_t * constant;
+    /// A string constant
+    object_string_t * string;
+    /// The inline cache of a property access or a method invocation
+    inline_cache_t * inlineCache;
+    /// The call cache of a call expression
+    call_cache_t * callCache;
+} threaded_code_cell_t;
+
+/// @brief Pre-decoded threaded code of a chunk
+typedef struct {
+    /// Amount of cells in the threaded code
+    uint32_t count;
+    /// The cells of the threaded code
+    threaded_code_cell_t * cells;
+    /// The index of the bytecode instruction in the chunk every cell belongs to
+    uint32_t * opCodeIndexes;
+} threaded_code_t;
+
+/// @brief Deallocates the memory used by the threaded code
+/// @param threadedCode The threaded code that is freed
+void threaded_code_free(threaded_code_t * threadedCode);
+
+/// @brief Initializes threaded code
+/// @param threadedCode The threaded code that is initialized
+void threaded_code_init(threaded_code_t * threadedCode);
+
+/// @brief Translates a chunk into threaded code
+/// @param threadedCode The threaded code where the translation is stored
+/// @param chunk The chunk that is translated
+/// @param handlers The addresses of the code that executes the instructions - indexed by the opcode
+void threaded_code_translate(threaded_code_t * threadedCode, chunk_t * chunk, void * const * handlers);
+
+#endif
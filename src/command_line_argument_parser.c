@@ -26,7 +26,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "backend/virtual_machine.h"
 #include "common.h"
+#include "frontend/compiler.h"
 #include "initializer.h"
 
 /// @brief Command line options of the cellox compiler
@@ -37,6 +39,10 @@ typedef enum {
     OPTION_TYPE_COMPILE,
     /// --help / -h
     OPTION_TYPE_HELP,
+    /// --jit / -j
+    OPTION_TYPE_JIT,
+    /// --stack-bytecode / -s
+    OPTION_TYPE_STACK_BYTECODE,
     /// --version / -v
     OPTION_TYPE_VERSION
 } command_line_option_type;
@@ -60,6 +66,10 @@ static command_line_option_type_config_t optionConfigs[] = {
                              .longRepresentation = "--compile",
                              .exclusionaryOption = true},
     [OPTION_TYPE_HELP] = {.shortRepresentation = "-h", .longRepresentation = "--help", .exclusionaryOption = true},
+    [OPTION_TYPE_JIT] = {.shortRepresentation = "-j", .longRepresentation = "--jit", .exclusionaryOption = false},
+    [OPTION_TYPE_STACK_BYTECODE] = {.shortRepresentation = "-s",
+                                    .longRepresentation = "--stack-bytecode",
+                                    .exclusionaryOption = false},
     [OPTION_TYPE_VERSION] = {
         .shortRepresentation = "-v", .longRepresentation = "--version", .exclusionaryOption = true}};
 
@@ -129,14 +139,27 @@ static inline bool command_line_argument_parser_is_option(char const * argument)
 /// @param option The option that is parsed (character sequence)
 /// @param currentOption The option that was previously specified
 static void command_line_argument_parser_parse_option(char const * option, command_line_option_type * currentOption) {
-    // Old option is a singular option
-    if (optionConfigs[*currentOption].exclusionaryOption) {
-        command_line_argument_parser_error("Multiple options specified");
-    }
     size_t upperBound = sizeof(optionConfigs) / sizeof(command_line_option_type_config_t);
     for (size_t i = 1; i < upperBound; i++) {
         if (!strcmp(optionConfigs[i].shortRepresentation, option) ||
             !strcmp(optionConfigs[i].longRepresentation, option)) {
+            // Options that are not exclusionary configure the compiler and can be combined with every other option
+            switch (i) {
+            case OPTION_TYPE_JIT:
+                if (!virtual_machine_set_dispatch_technique(DISPATCH_TECHNIQUE_JIT)) {
+                    command_line_argument_parser_error("The just in time compiler is not supported on this platform");
+                }
+                return;
+            case OPTION_TYPE_STACK_BYTECODE:
+                compiler_set_instruction_set(INSTRUCTION_SET_STACK);
+                return;
+            default:
+                break;
+            }
+            // Old option is a singular option
+            if (optionConfigs[*currentOption].exclusionaryOption) {
+                command_line_argument_parser_error("Multiple options specified");
+            }
             // New option is a singular option
             if (optionConfigs[i].exclusionaryOption && *currentOption) {
                 command_line_argument_parser_error("Multiple exclusionary options specified");
@@ -28,10 +28,11 @@
 #include "../common.h"
 // The debug header file only needs to be included if the bytecode is dissasembled
 #ifdef DEBUG_PRINT_CODE
-#include "../bytecode/chunk_disassembler.h"
+#include "../byte-code/chunk_disassembler.h"
 #endif
 #include "../backend/garbage_collector.h"
 #include "../backend/memory_mutator.h"
+#include "../backend/native_functions.h"
 #include "../backend/virtual_machine.h"
 #include "../middle-end/chunk_optimizer.h"
 #include "lexer.h"
@@ -97,6 +98,10 @@ typedef struct {
     int32_t depth;
     /// Boolean value that determines whether the local variable is captured by a closure
     bool isCaptured;
+    /// @brief Boolean value that determines whether the local variable is captured by value
+    /// @details Closures store a copy of the value of a local variable that is never assigned after its declaration,
+    /// instead of an upvalue that has to be closed
+    bool isCapturedByValue;
 } local_t;
 
 /// @brief An upvalue structure
@@ -107,6 +112,16 @@ typedef struct {
     bool isLocal;
 } upvalue_t;
 
+/// @brief A bytecode instruction that pushes a value onto the stack, that can also be used as a register operand
+/// @details The OP_GET_LOCAL and OP_CONSTANT instructions are fused with the instruction that consumes the value, if
+/// the register based instruction set is emitted
+typedef struct {
+    /// Offset of the instruction in the chunk (-1 if there is no such instruction)
+    int32_t offset;
+    /// The register operand that refers to the same value (slot of a local variable or constant)
+    uint8_t operand;
+} register_operand_t;
+
 /// @brief A cellox function
 typedef enum {
     /// Marks a normal function
@@ -135,9 +150,30 @@ typedef struct compiler_t {
     int32_t localCount;
     /// @brief The upvalues of the current scope (part of a closure)
     upvalue_t upvalues[UINT8_COUNT];
+    /// @brief The variables of the enclosing scopes that are captured by value
+    upvalue_t capturedValues[UINT8_COUNT];
     /// @brief The scopedepth
     /// @details Used to determine whether a declared variable is a global or a local variable
     int32_t scopeDepth;
+    /// @brief The last two instructions that pushed a value that can be used as a register operand
+    /// @details The most recent instruction is stored at the highest index
+    register_operand_t registerOperands[2];
+    /// @brief Offset of the last register instruction that pushes its result onto the stack (-1 if there is none)
+    int32_t registerInstructionOffset;
+    /// @brief Offset of the last instruction that is the target of a jump
+    /// @details Instructions are never fused across a jump target
+    int32_t lastJumpTarget;
+    /// @brief Offset of the last OP_CALL or OP_INVOKE instruction (-1 if there is none)
+    /// @details Used to turn a call in tail position into a tail call
+    int32_t callInstructionOffset;
+    /// @brief Offset of the last OP_GET_PROPERTY instruction (-1 if there is none)
+    /// @details Used to turn a property that is called right away into an invocation
+    int32_t propertyInstructionOffset;
+    /// @brief Determines whether the forward jumps are emitted in their wide form
+    bool wideJumps;
+    /// @brief Flag that indicates that a narrow forward jump was too long for its 16-bit offset
+    /// @details The function is compiled again with wide forward jumps afterwards
+    bool jumpTooLong;
 } compiler_t;
 
 /// @brief  Class compiler struct definition
@@ -155,12 +191,15 @@ parser_t parser;
 /// @brief Global compiler variable
 compiler_t * current = NULL;
 
+/// @brief The instruction set that is emitted by the compiler
+static instruction_set instructionSet = INSTRUCTION_SET_REGISTER;
+
 /// @brief Global classCompiler variable
 /// @details Used to model inheritance for a cellox class
 class_compiler_t * currentClass = NULL;
 
 static void compiler_add_local(token_t);
-static uint32_t compiler_add_upvalue(compiler_t *, uint8_t, bool);
+static uint32_t compiler_add_upvalue(compiler_t *, uint8_t, bool, bool);
 static void compiler_advance();
 static void compiler_and(bool);
 static uint8_t compiler_argument_list();
@@ -169,23 +208,30 @@ static void compiler_binary(bool);
 static inline void compiler_binary_number(bool);
 static void compiler_block();
 static inline void compiler_call(bool);
+static void compiler_call_property(int32_t);
 static inline bool compiler_check(tokentype);
 static void compiler_class_declaration();
 static void compiler_consume(tokentype, char const *);
 static inline chunk_t * compiler_current_chunk();
 static void compiler_declaration();
 static void compiler_declare_variable();
-static void compiler_define_variable(uint8_t);
+static void compiler_define_variable(uint32_t);
 static void compiler_do_while_statement();
 static void compiler_dot(bool);
 static void compiler_dynamic_array(bool);
 static uint8_t compiler_dynamic_array_argument_list();
+static void compiler_emit_binary_operator(uint8_t);
 static void compiler_emit_byte(uint8_t);
 static void compiler_emit_bytes(uint8_t, uint8_t);
+static void compiler_emit_call_cache();
+static void compiler_emit_constant_instruction(uint8_t, uint32_t);
 static inline void compiler_emit_constant(value_t);
+static void compiler_emit_inline_cache();
 static int32_t compiler_emit_jump(uint8_t);
 static void compiler_emit_loop(int32_t);
+static void compiler_emit_pop();
 static void compiler_emit_return();
+static void compiler_emit_variable(uint8_t, uint32_t);
 static object_function_t * compiler_end();
 static void compiler_end_scope();
 static inline void compiler_error(char const *, ...);
@@ -199,31 +245,36 @@ static void compiler_function_declaration();
 static inline parse_rule_t * compiler_get_rule(tokentype);
 static void compiler_grouping(bool);
 static inline void compiler_hex_number(bool);
-static uint8_t compiler_identifier_constant(token_t *);
+static uint32_t compiler_identifier_constant(token_t *);
 static bool compiler_identifiers_equal(token_t *, token_t *);
 static void compiler_if_statement();
 static void compiler_init(compiler_t *, function_type);
 static void compiler_index_of(bool, uint8_t, uint32_t);
+static void compiler_intrinsic_call(uint8_t);
+static bool compiler_is_assigned(token_t *, bool);
 static void compiler_literal(bool);
 static void compiler_mark_initialized();
-static uint8_t compiler_make_constant(value_t);
+static uint32_t compiler_make_constant(value_t);
 static bool compiler_match_token(tokentype);
 static void compiler_method();
 static void compiler_named_variable(token_t, bool);
-static void compiler_nondirect_assignment(uint8_t, uint8_t, uint8_t, uint8_t);
+static void compiler_nondirect_assignment(uint8_t, uint8_t, uint8_t, uint32_t);
 static inline void compiler_number(bool);
 static void compiler_or(bool);
 static void compiler_parse_precedence(precedence);
-static uint8_t compiler_parse_variable(char const *);
+static uint32_t compiler_parse_variable(char const *);
 static void compiler_patch_jump(int32_t);
+static void compiler_record_register_operand(int32_t, uint8_t);
+static void compiler_reset_register_operands();
 static int32_t compiler_resolve_local(compiler_t *, token_t *);
-static int32_t compiler_resolve_upvalue(compiler_t *, token_t *);
+static int32_t compiler_resolve_upvalue(compiler_t *, token_t *, bool *);
 static void compiler_return_statement();
 static void compiler_statement();
 static void compiler_string(bool);
 static void compiler_super(bool);
 static void compiler_synchronize();
 static token_t compiler_synthetic_token(char const *);
+static void compiler_tail_call(int32_t);
 static void compiler_this(bool);
 static void compiler_unary(bool);
 static void compiler_var_declaration();
@@ -287,20 +338,34 @@ static parse_rule_t rules[] = {
     [TOKEN_WHILE] = {.prefix = NULL, .infix = NULL, .precedence = PREC_NONE}};
 
 object_function_t * compiler_compile(char const * program) {
-    lexer_init(program);
     compiler_t compiler;
-    compiler_init(&compiler, TYPE_SCRIPT);
-    parser.hadError = false;
-    parser.panicMode = false;
-    compiler_advance();
-    // We keep compiling until we hit the end of the source file
-    while (!compiler_match_token(TOKEN_EOF)) {
-        compiler_declaration();
+    object_function_t * function;
+    bool wideJumps = false;
+    for (;;) {
+        lexer_init(program);
+        compiler_init(&compiler, TYPE_SCRIPT);
+        compiler.wideJumps = wideJumps;
+        parser.hadError = false;
+        parser.panicMode = false;
+        compiler_advance();
+        // We keep compiling until we hit the end of the source file
+        while (!compiler_match_token(TOKEN_EOF)) {
+            compiler_declaration();
+        }
+        function = compiler_end();
+        if (!compiler.jumpTooLong || parser.hadError) {
+            break;
+        }
+        // A forward jump was too long for a 16-bit offset - the script is compiled again with wide forward jumps
+        wideJumps = true;
     }
-    object_function_t * function = compiler_end();
     return parser.hadError ? NULL : function;
 }
 
+void compiler_set_instruction_set(instruction_set set) {
+    instructionSet = set;
+}
+
 void compiler_mark_roots() {
     compiler_t * compiler = current;
     while (compiler) {
@@ -320,30 +385,33 @@ static void compiler_add_local(token_t name) {
     local->name = name;
     local->depth = -1;
     local->isCaptured = false;
+    local->isCapturedByValue = false;
 }
 
 /// @brief Adds an upValue to the compiler
 /// @param compiler The compiler where the upvalue is added
 /// @param index The index of the upvalue
 /// @param isLocal A boolean value that indicates whether the upvalue comes from a local variable
-/// @return The index of the upvalue
-static uint32_t compiler_add_upvalue(compiler_t * compiler, uint8_t index, bool isLocal) {
-    uint32_t upvalueCount = compiler->function->upvalueCount;
-
-    for (uint32_t i = 0; i < upvalueCount; i++) {
-        upvalue_t * upvalue = &compiler->upvalues[i];
+/// @param byValue A boolean value that indicates whether the variable is captured by value
+/// @return The index of the upvalue - the upvalues and the values that are captured by value are indexed separately
+static uint32_t compiler_add_upvalue(compiler_t * compiler, uint8_t index, bool isLocal, bool byValue) {
+    upvalue_t * upvalues = byValue ? compiler->capturedValues : compiler->upvalues;
+    uint32_t * upvalueCount = byValue ? &compiler->function->capturedValueCount : &compiler->function->upvalueCount;
+
+    for (uint32_t i = 0; i < *upvalueCount; i++) {
+        upvalue_t * upvalue = &upvalues[i];
         if (upvalue->index == index && upvalue->isLocal == isLocal) {
             return i;
         }
     }
-    if (upvalueCount == UINT8_COUNT) {
+    if (*upvalueCount == UINT8_COUNT) {
         compiler_error("Too many closure variables in function.");
         return 0;
     }
 
-    compiler->upvalues[upvalueCount].isLocal = isLocal;
-    compiler->upvalues[upvalueCount].index = index;
-    return compiler->function->upvalueCount++;
+    upvalues[*upvalueCount].isLocal = isLocal;
+    upvalues[*upvalueCount].index = index;
+    return (*upvalueCount)++;
 }
 
 /// @brief Advances a poosition further in the linear sequence of tokens
@@ -403,34 +471,37 @@ static void compiler_binary(bool canAssign) {
 
     switch (operatorType) {
     case TOKEN_BANG_EQUAL:
-        compiler_emit_bytes(OP_EQUAL, OP_NOT);
+        compiler_emit_binary_operator(OP_EQUAL);
+        compiler_emit_byte(OP_NOT);
         break;
     case TOKEN_EQUAL_EQUAL:
-        compiler_emit_byte(OP_EQUAL);
+        compiler_emit_binary_operator(OP_EQUAL);
         break;
     case TOKEN_GREATER:
-        compiler_emit_byte(OP_GREATER);
+        compiler_emit_binary_operator(OP_GREATER);
         break;
     case TOKEN_GREATER_EQUAL:
-        compiler_emit_bytes(OP_LESS, OP_NOT);
+        compiler_emit_binary_operator(OP_LESS);
+        compiler_emit_byte(OP_NOT);
         break;
     case TOKEN_LESS:
-        compiler_emit_byte(OP_LESS);
+        compiler_emit_binary_operator(OP_LESS);
         break;
     case TOKEN_LESS_EQUAL:
-        compiler_emit_bytes(OP_GREATER, OP_NOT);
+        compiler_emit_binary_operator(OP_GREATER);
+        compiler_emit_byte(OP_NOT);
         break;
     case TOKEN_PLUS:
-        compiler_emit_byte(OP_ADD);
+        compiler_emit_binary_operator(OP_ADD);
         break;
     case TOKEN_MINUS:
-        compiler_emit_byte(OP_SUBTRACT);
+        compiler_emit_binary_operator(OP_SUBTRACT);
         break;
     case TOKEN_STAR:
-        compiler_emit_byte(OP_MULTIPLY);
+        compiler_emit_binary_operator(OP_MULTIPLY);
         break;
     case TOKEN_SLASH:
-        compiler_emit_byte(OP_DIVIDE);
+        compiler_emit_binary_operator(OP_DIVIDE);
         break;
     case TOKEN_MODULO:
         compiler_emit_byte(OP_MODULO);
@@ -461,10 +532,40 @@ static void compiler_block() {
 /// @brief Compiles a call expression
 /// @param canAssign Unused for call expressions
 /// @details For that purpose all the arguments when calling the function are compiled and a CALL instruction is emited
-/// followed by the amount of arguments, that where used when the function was called
+/// followed by the amount of arguments, that where used when the function was called, and the index of the call cache
+/// of the call site
 static inline void compiler_call(bool canAssign) {
+    chunk_t * chunk = compiler_current_chunk();
+    int32_t offset = current->propertyInstructionOffset;
+    // (instance.method)(arguments) -> instance.method(arguments), unless a jump targets the end of the property
+    if (offset >= 0 && offset + (int32_t)chunk_instruction_length(chunk, offset) == (int32_t)chunk->byteCodeCount &&
+        current->lastJumpTarget <= offset) {
+        compiler_call_property(offset);
+        return;
+    }
     uint8_t argCount = compiler_argument_list();
+    current->callInstructionOffset = compiler_current_chunk()->byteCodeCount;
     compiler_emit_bytes(OP_CALL, argCount);
+    compiler_emit_call_cache();
+}
+
+/// @brief Compiles a call of a property that was compiled last to an invocation
+/// @param offset The offset of the OP_GET_PROPERTY instruction
+/// @details The property isn't bound to the instance, if it is a method. The name and the inline cache of
+/// OP_GET_PROPERTY are reused by the OP_INVOKE instruction
+static void compiler_call_property(int32_t offset) {
+    chunk_t * chunk = compiler_current_chunk();
+    uint32_t name = chunk_read_constant_index(chunk, (uint32_t)offset);
+    uint8_t cacheHigh = chunk->code[chunk->byteCodeCount - 2];
+    uint8_t cacheLow = chunk->code[chunk->byteCodeCount - 1];
+    chunk_truncate(chunk, (uint32_t)offset);
+    compiler_reset_register_operands();
+    current->propertyInstructionOffset = -1;
+    uint8_t argCount = compiler_argument_list();
+    current->callInstructionOffset = compiler_current_chunk()->byteCodeCount;
+    compiler_emit_constant_instruction(OP_INVOKE, name);
+    compiler_emit_byte(argCount);
+    compiler_emit_bytes(cacheHigh, cacheLow);
 }
 
 /// @brief  Checks if the next Token is of a given type
@@ -480,9 +581,9 @@ static void compiler_class_declaration() {
     // Compiles the name of the class
     compiler_consume(TOKEN_IDENTIFIER, "Expect class name.");
     token_t className = parser.previous;
-    uint8_t nameConstant = compiler_identifier_constant(&parser.previous);
+    uint32_t nameConstant = compiler_identifier_constant(&parser.previous);
     compiler_declare_variable();
-    compiler_emit_bytes(OP_CLASS, nameConstant);
+    compiler_emit_constant_instruction(OP_CLASS, nameConstant);
     compiler_define_variable(nameConstant);
     class_compiler_t classCompiler;
     // If this class has a superclass we will set this to true later
@@ -577,14 +678,14 @@ static void compiler_declare_variable() {
 
 /// @brief Compiles the definition of a variable
 /// @param global The slot of the value
-static void compiler_define_variable(uint8_t global) {
+static void compiler_define_variable(uint32_t global) {
     if (current->scopeDepth > 0) {
         // Marks the variable as initialized (only used for local variables)
         compiler_mark_initialized();
         return;
     }
     // The variable has been declared at the global / top level scope
-    compiler_emit_bytes(OP_DEFINE_GLOBAL, global);
+    compiler_emit_variable(OP_DEFINE_GLOBAL, global);
 }
 
 /// @brief Compiles a do while statement
@@ -616,18 +717,21 @@ static void compiler_do_while_statement() {
 /// or invoking a method of a cellox object instance.
 static void compiler_dot(bool canAssign) {
     compiler_consume(TOKEN_IDENTIFIER, "Expect property name after '.'.");
-    uint8_t name = compiler_identifier_constant(&parser.previous);
+    uint32_t name = compiler_identifier_constant(&parser.previous);
 
     if (canAssign && compiler_match_token(TOKEN_EQUAL)) {
         compiler_expression();
-        compiler_emit_bytes(OP_SET_PROPERTY, name);
+        compiler_emit_constant_instruction(OP_SET_PROPERTY, name);
     } else if (compiler_match_token(TOKEN_LEFT_PAREN)) {
         uint8_t argCount = compiler_argument_list();
-        compiler_emit_bytes(OP_INVOKE, name);
+        current->callInstructionOffset = compiler_current_chunk()->byteCodeCount;
+        compiler_emit_constant_instruction(OP_INVOKE, name);
         compiler_emit_byte(argCount);
     } else {
-        compiler_emit_bytes(OP_GET_PROPERTY, name);
+        current->propertyInstructionOffset = compiler_current_chunk()->byteCodeCount;
+        compiler_emit_constant_instruction(OP_GET_PROPERTY, name);
     }
+    compiler_emit_inline_cache();
 }
 
 /// @brief
@@ -655,6 +759,58 @@ static uint8_t compiler_dynamic_array_argument_list() {
     return argCount;
 }
 
+/// @brief Emits a binary operator
+/// @param opCode The stack based instruction of the operator
+/// @details If the register based instruction set is emitted and both operands have just been pushed by OP_GET_LOCAL
+/// or OP_CONSTANT instructions, these instructions are replaced by a single register instruction that reads the
+/// operands directly from the slots of the call frame and the constants of the chunk
+static void compiler_emit_binary_operator(uint8_t opCode) {
+    uint8_t registerInstruction;
+    switch (opCode) {
+    case OP_ADD:
+        registerInstruction = OP_REGISTER_ADD;
+        break;
+    case OP_DIVIDE:
+        registerInstruction = OP_REGISTER_DIVIDE;
+        break;
+    case OP_EQUAL:
+        registerInstruction = OP_REGISTER_EQUAL;
+        break;
+    case OP_GREATER:
+        registerInstruction = OP_REGISTER_GREATER;
+        break;
+    case OP_LESS:
+        registerInstruction = OP_REGISTER_LESS;
+        break;
+    case OP_MULTIPLY:
+        registerInstruction = OP_REGISTER_MULTIPLY;
+        break;
+    case OP_SUBTRACT:
+        registerInstruction = OP_REGISTER_SUBTRACT;
+        break;
+    default:
+        compiler_emit_byte(opCode);
+        return;
+    }
+    register_operand_t * operands = current->registerOperands;
+    if (instructionSet != INSTRUCTION_SET_REGISTER || operands[0].offset < 0 ||
+        operands[0].offset + 2 != operands[1].offset ||
+        operands[1].offset + 2 != (int32_t)compiler_current_chunk()->byteCodeCount ||
+        current->lastJumpTarget > operands[0].offset) {
+        compiler_emit_byte(opCode);
+        return;
+    }
+    // OP_GET_LOCAL / OP_CONSTANT, OP_GET_LOCAL / OP_CONSTANT, operator -> register instruction
+    int32_t offset = operands[0].offset;
+    uint8_t left = operands[0].operand;
+    uint8_t right = operands[1].operand;
+    chunk_truncate(compiler_current_chunk(), (uint32_t)offset);
+    compiler_reset_register_operands();
+    compiler_emit_bytes(registerInstruction, REGISTER_DESTINATION_STACK);
+    compiler_emit_bytes(left, right);
+    current->registerInstructionOffset = offset;
+}
+
 /// @brief Emits a single byte
 /// @param byte The byte that is emitted
 static void compiler_emit_byte(uint8_t byte) {
@@ -669,18 +825,67 @@ static void compiler_emit_bytes(uint8_t byte1, uint8_t byte2) {
     compiler_emit_byte(byte2);
 }
 
+/// @brief Adds a call cache to the current chunk and emits the index of the cache
+/// @details Used by the instructions that call a callee
+static void compiler_emit_call_cache() {
+    uint32_t cache = chunk_add_call_cache(compiler_current_chunk());
+    if (cache > UINT16_MAX) {
+        // The index of the call cache is stored in two bytes
+        compiler_error("Too many calls in one chunk.");
+    }
+    compiler_emit_bytes((cache >> 8) & 0xff, cache & 0xff);
+}
+
 /// @brief Creates a constant bytecode instruction
 /// @param value The value of the constant
 /// This can either be a numerical value or a cellox object
 static inline void compiler_emit_constant(value_t value) {
-    compiler_emit_bytes(OP_CONSTANT, compiler_make_constant(value));
+    uint32_t constant = compiler_make_constant(value);
+    int32_t offset = compiler_current_chunk()->byteCodeCount;
+    compiler_emit_constant_instruction(OP_CONSTANT, constant);
+    if (constant < REGISTER_OPERAND_CONSTANT) {
+        compiler_record_register_operand(offset, constant | REGISTER_OPERAND_CONSTANT);
+    }
+}
+
+/// @brief Emits an instruction whose first operand is the index of a constant
+/// @param instruction The bytecode instruction that is emitted
+/// @param constant The index of the constant
+/// @details Constants after the first 256 constants of a chunk are referenced by the wide form of the instruction,
+/// that stores the index in three bytes
+static void compiler_emit_constant_instruction(uint8_t instruction, uint32_t constant) {
+    if (constant <= UINT8_MAX) {
+        compiler_emit_bytes(instruction, (uint8_t)constant);
+        return;
+    }
+    compiler_emit_bytes(OP_WIDE, instruction);
+    compiler_emit_byte((constant >> 16) & 0xff);
+    compiler_emit_bytes((constant >> 8) & 0xff, constant & 0xff);
+}
+
+/// @brief Adds an inline cache to the current chunk and emits the index of the cache
+/// @details Used by the instructions that access a property or invoke a method
+static void compiler_emit_inline_cache() {
+    uint32_t cache = chunk_add_inline_cache(compiler_current_chunk());
+    if (cache > UINT16_MAX) {
+        // The index of the inline cache is stored in two bytes
+        compiler_error("Too many property accesses in one chunk.");
+    }
+    compiler_emit_bytes((cache >> 8) & 0xff, cache & 0xff);
 }
 
 /// @brief Emits a bytecode instruction of the type jump (jump or jump-if-false) and writes a placeholder to the jump
 /// offset
 /// @param instruction The bytecode instruction that is emitted
 /// @return offset (start address) of the then or else branch
+/// @details The jump is emitted in its wide form with a four byte offset, if the function is compiled with wide jumps
 static int32_t compiler_emit_jump(uint8_t instruction) {
+    if (current->wideJumps) {
+        compiler_emit_bytes(OP_WIDE, instruction);
+        compiler_emit_bytes(0xff, 0xff);
+        compiler_emit_bytes(0xff, 0xff);
+        return compiler_current_chunk()->byteCodeCount - 4;
+    }
     compiler_emit_byte(instruction);
     compiler_emit_byte(0xff);
     compiler_emit_byte(0xff);
@@ -688,15 +893,51 @@ static int32_t compiler_emit_jump(uint8_t instruction) {
 }
 
 /// Emits the bytecode instructions for creating a loop
+/// @details Loop bodies with more than 65535 bytes are left using the wide form of the loop with a four byte offset
 static void compiler_emit_loop(int32_t loopStart) {
-    compiler_emit_byte(OP_LOOP);
-    int32_t offset = compiler_current_chunk()->byteCodeCount - loopStart + 2;
-    if (offset > (int32_t)UINT16_MAX) {
-        compiler_error(
-            "Loop body too large."); // There can only be 65535 lines betweem a jump instruction because we use a short
+    // The offset is relative to the end of the loop instruction
+    int32_t offset = compiler_current_chunk()->byteCodeCount - loopStart + 3;
+    if (offset <= (int32_t)UINT16_MAX) {
+        compiler_emit_byte(OP_LOOP);
+        compiler_emit_bytes((offset >> 8) & 0xff, offset & 0xff);
+        return;
     }
-    compiler_emit_byte((offset >> 8) & 0xff);
-    compiler_emit_byte(offset & 0xff);
+    offset += 3;
+    compiler_emit_bytes(OP_WIDE, OP_LOOP);
+    compiler_emit_bytes((offset >> 24) & 0xff, (offset >> 16) & 0xff);
+    compiler_emit_bytes((offset >> 8) & 0xff, offset & 0xff);
+}
+
+/// @brief Emits a pop bytecode instruction
+/// @details If the register based instruction set is emitted and the value that is popped has just been assigned to a
+/// local variable, the assignment is replaced by a register instruction that stores the value directly in the slot of
+/// the local variable
+static void compiler_emit_pop() {
+    chunk_t * chunk = compiler_current_chunk();
+    int32_t setLocal = (int32_t)chunk->byteCodeCount - 2;
+    int32_t instruction = current->registerInstructionOffset;
+    register_operand_t operand = current->registerOperands[1];
+    if (instructionSet == INSTRUCTION_SET_REGISTER && setLocal > 0) {
+        uint8_t slot = chunk->code[setLocal + 1];
+        // register instruction (push), OP_SET_LOCAL, OP_POP -> register instruction (local variable)
+        if (instruction >= 0 && instruction + 4 == setLocal && chunk->code[setLocal] == OP_SET_LOCAL &&
+            slot != REGISTER_DESTINATION_STACK && current->lastJumpTarget <= instruction) {
+            chunk->code[instruction + 1] = slot;
+            chunk_truncate(chunk, (uint32_t)setLocal);
+            compiler_reset_register_operands();
+            return;
+        }
+        // OP_GET_LOCAL / OP_CONSTANT, OP_SET_LOCAL, OP_POP -> OP_REGISTER_MOVE
+        if (operand.offset >= 0 && operand.offset + 2 == setLocal && chunk->code[setLocal] == OP_SET_LOCAL &&
+            slot != REGISTER_DESTINATION_STACK && current->lastJumpTarget <= operand.offset) {
+            chunk_truncate(chunk, (uint32_t)operand.offset);
+            compiler_reset_register_operands();
+            compiler_emit_bytes(OP_REGISTER_MOVE, slot);
+            compiler_emit_byte(operand.operand);
+            return;
+        }
+    }
+    compiler_emit_byte(OP_POP);
 }
 
 /// @brief Emits a return bytecode instruction
@@ -709,18 +950,45 @@ static void compiler_emit_return() {
     compiler_emit_byte(OP_RETURN);
 }
 
+/// @brief Emits an instruction that defines, gets or sets a variable
+/// @param instruction The bytecode instruction that is emitted
+/// @param arg The slot of a local variable, the index of an upvalue or the constant with the name of a global variable
+/// @details Global variables are additionally resolved to their slot in the global value array of the virtual machine
+static void compiler_emit_variable(uint8_t instruction, uint32_t arg) {
+    if (instruction != OP_DEFINE_GLOBAL && instruction != OP_GET_GLOBAL && instruction != OP_SET_GLOBAL) {
+        compiler_emit_bytes(instruction, (uint8_t)arg);
+        return;
+    }
+    compiler_emit_constant_instruction(instruction, arg);
+    uint32_t slot = virtual_machine_global_slot(AS_STRING(compiler_current_chunk()->constants.values[arg]));
+    if (slot > UINT16_MAX) {
+        // The slot of the global variable is stored in two bytes
+        compiler_error("Too many global variables.");
+    }
+    compiler_emit_bytes((slot >> 8) & 0xff, slot & 0xff);
+}
+
 /// @brief Yields a newly created function object after the compilation process finished
 static object_function_t * compiler_end() {
     compiler_emit_return();
     object_function_t * function = current->function;
 #ifdef DEBUG_PRINT_CODE
-    if (!parser.hadError) {
+    if (!parser.hadError && !current->jumpTooLong) {
         chunk_disassembler_disassemble_chunk(compiler_current_chunk(),
                                              function->name != NULL ? function->name->chars : "main", function->arity);
     }
 #endif
+    bool jumpTooLong = current->jumpTooLong;
     current = current->enclosing;
+    if (jumpTooLong) {
+        // The function is compiled again with wide forward jumps
+        return function;
+    }
     chunk_optimizer_optimize_chunk(&function->chunk);
+    // The virtual machine reserves the values of the call frame once per call, instead of checking every push
+    if (!chunk_determine_max_stack_depth(&function->chunk, &function->chunk.maxStackDepth) && !parser.hadError) {
+        compiler_error("Could not determine the stack depth of the function.");
+    }
     return function;
 }
 
@@ -799,7 +1067,7 @@ static void compiler_expression() {
 static void compiler_expression_statement() {
     compiler_expression();
     compiler_consume(TOKEN_SEMICOLON, "Expect ';' after expression.");
-    compiler_emit_byte(OP_POP);
+    compiler_emit_pop();
 }
 
 /// @brief Compiles a for-statement
@@ -831,7 +1099,7 @@ static void compiler_for_statement() {
         int32_t bodyJump = compiler_emit_jump(OP_JUMP);
         int32_t incrementStart = compiler_current_chunk()->byteCodeCount;
         compiler_expression();
-        compiler_emit_byte(OP_POP);
+        compiler_emit_pop();
         compiler_consume(TOKEN_RIGHT_PAREN, "Expect ')' after for clauses.");
         compiler_emit_loop(loopStart);
         loopStart = incrementStart;
@@ -852,39 +1120,59 @@ static void compiler_for_statement() {
 /// @brief Compiles a function declaration statement to bytecode instructions
 /// @param type The type of the function that is compiled
 static void compiler_function(function_type type) {
+    // The state of the lexer and the parser is stored, so the function can be compiled again
+    lexer_t lexerState = lexer_save_state();
+    parser_t parserState = parser;
     compiler_t compiler;
-    compiler_init(&compiler, type);
-    compiler_begin_scope();
+    object_function_t * function;
+    bool wideJumps = false;
+    for (;;) {
+        compiler_init(&compiler, type);
+        compiler.wideJumps = wideJumps;
+        compiler_begin_scope();
 
-    compiler_consume(TOKEN_LEFT_PAREN, "Expect '(' after function name.");
-    if (!compiler_check(TOKEN_RIGHT_PAREN)) {
-        // Compiling parameters of the function declaration
-        do {
-            // We expect an additional argument when the function is called
-            current->function->arity++;
-            // There are too much parameters specified
-            if (current->function->arity > 255) {
-                compiler_error_at_current("Can't have more than 255 parameters.");
-            }
-            uint8_t constant = compiler_parse_variable("Expect parameter name.");
-            compiler_define_variable(constant);
-        } while (compiler_match_token(TOKEN_COMMA));
+        compiler_consume(TOKEN_LEFT_PAREN, "Expect '(' after function name.");
+        if (!compiler_check(TOKEN_RIGHT_PAREN)) {
+            // Compiling parameters of the function declaration
+            do {
+                // We expect an additional argument when the function is called
+                current->function->arity++;
+                // There are too much parameters specified
+                if (current->function->arity > 255) {
+                    compiler_error_at_current("Can't have more than 255 parameters.");
+                }
+                uint32_t constant = compiler_parse_variable("Expect parameter name.");
+                compiler_define_variable(constant);
+            } while (compiler_match_token(TOKEN_COMMA));
+        }
+        compiler_consume(TOKEN_RIGHT_PAREN, "Expect ')' after parameters.");
+        compiler_consume(TOKEN_LEFT_BRACE, "Expect '{' before function body.");
+        // Compiles the statements inside a the function body
+        compiler_block();
+        function = compiler_end();
+        if (!compiler.jumpTooLong || parser.hadError) {
+            break;
+        }
+        // A forward jump was too long for a 16-bit offset - the function is compiled again with wide forward jumps
+        wideJumps = true;
+        lexer_restore_state(lexerState);
+        parser = parserState;
     }
-    compiler_consume(TOKEN_RIGHT_PAREN, "Expect ')' after parameters.");
-    compiler_consume(TOKEN_LEFT_BRACE, "Expect '{' before function body.");
-    // Compiles the statements inside a the function body
-    compiler_block();
-    object_function_t * function = compiler_end();
-    compiler_emit_bytes(OP_CLOSURE, compiler_make_constant(OBJECT_VAL(function)));
+    compiler_emit_constant_instruction(OP_CLOSURE, compiler_make_constant(OBJECT_VAL(function)));
     for (int32_t i = 0; i < function->upvalueCount; i++) {
         compiler_emit_byte(compiler.upvalues[i].isLocal ? 1 : 0);
         compiler_emit_byte(compiler.upvalues[i].index);
     }
+    // The values that are captured by value follow the upvalues
+    for (uint32_t i = 0; i < function->capturedValueCount; i++) {
+        compiler_emit_byte(compiler.capturedValues[i].isLocal ? 1 : 0);
+        compiler_emit_byte(compiler.capturedValues[i].index);
+    }
 }
 
 /// @brief Compiles a function statement and defines the function in the current environment
 static void compiler_function_declaration() {
-    uint8_t global = compiler_parse_variable("Expect function name.");
+    uint32_t global = compiler_parse_variable("Expect function name.");
     compiler_mark_initialized();
     compiler_function(TYPE_FUNCTION);
     // Defines the function at the specified slot
@@ -915,7 +1203,7 @@ static inline void compiler_hex_number(bool canAssign) {
 /// @brief Used to create a string object from an identifier token
 /// @param name The name of the token
 /// @return A byte code instruction that defines the constant
-static uint8_t compiler_identifier_constant(token_t * name) {
+static uint32_t compiler_identifier_constant(token_t * name) {
     return compiler_make_constant(OBJECT_VAL(object_copy_string(name->start, name->length, false)));
 }
 
@@ -938,6 +1226,8 @@ static void compiler_if_statement() {
     compiler_consume(TOKEN_RIGHT_PAREN, "Expect ')' after condition.");
     // Offset to the instruction that corresponds to the body of the then block
     int32_t thenJump = compiler_emit_jump(OP_JUMP_IF_FALSE);
+    // The condition is popped in both branches
+    compiler_emit_byte(OP_POP);
     compiler_statement();
     // Offset to the instruction that corresponds to the body of the else block
     int32_t elseJump = compiler_emit_jump(OP_JUMP);
@@ -959,14 +1249,20 @@ static void compiler_init(compiler_t * compiler, function_type type) {
     compiler->function = NULL;
     compiler->type = type;
     compiler->localCount = compiler->scopeDepth = 0;
+    compiler->lastJumpTarget = 0;
+    compiler->callInstructionOffset = -1;
+    compiler->propertyInstructionOffset = -1;
+    compiler->wideJumps = compiler->jumpTooLong = false;
     compiler->function = object_new_function();
     current = compiler;
+    compiler_reset_register_operands();
     if (type != TYPE_SCRIPT) {
         current->function->name = object_copy_string(parser.previous.start, parser.previous.length, false);
+        garbage_collector_write_barrier_object(&current->function->obj, &current->function->name->obj);
     }
     local_t * local = &current->locals[current->localCount++];
     local->depth = 0;
-    local->isCaptured = false;
+    local->isCaptured = local->isCapturedByValue = false;
     // In a method we refer to the memebers with this so we add it to the local values that are accessible
     if (type != TYPE_FUNCTION) {
         local->name.start = "this";
@@ -982,7 +1278,7 @@ static void compiler_init(compiler_t * compiler, function_type type) {
 /// @param getOp Indicates whether the index of gets a value
 /// @param arg The index of the constant
 static void compiler_index_of(bool canAssign, uint8_t getOp, uint32_t arg) {
-    compiler_emit_bytes(getOp, (uint8_t)arg);
+    compiler_emit_variable(getOp, arg);
     compiler_expression();
     if (compiler_match_token(TOKEN_RANGE)) {
         compiler_expression();
@@ -1009,6 +1305,56 @@ static void compiler_index_of(bool canAssign, uint8_t getOp, uint32_t arg) {
     }
 }
 
+/// @brief Compiles a call of a well-known native function to an intrinsic instruction
+/// @param native The index of the native function
+/// @details The native function isn't loaded from its global variable. The virtual machine checks whether the global
+/// variable still holds the native function and calls the value of the global variable otherwise
+static void compiler_intrinsic_call(uint8_t native) {
+    compiler_consume(TOKEN_LEFT_PAREN, "Expect '(' before arguments.");
+    uint8_t argCount = compiler_argument_list();
+    compiler_emit_bytes(OP_CALL_INTRINSIC, native);
+    compiler_emit_byte(argCount);
+}
+
+/// @brief Determines whether a local variable is assigned after its declaration
+/// @param name The name of the local variable
+/// @param isParameter Boolean value that determines whether the local variable is a parameter of a function
+/// @return true if the local variable may be assigned, false if not
+/// @details The tokens in the scope of the local variable are scanned again, from its name to the end of the block it
+/// was declared in (the body of the function for a parameter). Assignments of another variable with the same name in
+/// that range count as well, so a variable is never captured by value wrongly
+static bool compiler_is_assigned(token_t * name, bool isParameter) {
+    lexer_t lexerState = lexer_save_state();
+    // Synthetic names (this and super) are not part of the sourcecode, there are no tokens after them
+    lexer_restore_state((lexer_t){.start = name->start + name->length, .current = name->start + name->length});
+    // The body of a function starts after the parameters
+    int32_t depth = isParameter ? -1 : 0;
+    bool assigned = false;
+    tokentype beforePrevious = TOKEN_EOF;
+    token_t previous = {.type = TOKEN_EOF};
+    for (token_t token = lexer_scan_token(); token.type != TOKEN_EOF; token = lexer_scan_token()) {
+        if (token.type == TOKEN_LEFT_BRACE) {
+            depth++;
+        } else if (token.type == TOKEN_RIGHT_BRACE && --depth < 0) {
+            break;
+        }
+        bool assignment = token.type == TOKEN_EQUAL || token.type == TOKEN_MINUS_EQUAL ||
+                          token.type == TOKEN_MODULO_EQUAL || token.type == TOKEN_PLUS_EQUAL ||
+                          token.type == TOKEN_SLASH_EQUAL || token.type == TOKEN_STAR_EQUAL ||
+                          token.type == TOKEN_STAR_STAR_EQUAL;
+        // Neither a property (instance.name = value) nor the declaration of another variable (var name = value)
+        if (assignment && previous.type == TOKEN_IDENTIFIER && compiler_identifiers_equal(&previous, name) &&
+            beforePrevious != TOKEN_DOT && beforePrevious != TOKEN_VAR) {
+            assigned = true;
+            break;
+        }
+        beforePrevious = previous.type;
+        previous = token;
+    }
+    lexer_restore_state(lexerState);
+    return assigned;
+}
+
 /// @brief Compiles a boolean literal expression
 /// @param canAssign Unused for boolean literal expressions
 static void compiler_literal(bool canAssign) {
@@ -1039,14 +1385,15 @@ static void compiler_mark_initialized() {
 /// @brief Emits a constant bytecode instruction with the value that was passed as an argument up opon the function call
 /// @param value The value of the constant
 /// @return The index off the constant
-static uint8_t compiler_make_constant(value_t value) {
+static uint32_t compiler_make_constant(value_t value) {
     int32_t constant = chunk_add_constant(compiler_current_chunk(), value);
-    if (constant > (int32_t)UINT8_MAX) {
-        // A chunk can only contain 255 constants
+    garbage_collector_write_barrier(&current->function->obj, value);
+    if (constant >= (int32_t)CHUNK_CONSTANTS_MAX) {
+        // The wide instructions store the index of a constant in three bytes
         compiler_error("Too many constants in one chunk.");
         return 0;
     }
-    return (uint8_t)constant;
+    return (uint32_t)constant;
 }
 
 /// @brief Determines whether the next Token is from the specified TokenTypes and advances a position further, if that
@@ -1064,13 +1411,13 @@ static bool compiler_match_token(tokentype type) {
 /// @brief Compiles a method declaration
 static void compiler_method() {
     compiler_consume(TOKEN_IDENTIFIER, "Expect method name.");
-    uint8_t constant = compiler_identifier_constant(&parser.previous);
+    uint32_t constant = compiler_identifier_constant(&parser.previous);
     function_type type = TYPE_METHOD;
     if (parser.previous.length == 4 && !memcmp(parser.previous.start, "init", 4)) {
         type = TYPE_INITIALIZER; // The initializer method, also called constructor in other languages, of a class.
     }
     compiler_function(type);
-    compiler_emit_bytes(OP_METHOD, constant);
+    compiler_emit_constant_instruction(OP_METHOD, constant);
 }
 
 /// @brief Handles getting and setting a variable (locals, globals and upvalues)
@@ -1078,13 +1425,19 @@ static void compiler_method() {
 /// @param canAssign Boolean value that determines whether the value can be set
 static void compiler_named_variable(token_t name, bool canAssign) {
     uint8_t getOp, setOp;
+    bool byValue;
     int32_t arg = compiler_resolve_local(current, &name);
     if (arg != -1) {
         getOp = OP_GET_LOCAL;
         setOp = OP_SET_LOCAL;
-    } else if ((arg = compiler_resolve_upvalue(current, &name)) != -1) {
-        getOp = OP_GET_UPVALUE;
+    } else if ((arg = compiler_resolve_upvalue(current, &name, &byValue)) != -1) {
+        getOp = byValue ? OP_GET_CAPTURED_VALUE : OP_GET_UPVALUE;
+        // A variable that is captured by value is never assigned
         setOp = OP_SET_UPVALUE;
+    } else if (compiler_check(TOKEN_LEFT_PAREN) &&
+               (arg = native_functions_get_intrinsic(name.start, name.length)) != -1) {
+        compiler_intrinsic_call((uint8_t)arg);
+        return;
     } else {
         arg = compiler_identifier_constant(&name);
         getOp = OP_GET_GLOBAL;
@@ -1092,7 +1445,7 @@ static void compiler_named_variable(token_t name, bool canAssign) {
     }
     if (canAssign && compiler_match_token(TOKEN_EQUAL)) {
         compiler_expression();
-        compiler_emit_bytes(setOp, (uint8_t)arg);
+        compiler_emit_variable(setOp, arg);
     } else if (canAssign && compiler_match_token(TOKEN_PLUS_EQUAL)) {
         compiler_nondirect_assignment(OP_ADD, getOp, setOp, arg);
     } else if (canAssign && compiler_match_token(TOKEN_MINUS_EQUAL)) {
@@ -1108,7 +1461,11 @@ static void compiler_named_variable(token_t name, bool canAssign) {
     } else if (compiler_match_token(TOKEN_LEFT_BRACKET)) {
         compiler_index_of(canAssign, getOp, arg);
     } else {
-        compiler_emit_bytes(getOp, (uint8_t)arg);
+        int32_t offset = compiler_current_chunk()->byteCodeCount;
+        compiler_emit_variable(getOp, arg);
+        if (getOp == OP_GET_LOCAL && arg < REGISTER_OPERAND_CONSTANT) {
+            compiler_record_register_operand(offset, (uint8_t)arg);
+        }
     }
 }
 
@@ -1117,11 +1474,15 @@ static void compiler_named_variable(token_t name, bool canAssign) {
 /// @param getOp The left operand (x += 5 -> x)
 /// @param setOp The left operand (x += 5 -> x)
 /// @param arg The right operand (x += 5 -> 5)
-static void compiler_nondirect_assignment(uint8_t assignmentType, uint8_t getOp, uint8_t setOp, uint8_t arg) {
-    compiler_emit_bytes(getOp, arg);
+static void compiler_nondirect_assignment(uint8_t assignmentType, uint8_t getOp, uint8_t setOp, uint32_t arg) {
+    int32_t offset = compiler_current_chunk()->byteCodeCount;
+    compiler_emit_variable(getOp, arg);
+    if (getOp == OP_GET_LOCAL && arg < REGISTER_OPERAND_CONSTANT) {
+        compiler_record_register_operand(offset, arg);
+    }
     compiler_expression();
-    compiler_emit_byte(assignmentType);
-    compiler_emit_bytes(setOp, arg);
+    compiler_emit_binary_operator(assignmentType);
+    compiler_emit_variable(setOp, arg);
 }
 
 /// @brief compiles a number literal expression
@@ -1172,7 +1533,7 @@ static void compiler_parse_precedence(precedence precedence) {
 /// @brief Parses a variable statement
 /// @param errorMessage The error message that is shown if the identifier is not valid
 /// @return The slot of the local variable
-static uint8_t compiler_parse_variable(char const * errorMessage) {
+static uint32_t compiler_parse_variable(char const * errorMessage) {
     compiler_consume(TOKEN_IDENTIFIER, errorMessage);
     compiler_declare_variable();
     if (current->scopeDepth > 0) {
@@ -1184,14 +1545,42 @@ static uint8_t compiler_parse_variable(char const * errorMessage) {
 /// @brief Replaces the instruction at the given location with the calculated jump offset
 /// @param offset The offset if the instruction
 static void compiler_patch_jump(int32_t offset) {
-    // -2 to adjust for the bytecode for the jump offset itself.
-    int32_t jump = compiler_current_chunk()->byteCodeCount - offset - 2;
-    if (jump > (int32_t)UINT16_MAX) {
-        compiler_error("Too much code to jump over."); // More than 65,535 bytes of code
+    chunk_t * chunk = compiler_current_chunk();
+    if (current->wideJumps) {
+        // -4 to adjust for the bytecode for the wide jump offset itself
+        uint32_t jump = chunk->byteCodeCount - offset - 4;
+        chunk->code[offset] = (jump >> 24) & 0xff;
+        chunk->code[offset + 1] = (jump >> 16) & 0xff;
+        chunk->code[offset + 2] = (jump >> 8) & 0xff;
+        chunk->code[offset + 3] = jump & 0xff;
+    } else {
+        // -2 to adjust for the bytecode for the jump offset itself.
+        int32_t jump = chunk->byteCodeCount - offset - 2;
+        if (jump > (int32_t)UINT16_MAX) {
+            // More than 65,535 bytes of code - the function is compiled again with wide jumps
+            current->jumpTooLong = true;
+        }
+        // Jump offset (16-bit value) is split into two bytes
+        chunk->code[offset] = (jump >> 8) & 0xff;
+        chunk->code[offset + 1] = jump & 0xff;
     }
-    // Jump offset (16-bit value) is split into two bytes
-    compiler_current_chunk()->code[offset] = (jump >> 8) & 0xff;
-    compiler_current_chunk()->code[offset + 1] = jump & 0xff;
+    current->lastJumpTarget = chunk->byteCodeCount;
+}
+
+/// @brief Records an instruction that pushes a value that can also be used as a register operand
+/// @param offset The offset of the instruction in the chunk
+/// @param operand The register operand that refers to the same value
+static void compiler_record_register_operand(int32_t offset, uint8_t operand) {
+    current->registerOperands[0] = current->registerOperands[1];
+    current->registerOperands[1].offset = offset;
+    current->registerOperands[1].operand = operand;
+}
+
+/// @brief Forgets all the instructions that could be fused into register instructions
+/// @details Needs to be called after instructions were removed from the chunk, because the offsets are reused
+static void compiler_reset_register_operands() {
+    current->registerOperands[0].offset = current->registerOperands[1].offset = -1;
+    current->registerInstructionOffset = -1;
 }
 
 /// @brief Resolves a local variable name
@@ -1214,20 +1603,29 @@ static int32_t compiler_resolve_local(compiler_t * compiler, token_t * name) {
 /// @brief Looks for a local variable declared in any of the surrounding functions.
 /// @param compiler The compiler where the upvalue is attempted to be resolved
 /// @param name The name of the local varoable the is resolved
+/// @param byValue Stores whether the local variable is captured by value
 /// @return If an upvalue is found it returns an upvalue index, if not -1 is returned.
-static int32_t compiler_resolve_upvalue(compiler_t * compiler, token_t * name) {
+/// @details Whether a local variable is captured by value is decided, when it is captured for the first time
+static int32_t compiler_resolve_upvalue(compiler_t * compiler, token_t * name, bool * byValue) {
     if (!compiler->enclosing) {
         return -1; // not found
     }
     int32_t local = compiler_resolve_local(compiler->enclosing, name);
     if (local != -1) {
-        compiler->enclosing->locals[local].isCaptured = true;
-        return compiler_add_upvalue(compiler, (uint8_t)local, true);
+        local_t * variable = &compiler->enclosing->locals[local];
+        if (!variable->isCaptured && !variable->isCapturedByValue) {
+            // The parameters of a function are stored in the slots after the function itself
+            bool isParameter = local > 0 && local <= (int32_t)compiler->enclosing->function->arity;
+            variable->isCaptured = compiler_is_assigned(&variable->name, isParameter);
+            variable->isCapturedByValue = !variable->isCaptured;
+        }
+        *byValue = variable->isCapturedByValue;
+        return compiler_add_upvalue(compiler, (uint8_t)local, true, *byValue);
     }
     // Resolution of a local variable failed in the current environent -> look in the enclosing environment
-    int32_t upvalue = compiler_resolve_upvalue(compiler->enclosing, name);
+    int32_t upvalue = compiler_resolve_upvalue(compiler->enclosing, name, byValue);
     if (upvalue != -1) {
-        return compiler_add_upvalue(compiler, (uint8_t)upvalue, false);
+        return compiler_add_upvalue(compiler, (uint8_t)upvalue, false, *byValue);
     }
     // not found
     return -1;
@@ -1245,8 +1643,10 @@ static void compiler_return_statement() {
             compiler_error("Can't return a value from an initializer. An initializer in cellox is not permitted to "
                            "return a value.");
         }
+        int32_t expressionStart = compiler_current_chunk()->byteCodeCount;
         compiler_expression();
         compiler_consume(TOKEN_SEMICOLON, "Expect ';' after return value.");
+        compiler_tail_call(expressionStart);
         compiler_emit_byte(OP_RETURN);
     }
 }
@@ -1300,17 +1700,17 @@ static void compiler_super(bool canAssign) {
     }
     compiler_consume(TOKEN_DOT, "Expect '.' after 'super'.");
     compiler_consume(TOKEN_IDENTIFIER, "Expect superclass method name.");
-    uint8_t name = compiler_identifier_constant(&parser.previous);
+    uint32_t name = compiler_identifier_constant(&parser.previous);
     compiler_named_variable(compiler_synthetic_token("this"), false);
     // Compiles arguments of the super expression
     if (compiler_match_token(TOKEN_LEFT_PAREN)) {
         uint8_t argCount = compiler_argument_list();
         compiler_named_variable(compiler_synthetic_token("super"), false);
-        compiler_emit_bytes(OP_SUPER_INVOKE, name);
+        compiler_emit_constant_instruction(OP_SUPER_INVOKE, name);
         compiler_emit_byte(argCount);
     } else {
         compiler_named_variable(compiler_synthetic_token("super"), false);
-        compiler_emit_bytes(OP_GET_SUPER, name);
+        compiler_emit_constant_instruction(OP_GET_SUPER, name);
     }
 }
 
@@ -1349,6 +1749,24 @@ static token_t compiler_synthetic_token(char const * text) {
     return token;
 }
 
+/// @brief Turns the call that was compiled last into a tail call, if it is the last instruction of a return value
+/// @param expressionStart The offset of the first instruction of the return value
+/// @details The call frame of the function is reused by the called closure. OP_RETURN is emitted after the tail call
+/// nevertheless, because natives and initializers push their result instead and jumps of the return value (e.g. of an
+/// and expression) can have OP_RETURN as their target
+static void compiler_tail_call(int32_t expressionStart) {
+    chunk_t * chunk = compiler_current_chunk();
+    int32_t offset = current->callInstructionOffset;
+    if (offset < expressionStart || offset + (int32_t)chunk_instruction_length(chunk, offset) != chunk->byteCodeCount) {
+        return;
+    }
+    // The opcode of a wide invocation follows OP_WIDE
+    if (chunk->code[offset] == OP_WIDE) {
+        offset++;
+    }
+    chunk->code[offset] = chunk->code[offset] == OP_CALL ? OP_TAIL_CALL : OP_TAIL_INVOKE;
+}
+
 /// @brief Compiles a this expression
 /// @param canAssign Unused for this expression
 static void compiler_this(bool canAssign) {
@@ -1381,7 +1799,7 @@ static void compiler_unary(bool canAssign) {
 
 /// @brief Compiles a variable declaration
 static void compiler_var_declaration() {
-    uint8_t global = compiler_parse_variable("Expect variable name.");
+    uint32_t global = compiler_parse_variable("Expect variable name.");
     if (compiler_match_token(TOKEN_EQUAL)) {
         // Variable was initialzed
         if (!compiler_match_token(TOKEN_LEFT_BRACE)) {
@@ -24,6 +24,14 @@
 #include "../frontend/lexer.h"
 #include "../language-models/object.h"
 
+/// @brief Instruction set of the bytecode that is emitted by the compiler
+typedef enum {
+    /// Three-address instructions that operate directly on the slots of the call frame, where it is possible
+    INSTRUCTION_SET_REGISTER,
+    /// Purely stack based instructions - every operand is pushed onto the stack of the virtual machine
+    INSTRUCTION_SET_STACK
+} instruction_set;
+
 /// @brief Compiles a cellox program.
 /// @param code The cellox program that is compiled
 /// @return A obect_function_t that that stores all the instructions that of the cellox program
@@ -36,4 +44,8 @@ object_function_t * compiler_compile(char const * code);
 /// reference in some other object.
 void compiler_mark_roots();
 
+/// @brief Sets the instruction set of the bytecode that is emitted by the compiler
+/// @param set The instruction set that is used from now on
+void compiler_set_instruction_set(instruction_set set);
+
 #endif
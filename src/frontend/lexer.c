@@ -25,17 +25,6 @@
 #include <stdio.h>
 #include <string.h>
 
-/// @brief A lexer or more commonly called scanner
-/// @details It is used to scan the tokens in a cellox source file
-typedef struct {
-    /// Pointer to the start of the current token where the lexical analysis is performed
-    char const * start;
-    /// Pointer to the current position in the current token where the lexical analysis is performed
-    char const * current;
-    /// Line counter - used for error reporting
-    uint32_t line;
-} lexer_t;
-
 /// Global Lexer variable
 lexer_t lexer;
 
@@ -60,6 +49,14 @@ void lexer_init(char const * sourcecode) {
     lexer.line = 1u;
 }
 
+void lexer_restore_state(lexer_t state) {
+    lexer = state;
+}
+
+lexer_t lexer_save_state() {
+    return lexer;
+}
+
 token_t lexer_scan_token() {
 #define MAKE_TOKEN_CASE(character, token) \
     case character:                       \
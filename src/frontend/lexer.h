@@ -152,10 +152,29 @@ typedef struct {
     uint32_t line;
 } token_t;
 
+/// @brief A lexer or more commonly called scanner
+/// @details It is used to scan the tokens in a cellox source file
+typedef struct {
+    /// Pointer to the start of the current token where the lexical analysis is performed
+    char const * start;
+    /// Pointer to the current position in the current token where the lexical analysis is performed
+    char const * current;
+    /// Line counter - used for error reporting
+    uint32_t line;
+} lexer_t;
+
 /// @brief Initializes the lexer
 /// @param sourcecode The sourcecode that is used for initialitizing the lexer
 void lexer_init(char const * sourcecode);
 
+/// @brief Continues the lexical analysis at a position that was stored before
+/// @param state The state of the lexer that was stored using lexer_save_state()
+void lexer_restore_state(lexer_t state);
+
+/// @brief Stores the current state of the lexer
+/// @return The state of the lexer, that can be restored to scan the tokens after the current position again
+lexer_t lexer_save_state();
+
 /// @brief Scans the next token in the sourcecode and saves it in a linear sequence of tokens
 /// @return The Next Token in the sourcecode
 token_t lexer_scan_token();
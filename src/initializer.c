@@ -126,6 +126,8 @@ void initializer_show_help() {
     printf("Options\n");
     printf("  -c, --compile\t\tConverts the specified file to bytecode and stores the result as a seperate file\n");
     printf("  -h, --help\t\tDisplay this help and exit\n");
+    printf("  -j, --jit\t\tCompiles hot functions into machine code (x86-64 Linux only)\n");
+    printf("  -s, --stack-bytecode\tEmits purely stack based bytecode instead of register based bytecode\n");
     printf("  -v, --version\t\tShows the version of the installed compiler and exit\n\n");
 }
 
@@ -20,6 +20,7 @@
 
 #include <stdlib.h>
 
+#include "../../backend/garbage_collector.h"
 #include "../../backend/memory_mutator.h"
 
 void dynamic_value_array_free(dynamic_value_array_t * array) {
@@ -41,6 +42,8 @@ void dynamic_value_array_remove(dynamic_value_array_t * array, size_t index) {
 }
 
 void dynamic_value_array_write(dynamic_value_array_t * array, value_t value) {
+    // The value has to be stored before the count is incremented, when the array is read by the concurrent marker
+    garbage_collector_begin_heap_change();
     if (array->capacity < array->count + 1u) {
         uint32_t oldCapacity = array->capacity;
         array->capacity = GROW_CAPACITY(oldCapacity);
@@ -50,4 +53,5 @@ void dynamic_value_array_write(dynamic_value_array_t * array, value_t value) {
     }
     array->values[array->count] = value;
     array->count++;
+    garbage_collector_end_heap_change();
 }
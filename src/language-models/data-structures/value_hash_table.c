@@ -46,8 +46,8 @@ void value_hash_table_init(value_hash_table_t * table) {
 void value_hash_table_mark(value_hash_table_t * table) {
     for (uint32_t i = 0; i < table->capacity; i++) {
         value_hash_table_entry_t * entry = table->entries + i;
-        garbage_collector_mark_object((object_t *)entry->key);
-        garbage_collector_mark_value(entry->value);
+        garbage_collector_mark_object((object_t *)GC_LOAD_SLOT(entry->key));
+        garbage_collector_mark_value(GC_LOAD_SLOT(entry->value));
     }
 }
 
@@ -70,8 +70,8 @@ bool value_hash_table_delete(value_hash_table_t * table, object_string_t * key)
         return false;
     }
     // Replace the entry with a tombstone
-    entry->key = NULL;
-    entry->value = BOOL_VAL(true);
+    GC_STORE_SLOT(entry->key, NULL);
+    GC_STORE_SLOT(entry->value, BOOL_VAL(true));
     return true;
 }
 
@@ -132,8 +132,8 @@ bool value_hash_table_set(value_hash_table_t * table, object_string_t * key, val
     if (isNewKey && IS_NULL(entry->value)) {
         table->count++;
     }
-    entry->key = key;
-    entry->value = value;
+    GC_STORE_SLOT(entry->key, key);
+    GC_STORE_SLOT(entry->value, value);
     return isNewKey;
 }
 
@@ -144,6 +144,7 @@ bool value_hash_table_set(value_hash_table_t * table, object_string_t * key, val
 /// so we can wrap around the entries when we look for a key,
 /// without risking an infinite loop when the hashtable is full.
 static void hash_table_adjust_capacity(value_hash_table_t * table, int32_t capacity) {
+    garbage_collector_begin_heap_change();
     value_hash_table_entry_t * entries = ALLOCATE(value_hash_table_entry_t, capacity);
     for (uint32_t i = 0; i < capacity; i++) {
         entries[i].key = NULL;
@@ -163,6 +164,7 @@ static void hash_table_adjust_capacity(value_hash_table_t * table, int32_t capac
     FREE_ARRAY(value_hash_table_entry_t, table->entries, table->capacity);
     table->entries = entries;
     table->capacity = capacity;
+    garbage_collector_end_heap_change();
 }
 
 /// @brief Looks up an entry in the hashtable
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../backend/garbage_collector.h"
 #include "../backend/memory_mutator.h"
 #include "../backend/virtual_machine.h"
 #include "../string_utils.h"
@@ -36,7 +37,9 @@ static char const * objectTypesStringified[] = {"method",          "class",  "cl
                                                 "native function", "string", "upvalue", "unknown"};
 
 static object_t * object_allocate_object(size_t, object_type);
+static object_shape_t * object_allocate_shape(object_class_t *, object_shape_t *, object_string_t *);
 static object_string_t * object_allocate_string(char *, uint32_t, uint32_t);
+static void object_print_fields(object_instance_t *, object_shape_t *);
 static void object_print_function(object_function_t *);
 
 object_string_t * object_copy_string(char const * chars, uint32_t length, bool removeBackSlash) {
@@ -85,9 +88,15 @@ object_bound_method_t * object_new_bound_method(value_t receiver, object_closure
 }
 
 object_class_t * object_new_class(object_string_t * name) {
+    // The root shape is allocated first, because the class isn't reachable by the garbage collector yet
+    object_shape_t * rootShape = object_allocate_shape(NULL, NULL, NULL);
     object_class_t * celloxClass = ALLOCATE_OBJECT(object_class_t, OBJECT_CLASS);
     celloxClass->name = name;
     value_hash_table_init(&celloxClass->methods);
+    celloxClass->version = 0u;
+    celloxClass->inlineFieldCount = 0u;
+    celloxClass->rootShape = rootShape;
+    rootShape->celloxClass = celloxClass;
     return celloxClass;
 }
 
@@ -98,14 +107,20 @@ object_dynamic_value_array_t * object_new_dynamic_value_array() {
 }
 
 object_closure_t * object_new_closure(object_function_t * function) {
-    object_upvalue_t ** upvalues = ALLOCATE(object_upvalue_t *, function->upvalueCount);
-    for (uint32_t i = 0; i < function->upvalueCount; i++) {
-        upvalues[i] = NULL;
-    }
-    object_closure_t * closure = ALLOCATE_OBJECT(object_closure_t, OBJECT_CLOSURE);
+    object_closure_t * closure = (object_closure_t *)object_allocate_object(
+        sizeof(object_closure_t) + sizeof(object_upvalue_t *) * function->upvalueCount +
+            sizeof(value_t) * function->capturedValueCount,
+        OBJECT_CLOSURE);
     closure->function = function;
-    closure->upvalues = upvalues;
     closure->upvalueCount = function->upvalueCount;
+    closure->capturedValueCount = function->capturedValueCount;
+    for (uint32_t i = 0; i < function->upvalueCount; i++) {
+        closure->upvalues[i] = NULL;
+    }
+    // The captured values are marked by the garbage collector before they are copied into the closure
+    for (uint32_t i = 0; i < function->capturedValueCount; i++) {
+        CLOSURE_CAPTURED_VALUES(closure)[i] = NULL_VAL;
+    }
     return closure;
 }
 
@@ -113,15 +128,59 @@ object_function_t * object_new_function() {
     object_function_t * function = ALLOCATE_OBJECT(object_function_t, OBJECT_FUNCTION);
     function->arity = 0u;
     function->upvalueCount = 0u;
+    function->capturedValueCount = 0u;
     function->name = NULL;
+    function->closure = NULL;
     chunk_init(&function->chunk);
+    threaded_code_init(&function->threadedCode);
+    jit_compiler_init(&function->jitCode);
+    function->hotness = 0u;
     return function;
 }
 
+object_closure_t * object_function_closure(object_function_t * function) {
+    if (!function->closure) {
+        object_closure_t * closure = object_new_closure(function);
+        GC_STORE_SLOT(function->closure, closure);
+        garbage_collector_write_barrier_object(&function->obj, &closure->obj);
+    }
+    return function->closure;
+}
+
+void object_instance_add_field(object_instance_t * instance, object_shape_t * transition, value_t value) {
+    // The fields and the shape of the instance are changed together
+    garbage_collector_begin_heap_change();
+    uint32_t slot = transition->fieldCount - 1u;
+    if (slot >= instance->inlineFieldCount + instance->outOfLineFieldCapacity) {
+        uint32_t oldCapacity = instance->outOfLineFieldCapacity;
+        instance->outOfLineFieldCapacity = GROW_CAPACITY(oldCapacity);
+        instance->outOfLineFields =
+            GROW_ARRAY(value_t, instance->outOfLineFields, oldCapacity, instance->outOfLineFieldCapacity);
+        if (!instance->outOfLineFields) {
+            exit(EXIT_CODE_SYSTEM_ERROR);
+        }
+    }
+    *object_instance_field(instance, slot) = value;
+    garbage_collector_write_barrier(&instance->obj, value);
+    instance->shape = transition;
+    garbage_collector_end_heap_change();
+    // Instances of the class that are created from now on have room for the field
+    object_class_t * celloxClass = instance->celloxClass;
+    if (transition->fieldCount > celloxClass->inlineFieldCount &&
+        transition->fieldCount <= OBJECT_INSTANCE_MAX_INLINE_FIELDS) {
+        celloxClass->inlineFieldCount = transition->fieldCount;
+    }
+}
+
 object_instance_t * object_new_instance(object_class_t * celloxClass) {
-    object_instance_t * instance = ALLOCATE_OBJECT(object_instance_t, OBJECT_INSTANCE);
+    object_instance_t * instance = (object_instance_t *)object_allocate_object(
+        sizeof(object_instance_t) + sizeof(value_t) * celloxClass->inlineFieldCount, OBJECT_INSTANCE);
     instance->celloxClass = celloxClass;
-    value_hash_table_init(&instance->fields);
+    instance->shape = celloxClass->rootShape;
+    instance->inlineFieldCount = celloxClass->inlineFieldCount;
+    instance->outOfLineFieldCapacity = 0u;
+    instance->outOfLineFields = NULL;
+    instance->boundMethod = NULL;
     return instance;
 }
 
@@ -138,8 +197,6 @@ object_upvalue_t * object_new_upvalue(value_t * slot) {
     upvalue->closed = NULL_VAL;
     // Adress of the slot where the closed over variables live (enclosing environment)
     upvalue->location = slot;
-    // When we allocate a new upvalue, it is not attached to any list
-    upvalue->next = NULL;
     return upvalue;
 }
 
@@ -173,28 +230,8 @@ void object_print(value_t value) {
     case OBJECT_INSTANCE:
         {
             object_instance_t * instance = AS_INSTANCE(value);
-            if (!instance->fields.count) {
-                printf("{}");
-                break;
-            }
             putc('{', stdout);
-            value_t fieldValue;
-            size_t fieldCounter = instance->fields.count;
-            for (size_t i = 0; i < instance->fields.capacity; i++) {
-                if (instance->fields.entries[i].key != NULL) {
-                    printf("%s: ", instance->fields.entries[i].key->chars);
-                    if (IS_STRING(instance->fields.entries[i].value)) {
-                        putc('"', stdout);
-                    }
-                    value_print(instance->fields.entries[i].value);
-                    if (IS_STRING(instance->fields.entries[i].value)) {
-                        putc('"', stdout);
-                    }
-                    if (fieldCounter-- > 1) {
-                        printf(", ");
-                    }
-                }
-            }
+            object_print_fields(instance, instance->shape);
             putc('}', stdout);
             break;
         }
@@ -210,6 +247,48 @@ void object_print(value_t value) {
     }
 }
 
+uint32_t object_shape_find_field(object_shape_t * shape, object_string_t * name) {
+    // Every shape adds a single field to its parent, so the field is added by one of the ancestors of the shape
+    for (; shape->parent; shape = shape->parent) {
+        if (shape->name == name) {
+            return shape->fieldCount - 1u;
+        }
+    }
+    return OBJECT_SHAPE_NO_FIELD;
+}
+
+void object_shape_free(object_shape_t * shape) {
+    for (uint32_t i = 0u; i < shape->transitionCount; i++) {
+        object_shape_free(shape->transitions[i]);
+    }
+    FREE_ARRAY(object_shape_t *, shape->transitions, shape->transitionCapacity);
+    FREE(object_shape_t, shape);
+}
+
+object_shape_t * object_shape_transition(object_shape_t * shape, object_string_t * name) {
+    for (uint32_t i = 0u; i < shape->transitionCount; i++) {
+        if (shape->transitions[i]->name == name) {
+            return shape->transitions[i];
+        }
+    }
+    object_shape_t * transition = object_allocate_shape(shape->celloxClass, shape, name);
+    garbage_collector_begin_heap_change();
+    if (shape->transitionCapacity < shape->transitionCount + 1u) {
+        uint32_t oldCapacity = shape->transitionCapacity;
+        // Most of the shapes only have a single transition
+        shape->transitionCapacity = oldCapacity ? oldCapacity * 2u : 1u;
+        shape->transitions = GROW_ARRAY(object_shape_t *, shape->transitions, oldCapacity, shape->transitionCapacity);
+        if (!shape->transitions) {
+            exit(EXIT_CODE_SYSTEM_ERROR);
+        }
+    }
+    shape->transitions[shape->transitionCount++] = transition;
+    garbage_collector_end_heap_change();
+    // The shapes are owned by the class, so the class refers to the name of the field
+    garbage_collector_write_barrier_object(&shape->celloxClass->obj, &name->obj);
+    return transition;
+}
+
 object_string_t * object_take_string(char * chars, uint32_t length) {
     uint32_t hash = string_utils_hash_string(chars, length);
     object_string_t * interned = value_hash_table_find_string(&virtualMachine.strings, chars, length, hash);
@@ -243,20 +322,60 @@ static object_string_t * object_allocate_string(char * chars, uint32_t length, u
 /// @return The allocated object
 static object_t * object_allocate_object(size_t size, object_type type) {
     // Allocates the memory used by the Object
-    object_t * object = (object_t *)memory_mutator_reallocate(NULL, 0, size);
+    object_t * object = (object_t *)memory_mutator_allocate_object(size);
     // Sets the type of the object
     object->type = type;
     // Disables mark so it is picked up by the Garbage Collection in the next cycle
     object->isMarked = false;
-    // Adds the object at the start of the linked list storing the objects allocated by the virtualMachine
-    object->next = virtualMachine.objects;
-    virtualMachine.objects = object;
+    object->isRemembered = false;
+    // Adds the object at the start of the linked list storing the young objects allocated by the virtualMachine
+    object->next = virtualMachine.youngObjects;
+    virtualMachine.youngObjects = object;
 #ifdef DEBUG_LOG_GC
     printf("%p allocated %zu bytes for %d\n", (void *)object, size, type);
 #endif
     return object;
 }
 
+/// @brief Allocates the memory for a shape
+/// @param celloxClass The class of the instances that have the shape
+/// @param parent The shape that is extended by a field - NULL for the root shape
+/// @param name The name of the field that is added to the parent - NULL for the root shape
+/// @return The allocated shape
+static object_shape_t * object_allocate_shape(object_class_t * celloxClass, object_shape_t * parent,
+                                              object_string_t * name) {
+    object_shape_t * shape = ALLOCATE(object_shape_t, 1);
+    shape->celloxClass = celloxClass;
+    shape->parent = parent;
+    shape->name = name;
+    shape->fieldCount = parent ? parent->fieldCount + 1u : 0u;
+    shape->transitionCount = shape->transitionCapacity = 0u;
+    shape->transitions = NULL;
+    return shape;
+}
+
+/// @brief Prints the fields of an instance in the order they have been added
+/// @param instance The instance where the fields are printed
+/// @param shape The shape that contains the fields that are printed
+static void object_print_fields(object_instance_t * instance, object_shape_t * shape) {
+    if (!shape->parent) {
+        return;
+    }
+    object_print_fields(instance, shape->parent);
+    if (shape->parent->parent) {
+        printf(", ");
+    }
+    printf("%s: ", shape->name->chars);
+    value_t fieldValue = *object_instance_field(instance, shape->fieldCount - 1u);
+    if (IS_STRING(fieldValue)) {
+        putc('"', stdout);
+    }
+    value_print(fieldValue);
+    if (IS_STRING(fieldValue)) {
+        putc('"', stdout);
+    }
+}
+
 /// @brief Prints a function or a script
 /// @param function The function that is printed
 static void object_print_function(object_function_t * function) {
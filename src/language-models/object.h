@@ -21,8 +21,10 @@
 #ifndef CELLOX_OBJECT_H_
 #define CELLOX_OBJECT_H_
 
+#include "../backend/jit_compiler.h"
 #include "../backend/native_functions.h"
 #include "../byte-code/chunk.h"
+#include "../byte-code/threaded_code.h"
 #include "../common.h"
 #include "./data-structures/value_hash_table.h"
 #include "value.h"
@@ -47,6 +49,12 @@
 /// Makro that determines if the object has the object type string
 #define IS_STRING(value)       object_is_type(value, OBJECT_STRING)
 
+/// Maximum amount of fields that are stored inline in an instance
+#define OBJECT_INSTANCE_MAX_INLINE_FIELDS (32u)
+
+/// Slot of a field, that doesn't exist in a shape
+#define OBJECT_SHAPE_NO_FIELD             (UINT32_MAX)
+
 /// Makro that gets the value of an object as a dynamic value array
 #define AS_ARRAY(value)        ((object_dynamic_value_array_t *)AS_OBJECT(value))
 /// Makro that gets the value of an object as a bound method
@@ -57,6 +65,8 @@
 #define AS_CLASS(value)        ((object_class_t *)AS_OBJECT(value))
 /// Makro that gets the value of an object as a closure
 #define AS_CLOSURE(value)      ((object_closure_t *)AS_OBJECT(value))
+/// Makro that gets the values that are captured by value by a closure - they are stored after the upvalues
+#define CLOSURE_CAPTURED_VALUES(closure) ((value_t *)((closure)->upvalues + (closure)->upvalueCount))
 /// Makro that gets the value of an object as a cstring
 #define AS_CSTRING(value)      (((object_string_t *)AS_OBJECT(value))->chars)
 /// Makro that gets the value of an object as a function
@@ -92,9 +102,13 @@ typedef enum {
 struct object_t {
     /// The type of the object
     object_type type;
-    /// Determines whether the object has already been marked by the grabage collector
+    /// Determines whether the object has already been marked by the grabage collector - the objects that survived a
+    /// garbage collection stay marked until the next major collection, so a marked object belongs to the old generation
     bool isMarked;
-    /// pointer to the next object in the linear sequence of objects stored on the heap
+    /// Determines whether the object is stored in the remembered set, because it belongs to the old generation and
+    /// refers to objects of the young generation
+    bool isRemembered;
+    /// pointer to the next object in the linear sequence of objects of the same generation stored on the heap
     struct object_t * next;
 };
 
@@ -106,10 +120,21 @@ typedef struct {
     uint32_t arity;
     /// Number of values from enclosing scopes
     uint32_t upvalueCount;
+    /// Number of values from enclosing scopes that are captured by value, because they are never assigned
+    uint32_t capturedValueCount;
     /// The instructions in the function
     chunk_t chunk;
+    /// Pre-decoded threaded code of the chunk - only created if the function is executed using direct threading
+    threaded_code_t threadedCode;
+    /// Machine code of the chunk - only created by the just in time compiler, after the function has become hot
+    jit_code_t jitCode;
+    /// Counts the calls of the function and the loop iterations in the function to detect hot functions
+    uint32_t hotness;
     /// The name of the function
     object_string_t * name;
+    /// The closure that is shared by all the declarations of the function, if it doesn't capture any variables -
+    /// allocated when the declaration is executed for the first time
+    object_closure_t * closure;
 } object_function_t;
 
 /// @brief A native function
@@ -140,8 +165,6 @@ typedef struct object_upvalue_t {
     value_t * location;
     /// The Enclosed value after the current environment is left
     value_t closed;
-    /// The memory location of the next upvalue in memory
-    struct object_upvalue_t * next;
 } object_upvalue_t;
 
 /**
@@ -152,36 +175,59 @@ typedef struct object_upvalue_t {
  * Closures only exist in languages with first class functions
  * and allow the function to access the values that are captured through it's surrounding state.
  */
-typedef struct {
+struct object_closure_t {
     /// data that defines all types of objects
     object_t obj;
     /// The function of the closure
     object_function_t * function;
-    /// The upvalues which are captured by the closure
-    object_upvalue_t ** upvalues;
     /// The amount of upvalues that is captured by the closure
     uint32_t upvalueCount;
-} object_closure_t;
+    /// The amount of values that are captured by the closure
+    uint32_t capturedValueCount;
+    /// The upvalues which are captured by the closure - stored inline, so a closure is allocated at once. The values
+    /// that are captured by value are stored after the upvalues
+    object_upvalue_t * upvalues[];
+};
+
+/// @brief A shape (hidden class) of cellox class instances
+/// @details The shapes of a class form a transition tree. The root shape describes an instance without fields and
+/// every transition adds a single field, that is stored in the next slot of the instance. Instances that got the same
+/// fields in the same order share their shape, so the slot of a field only has to be looked up once per shape. Shapes
+/// aren't objects, they are owned by the class and freed together with the class.
+struct object_shape_t {
+    /// The class of the instances that have the shape
+    object_class_t * celloxClass;
+    /// The shape that was extended by the field - NULL for the root shape
+    object_shape_t * parent;
+    /// The name of the field that was added by the transition from the parent - NULL for the root shape
+    object_string_t * name;
+    /// The amount of fields of an instance with the shape - the field that was added is stored in the last slot
+    uint32_t fieldCount;
+    /// The amount of transitions to other shapes
+    uint32_t transitionCount;
+    /// The capacity of the transitions
+    uint32_t transitionCapacity;
+    /// The shapes that are created by adding a field to an instance with the shape
+    object_shape_t ** transitions;
+};
 
 /// @brief A class structure - a class in cellox
-typedef struct {
+struct object_class_t {
     /// data that defines all types of objects
     object_t obj;
     /// The name of the class
     object_string_t * name;
     /// The methods that are defined in the class body
     value_hash_table_t methods;
-} object_class_t;
-
-/// @brief A cellox class instance
-typedef struct {
-    /// data that defines all types of objects
-    object_t obj;
-    /// The class of the object instance
-    object_class_t * celloxClass;
-    /// The fields of the instance
-    value_hash_table_t fields;
-} object_instance_t;
+    /// Version of the class - incremented if the methods change, which invalidates the inline caches that store
+    /// methods of the class
+    uint32_t version;
+    /// The amount of fields that are stored inline by instances that are created from now on - the highest amount of
+    /// fields an instance of the class had so far
+    uint32_t inlineFieldCount;
+    /// The shape of a new instance without any fields
+    object_shape_t * rootShape;
+};
 
 /// @brief A bound method
 typedef struct {
@@ -193,6 +239,26 @@ typedef struct {
     object_closure_t * method;
 } object_bound_method_t;
 
+/// @brief A cellox class instance
+typedef struct {
+    /// data that defines all types of objects
+    object_t obj;
+    /// The class of the object instance
+    object_class_t * celloxClass;
+    /// The shape of the instance that determines the slots of the fields
+    object_shape_t * shape;
+    /// The amount of fields that are stored inline in the instance
+    uint32_t inlineFieldCount;
+    /// The capacity of the fields that are stored outside of the instance
+    uint32_t outOfLineFieldCapacity;
+    /// The fields that don't fit into the instance
+    value_t * outOfLineFields;
+    /// The method that was bound to the instance last - reused if the same method is bound to the instance again
+    object_bound_method_t * boundMethod;
+    /// The fields that are stored inline - the first slots of the shape
+    value_t fields[];
+} object_instance_t;
+
 /// @brief A dynamic array
 typedef struct {
     /// data that defines all types of objects
@@ -233,9 +299,21 @@ object_dynamic_value_array_t * object_new_dynamic_value_array();
 /// @return The new function that was created
 object_function_t * object_new_function();
 
+/// @brief Gets the closure that is shared by all the declarations of a function that doesn't capture any variables
+/// @param function The function whose closure is returned - must not capture any variables
+/// @return The shared closure of the function, that is allocated when it is requested for the first time
+object_closure_t * object_function_closure(object_function_t * function);
+
+/// @brief Adds a field to a cellox class instance
+/// @param instance The instance where the field is added
+/// @param transition The shape of the instance after the field has been added
+/// @param value The value of the field
+void object_instance_add_field(object_instance_t * instance, object_shape_t * transition, value_t value);
+
 /// @brief Creates a new cellox class instance
 /// @param celloxClass The class of the instance
 /// @return The new instance that was created
+/// @details The instance has room for the amount of fields the instances of the class had so far
 object_instance_t * object_new_instance(object_class_t * celloxClass);
 
 /// @brief Creates a new native function object
@@ -258,6 +336,22 @@ object_upvalue_t * object_new_upvalue(value_t * slot);
 /// @param value The value that is printed
 void object_print(value_t value);
 
+/// @brief Looks up the slot of a field in a shape
+/// @param shape The shape where the field is looked up
+/// @param name The name of the field
+/// @return The slot of the field or OBJECT_SHAPE_NO_FIELD if the shape doesn't contain the field
+uint32_t object_shape_find_field(object_shape_t * shape, object_string_t * name);
+
+/// @brief Deallocates the memory used by a shape and all the shapes that were created by adding fields to it
+/// @param shape The shape that is freed
+void object_shape_free(object_shape_t * shape);
+
+/// @brief Determines the shape that is created by adding a field to an instance with the specified shape
+/// @param shape The shape of the instance before the field is added
+/// @param name The name of the field that is added
+/// @return The shape after the field has been added - created if the transition doesn't exist yet
+object_shape_t * object_shape_transition(object_shape_t * shape, object_string_t * name);
+
 /// @brief Gets the textual representation of a cellox type
 /// @param object The object that is used
 /// @return A character pointer that represents the type
@@ -271,4 +365,13 @@ static inline bool object_is_type(value_t value, object_type type) {
     return IS_OBJECT(value) && AS_OBJECT(value)->type == type;
 }
 
+/// @brief Determines the address of a field of a cellox class instance
+/// @param instance The instance where the field is stored
+/// @param slot The slot of the field in the shape of the instance
+/// @return The address of the field
+static inline value_t * object_instance_field(object_instance_t * instance, uint32_t slot) {
+    return slot < instance->inlineFieldCount ? instance->fields + slot
+                                             : instance->outOfLineFields + (slot - instance->inlineFieldCount);
+}
+
 #endif
@@ -49,6 +49,7 @@ void value_print(value_t value) {
         printf(AS_BOOL(value) ? "true" : "false");
         break;
     case VAL_NULL:
+    case VAL_UNDEFINED:
         printf("null");
         break;
     case VAL_NUMBER:
@@ -77,6 +78,7 @@ char const * value_stringify_type(value_t value) {
     case VAL_BOOL:
         return valueTypesStringified[0];
     case VAL_NULL:
+    case VAL_UNDEFINED:
         return valueTypesStringified[1];
     case VAL_NUMBER:
         return valueTypesStringified[2];
@@ -101,6 +103,10 @@ bool value_values_equal(value_t a, value_t b) {
             }
         }
         return true;
+    } else if (IS_BOUND_METHOD(a) && IS_BOUND_METHOD(b)) {
+        // The bound methods are cached, so the same method of the same receiver isn't necessarily the same object
+        return AS_BOUND_METHOD(a)->receiver == AS_BOUND_METHOD(b)->receiver &&
+               AS_BOUND_METHOD(a)->method == AS_BOUND_METHOD(b)->method;
     }
     return a == b;
 #else
@@ -111,6 +117,7 @@ bool value_values_equal(value_t a, value_t b) {
     case VAL_BOOL:
         return AS_BOOL(a) == AS_BOOL(b);
     case VAL_NULL:
+    case VAL_UNDEFINED:
         return true;
     case VAL_NUMBER:
         return AS_NUMBER(a) == AS_NUMBER(b);
@@ -127,6 +134,10 @@ bool value_values_equal(value_t a, value_t b) {
                 }
             }
             return true;
+        } else if (IS_BOUND_METHOD(a) && IS_BOUND_METHOD(b)) {
+            // The bound methods are cached, so the same method of the same receiver isn't necessarily the same object
+            return value_values_equal(AS_BOUND_METHOD(a)->receiver, AS_BOUND_METHOD(b)->receiver) &&
+                   AS_BOUND_METHOD(a)->method == AS_BOUND_METHOD(b)->method;
         }
         return AS_OBJECT(a) == AS_OBJECT(b);
     default:
@@ -31,21 +31,33 @@ typedef struct object_t object_t;
 /// Defines object_string_t as a new type (specified in object.h)
 typedef struct object_string_t object_string_t;
 
+/// Defines object_class_t as a new type (specified in object.h)
+typedef struct object_class_t object_class_t;
+
+/// Defines object_closure_t as a new type (specified in object.h)
+typedef struct object_closure_t object_closure_t;
+
+/// Defines object_shape_t as a new type (specified in object.h)
+typedef struct object_shape_t object_shape_t;
+
 #ifdef NAN_BOXING
 
-#define SIGN_BIT  ((uint64_t)0x8000000000000000)
+#define SIGN_BIT      ((uint64_t)0x8000000000000000)
 
 /// quiet not a number 🤫
-#define QNAN      ((uint64_t)0x7ffc000000000000)
+#define QNAN          ((uint64_t)0x7ffc000000000000)
 
 /// Used to tag a null-value &frasl; undefiened value
-#define TAG_NULL  (0x1)
+#define TAG_NULL      (0x1)
 
 /// Used to tag a false-value
-#define TAG_FALSE (0x2)
+#define TAG_FALSE     (0x2)
 
 /// Used to tag a true-value
-#define TAG_TRUE  (0x3)
+#define TAG_TRUE      (0x3)
+
+/// Used to tag the value of a global variable that has not been defined yet
+#define TAG_UNDEFINED (0x4)
 
 /// @brief An value type
 /// @details In Cellox a value can be either a numerical, a boolean or a undefiended value. Additionally a value can
@@ -53,33 +65,37 @@ typedef struct object_string_t object_string_t;
 typedef uint64_t value_t;
 
 /// Makro that determines whether a value is of the type bool
-#define IS_BOOL(value)   (((value) | 1) == TRUE_VAL)
+#define IS_BOOL(value)      (((value) | 1) == TRUE_VAL)
 /// Makro that determines whether a value is nil
-#define IS_NULL(value)   ((value) == NULL_VAL)
+#define IS_NULL(value)      ((value) == NULL_VAL)
 /// Makro that determines whether a value is of the type number
-#define IS_NUMBER(value) (((value)&QNAN) != QNAN)
+#define IS_NUMBER(value)    (((value)&QNAN) != QNAN)
 /// Makro that determines whether a value is of the type obejct
-#define IS_OBJECT(value) (((value) & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT))
+#define IS_OBJECT(value)    (((value) & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT))
+/// Makro that determines whether a value is the marker of an undefined global variable
+#define IS_UNDEFINED(value) ((value) == UNDEFINED_VAL)
 
 /// Makro that yields the value of a boolean and converts to a c boolean
-#define AS_BOOL(value)   ((value) == TRUE_VAL)
+#define AS_BOOL(value)      ((value) == TRUE_VAL)
 /// Makro that yields the value of a number and converts to a c double
-#define AS_NUMBER(value) valueToNum(value)
+#define AS_NUMBER(value)    valueToNum(value)
 /// Makro that yields the value of an object and converts to an object pointer
-#define AS_OBJECT(value) ((object_t *)(uintptr_t)((value) & ~(SIGN_BIT | QNAN)))
+#define AS_OBJECT(value)    ((object_t *)(uintptr_t)((value) & ~(SIGN_BIT | QNAN)))
 
 /// Makro that yields the boolean value stored in a Value
-#define BOOL_VAL(b)      ((b) ? TRUE_VAL : FALSE_VAL)
+#define BOOL_VAL(b)         ((b) ? TRUE_VAL : FALSE_VAL)
 /// Makro that yields a false value
-#define FALSE_VAL        ((value_t)(uint64_t)(QNAN | TAG_FALSE))
+#define FALSE_VAL           ((value_t)(uint64_t)(QNAN | TAG_FALSE))
 /// Makro that yields a true value
-#define TRUE_VAL         ((value_t)(uint64_t)(QNAN | TAG_TRUE))
+#define TRUE_VAL            ((value_t)(uint64_t)(QNAN | TAG_TRUE))
 /// Makro that yields null
-#define NULL_VAL         ((value_t)(uint64_t)(QNAN | TAG_NULL))
+#define NULL_VAL            ((value_t)(uint64_t)(QNAN | TAG_NULL))
 /// Makro that yields the numerical value
-#define NUMBER_VAL(num)  numToValue(num)
+#define NUMBER_VAL(num)     numToValue(num)
 /// Makro that yields the value of a object
-#define OBJECT_VAL(obj)  (value_t)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(obj))
+#define OBJECT_VAL(obj)     (value_t)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(obj))
+/// Makro that yields the marker of an undefined global variable - never visible to a cellox program
+#define UNDEFINED_VAL       ((value_t)(uint64_t)(QNAN | TAG_UNDEFINED))
 
 /// @brief Converts a double to a value_t using type punning
 /// @param number The value that is converted (a double)
@@ -109,7 +125,9 @@ typedef enum {
     /// A numerical value
     VAL_NUMBER,
     /// A cellox object
-    VAL_OBJ
+    VAL_OBJ,
+    /// Marker of a global variable that has not been defined yet - never visible to a cellox program
+    VAL_UNDEFINED
 } value_type;
 
 /// @brief An value type
@@ -125,33 +143,37 @@ typedef struct {
 } value_t;
 
 /// Makro that determines whether a value is of the type bool
-#define IS_BOOL(value)     ((value).type == VAL_BOOL)
+#define IS_BOOL(value)      ((value).type == VAL_BOOL)
 /// Makro that determines whether a value is of the type nil
-#define IS_NULL(value)     ((value).type == VAL_NULL)
+#define IS_NULL(value)      ((value).type == VAL_NULL)
 /// Makro that determines whether a value is of the type number
-#define IS_NUMBER(value)   ((value).type == VAL_NUMBER)
+#define IS_NUMBER(value)    ((value).type == VAL_NUMBER)
 /// Makro that determines whether a value is of the type object
-#define IS_OBJECT(value)   ((value).type == VAL_OBJ)
+#define IS_OBJECT(value)    ((value).type == VAL_OBJ)
+/// Makro that determines whether a value is the marker of an undefined global variable
+#define IS_UNDEFINED(value) ((value).type == VAL_UNDEFINED)
 
 /// Makro that returns the boolean value in the union
-#define AS_BOOL(value)     ((value).as.boolean)
+#define AS_BOOL(value)      ((value).as.boolean)
 /// Makro that returns the value of a number in the union
-#define AS_NUMBER(value)   ((value).as.number)
+#define AS_NUMBER(value)    ((value).as.number)
 /// Makro that returns the value of an object in the union
-#define AS_OBJECT(value)   ((value).as.obj)
+#define AS_OBJECT(value)    ((value).as.obj)
 
 /// Makro that creates a boolean value
-#define BOOL_VAL(value)    ((value_t){VAL_BOOL, {.boolean = value}})
+#define BOOL_VAL(value)     ((value_t){VAL_BOOL, {.boolean = value}})
 /// Makro that creates a null value
-#define NULL_VAL           ((value_t){VAL_NULL, {.number = 0}})
+#define NULL_VAL            ((value_t){VAL_NULL, {.number = 0}})
 /// Makro that creates a numerical value
-#define NUMBER_VAL(value)  ((value_t){VAL_NUMBER, {.number = value}})
+#define NUMBER_VAL(value)   ((value_t){VAL_NUMBER, {.number = value}})
 /// Makro that creates an object
-#define OBJECT_VAL(object) ((value_t){VAL_OBJ, {.obj = (object_t *)object}})
+#define OBJECT_VAL(object)  ((value_t){VAL_OBJ, {.obj = (object_t *)object}})
+/// Makro that creates the marker of an undefined global variable
+#define UNDEFINED_VAL       ((value_t){VAL_UNDEFINED, {.number = 0}})
 /// Makro that creates a boolean value that is true
-#define TRUE_VAL           (BOOL_VAL(true))
+#define TRUE_VAL            (BOOL_VAL(true))
 /// Makro that creates a boolean value that is false
-#define FALSE_VAL          (BOOL_VAL(false))
+#define FALSE_VAL           (BOOL_VAL(false))
 
 #endif // No NAN_BOXING defined
 
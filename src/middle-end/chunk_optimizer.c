@@ -20,71 +20,160 @@
 
 #include "chunk_optimizer.h"
 
-#define FOLD_EXPRESSION(op)                                                           \
-    chunk->constants.values[chunk->code[*indexPointer + 1]] =                         \
-        NUMBER_VAL(AS_NUMBER(chunk->constants.values[chunk->code[*indexPointer + 1]]) \
-                       op AS_NUMBER(chunk->constants.values[chunk->code[*indexPointer + 3]]))
+/// The maximum amount of instructions that are executed by a single superinstruction
+#define CHUNK_OPTIMIZER_MAX_SEQUENCE_LENGTH (3u)
 
-static void chunk_optimizer_fold_numerical_expression(chunk_t *, int32_t *);
+#define FOLD_EXPRESSION(op)                                                                                            \
+    chunk->constants.values[code[1]] =                                                                                 \
+        NUMBER_VAL(AS_NUMBER(chunk->constants.values[code[1]]) op AS_NUMBER(chunk->constants.values[code[3]]))
+
+/// @brief A superinstruction and the sequence of instructions it executes
+typedef struct {
+    /// The opcode of the superinstruction
+    uint8_t superinstruction;
+    /// The amount of instructions in the sequence
+    uint8_t length;
+    /// The opcodes of the instructions in the sequence
+    uint8_t sequence[CHUNK_OPTIMIZER_MAX_SEQUENCE_LENGTH];
+    /// Additional condition that has to be met by the instructions in the sequence (NULL if there is none)
+    bool (*condition)(chunk_t const * chunk, uint32_t const * opCodeIndexes);
+} chunk_optimizer_superinstruction_t;
+
+static void chunk_optimizer_adjust_jumps(chunk_t *, uint32_t, uint32_t);
+static void chunk_optimizer_create_superinstructions(chunk_t *);
+static void chunk_optimizer_fold_constants(chunk_t *);
+static bool chunk_optimizer_fold_numerical_expression(chunk_t *, uint32_t);
+static bool chunk_optimizer_is_jump_target(chunk_t const *, uint32_t);
+static inline uint8_t chunk_optimizer_jump_opcode(chunk_t const *, uint32_t);
+static bool chunk_optimizer_jumps_to_pop(chunk_t const *, uint32_t const *);
+static bool chunk_optimizer_matches_sequence(chunk_t const *, uint32_t, chunk_optimizer_superinstruction_t const *,
+                                             uint32_t *);
+static bool chunk_optimizer_pushes_and_jumps_to_pop(chunk_t const *, uint32_t const *);
+static inline uint32_t chunk_optimizer_read_jump_offset(chunk_t const *, uint32_t);
+static inline void chunk_optimizer_write_jump_offset(chunk_t *, uint32_t, uint32_t);
+
+/// @brief The superinstructions that are created by the optimizer
+/// @details The sequences are the most frequently executed n-grams of our benchmarks (benchmark/benchmarks), that were
+/// determined using the opcode profiler (CLX_PROFILE_OPCODES). Sequences that contain a call, an invocation or a
+/// return are left out, because those instructions change the call frame. When the workload changes the profile has
+/// to be regenerated and the table adjusted - the virtual machine only needs a handler for every new superinstruction.
+static chunk_optimizer_superinstruction_t const superinstructions[] = {
+    // Accessing a property of this (or another local variable) - e.g. this.x
+    {OP_GET_LOCAL_GET_PROPERTY, 2u, {OP_GET_LOCAL, OP_GET_PROPERTY}, NULL},
+    // Conditions of loops and if statements that compare local variables or constants - e.g. while (i < 10)
+    {OP_REGISTER_LESS_JUMP_IF_FALSE,
+     3u,
+     {OP_REGISTER_LESS, OP_JUMP_IF_FALSE, OP_POP},
+     chunk_optimizer_pushes_and_jumps_to_pop},
+    // Conditions of loops and if statements that compare global variables
+    {OP_LESS_JUMP_IF_FALSE, 3u, {OP_LESS, OP_JUMP_IF_FALSE, OP_POP}, chunk_optimizer_jumps_to_pop},
+    // Assignments to global variables that are used as a statement - e.g. i = i + 1;
+    {OP_SET_GLOBAL_POP, 2u, {OP_SET_GLOBAL, OP_POP}, NULL},
+};
 
 void chunk_optimizer_optimize_chunk(chunk_t * chunk) {
-    for (int32_t i = 0; i < chunk->byteCodeCount; i++) {
-        switch (chunk->code[i]) {
-        case OP_CONSTANT:
-            if (i + 4 < chunk->byteCodeCount) {
-                if (chunk->code[i + 2] == OP_CONSTANT) {
-                    // Constant folding 🙏
-                    switch (chunk->code[i + 4]) {
-                    case OP_ADD:
-                    case OP_DIVIDE:
-                    case OP_MULTIPLY:
-                    case OP_SUBTRACT:
-                        if (IS_NUMBER(chunk->constants.values[chunk->code[i + 1]]) &&
-                            IS_NUMBER(chunk->constants.values[chunk->code[i + 2]])) {
-                            chunk_optimizer_fold_numerical_expression(chunk, &i);
-                        }
-                        break;
-                    default:
-                        break;
-                    }
-                }
+    chunk_optimizer_fold_constants(chunk);
+#ifndef PROFILE_OPCODES
+    // The profiler has to count the original sequences of instructions
+    chunk_optimizer_create_superinstructions(chunk);
+#endif
+}
+
+/// @brief Adjusts the offsets of the jumps that cross a sequence of bytecode, that is removed from a chunk
+/// @param chunk The chunk where the bytecode is removed
+/// @param startIndex The index of the first byte that is removed
+/// @param amount The amount of bytes that are removed
+/// @details The jumps are adjusted before the bytecode is removed. None of the removed bytes can be a jump target
+static void chunk_optimizer_adjust_jumps(chunk_t * chunk, uint32_t startIndex, uint32_t amount) {
+    for (uint32_t i = 0u; i < chunk->byteCodeCount; i += chunk_instruction_length(chunk, i)) {
+        uint32_t end = i + chunk_instruction_length(chunk, i);
+        switch (chunk_optimizer_jump_opcode(chunk, i)) {
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+            if (end <= startIndex && chunk_jump_target(chunk, i) >= startIndex + amount) {
+                chunk_optimizer_write_jump_offset(chunk, i, chunk_optimizer_read_jump_offset(chunk, i) - amount);
             }
-        case OP_ARRAY_LITERAL:
-        case OP_CLASS:
-        case OP_DEFINE_GLOBAL:
-        case OP_GET_GLOBAL:
-        case OP_GET_PROPERTY:
-        case OP_GET_SUPER:
-        case OP_METHOD:
-        case OP_SET_GLOBAL:
-        case OP_SET_PROPERTY:
-        case OP_CALL:
-        case OP_GET_LOCAL:
-        case OP_GET_UPVALUE:
-        case OP_SET_LOCAL:
-        case OP_SET_UPVALUE:
-            i++;
             break;
-        case OP_INVOKE:
-        case OP_JUMP:
-            i += 2;
+        case OP_LOOP:
+            if (i >= startIndex + amount && chunk_jump_target(chunk, i) < startIndex) {
+                chunk_optimizer_write_jump_offset(chunk, i, chunk_optimizer_read_jump_offset(chunk, i) - amount);
+            }
             break;
-
         default:
             break;
         }
     }
 }
 
-/// @brief Folds a expression in a chunk
-/// @param chunk The chunk where the expression is folded
-/// @param indexPointer Pointer to the index of the first constant in the expression that is folded
-static void chunk_optimizer_fold_numerical_expression(chunk_t * chunk, int32_t * indexPointer) {
-    // Removes OP_ADD, OP_CONSTANT and the constant index and replaced the first constant at the index with the result
-    // of evaluating the expression
-    double foldedConstantValue;
+/// @brief Replaces the sequences of instructions in the chunk, that can be executed by a superinstruction
+/// @param chunk The chunk where the superinstructions are created
+/// @details Only the opcode of the first instruction of a sequence is replaced, so the jump offsets stay valid
+static void chunk_optimizer_create_superinstructions(chunk_t * chunk) {
+    uint32_t opCodeIndexes[CHUNK_OPTIMIZER_MAX_SEQUENCE_LENGTH];
+    for (uint32_t i = 0u; i < chunk->byteCodeCount; i += chunk_instruction_length(chunk, i)) {
+        for (size_t j = 0u; j < sizeof(superinstructions) / sizeof(chunk_optimizer_superinstruction_t); j++) {
+            if (chunk_optimizer_matches_sequence(chunk, i, &superinstructions[j], opCodeIndexes)) {
+                chunk->code[i] = superinstructions[j].superinstruction;
+                // The instructions that are executed by the superinstruction can't start another one
+                i = opCodeIndexes[superinstructions[j].length - 1u];
+                break;
+            }
+        }
+    }
+}
 
-    switch (chunk->code[*indexPointer + 4]) {
+/// @brief Folds the numerical expressions in a chunk that only consist of constants
+/// @param chunk The chunk where the expressions are folded
+static void chunk_optimizer_fold_constants(chunk_t * chunk) {
+    // Indexes of the constants that are loaded right before the current instruction - needed for nested expressions
+    uint32_t constantIndexes[UINT8_COUNT];
+    uint32_t constantCount = 0u;
+    uint32_t i = 0u;
+    while (i < chunk->byteCodeCount) {
+        if (chunk_optimizer_fold_numerical_expression(chunk, i)) {
+            // Constant folding 🙏 - the result could be folded again together with the constant before
+            if (constantCount) {
+                i = constantIndexes[--constantCount];
+            }
+            continue;
+        }
+        if (chunk->code[i] != OP_CONSTANT) {
+            constantCount = 0u;
+        } else if (constantCount < UINT8_COUNT) {
+            constantIndexes[constantCount++] = i;
+        }
+        i += chunk_instruction_length(chunk, i);
+    }
+}
+
+/// @brief Folds an expression in a chunk, if it consists of two numerical constants and an arithmetic operator
+/// @param chunk The chunk where the expression is folded
+/// @param opCodeIndex The index of the first constant in the expression that is folded
+/// @return true if the expression was folded, false if not
+static bool chunk_optimizer_fold_numerical_expression(chunk_t * chunk, uint32_t opCodeIndex) {
+    uint8_t const * code = chunk->code + opCodeIndex;
+    if (opCodeIndex + 4u >= chunk->byteCodeCount || code[0] != OP_CONSTANT || code[2] != OP_CONSTANT) {
+        return false;
+    }
+    switch (code[4]) {
+    case OP_ADD:
+    case OP_DIVIDE:
+    case OP_MULTIPLY:
+    case OP_SUBTRACT:
+        break;
+    default:
+        return false;
+    }
+    if (!IS_NUMBER(chunk->constants.values[code[1]]) || !IS_NUMBER(chunk->constants.values[code[3]])) {
+        return false;
+    }
+    // The second constant or the operator are reached from a different path as well (e.g. the end of an or)
+    if (chunk_optimizer_is_jump_target(chunk, opCodeIndex + 2u) ||
+        chunk_optimizer_is_jump_target(chunk, opCodeIndex + 4u)) {
+        return false;
+    }
+    // The first constant is replaced with the result of evaluating the expression
+    switch (code[4]) {
     case OP_ADD:
         FOLD_EXPRESSION(+);
         break;
@@ -108,8 +197,107 @@ static void chunk_optimizer_fold_numerical_expression(chunk_t * chunk, int32_t *
 #endif
     }
     // Removing OP_CONSTANT and OP_ADD / OP_DIVIDE / OP_MULTIPLY / OP_SUBTRACT from the chunk
-    chunk_remove_bytecode(chunk, *indexPointer + 2, 3);
-    if (*indexPointer > 2 && chunk->code[*indexPointer - 2] == OP_CONSTANT) {
-        *indexPointer -= 4; // Checking prevoius bytecode instruction again for recursive constant folding
+    chunk_optimizer_adjust_jumps(chunk, opCodeIndex + 2u, 3u);
+    chunk_remove_bytecode(chunk, opCodeIndex + 2u, 3u);
+    return true;
+}
+
+/// @brief Determines whether an instruction is the target of a jump or a loop
+/// @param chunk The chunk where the instruction is stored
+/// @param opCodeIndex The index of the instruction
+/// @return true if a jump or a loop has the instruction as its target, false if not
+static bool chunk_optimizer_is_jump_target(chunk_t const * chunk, uint32_t opCodeIndex) {
+    for (uint32_t i = 0u; i < chunk->byteCodeCount; i += chunk_instruction_length(chunk, i)) {
+        switch (chunk_optimizer_jump_opcode(chunk, i)) {
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+        case OP_LOOP:
+            if (chunk_jump_target(chunk, i) == opCodeIndex) {
+                return true;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+/// @brief Determines the opcode of an instruction, that is used to recognize narrow and wide jumps alike
+/// @param chunk The chunk where the instruction is stored
+/// @param opCodeIndex The index of the instruction
+/// @return The opcode of the instruction - the opcode after OP_WIDE for a wide jump
+static inline uint8_t chunk_optimizer_jump_opcode(chunk_t const * chunk, uint32_t opCodeIndex) {
+    if (chunk->code[opCodeIndex] != OP_WIDE) {
+        return chunk->code[opCodeIndex];
+    }
+    uint8_t opCode = chunk->code[opCodeIndex + 1u];
+    return opCode == OP_JUMP || opCode == OP_JUMP_IF_FALSE || opCode == OP_LOOP ? opCode : OP_WIDE;
+}
+
+/// @brief Determines whether the jump of a sequence (the second instruction) has an OP_POP as its target
+/// @param chunk The chunk where the sequence is stored
+/// @param opCodeIndexes The indexes of the instructions in the sequence
+/// @return true if the jump target is an OP_POP, false if not
+/// @details The superinstruction doesn't push the condition and jumps over the OP_POP at the jump target instead
+static bool chunk_optimizer_jumps_to_pop(chunk_t const * chunk, uint32_t const * opCodeIndexes) {
+    uint32_t target = chunk_jump_target(chunk, opCodeIndexes[1]);
+    return target < chunk->byteCodeCount && chunk->code[target] == OP_POP;
+}
+
+/// @brief Determines whether a sequence of instructions can be executed by a superinstruction
+/// @param chunk The chunk where the instructions are stored
+/// @param opCodeIndex The index of the first instruction of the sequence
+/// @param superinstruction The superinstruction that is checked
+/// @param opCodeIndexes Array where the indexes of the instructions in the sequence are stored
+/// @return true if the instructions match the sequence of the superinstruction, false if not
+static bool chunk_optimizer_matches_sequence(chunk_t const * chunk, uint32_t opCodeIndex,
+                                             chunk_optimizer_superinstruction_t const * superinstruction,
+                                             uint32_t * opCodeIndexes) {
+    for (uint32_t i = 0u; i < superinstruction->length; i++) {
+        if (opCodeIndex >= chunk->byteCodeCount || chunk->code[opCodeIndex] != superinstruction->sequence[i]) {
+            return false;
+        }
+        opCodeIndexes[i] = opCodeIndex;
+        opCodeIndex += chunk_instruction_length(chunk, opCodeIndex);
+    }
+    return !superinstruction->condition || superinstruction->condition(chunk, opCodeIndexes);
+}
+
+/// @brief Determines whether the register instruction of a sequence pushes its result onto the stack and the jump of
+/// the sequence has an OP_POP as its target
+/// @param chunk The chunk where the sequence is stored
+/// @param opCodeIndexes The indexes of the instructions in the sequence
+/// @return true if the sequence fulfills both conditions, false if not
+static bool chunk_optimizer_pushes_and_jumps_to_pop(chunk_t const * chunk, uint32_t const * opCodeIndexes) {
+    return chunk->code[opCodeIndexes[0] + 1u] == REGISTER_DESTINATION_STACK &&
+           chunk_optimizer_jumps_to_pop(chunk, opCodeIndexes);
+}
+
+/// @brief Reads the offset of a jump or a loop
+/// @param chunk The chunk where the jump is stored
+/// @param opCodeIndex The index of the jump (of OP_WIDE for a wide jump)
+/// @return The offset of the jump
+static inline uint32_t chunk_optimizer_read_jump_offset(chunk_t const * chunk, uint32_t opCodeIndex) {
+    if (chunk->code[opCodeIndex] == OP_WIDE) {
+        return ((uint32_t)chunk->code[opCodeIndex + 2u] << 24u) | ((uint32_t)chunk->code[opCodeIndex + 3u] << 16u) |
+               ((uint32_t)chunk->code[opCodeIndex + 4u] << 8u) | chunk->code[opCodeIndex + 5u];
+    }
+    return (uint16_t)((chunk->code[opCodeIndex + 1u] << 8u) | chunk->code[opCodeIndex + 2u]);
+}
+
+/// @brief Writes the offset of a jump or a loop
+/// @param chunk The chunk where the jump is stored
+/// @param opCodeIndex The index of the jump (of OP_WIDE for a wide jump)
+/// @param offset The new offset of the jump
+static inline void chunk_optimizer_write_jump_offset(chunk_t * chunk, uint32_t opCodeIndex, uint32_t offset) {
+    if (chunk->code[opCodeIndex] == OP_WIDE) {
+        chunk->code[opCodeIndex + 2u] = (offset >> 24u) & 0xffu;
+        chunk->code[opCodeIndex + 3u] = (offset >> 16u) & 0xffu;
+        chunk->code[opCodeIndex + 4u] = (offset >> 8u) & 0xffu;
+        chunk->code[opCodeIndex + 5u] = offset & 0xffu;
+        return;
     }
+    chunk->code[opCodeIndex + 1u] = (offset >> 8u) & 0xffu;
+    chunk->code[opCodeIndex + 2u] = offset & 0xffu;
 }
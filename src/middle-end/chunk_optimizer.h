@@ -25,7 +25,8 @@
 
 /// @brief Optimizes the chunk by using different compiler optimization techniques
 /// @param chunk The chunk that is optimized
-/// @details At the moment only constant folding is used
+/// @details Numerical expressions that only consist of constants are folded and the most frequently executed sequences
+/// of instructions are replaced with superinstructions
 void chunk_optimizer_optimize_chunk(chunk_t * chunk);
 
 #endif
\ No newline at end of file
@@ -18,6 +18,26 @@ TEST(BinaryOperators, GreaterEqual) {
     test_cellox_program("binary_operators/greater_equal.clx", "true\ntrue\nfalse\n");
 }
 
+TEST(BinaryOperators, LocalOperands) {
+    test_cellox_program("binary_operators/local_operands.clx", "7\n4\n3\ntrue\ntrue\nfoobarfoo\n");
+}
+
+TEST(BinaryOperators, LocalOperandsNotNumbers) {
+    test_failing_cellox_program("binary_operators/local_operands_not_numbers.clx",
+                                "Operands must be numbers but they are a string object and a numerical value\n[line 2] in "
+                                "subtract()\n[line 4] in script\n");
+}
+
+TEST(BinaryOperators, QuickenedOperands) {
+    test_cellox_program("binary_operators/quickened_operands.clx", "3\ntrue\nfoobar\n7\ntrue\n");
+}
+
+TEST(BinaryOperators, QuickenedOperandsNotNumbers) {
+    test_failing_cellox_program("binary_operators/quickened_operands_not_numbers.clx",
+                                "Operands must be numbers but they are a numerical value and a string object\n[line 3] "
+                                "in lessThan()\n[line 7] in script\n");
+}
+
 TEST(BinaryOperators, minus) {
     test_cellox_program("binary_operators/minus.clx", "2\n");
 }
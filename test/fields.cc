@@ -73,6 +73,14 @@ TEST(Fields, SerializeProperties) {
     test_cellox_program("fields/serialize.clx", "{value: 10, text: \"test\"}\n");
 }
 
+TEST(Fields, ShadowCachedMethod) {
+    test_cellox_program("fields/shadow_cached_method.clx", "method method\nmethod method\nfield field\n");
+}
+
+TEST(Fields, Shapes) {
+    test_cellox_program("fields/shapes.clx", "3 7 13\n{x: 1, y: 2}\n{y: 3, x: 4, z: 5}\n{x: 6, y: 7, z: 8, w: 9}\n");
+}
+
 TEST(Fields, UndefienedProperty) {
     test_failing_cellox_program("fields/undefiened.clx", "Undefined property 'test'.\n[line 6] in script\n");
 }
\ No newline at end of file
@@ -6,6 +6,23 @@ TEST(Functions, duplicateParameter) {
     test_failing_cellox_program("functions/duplicate_parameter.clx", "[line 1] Error at 'a': Already a variable with this name in this scope.\n");
 }
 
+TEST(Functions, capturedVariables) {
+    test_cellox_program("functions/captured_variables.clx", "2\n3\n13\n23\n");
+}
+
+TEST(Functions, capturedByValue) {
+    test_cellox_program("functions/captured_by_value.clx", "Hello Cellox\n1110\n4\n0 1 4\n");
+}
+
+TEST(Functions, changingCallee) {
+    test_cellox_program("functions/changing_callee.clx",
+                        "0\n0\n10\ntrue\ntrue\n2\n1\n11\ntrue\ntrue\n4\n2\n12\ntrue\ntrue\n");
+}
+
+TEST(Functions, deepRecursion) {
+    test_cellox_program("functions/deep_recursion.clx", "500500\nafter\n");
+}
+
 TEST(Functions, emptyBody) {
     test_cellox_program("functions/empty_body.clx", "null\n");
 }
@@ -20,4 +37,12 @@ TEST(Functions, parameters) {
 
 TEST(Functions, recursion) {
     test_cellox_program("functions/recursion.clx", "21\n");
+}
+
+TEST(Functions, sharedClosure) {
+    test_cellox_program("functions/shared_closure.clx", "true\n42\nfalse\n1 2\n");
+}
+
+TEST(Functions, stackDepth) {
+    test_cellox_program("functions/stack_depth.clx", "500500\n");
 }
\ No newline at end of file
@@ -0,0 +1,24 @@
+#include <gtest/gtest.h>
+
+#include "test_cellox.hh"
+
+TEST(GarbageCollector, ConcurrentMarking) {
+    test_cellox_program("garbage_collector/concurrent_marking.clx", "30000 1.80012e+09\n");
+}
+
+TEST(GarbageCollector, IncrementalMarking) {
+    test_cellox_program("garbage_collector/incremental_marking.clx", "50000 1.25017e+09\n");
+}
+
+TEST(GarbageCollector, OldObjectsReferToYoungObjects) {
+    test_cellox_program("garbage_collector/old_objects_refer_to_young_objects.clx",
+                        "1.99998e+10 300000 300000\n100000 100000\n");
+}
+
+TEST(GarbageCollector, ParallelMarking) {
+    test_cellox_program("garbage_collector/parallel_marking.clx", "368580 1\n");
+}
+
+TEST(GarbageCollector, SizeClasses) {
+    test_cellox_program("garbage_collector/size_classes.clx", "4.99995e+10 100 2.97e+07\n");
+}
\ No newline at end of file
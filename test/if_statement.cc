@@ -10,6 +10,10 @@ TEST(If, FunctionInThen) {
     test_failing_cellox_program("if_statement/function_in_then.clx", "[line 2] Error at 'fun': Expect expression.\n");
 }
 
+TEST(If, LocalAfterThen) {
+    test_cellox_program("if_statement/local_after_then.clx", "then\nlocal\n");
+}
+
 TEST(If, Simple) {
     test_cellox_program("if_statement/simple.clx", "yes\nblock\ntrue\n");
 }
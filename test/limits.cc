@@ -6,8 +6,16 @@ TEST(Limits, FunTooManyArguments) {
     test_failing_cellox_program("limits/fun_too_many_arguments.clx", "[line 15] Error at '256': Can't have more than 255 arguments in a function call.\n");
 }
 
-TEST(Limits, LoopBodyTooLarge) {
-    test_failing_cellox_program("limits/loop_body_too_large.clx", "[line 2051] Error at '}': Loop body too large.\n");
+TEST(Limits, LargeIfBody) {
+    test_cellox_program("limits/large_if_body.clx", "3\n");
+}
+
+TEST(Limits, LargeLoopBody) {
+    test_cellox_program("limits/large_loop_body.clx", "3\n");
+}
+
+TEST(Limits, ManyConstants) {
+    test_cellox_program("limits/many_constants.clx", "300\n");
 }
 
 TEST(Limits, MethodTooManyArguments) {
@@ -23,10 +31,6 @@ TEST(Limits, TooLongArrayLiteral) {
                                 "[line 15] Error at '256': Can't have more than 255 arguments in a array literal expression.\n");
 }
 
-TEST(Limits, TooManyConstants) {
-    test_failing_cellox_program("limits/too_many_constants.clx", "[line 34] Error at '256': Too many constants in one chunk.\n");
-}
-
 TEST(Limits, TooManyLocals) {
     test_failing_cellox_program("limits/too_many_locals.clx", "[line 52] Error at 'v100': Too many local variables in function.\n");
 }
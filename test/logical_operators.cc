@@ -8,4 +8,8 @@ TEST(LogicalOperators, And) {
 
 TEST(LogicalOperators, Or) {
     test_cellox_program("logical_operators/or.clx", "false\ntrue\ntrue\nfalse\ntrue\ntrue\n");
-}
\ No newline at end of file
+}
+
+TEST(LogicalOperators, AndStatement) {
+    test_cellox_program("logical_operators/and_statement.clx", "0 1 2 g2 g3 g4 \n32\n");
+}
@@ -10,6 +10,15 @@ TEST(Methods, BindThis) {
     test_cellox_program("method/binds_this.clx", "foo1\n1\n");
 }
 
+TEST(Methods, BoundMethod) {
+    test_cellox_program("method/bound_method.clx", "3\n2\ntrue\nfalse\ntrue\na\n7\n13\nb\n");
+}
+
+TEST(Methods, CalledPropertyOnNumber) {
+    test_failing_cellox_program("method/called_property_on_number.clx",
+                                "Only instances have methods but a numerical value was invoked\n[line 2] in script\n");
+}
+
 TEST(Methods, Empty) {
     test_cellox_program("method/empty.clx", "null\n");
 }
@@ -22,6 +31,10 @@ TEST(Methods, MissingArguments) {
     test_failing_cellox_program("method/missing_arguments.clx", "Expected 2 arguments but got 1.\n[line 5] in script\n");
 }
 
+TEST(Methods, Polymorphic) {
+    test_cellox_program("method/polymorphic.clx", "ABCDEA\nABCDEA\n");
+}
+
 TEST(Methods, Simple) {
     test_cellox_program("method/simple.clx", "arg\n");
 }
\ No newline at end of file
@@ -14,6 +14,10 @@ TEST(NativeFunctions, ClassOf) {
     test_cellox_program("native_functions/class_of.clx", "Foo\ntrue\n");
 }
 
+TEST(NativeFunctions, Intrinsics) {
+    test_cellox_program("native_functions/intrinsics.clx", "8\n0\ntrue\n2\n84\n");
+}
+
 TEST(NativeFunctions, NumericalToAsci) {
     test_cellox_program("native_functions/numerical_to_asci.clx", "F");
 }
@@ -4,4 +4,12 @@
 
 TEST(Return, AtTopLevel) {
     test_failing_cellox_program("return/at_top_level.clx", "[line 1] Error at 'return': You can't use return from top-level code.\n");
-}
\ No newline at end of file
+}
+
+TEST(Return, TailCall) {
+    test_cellox_program("return/tail_call.clx", "20000\n4\n3\ncaptured\n");
+}
+
+TEST(Return, TailInvoke) {
+    test_cellox_program("return/tail_invoke.clx", "30000\ndone\n");
+}
@@ -2,6 +2,10 @@
 
 #include <gtest/gtest.h>
 
+TEST(Variable, AssignUndefined) {
+    test_failing_cellox_program("variable/assign_undefined.clx", "Undefined variable 'unassigned'.\n[line 1] in script\n");
+}
+
 TEST(Variable, ClassAsIdentifier) {
     test_failing_cellox_program("variable/class_as_identifier.clx", "[line 1] Error at 'class': Expect variable name.\n");
 }
@@ -18,6 +22,10 @@ TEST(Variable, FunAsIdentifier) {
     test_failing_cellox_program("variable/fun_as_identifier.clx", "[line 1] Error at 'fun': Expect variable name.\n");
 }
 
+TEST(Variable, LateBound) {
+    test_cellox_program("variable/late_bound.clx", "late\nbound\n");
+}
+
 TEST(Variable, NullAsIdentifier) {
     test_failing_cellox_program("variable/null_as_identifier.clx", "[line 1] Error at 'null': Expect variable name.\n");
 }